@@ -0,0 +1,462 @@
+#include "stdafx.h"
+
+// Load generator in the spirit of redis-benchmark, built on the library. Clients issue a configurable mix of
+// commands through a ClientRuntime, either as fast as possible (closed loop) or at a constant arrival rate (open
+// loop). Latencies are reported as recorded and corrected for coordinated omission. With the loopback transport
+// every client runs its own socketless connection to an in-process engine instead, which measures the client
+// overhead per operation without kernel and network.
+
+#include "redispp/ClientRuntime.h"
+#include "redispp/Commands.h"
+#include "redispp/HashCommands.h"
+#include "redispp/LoopbackConnectionManager.h"
+#include "redispp/Metrics.h"
+#include "redispp/SingleHostConnectionManager.h"
+#include "redispp/Transaction.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+    enum class Operation { Get, Set, Incr, HSet, Pipeline, Multi, Count };
+
+    const char* OperationNames[] = { "get", "set", "incr", "hset", "pipeline", "multi" };
+
+    struct Settings
+    {
+        std::string Hostname;
+        int Port;
+        size_t IOThreads;
+        size_t ConnectionsPerThread;
+        size_t Clients;
+        double Duration;
+        double Warmup;
+        std::array<double, static_cast<size_t>( Operation::Count )> Mix{};
+        size_t PipelineDepth;
+        size_t MinimumValueSize;
+        size_t MaximumValueSize;
+        size_t Keyspace;
+        double Zipf;
+        double Rate;
+        double ExpectedInterval;
+        bool LeastLoad;
+        bool Loopback;
+        uint64_t Seed;
+    };
+
+    // "get=50,set=40,pipeline=10"
+    bool parseMix( const std::string& Text, Settings& Options )
+    {
+        std::istringstream In( Text );
+        std::string Entry;
+        while( std::getline( In, Entry, ',' ) )
+        {
+            auto Separator = Entry.find( '=' );
+            if( Separator == std::string::npos )
+                return false;
+
+            auto Name = Entry.substr( 0, Separator );
+            auto Found = std::find( std::begin( OperationNames ), std::end( OperationNames ), Name );
+            if( Found == std::end( OperationNames ) )
+                return false;
+
+            Options.Mix[Found - std::begin( OperationNames )] = std::stod( Entry.substr( Separator + 1 ) );
+        }
+
+        return std::accumulate( Options.Mix.begin(), Options.Mix.end(), 0. ) > 0.;
+    }
+
+    // "64" or "16-1024"
+    bool parseValueSize( const std::string& Text, Settings& Options )
+    {
+        auto Separator = Text.find( '-' );
+        Options.MinimumValueSize = std::stoul( Text.substr( 0, Separator ) );
+        Options.MaximumValueSize = Separator == std::string::npos ? Options.MinimumValueSize : std::stoul( Text.substr( Separator + 1 ) );
+        return Options.MinimumValueSize <= Options.MaximumValueSize;
+    }
+
+    // draws key indices with probability proportional to 1 / rank^Exponent - uniform for Exponent 0
+    class KeyDistribution
+    {
+    public:
+        KeyDistribution( size_t Keyspace, double Exponent ) :
+            Keyspace_( Keyspace )
+        {
+            if( Exponent <= 0. )
+                return;
+
+            Cumulative_.reserve( Keyspace );
+            double Sum = 0.;
+            for( size_t Rank = 1; Rank <= Keyspace; ++Rank )
+            {
+                Sum += 1. / std::pow( static_cast<double>( Rank ), Exponent );
+                Cumulative_.push_back( Sum );
+            }
+            for( auto& Value : Cumulative_ )
+                Value /= Sum;
+        }
+
+        template <class GeneratorT_>
+        size_t operator()( GeneratorT_& Generator ) const
+        {
+            if( Cumulative_.empty() )
+                return std::uniform_int_distribution<size_t>( 0, Keyspace_ - 1 )( Generator );
+
+            auto Found = std::lower_bound( Cumulative_.begin(), Cumulative_.end(), std::uniform_real_distribution<double>()( Generator ) );
+            return std::min( static_cast<size_t>( Found - Cumulative_.begin() ), Cumulative_.size() - 1 );
+        }
+
+    private:
+        size_t Keyspace_;
+        std::vector<double> Cumulative_;
+    };
+
+    struct ClientResult
+    {
+        std::array<redis::LatencyHistogram, static_cast<size_t>( Operation::Count )> Latencies;
+        uint64_t Commands = 0;
+        uint64_t Errors = 0;
+        std::string FirstError;
+    };
+
+    // Adds the samples a closed-loop client missed while it waited for a slow reply - the same correction as
+    // HdrHistogram's recordValueWithExpectedInterval, applied to the merged histogram
+    redis::LatencySnapshot correctForCoordinatedOmission( const redis::LatencySnapshot& Measured, uint64_t ExpectedInterval )
+    {
+        auto Result = Measured;
+        if( !ExpectedInterval )
+            return Result;
+
+        for( size_t Index = 0; Index < Measured.Buckets.size(); ++Index )
+        {
+            auto Count = Measured.Buckets[Index];
+            if( !Count )
+                continue;
+
+            for( auto Missing = redis::LatencyHistogram::bucketValue( Index ); Missing >= 2 * ExpectedInterval; )
+            {
+                Missing -= ExpectedInterval;
+                Result.Buckets[redis::LatencyHistogram::bucketIndex( Missing )] += Count;
+                Result.Count += Count;
+                Result.Sum += Missing * Count;
+            }
+        }
+
+        return Result;
+    }
+
+    template <class ConnectionT_>
+    class Client
+    {
+    public:
+        Client( ConnectionT_& Connection, const Settings& Options, const std::vector<std::string>& Keys, const KeyDistribution& Keyspace, const std::string& Payload, size_t Index ) :
+            Connection_( Connection ),
+            Options_( Options ),
+            Keys_( Keys ),
+            Keyspace_( Keyspace ),
+            Payload_( Payload ),
+            Generator_( Options.Seed + Index ),
+            Operations_( Options.Mix.begin(), Options.Mix.end() ),
+            ValueSizes_( Options.MinimumValueSize, Options.MaximumValueSize )
+        {}
+
+        // runs until End - only requests started after MeasureFrom are recorded
+        void run( std::chrono::steady_clock::time_point MeasureFrom, std::chrono::steady_clock::time_point End, ClientResult& Result )
+        {
+            // open loop: every client issues a request each Interval - the latency counts from the intended start,
+            // so a stalled server cannot hide the requests it delayed
+            auto Interval = Options_.Rate > 0. ? std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( static_cast<double>( Options_.Clients ) / Options_.Rate ) ) : std::chrono::steady_clock::duration::zero();
+            auto Intended = std::chrono::steady_clock::now();
+
+            for( ;;)
+            {
+                auto Now = std::chrono::steady_clock::now();
+                if( Interval.count() )
+                {
+                    if( Intended > Now )
+                    {
+                        std::this_thread::sleep_until( Intended );
+                        Now = Intended;
+                    }
+                }
+                else
+                    Intended = Now;
+
+                if( Now >= End )
+                    break;
+
+                auto TheOperation = static_cast<Operation>( Operations_( Generator_ ) );
+                boost::system::error_code ec;
+                size_t Failed = 0;
+                auto Commands = execute( TheOperation, ec, Failed );
+                auto Completed = std::chrono::steady_clock::now();
+
+                if( Intended >= MeasureFrom )
+                {
+                    Result.Latencies[static_cast<size_t>( TheOperation )].record( static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( Completed - Intended ).count() ), !!ec );
+                    Result.Commands += Commands;
+                    if( ec )
+                    {
+                        if( !Result.Errors )
+                            Result.FirstError = ec.message() + " " + Connection_.lastServerError();
+                        Result.Errors += std::max( Failed, size_t( 1 ) );
+                    }
+                }
+
+                Intended += Interval;
+            }
+        }
+
+    private:
+        const std::string& key()
+        {
+            return Keys_[Keyspace_( Generator_ )];
+        }
+
+        boost::asio::const_buffer value()
+        {
+            return boost::asio::buffer( Payload_.data(), ValueSizes_( Generator_ ) );
+        }
+
+        // returns the number of commands sent - Failed is set to the number of failed commands of a pipeline
+        size_t execute( Operation TheOperation, boost::system::error_code& ec, size_t& Failed )
+        {
+            switch( TheOperation )
+            {
+            case Operation::Get:
+                redis::get( Connection_, ec, key() );
+                return 1;
+            case Operation::Set:
+                redis::set( Connection_, ec, key(), value() );
+                return 1;
+            case Operation::Incr:
+                redis::incr( Connection_, ec, key() );
+                return 1;
+            case Operation::HSet:
+                redis::hset( Connection_, ec, key(), std::string( "field" ), value() );
+                return 1;
+            case Operation::Pipeline:
+            {
+                redis::Pipeline Commands;
+                for( size_t Index = 0; Index < Options_.PipelineDepth; ++Index )
+                {
+                    if( Index % 2 )
+                        Commands << redis::getCommand( key() );
+                    else
+                        Commands << redis::setCommand( key(), value() );
+                }
+                auto Replies = Connection_.transmit( Commands, ec );
+
+                // the pipeline succeeds even if some of its commands were rejected
+                for( size_t Index = 0; !ec && Index < Replies.size(); ++Index )
+                {
+                    if( Replies[Index].type() == redis::Response::Type::Error && !Failed++ )
+                        Connection_.setLastServerError( Replies[Index].string() );
+                }
+                if( Failed )
+                    ec = redis::make_error_code( redis::ErrorCodes::server_error );
+                return Options_.PipelineDepth;
+            }
+            case Operation::Multi:
+            {
+                const auto& Key = key();
+                redis::Transaction<>()
+                    .add( redis::incrCommand( Key ), &redis::incrResult )
+                    .add( redis::setCommand( Key + ":value", value() ), &redis::OKResult )
+                    .exec( Connection_, ec );
+                return 4;
+            }
+            default:
+                return 0;
+            }
+        }
+
+        ConnectionT_& Connection_;
+        const Settings& Options_;
+        const std::vector<std::string>& Keys_;
+        const KeyDistribution& Keyspace_;
+        const std::string& Payload_;
+        std::mt19937_64 Generator_;
+        std::discrete_distribution<size_t> Operations_;
+        std::uniform_int_distribution<size_t> ValueSizes_;
+    };
+
+    void report( const char* Name, const redis::LatencySnapshot& Measured, const redis::LatencySnapshot& Corrected, double Seconds )
+    {
+        auto line = []( const char* Label, const redis::LatencySnapshot& Latencies )
+        {
+            std::cout << "  " << std::left << std::setw( 12 ) << Label << std::right;
+            for( auto Percentile : { 50., 90., 99., 99.9, 99.99 } )
+                std::cout << std::setw( 12 ) << std::fixed << std::setprecision( 1 ) << Latencies.percentile( Percentile ) / 1000.;
+            std::cout << std::setw( 12 ) << Latencies.Maximum / 1000. << "\n";
+        };
+
+        std::cout << "== " << Name << ": " << Measured.Count << " requests, " << std::fixed << std::setprecision( 1 )
+                  << Measured.Count / Seconds << " requests/s, " << Measured.Failures << " errors\n"
+                  << "  latency us          p50         p90         p99       p99.9      p99.99         max\n";
+        line( "measured", Measured );
+        line( "corrected", Corrected );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    Settings Options;
+    std::string Mix;
+    std::string ValueSize;
+    std::string Dispatch;
+    std::string Transport;
+
+    try
+    {
+        po::options_description CommandlineOptionsDescription( "Usage: benchmark [OPTIONS]" );
+        CommandlineOptionsDescription.add_options()
+            ("help",                                                                                                        "Output this text and exit")
+            ("hostname,h",          po::value<std::string>(&Options.Hostname)->default_value("127.0.0.1"),                 "Server hostname")
+            ("port,p",              po::value<int>(&Options.Port)->default_value(6379),                                    "Server port")
+            ("threads,t",           po::value<size_t>(&Options.IOThreads)->default_value(1),                               "I/O threads of the client runtime")
+            ("connections",         po::value<size_t>(&Options.ConnectionsPerThread)->default_value(1),                    "Connections per I/O thread")
+            ("clients,c",           po::value<size_t>(&Options.Clients)->default_value(50),                                "Clients issuing requests concurrently")
+            ("duration,d",          po::value<double>(&Options.Duration)->default_value(10.),                              "Measured seconds")
+            ("warmup",              po::value<double>(&Options.Warmup)->default_value(1.),                                 "Seconds before the measurement starts")
+            ("mix,m",               po::value<std::string>(&Mix)->default_value("get=50,set=50"),                          "Weighted command mix of get, set, incr, hset, pipeline, multi")
+            ("pipeline,P",          po::value<size_t>(&Options.PipelineDepth)->default_value(16),                          "Commands per pipeline request")
+            ("value-size,s",        po::value<std::string>(&ValueSize)->default_value("64"),                               "Value size in bytes - fixed (64) or uniform in a range (16-1024)")
+            ("keyspace,k",          po::value<size_t>(&Options.Keyspace)->default_value(100000),                           "Number of distinct keys")
+            ("zipf,z",              po::value<double>(&Options.Zipf)->default_value(0.),                                   "Key skew exponent - 0 is uniform, 0.99 is typical for caches")
+            ("rate,r",              po::value<double>(&Options.Rate)->default_value(0.),                                   "Requests per second of all clients (open loop) - 0 is closed loop")
+            ("expected-interval",   po::value<double>(&Options.ExpectedInterval)->default_value(0.),                       "Closed loop: expected microseconds between requests of a client for the correction - 0 uses the mean latency")
+            ("dispatch",            po::value<std::string>(&Dispatch)->default_value("key"),                               "Dispatch to the I/O threads by key or to the least loaded - key or load")
+            ("transport",           po::value<std::string>(&Transport)->default_value("tcp"),                              "tcp or loopback - an in-process engine without sockets, measures the client overhead")
+            ("seed",                po::value<uint64_t>(&Options.Seed)->default_value(1),                                  "Seed of the random generators")
+            ;
+
+        po::variables_map CommandlineOptions;
+        po::store( po::command_line_parser( argc, argv )
+                   .options( CommandlineOptionsDescription )
+                   .run(),
+                   CommandlineOptions );
+
+        po::notify( CommandlineOptions );
+
+        if( CommandlineOptions.count( "help" ) )
+        {
+            std::cerr << CommandlineOptionsDescription << std::endl;
+            return 8;
+        }
+
+        if( !parseMix( Mix, Options ) || !parseValueSize( ValueSize, Options ) || !Options.Clients || !Options.Keyspace || !Options.PipelineDepth )
+        {
+            std::cerr << "invalid options\n" << CommandlineOptionsDescription << std::endl;
+            return 8;
+        }
+        Options.LeastLoad = Dispatch == "load";
+        Options.Loopback = Transport == "loopback";
+
+        std::vector<std::string> Keys;
+        Keys.reserve( Options.Keyspace );
+        for( size_t Index = 0; Index < Options.Keyspace; ++Index )
+            Keys.push_back( "benchmark:" + std::to_string( Index ) );
+        std::string Payload( std::max( Options.MaximumValueSize, size_t( 1 ) ), 'x' );
+        KeyDistribution Keyspace( Options.Keyspace, Options.Zipf );
+
+        redis::SingleHostConnectionManager Server( redis::Host{ Options.Hostname, Options.Port } );
+        std::unique_ptr<redis::ClientRuntime<redis::SingleHostConnectionManager>> spRuntime;
+        if( !Options.Loopback )
+        {
+            redis::ClientRuntimeOptions RuntimeOptions;
+            RuntimeOptions.Threads = Options.IOThreads;
+            RuntimeOptions.ConnectionsPerThread = Options.ConnectionsPerThread;
+            RuntimeOptions.Dispatch = Options.LeastLoad ? redis::DispatchPolicy::LeastLoad : redis::DispatchPolicy::KeyAffinity;
+            spRuntime = std::make_unique<redis::ClientRuntime<redis::SingleHostConnectionManager>>( Server, RuntimeOptions );
+
+            boost::system::error_code ec;
+            redis::ping( *spRuntime, ec );
+            if( ec )
+            {
+                std::cerr << "server " << Options.Hostname << ":" << Options.Port << " not reachable: " << ec.message() << std::endl;
+                return 2;
+            }
+        }
+
+        std::cout << Options.Clients << " clients, "
+                  << (spRuntime ? std::to_string( spRuntime->threads() ) + " I/O threads, " + std::to_string( Options.ConnectionsPerThread ) + " connections per thread, " : std::string( "loopback transport, " ))
+                  << (Options.Rate > 0. ? "open loop at " + std::to_string( static_cast<uint64_t>( Options.Rate ) ) + " requests/s" : std::string( "closed loop" )) << "\n";
+
+        std::vector<ClientResult> Results( Options.Clients );
+        std::vector<std::thread> Threads;
+        auto Start = std::chrono::steady_clock::now();
+        auto MeasureFrom = Start + std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( Options.Warmup ) );
+        auto End = MeasureFrom + std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( Options.Duration ) );
+        for( size_t Index = 0; Index < Options.Clients; ++Index )
+            Threads.emplace_back( [&, Index]()
+            {
+                if( spRuntime )
+                {
+                    Client<redis::ClientRuntime<redis::SingleHostConnectionManager>> TheClient( *spRuntime, Options, Keys, Keyspace, Payload, Index );
+                    TheClient.run( MeasureFrom, End, Results[Index] );
+                    return;
+                }
+
+                // an engine per client - the clients do not contend for its lock
+                redis::MockEngine Engine;
+                redis::LoopbackConnectionManager Loopback( Engine );
+                boost::asio::io_service io_service;
+                redis::Connection<redis::LoopbackConnectionManager> Connection( io_service, Loopback );
+                Client<decltype( Connection )> TheClient( Connection, Options, Keys, Keyspace, Payload, Index );
+                TheClient.run( MeasureFrom, End, Results[Index] );
+            } );
+        for( auto& Thread : Threads )
+            Thread.join();
+
+        redis::LatencySnapshot Total;
+        uint64_t Commands = 0;
+        for( size_t Type = 0; Type < static_cast<size_t>( Operation::Count ); ++Type )
+        {
+            redis::LatencySnapshot Measured;
+            for( const auto& Result : Results )
+                Measured.add( Result.Latencies[Type] );
+            if( !Measured.Count )
+                continue;
+
+            auto ExpectedInterval = Options.Rate > 0. ? 0 : (Options.ExpectedInterval > 0. ? static_cast<uint64_t>( Options.ExpectedInterval * 1000. ) : Measured.mean());
+            report( OperationNames[Type], Measured, correctForCoordinatedOmission( Measured, ExpectedInterval ), Options.Duration );
+
+            for( const auto& Result : Results )
+                Total.add( Result.Latencies[Type] );
+        }
+
+        std::string FirstError;
+        uint64_t Errors = 0;
+        for( const auto& Result : Results )
+        {
+            Commands += Result.Commands;
+            Errors += Result.Errors;
+            if( FirstError.empty() )
+                FirstError = Result.FirstError;
+        }
+
+        std::cout << "== total: " << Total.Count << " requests, " << Commands << " commands, " << std::fixed << std::setprecision( 1 )
+                  << Commands / Options.Duration << " commands/s, " << Errors << " errors\n";
+        if( Errors )
+            std::cout << "first error: " << FirstError << "\n";
+
+        if( spRuntime )
+        {
+            auto Statistics = spRuntime->statistics();
+            std::cout << "runtime: " << Statistics.Submissions << " submissions, " << Statistics.Writes << " writes, "
+                      << Statistics.Stalls << " stalls, " << Statistics.Reconnects << " reconnects\n";
+        }
+        else if( Total.Count && Commands )
+            // includes the engine executing the commands
+            std::cout << "client overhead: " << std::setprecision( 0 ) << static_cast<double>( Total.Sum ) / Total.Count << " ns per request, "
+                      << static_cast<double>( Total.Sum ) / Commands << " ns per command\n";
+    }
+    catch( std::exception& e )
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
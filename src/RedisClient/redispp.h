@@ -6,13 +6,23 @@
 // Copyright Soenke K. Schau 2016-2017
 // See accompanying file LICENSE.txt for Lincense
 
+#include <type_traits>
+
 namespace redis
 {
     using Host = std::tuple<std::string, int>;
 
+    // levels of the notification sink functions - from the most to the least verbose
+    enum class NotificationLevel
+    {
+        debug, trace, warning, error, off
+    };
+
     class NullNotificationSink
     {
     public:
+        static constexpr NotificationLevel MinimumLevel = NotificationLevel::off;
+
         template <typename... Args>
         void debug( const Args & ... args ) {}
         template <typename... Args>
@@ -22,8 +32,50 @@ namespace redis
         template <typename... Args>
         void error( const Args & ... args ) {}
     };
+
+    namespace Detail
+    {
+        // A sink may declare the least verbose level it is interested in at compile time:
+        //   static constexpr redis::NotificationLevel MinimumLevel = redis::NotificationLevel::warning;
+        template <class SinkT_, class = void>
+        struct SinkMinimumLevel
+        {
+            static constexpr NotificationLevel value = NotificationLevel::debug;
+        };
+
+        template <class SinkT_>
+        struct SinkMinimumLevel<SinkT_, typename std::enable_if<std::is_same<decltype(std::decay<SinkT_>::type::MinimumLevel), const NotificationLevel>::value>::type>
+        {
+            static constexpr NotificationLevel value = std::decay<SinkT_>::type::MinimumLevel;
+        };
+
+        // ... and may decide at runtime with: bool enabled( redis::NotificationLevel Level ) const
+        template <class SinkT_>
+        auto sinkEnabled( const SinkT_& Sink, NotificationLevel Level, int ) -> decltype( static_cast<bool>( Sink.enabled( Level ) ) )
+        {
+            return Sink.enabled( Level );
+        }
+
+        template <class SinkT_>
+        bool sinkEnabled( const SinkT_&, NotificationLevel, long )
+        {
+            return true;
+        }
+    }
+
+    // returns true if Sink wants notifications of Level_ - constant false for levels excluded at compile time
+    template <NotificationLevel Level_, class SinkT_>
+    bool notificationEnabled( const SinkT_& Sink )
+    {
+        return Level_ >= Detail::SinkMinimumLevel<SinkT_>::value && Detail::sinkEnabled( Sink, Level_, 0 );
+    }
 }
 
+// Calls Sink.Level( ... ) only if the level is enabled - otherwise the arguments are not evaluated at all, so debug
+// notifications on the hot path cost nothing with a NullNotificationSink or a sink set to a less verbose level.
+#define REDISPP_NOTIFY( Sink, Level, ... ) \
+    do { if( ::redis::notificationEnabled< ::redis::NotificationLevel::Level>( Sink ) ) (Sink).Level( __VA_ARGS__ ); } while( false )
+
 inline std::ostream& operator<<( std::ostream& Out, const redis::Host& h )
 {
     Out << "[" << std::get<0>(h) << ":" << std::get<1>(h) << "]";
@@ -0,0 +1,320 @@
+#pragma once
+
+#ifndef REDISPP_BULKLOADER_INCLUDED
+#define REDISPP_BULKLOADER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "redispp/Commands.h"
+#include "redispp/Connection.h"
+#include "redispp/ReplyCounter.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    // A command rejected by the server
+    struct BulkLoadError
+    {
+        // position of the command in the loaded data, starting with 0
+        size_t CommandIndex;
+        std::string Message;
+    };
+
+    struct BulkLoadResult
+    {
+        size_t Commands = 0;
+        size_t Replies = 0;
+        size_t BytesSent = 0;
+        std::vector<BulkLoadError> Errors;
+    };
+
+    // Mass insertion, like redis-cli --pipe: commands are written with large writes on a dedicated connection while
+    // the replies are read concurrently. The replies are only counted - error replies are collected with the index
+    // of their command - so the server is never waited for but at the end.
+    // A database Index other than 0 is selected before the commands are written; its reply is not counted.
+    // A loader runs one load at a time on the calling thread.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class BulkLoader
+    {
+    public:
+        // maximum size of a single write
+        static constexpr size_t DefaultSendWindow = 4 * 1024 * 1024;
+        static constexpr size_t ReceiveBufferSize = 256 * 1024;
+
+        BulkLoader( const BulkLoader& ) = delete;
+        BulkLoader& operator=( const BulkLoader& ) = delete;
+
+        BulkLoader( const ConnectionManagerType& Manager, size_t SendWindow = DefaultSendWindow, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            SendWindow_( SendWindow ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink ),
+            Socket_( io_service_ ),
+            ReceiveBuffer_( ReceiveBufferSize )
+        {}
+
+        // Loads a file of RESP encoded commands - as written for redis-cli --pipe. The file is memory mapped and
+        // written directly from the mapping.
+        BulkLoadResult loadFile( const std::string& FileName, boost::system::error_code& ec )
+        {
+            try
+            {
+                boost::interprocess::file_mapping Mapping( FileName.c_str(), boost::interprocess::read_only );
+                boost::interprocess::mapped_region Region( Mapping, boost::interprocess::read_only );
+                Region.advise( boost::interprocess::mapped_region::advice_sequential );
+
+                return load( boost::asio::const_buffer( Region.get_address(), Region.get_size() ), ec );
+            }
+            catch( const boost::interprocess::interprocess_exception& e )
+            {
+                NotificationSink_.error( "BulkLoader::loadFile: unable to map '{}': {}", FileName, e.what() );
+                ec = boost::system::error_code( e.get_native_error(), boost::system::system_category() );
+                return BulkLoadResult();
+            }
+        }
+
+        // Loads RESP encoded commands. The data is written in slices of the send window, which need not end at a
+        // command boundary - the commands are counted on the way to know how many replies to wait for.
+        BulkLoadResult load( boost::asio::const_buffer Data, boost::system::error_code& ec )
+        {
+            ReplyCounter Commands;
+            auto pData = boost::asio::buffer_cast<const char*>(Data);
+            size_t Remaining = boost::asio::buffer_size( Data );
+
+            auto Result = run( [&]( std::vector<boost::asio::const_buffer>& Chunk, size_t& ChunkCommands )
+            {
+                if( !Remaining )
+                    return false;
+
+                auto Size = std::min( Remaining, SendWindow_ );
+                ChunkCommands = Commands.consume( pData, Size );
+                // invalid data is not sent
+                if( Commands.failed() )
+                    return false;
+
+                Chunk.push_back( boost::asio::buffer( pData, Size ) );
+                pData += Size;
+                Remaining -= Size;
+                return true;
+            }, ec );
+
+            if( !ec && (Commands.failed() || !Commands.idle()) )
+            {
+                NotificationSink_.error( "BulkLoader::load: invalid or truncated data after {} commands", Result.Commands );
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            }
+
+            return Result;
+        }
+
+        // Loads the commands of a range of Request objects - encoded in batches of about the send window
+        template <class InputIteratorT_>
+        BulkLoadResult load( InputIteratorT_ First, InputIteratorT_ Last, boost::system::error_code& ec )
+        {
+            std::unique_ptr<Pipeline> spBatch;
+
+            return run( [&]( std::vector<boost::asio::const_buffer>& Chunk, size_t& ChunkCommands )
+            {
+                // the previous batch has been written completely
+                spBatch = std::make_unique<Pipeline>();
+                size_t Size = 0;
+                for( ; First != Last && Size < SendWindow_; ++First )
+                    Size += addToBatch( *spBatch, *First );
+
+                ChunkCommands = spBatch->requestCount();
+                Chunk = spBatch->bufferSequence();
+                return ChunkCommands != 0;
+            }, ec );
+        }
+
+    private:
+        using ChunkSourceType = std::function<bool( std::vector<boost::asio::const_buffer>& Chunk, size_t& ChunkCommands )>;
+
+        static size_t addToBatch( Pipeline& Batch, const Request& Command )
+        {
+            Batch.add( Command );
+            return boost::asio::buffer_size( Command.bufferSequence() );
+        }
+
+        static size_t addToBatch( Pipeline& Batch, Request&& Command )
+        {
+            auto Size = boost::asio::buffer_size( Command.bufferSequence() );
+            Batch << std::move( Command );
+            return Size;
+        }
+
+        BulkLoadResult run( ChunkSourceType NextChunk, boost::system::error_code& ec )
+        {
+            Result_ = BulkLoadResult();
+            Replies_ = ReplyCounter();
+            InputDone_ = false;
+            ec_.clear();
+            NextChunk_ = std::move( NextChunk );
+
+            io_service_.reset();
+            Socket_ = ConnectionManagerInstance_.getConnectedSocket( io_service_, ec );
+            if( ec )
+            {
+                NotificationSink_.error( "BulkLoader::run: unable to connect: {}", ec.message() );
+                return Result_;
+            }
+
+            boost::system::error_code Ignored;
+            if( Index_ && !select( ec ) )
+            {
+                Socket_.close( Ignored );
+                NextChunk_ = nullptr;
+                return Result_;
+            }
+
+            Socket_.set_option( boost::asio::socket_base::send_buffer_size( static_cast<int>(std::min<size_t>( SendWindow_, 16 * 1024 * 1024 )) ), Ignored );
+
+            send();
+            // no reply to wait for if nothing was sent, e.g. for invalid data
+            if( !completed() )
+                receive();
+            io_service_.run();
+
+            Socket_.close( Ignored );
+            NextChunk_ = nullptr;
+
+            Result_.Replies = Replies_.replies();
+            ec = ec_;
+            REDISPP_NOTIFY( NotificationSink_, debug, "BulkLoader::run: {} commands, {} bytes, {} errors", Result_.Commands, Result_.BytesSent, Result_.Errors.size() );
+            return Result_;
+        }
+
+        // selects the database - its reply is read before any command is written, so it is not counted
+        bool select( boost::system::error_code& ec )
+        {
+            boost::asio::write( Socket_, selectCommand( Index_ ).bufferSequence(), ec );
+            if( ec )
+                return false;
+
+            ReplyCounter Confirmation;
+            std::string Error;
+            while( !Confirmation.replies() )
+            {
+                auto BytesRead = Socket_.read_some( boost::asio::buffer( ReceiveBuffer_ ), ec );
+                if( ec )
+                    return false;
+
+                Confirmation.consume( ReceiveBuffer_.data(), BytesRead, [&Error]( size_t ReplyIndex, boost::string_view Message ) { Error = Message.to_string(); } );
+                if( Confirmation.failed() )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return false;
+                }
+            }
+
+            if( !Error.empty() )
+            {
+                NotificationSink_.error( "BulkLoader::select: unable to select database {}: {}", Index_, Error );
+                ec = ::redis::make_error_code( ErrorCodes::server_error );
+                return false;
+            }
+            return true;
+        }
+
+        bool completed() const
+        {
+            return InputDone_ && Replies_.replies() >= Result_.Commands;
+        }
+
+        void send()
+        {
+            Chunk_.clear();
+            size_t ChunkCommands = 0;
+            if( !NextChunk_( Chunk_, ChunkCommands ) )
+            {
+                InputDone_ = true;
+                // all replies may have arrived already
+                if( completed() )
+                {
+                    boost::system::error_code Ignored;
+                    Socket_.cancel( Ignored );
+                }
+                return;
+            }
+
+            Result_.Commands += ChunkCommands;
+            boost::asio::async_write( Socket_, Chunk_, [this]( const boost::system::error_code& ec, std::size_t BytesSent ) {
+                if( ec )
+                {
+                    fail( ec );
+                    return;
+                }
+
+                Result_.BytesSent += BytesSent;
+                send();
+            } );
+        }
+
+        void receive()
+        {
+            Socket_.async_read_some( boost::asio::buffer( ReceiveBuffer_ ), [this]( const boost::system::error_code& ec, std::size_t BytesReceived ) {
+                if( completed() || ec_ )
+                    return;
+
+                if( ec )
+                {
+                    fail( ec );
+                    return;
+                }
+
+                Replies_.consume( ReceiveBuffer_.data(), BytesReceived, [this]( size_t ReplyIndex, boost::string_view Message ) {
+                    Result_.Errors.push_back( BulkLoadError{ ReplyIndex, Message.to_string() } );
+                } );
+
+                if( Replies_.failed() )
+                {
+                    fail( ::redis::make_error_code( ErrorCodes::protocol_error ) );
+                    return;
+                }
+
+                if( !completed() )
+                    receive();
+            } );
+        }
+
+        void fail( const boost::system::error_code& ec )
+        {
+            if( ec_ )
+                return;
+
+            NotificationSink_.error( "BulkLoader::fail: load aborted after {} replies: {}", Replies_.replies(), ec.message() );
+            ec_ = ec;
+
+            boost::system::error_code Ignored;
+            Socket_.close( Ignored );
+        }
+
+        typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        const size_t SendWindow_;
+        const int64_t Index_;
+        NotificationSinkType_ NotificationSink_;
+
+        boost::asio::io_service io_service_;
+        boost::asio::ip::tcp::socket Socket_;
+        std::vector<char> ReceiveBuffer_;
+        std::vector<boost::asio::const_buffer> Chunk_;
+
+        // state of the current load
+        ChunkSourceType NextChunk_;
+        BulkLoadResult Result_;
+        ReplyCounter Replies_;
+        bool InputDone_ = false;
+        boost::system::error_code ec_;
+    };
+}
+
+#endif
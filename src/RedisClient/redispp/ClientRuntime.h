@@ -0,0 +1,335 @@
+#pragma once
+
+#ifndef REDISPP_CLIENTRUNTIME_INCLUDED
+#define REDISPP_CLIENTRUNTIME_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "redispp/SharedConnection.h"
+#include "redispp/CommandKeys.h"
+#include "redispp/KeyHash.h"
+
+// windows.h comes last and without its min/max macros - the calls of max are parenthesized in case it has been
+// included before
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define REDISPP_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#define REDISPP_UNDEF_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef REDISPP_UNDEF_WIN32_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef REDISPP_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifdef REDISPP_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef REDISPP_UNDEF_NOMINMAX
+#endif
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace redis
+{
+    enum class DispatchPolicy
+    {
+        // requests with the same key use the same connection, so they are executed in the order of submission
+        KeyAffinity,
+        // requests go to the thread with the fewest outstanding requests - no ordering between requests
+        LeastLoad
+    };
+
+    struct ClientRuntimeOptions
+    {
+        // number of I/O threads - 0 uses one per core
+        size_t Threads = 0;
+        size_t ConnectionsPerThread = 1;
+        // binds I/O thread n to core n
+        bool PinThreads = false;
+        DispatchPolicy Dispatch = DispatchPolicy::KeyAffinity;
+        // database selected on every connection
+        int64_t Index = 0;
+    };
+
+    namespace Detail
+    {
+        // binds a thread to a core - returns false if not supported or failed
+        inline bool pinThread( std::thread& Thread, size_t Core )
+        {
+#if defined(_WIN32)
+            return SetThreadAffinityMask( Thread.native_handle(), DWORD_PTR( 1 ) << (Core % (sizeof( DWORD_PTR ) * 8)) ) != 0;
+#elif defined(__linux__)
+            cpu_set_t Cores;
+            CPU_ZERO( &Cores );
+            CPU_SET( Core % CPU_SETSIZE, &Cores );
+            return pthread_setaffinity_np( Thread.native_handle(), sizeof( Cores ), &Cores ) == 0;
+#else
+            return false;
+#endif
+        }
+    }
+
+    // Client driving its connections with several I/O threads, each running an io_service of its own with its own set
+    // of SharedConnections - so the I/O scales with the number of cores instead of being bound to one event loop.
+    // Requests are dispatched by the hash of their key (see requestKey) or to the least loaded thread; requests without
+    // a key always go to the least loaded thread. It is used like a connection, with the synchronous and the
+    // asynchronous commands, from any number of threads.
+    // The asynchronous handlers are called on the I/O threads - use postingTo to have them called on an io_service
+    // of the caller instead.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class ClientRuntime
+    {
+    public:
+        using ConnectionType = SharedConnection<ConnectionManagerType, NotificationSinkType_>;
+
+        ClientRuntime( const ClientRuntime& ) = delete;
+        ClientRuntime& operator=( const ClientRuntime& ) = delete;
+
+        ClientRuntime( const ConnectionManagerType& Manager, ClientRuntimeOptions Options = ClientRuntimeOptions{}, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            Options_( Options ),
+            NotificationSink_( NotificationSink )
+        {
+            if( !Options_.Threads )
+                Options_.Threads = (std::max)( std::thread::hardware_concurrency(), 1u );
+            Options_.ConnectionsPerThread = (std::max)( Options_.ConnectionsPerThread, size_t( 1 ) );
+
+            for( size_t Index = 0; Index < Options_.Threads; ++Index )
+            {
+                auto spShard = std::make_unique<Shard>();
+                for( size_t Connection = 0; Connection < Options_.ConnectionsPerThread; ++Connection )
+                    spShard->Connections_.push_back( std::make_unique<ConnectionType>( spShard->Service_, Manager, Options_.Index, NotificationSink_ ) );
+
+                spShard->Thread_ = std::thread( [pShard = spShard.get()]() { pShard->Service_.run(); } );
+                if( Options_.PinThreads && !Detail::pinThread( spShard->Thread_, Index ) )
+                    NotificationSink_.warning( "ClientRuntime::ClientRuntime: unable to pin thread {}", Index );
+
+                Shards_.push_back( std::move( spShard ) );
+            }
+        }
+
+        // all requests have to be completed - outstanding ones fail with operation_aborted
+        ~ClientRuntime()
+        {
+            for( auto& spShard : Shards_ )
+                spShard->Service_.stop();
+            for( auto& spShard : Shards_ )
+                spShard->Thread_.join();
+        }
+
+        auto transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            auto Target = route( Command );
+            Load TheLoad( *Target.first );
+            return Target.second->transmit( Command, ec );
+        }
+
+        // all requests of the pipeline use the connection of the first one
+        auto transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            auto Target = thePipeline.requestCount() ? route( *thePipeline.requests().front() ) : leastLoaded();
+            Load TheLoad( *Target.first );
+            return Target.second->transmit( thePipeline, ec );
+        }
+
+        // the handler is called on an I/O thread - Command has to stay valid until then
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            using handler_type = typename boost::asio::handler_type<CompletionToken,
+                void( boost::system::error_code, const Response& Data )>::type;
+            handler_type handler( std::forward<decltype(token)>( token ) );
+            boost::asio::async_result<decltype(handler)> result( handler );
+
+            auto Target = route( Command );
+            auto pShard = Target.first;
+            pShard->Load_.fetch_add( 1, std::memory_order_relaxed );
+            Target.second->async_transmit( Command, [pShard, handler]( const boost::system::error_code& ec, const typename ConnectionType::Reply& Data ) mutable
+            {
+                pShard->Load_.fetch_sub( 1, std::memory_order_relaxed );
+                handler( ec, Data.top() );
+            } );
+
+            return result.get();
+        }
+
+        // View of the runtime calling the asynchronous handlers on CallerService - e.g.
+        //   redis::async_get( Runtime.postingTo( MyService ), Handler, Key );
+        class Poster
+        {
+        public:
+            Poster( ClientRuntime& Runtime, boost::asio::io_service& CallerService ) :
+                Runtime_( Runtime ),
+                CallerService_( CallerService )
+            {}
+
+            auto transmit( const Request& Command, boost::system::error_code& ec )
+            {
+                return Runtime_.transmit( Command, ec );
+            }
+
+            auto transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+            {
+                return Runtime_.transmit( thePipeline, ec );
+            }
+
+            template <class	CompletionToken>
+            auto async_command( const Request& Command, CompletionToken&& token )
+            {
+                using handler_type = typename boost::asio::handler_type<CompletionToken,
+                    void( boost::system::error_code, const Response& Data )>::type;
+                handler_type handler( std::forward<decltype(token)>( token ) );
+                boost::asio::async_result<decltype(handler)> result( handler );
+
+                auto Target = Runtime_.route( Command );
+                auto pShard = Target.first;
+                pShard->Load_.fetch_add( 1, std::memory_order_relaxed );
+                Target.second->async_transmit( Command, [pShard, &Service = CallerService_, handler]( const boost::system::error_code& ec, const typename ConnectionType::Reply& Data ) mutable
+                {
+                    pShard->Load_.fetch_sub( 1, std::memory_order_relaxed );
+
+                    // the reply keeps the received buffers alive until the handler has run
+                    Service.post( [handler, ec, Data]() mutable { handler( ec, Data.top() ); } );
+                } );
+
+                return result.get();
+            }
+
+            std::string lastServerError() const
+            {
+                return Runtime_.lastServerError();
+            }
+            void setLastServerError( const std::string& LastServerError )
+            {
+                Runtime_.setLastServerError( LastServerError );
+            }
+
+        private:
+            ClientRuntime& Runtime_;
+            boost::asio::io_service& CallerService_;
+        };
+
+        Poster postingTo( boost::asio::io_service& CallerService )
+        {
+            return Poster( *this, CallerService );
+        }
+
+        size_t threads() const { return Shards_.size(); }
+
+        // sum of the counters of all connections
+        SharedConnectionStatistics statistics() const
+        {
+            SharedConnectionStatistics Result;
+            for( const auto& spShard : Shards_ )
+            {
+                for( const auto& spConnection : spShard->Connections_ )
+                {
+                    auto Current = spConnection->statistics();
+                    Result.Submissions += Current.Submissions;
+                    Result.Writes += Current.Writes;
+                    Result.Stalls += Current.Stalls;
+                    Result.Reconnects += Current.Reconnects;
+                }
+            }
+            return Result;
+        }
+
+        // last server error of any thread using the runtime
+        std::string lastServerError() const
+        {
+            std::lock_guard<std::mutex> Lock( ServerErrorMutex_ );
+            return LastServerError_;
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            std::lock_guard<std::mutex> Lock( ServerErrorMutex_ );
+            LastServerError_ = LastServerError;
+        }
+
+    private:
+        struct Shard
+        {
+            boost::asio::io_service Service_;
+            boost::asio::io_service::work Work_{ Service_ };
+            std::vector<std::unique_ptr<ConnectionType>> Connections_;
+            // outstanding requests
+            alignas(Detail::CacheLineSize) std::atomic<size_t> Load_{ 0 };
+            std::thread Thread_;
+        };
+
+        // counts a synchronous request as outstanding while it is alive
+        class Load
+        {
+        public:
+            explicit Load( Shard& TheShard ) :
+                Shard_( TheShard )
+            {
+                Shard_.Load_.fetch_add( 1, std::memory_order_relaxed );
+            }
+            ~Load()
+            {
+                Shard_.Load_.fetch_sub( 1, std::memory_order_relaxed );
+            }
+
+        private:
+            Shard& Shard_;
+        };
+
+        using Target = std::pair<Shard*, ConnectionType*>;
+
+        Target route( const Request& Command )
+        {
+            boost::asio::const_buffer Key;
+            if( Options_.Dispatch == DispatchPolicy::LeastLoad || !requestKey( Command, Key ) )
+                return leastLoaded();
+
+            auto Slot = keyRingHash( Key ) % (Shards_.size() * Options_.ConnectionsPerThread);
+            auto& TheShard = *Shards_[Slot / Options_.ConnectionsPerThread];
+            return Target( &TheShard, TheShard.Connections_[Slot % Options_.ConnectionsPerThread].get() );
+        }
+
+        Target leastLoaded()
+        {
+            // start at a rotating position, so equally loaded threads are used in turn
+            auto Start = Next_.fetch_add( 1, std::memory_order_relaxed );
+            Shard* pBest = nullptr;
+            size_t BestLoad = (std::numeric_limits<size_t>::max)();
+            for( size_t Index = 0; Index < Shards_.size() && BestLoad; ++Index )
+            {
+                auto& Candidate = *Shards_[(Start + Index) % Shards_.size()];
+                auto CurrentLoad = Candidate.Load_.load( std::memory_order_relaxed );
+                if( CurrentLoad < BestLoad )
+                {
+                    BestLoad = CurrentLoad;
+                    pBest = &Candidate;
+                }
+            }
+
+            return Target( pBest, pBest->Connections_[Start % Options_.ConnectionsPerThread].get() );
+        }
+
+        ClientRuntimeOptions Options_;
+        NotificationSinkType_ NotificationSink_;
+        std::vector<std::unique_ptr<Shard>> Shards_;
+        std::atomic<size_t> Next_{ 0 };
+
+        mutable std::mutex ServerErrorMutex_;
+        std::string LastServerError_;
+    };
+}
+
+#endif
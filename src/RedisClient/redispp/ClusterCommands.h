@@ -0,0 +1,216 @@
+#pragma once
+
+#ifndef REDISPP_CLUSTER_COMMANDS_INCLUDED
+#define REDISPP_CLUSTER_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Commands.h"
+
+#include <vector>
+
+namespace redis
+{
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  A S K I N G
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    inline Request askingCommand()
+    {
+        return Request( "ASKING" );
+    }
+
+    template <class Connection>
+    auto asking( Connection& con, boost::system::error_code& ec )
+    {
+        return Detail::sync_universal( con, ec, &askingCommand, &OKResult );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                           C L U S T E R  S L O T S
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // A contiguous range of hash slots together with the nodes serving it
+    struct ClusterSlotRange
+    {
+        uint16_t Start;
+        uint16_t End;
+        Host Master;
+        std::vector<Host> Replicas;
+    };
+
+    inline Request clusterSlotsCommand()
+    {
+        return Request( "CLUSTER", "SLOTS" );
+    }
+
+    inline std::vector<ClusterSlotRange> clusterSlotsResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<ClusterSlotRange> Result;
+
+        if( Data.type() != Response::Type::Array )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        // every entry: start slot, end slot, master node, replica nodes ... - every node: ip, port, [id, ...]
+        auto NodeFromResponse = [&ec]( const Response& Node ) {
+            if( Node.type() != Response::Type::Array || Node.elements().size() < 2 || Node[1].type() != Response::Type::Integer )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return Host();
+            }
+            return Host( Node[0].string(), static_cast<int>(Node[1].asint()) );
+        };
+
+        Result.reserve( Data.elements().size() );
+        for( const auto& spRange : Data.elements() )
+        {
+            if( spRange->type() != Response::Type::Array || spRange->elements().size() < 3 )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return std::vector<ClusterSlotRange>();
+            }
+
+            const auto& Range = *spRange;
+            ClusterSlotRange SlotRange{ static_cast<uint16_t>(Range[0].asint()), static_cast<uint16_t>(Range[1].asint()), NodeFromResponse( Range[2] ), {} };
+            for( size_t Index = 3; Index < Range.elements().size(); ++Index )
+                SlotRange.Replicas.push_back( NodeFromResponse( Range[Index] ) );
+
+            if( ec )
+                return std::vector<ClusterSlotRange>();
+
+            Result.push_back( std::move( SlotRange ) );
+        }
+
+        return Result;
+    }
+
+    template <class Connection>
+    auto cluster_slots( Connection& con, boost::system::error_code& ec )
+    {
+        return Detail::sync_universal( con, ec, &clusterSlotsCommand, &clusterSlotsResult );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_cluster_slots( Connection& con, CompletionToken&& token )
+    {
+        return Detail::async_universal( con, token, &clusterSlotsCommand, &clusterSlotsResult );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                          C L U S T E R  S H A R D S
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // CLUSTER SHARDS (Redis 7) replaces the deprecated CLUSTER SLOTS - the result is converted to slot ranges,
+    // one per range of a shard. Replicas not reported as online are left out.
+    inline Request clusterShardsCommand()
+    {
+        return Request( "CLUSTER", "SHARDS" );
+    }
+
+    namespace Detail
+    {
+        // returns the value of the entry Name of a flat name/value array - nullptr if it is missing
+        inline const Response* mapEntry( const Response& Map, const char* pName )
+        {
+            const auto& Elements = Map.elements();
+            for( size_t Index = 0; Index + 1 < Elements.size(); Index += 2 )
+                if( Elements[Index]->string() == pName )
+                    return Elements[Index + 1].get();
+            return nullptr;
+        }
+    }
+
+    inline std::vector<ClusterSlotRange> clusterShardsResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<ClusterSlotRange> Result;
+
+        if( Data.type() != Response::Type::Array )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        for( const auto& spShard : Data.elements() )
+        {
+            const Response* pSlots = spShard->type() == Response::Type::Array ? Detail::mapEntry( *spShard, "slots" ) : nullptr;
+            const Response* pNodes = spShard->type() == Response::Type::Array ? Detail::mapEntry( *spShard, "nodes" ) : nullptr;
+            if( !pSlots || !pNodes || pSlots->type() != Response::Type::Array || pNodes->type() != Response::Type::Array )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return std::vector<ClusterSlotRange>();
+            }
+
+            // every node: id, port, ip, endpoint, role, health, ... - the endpoint is "?" if it is unknown
+            Host Master;
+            bool MasterFound = false;
+            std::vector<Host> Replicas;
+            for( const auto& spNode : pNodes->elements() )
+            {
+                if( spNode->type() != Response::Type::Array )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return std::vector<ClusterSlotRange>();
+                }
+
+                auto pPort = Detail::mapEntry( *spNode, "port" );
+                if( !pPort )
+                    pPort = Detail::mapEntry( *spNode, "tls-port" );
+                auto pEndpoint = Detail::mapEntry( *spNode, "endpoint" );
+                if( !pEndpoint || pEndpoint->string().empty() || pEndpoint->string() == "?" )
+                    pEndpoint = Detail::mapEntry( *spNode, "ip" );
+                auto pRole = Detail::mapEntry( *spNode, "role" );
+                auto pHealth = Detail::mapEntry( *spNode, "health" );
+                if( !pPort || pPort->type() != Response::Type::Integer || !pEndpoint || !pRole )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return std::vector<ClusterSlotRange>();
+                }
+
+                Host Node( pEndpoint->string(), static_cast<int>(pPort->asint()) );
+                if( pRole->string() == "master" )
+                {
+                    Master = Node;
+                    MasterFound = true;
+                }
+                else
+                    if( !pHealth || pHealth->string() == "online" )
+                        Replicas.push_back( Node );
+            }
+
+            // a shard without slots or master does not serve any key
+            const auto& Slots = pSlots->elements();
+            if( !MasterFound || Slots.empty() )
+                continue;
+
+            for( size_t Index = 0; Index + 1 < Slots.size(); Index += 2 )
+            {
+                if( Slots[Index]->type() != Response::Type::Integer || Slots[Index + 1]->type() != Response::Type::Integer )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return std::vector<ClusterSlotRange>();
+                }
+                Result.push_back( ClusterSlotRange{ static_cast<uint16_t>(Slots[Index]->asint()), static_cast<uint16_t>(Slots[Index + 1]->asint()), Master, Replicas } );
+            }
+        }
+
+        return Result;
+    }
+
+    template <class Connection>
+    auto cluster_shards( Connection& con, boost::system::error_code& ec )
+    {
+        return Detail::sync_universal( con, ec, &clusterShardsCommand, &clusterShardsResult );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_cluster_shards( Connection& con, CompletionToken&& token )
+    {
+        return Detail::async_universal( con, token, &clusterShardsCommand, &clusterShardsResult );
+    }
+}
+
+#endif
@@ -0,0 +1,537 @@
+#pragma once
+
+#ifndef REDISPP_CLUSTERCONNECTIONMANAGER_INCLUDED
+#define REDISPP_CLUSTERCONNECTIONMANAGER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <list>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+#include "redispp/ClusterCommands.h"
+#include "redispp/SingleHostConnectionManager.h"
+#include "redispp/PartitionedPipeline.h"
+#include "redispp/KeyHash.h"
+#include "redispp/CommandKeys.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    namespace Detail
+    {
+        // Content of a -MOVED or -ASK error reply
+        struct ClusterRedirect
+        {
+            bool Moved_ = false;
+            uint16_t Slot_ = 0;
+            Host Node_;
+        };
+
+        // returns true if Data is a MOVED or ASK redirect - Current is used if the reply omits the host
+        inline bool parseClusterRedirect( const Response& Data, const Host& Current, ClusterRedirect& Redirect )
+        {
+            if( Data.type() != Response::Type::Error )
+                return false;
+
+            std::string Message( Data.string() );
+            size_t SlotStart;
+            if( Message.compare( 0, 6, "MOVED " ) == 0 )
+            {
+                Redirect.Moved_ = true;
+                SlotStart = 6;
+            }
+            else
+                if( Message.compare( 0, 4, "ASK " ) == 0 )
+                {
+                    Redirect.Moved_ = false;
+                    SlotStart = 4;
+                }
+                else
+                    return false;
+
+            auto NodeStart = Message.find( ' ', SlotStart );
+            auto PortStart = Message.rfind( ':' );
+            if( NodeStart == std::string::npos || PortStart == std::string::npos || PortStart < NodeStart )
+                return false;
+
+            Redirect.Slot_ = static_cast<uint16_t>(std::stoi( Message.substr( SlotStart, NodeStart - SlotStart ) ));
+
+            std::string Hostname( Message.substr( NodeStart + 1, PortStart - NodeStart - 1 ) );
+            Redirect.Node_ = Host( Hostname.empty() ? std::get<0>(Current) : Hostname, std::stoi( Message.substr( PortStart + 1 ) ) );
+
+            return true;
+        }
+
+        // true for the error reply of a server not knowing a command or subcommand, e.g. "ERR unknown subcommand 'shards'"
+        // or "ERR Unknown subcommand or wrong number of arguments for 'SHARDS'" of Redis before 6.2
+        inline bool unknownCommand( const std::string& ServerError )
+        {
+            std::string Prefix( ServerError.substr( 0, 22 ) );
+            std::transform( Prefix.begin(), Prefix.end(), Prefix.begin(), []( unsigned char Character ) { return static_cast<char>( ::tolower( Character ) ); } );
+            return Prefix.compare( 0, 19, "err unknown command" ) == 0 || Prefix == "err unknown subcommand";
+        }
+
+        // returns the hash slot of a request - false if the request has no key argument (see requestKey)
+        inline bool requestSlot( const Request& Command, uint16_t& Slot )
+        {
+            boost::asio::const_buffer Key;
+            if( !requestKey( Command, Key ) )
+                return false;
+
+            Slot = hashSlot( Key );
+            return true;
+        }
+    }
+
+    // Shared, thread safe topology of a Redis Cluster: the masters and the hash slot map.
+    // The map is loaded with CLUSTER SHARDS (CLUSTER SLOTS before Redis 7) from a known node or one of the seeds and is
+    // patched and reloaded whenever a connection sees a MOVED redirect.
+    template<class NotificationSinkType_=NullNotificationSink>
+    class ClusterConnectionManager
+    {
+    public:
+        typedef std::list<Host> HostContainer;
+
+        ClusterConnectionManager( const ClusterConnectionManager& ) = delete;
+        ClusterConnectionManager& operator=( const ClusterConnectionManager& ) = delete;
+
+        ClusterConnectionManager( const HostContainer& Seeds, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, std::chrono::milliseconds MinimumRefreshInterval = std::chrono::seconds( 1 ) ) :
+            Seeds_( Seeds ),
+            NotificationSink_( NotificationSink ),
+            MinimumRefreshInterval_( MinimumRefreshInterval ),
+            SlotMap_( ClusterSlotCount, NoNode )
+        {
+            if( Seeds_.empty() )
+                throw std::out_of_range( "Hostcontainer does not contain any hosts." );
+        }
+
+        // returns the master serving Slot - false if the slot is not known yet
+        bool nodeForSlot( uint16_t Slot, Host& Node ) const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            auto NodeIndex = SlotMap_[Slot & (ClusterSlotCount - 1)];
+            if( NodeIndex == NoNode )
+                return false;
+            Node = Nodes_[NodeIndex];
+            return true;
+        }
+
+        // returns one of the known masters - used for requests without a key
+        bool anyNode( Host& Node ) const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            if( Nodes_.empty() )
+                return false;
+            Node = Nodes_[NextNode_++ % Nodes_.size()];
+            return true;
+        }
+
+        // returns all known masters
+        std::vector<Host> masters() const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return Nodes_;
+        }
+
+        // true after the first successful load of the slot map
+        bool initialized() const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return !Nodes_.empty();
+        }
+
+        // records a MOVED redirect in the slot map and requests a reload of the topology
+        void moved( uint16_t Slot, const Host& Node )
+        {
+            {
+                std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                auto NodeIterator = std::find( Nodes_.begin(), Nodes_.end(), Node );
+                if( NodeIterator == Nodes_.end() )
+                    NodeIterator = Nodes_.insert( Nodes_.end(), Node );
+                SlotMap_[Slot & (ClusterSlotCount - 1)] = static_cast<uint16_t>(NodeIterator - Nodes_.begin());
+            }
+
+            requestRefresh();
+        }
+
+        void requestRefresh()
+        {
+            RefreshRequested_.store( true, std::memory_order_relaxed );
+        }
+
+        bool refreshRequested() const
+        {
+            return RefreshRequested_.load( std::memory_order_relaxed );
+        }
+
+        // reloads the slot map - at most once per MinimumRefreshInterval unless Force is set.
+        // Once the map is loaded, concurrent callers do not wait for a refresh already running in another thread;
+        // before that they wait for it, since they could not route anything.
+        void refresh( boost::asio::io_service& io_service, boost::system::error_code& ec, bool Force = false )
+        {
+            std::unique_lock<std::mutex> RefreshLock( RefreshMutex_, std::defer_lock );
+            if( initialized() )
+            {
+                if( !RefreshLock.try_lock() )
+                    return;
+            }
+            else
+                RefreshLock.lock();
+
+            auto Now = std::chrono::steady_clock::now();
+            if( !Force && initialized() && Now - LastRefresh_ < MinimumRefreshInterval_ )
+                return;
+            LastRefresh_ = Now;
+            RefreshRequested_.store( false, std::memory_order_relaxed );
+
+            // ask the known masters first, then the seeds
+            auto Candidates = masters();
+            Candidates.insert( Candidates.end(), Seeds_.begin(), Seeds_.end() );
+
+            for( const auto& Candidate : Candidates )
+            {
+                SingleHostConnectionManager shcm( Candidate );
+                redis::Connection<redis::SingleHostConnectionManager, NotificationSinkType_> NodeConnection( io_service, shcm, 0, NotificationSink_ );
+
+                // CLUSTER SHARDS is known since Redis 7 - older servers reply with an unknown (sub)command error and are asked with CLUSTER SLOTS
+                std::vector<ClusterSlotRange> SlotRanges;
+                if( UseShards_.load( std::memory_order_relaxed ) )
+                {
+                    SlotRanges = redis::cluster_shards( NodeConnection, ec ).second;
+                    if( ec == ::redis::make_error_code( ErrorCodes::server_error ) && Detail::unknownCommand( NodeConnection.lastServerError() ) )
+                    {
+                        REDISPP_NOTIFY( NotificationSink_, debug, "ClusterConnectionManager::refresh: node '{}' does not know CLUSTER SHARDS - using CLUSTER SLOTS", Candidate );
+                        UseShards_.store( false, std::memory_order_relaxed );
+                    }
+                }
+                if( !UseShards_.load( std::memory_order_relaxed ) )
+                    SlotRanges = redis::cluster_slots( NodeConnection, ec ).second;
+
+                if( ec || SlotRanges.empty() )
+                {
+                    NotificationSink_.warning( "ClusterConnectionManager::refresh: node '{}' did not deliver the slot map: {}", Candidate, ec ? ec.message() : std::string( "no slots" ) );
+                    continue;
+                }
+
+                std::vector<Host> Nodes;
+                std::vector<uint16_t> SlotMap( ClusterSlotCount, NoNode );
+                for( const auto& Range : SlotRanges )
+                {
+                    auto NodeIterator = std::find( Nodes.begin(), Nodes.end(), Range.Master );
+                    if( NodeIterator == Nodes.end() )
+                        NodeIterator = Nodes.insert( Nodes.end(), Range.Master );
+
+                    auto NodeIndex = static_cast<uint16_t>(NodeIterator - Nodes.begin());
+                    for( size_t Slot = Range.Start; Slot <= Range.End && Slot < ClusterSlotCount; ++Slot )
+                        SlotMap[Slot] = NodeIndex;
+                }
+
+                {
+                    std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                    Nodes_ = std::move( Nodes );
+                    SlotMap_ = std::move( SlotMap );
+                }
+
+                REDISPP_NOTIFY( NotificationSink_, trace, "ClusterConnectionManager::refresh: slot map loaded from '{}' - {} slot ranges", Candidate, SlotRanges.size() );
+
+                ec.clear();
+                return;
+            }
+
+            NotificationSink_.error( "ClusterConnectionManager::refresh: no node delivered the slot map!" );
+
+            ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
+        }
+
+    private:
+        static constexpr uint16_t NoNode = 0xffff;
+
+        HostContainer Seeds_;
+        NotificationSinkType_ NotificationSink_;
+        std::chrono::milliseconds MinimumRefreshInterval_;
+
+        mutable std::shared_timed_mutex Mutex_;
+        std::vector<Host> Nodes_;
+        std::vector<uint16_t> SlotMap_;
+        mutable std::atomic<size_t> NextNode_{ 0 };
+
+        std::mutex RefreshMutex_;
+        std::atomic<bool> RefreshRequested_{ false };
+        std::atomic<bool> UseShards_{ true };
+        std::chrono::steady_clock::time_point LastRefresh_;
+    };
+
+    // Connection to a Redis Cluster with one connection per node.
+    // Requests are routed by the hash slot of their key (see requestKey), requests without a key go to any master.
+    // MOVED and ASK redirects are followed. Pipelines are split into one partial pipeline per node, sent in parallel
+    // and the responses are returned in the original order.
+    // Like Connection, a ClusterConnection must not be shared between threads - the manager may.
+    template<class NotificationSinkType_=NullNotificationSink>
+    class ClusterConnection
+    {
+    public:
+        using ManagerType = ClusterConnectionManager<NotificationSinkType_>;
+        using NodeConnectionType = Connection<SingleHostConnectionManager, NotificationSinkType_>;
+
+        // Maximum number of redirects followed for a single request
+        static constexpr size_t MaximumRedirects = 5;
+
+        ClusterConnection( const ClusterConnection& ) = delete;
+        ClusterConnection& operator=( const ClusterConnection& ) = delete;
+
+        ClusterConnection( boost::asio::io_service& io_service, ManagerType& Manager, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            io_service_( io_service ),
+            Manager_( Manager ),
+            NotificationSink_( NotificationSink )
+        {}
+
+        std::unique_ptr<ResponseHandler<NotificationSinkType_>> transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            prepareTopology();
+
+            Host Node;
+            if( !routeRequest( Command, Node ) )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
+                return std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+            }
+
+            bool Asking = false;
+            bool Reconnected = false;
+            for( size_t Redirects = 0; ; ++Redirects )
+            {
+                auto& NodeConnection = connection( Node );
+
+                if( Asking )
+                {
+                    redis::asking( NodeConnection, ec );
+                    Asking = false;
+                }
+
+                auto Result = NodeConnection.transmit( Command, ec );
+                if( ec )
+                {
+                    // the node may have failed over - reload the topology and try once more
+                    if( Reconnected )
+                        return Result;
+
+                    NotificationSink_.warning( "ClusterConnection::transmit: node '{}' failed: {} - reloading slot map", Node, ec.message() );
+
+                    Reconnected = true;
+                    boost::system::error_code RefreshEc;
+                    Manager_.refresh( io_service_, RefreshEc, true );
+                    if( RefreshEc || !routeRequest( Command, Node ) )
+                        return Result;
+
+                    ec.clear();
+                    continue;
+                }
+
+                Detail::ClusterRedirect Redirect;
+                if( Redirects >= MaximumRedirects || !Detail::parseClusterRedirect( Result->top(), Node, Redirect ) )
+                    return Result;
+
+                REDISPP_NOTIFY( NotificationSink_, debug, "ClusterConnection::transmit: {} redirect for slot {} to '{}'", Redirect.Moved_ ? "MOVED" : "ASK", Redirect.Slot_, Redirect.Node_ );
+
+                if( Redirect.Moved_ )
+                    Manager_.moved( Redirect.Slot_, Redirect.Node_ );
+                else
+                    Asking = true;
+
+                Node = Redirect.Node_;
+            }
+        }
+
+        PipelineResult<NotificationSinkType_> transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            prepareTopology();
+
+            const auto& Requests = thePipeline.requests();
+
+            std::vector<NodeConnectionType*> Targets( Requests.size(), nullptr );
+            for( size_t Position = 0; Position < Requests.size(); ++Position )
+            {
+                uint16_t Slot;
+                Host Node;
+                if( Detail::requestSlot( *Requests[Position], Slot ) && Manager_.nodeForSlot( Slot, Node ) )
+                    Targets[Position] = &connection( Node );
+            }
+
+            auto Transactions = Detail::transactionBlocks( Requests );
+            if( !Detail::assignTransactions( Transactions, Targets ) )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::cross_node_transaction );
+                return PipelineResult<NotificationSinkType_>( std::make_shared<Response::ElementContainer>( Requests.size() ), std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>(), NotificationSink_ );
+            }
+
+            if( !Detail::assignKeylessRequests( Targets ) )
+            {
+                Host Node;
+                if( !Manager_.anyNode( Node ) )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
+                    return PipelineResult<NotificationSinkType_>( std::make_shared<Response::ElementContainer>( Requests.size() ), std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>(), NotificationSink_ );
+                }
+                std::fill( Targets.begin(), Targets.end(), &connection( Node ) );
+            }
+
+            auto Result = Detail::transmitPartitioned<NodeConnectionType>( thePipeline, ec, [&Targets]( size_t Position, const Request& ) -> NodeConnectionType& { return *Targets[Position]; }, NotificationSink_ );
+            if( ec )
+            {
+                Manager_.requestRefresh();
+                return Result;
+            }
+
+            // Requests hitting a migrated slot are repeated one by one, following the redirects -
+            // a transaction is repeated as a whole on the node named by the redirect
+            for( size_t Position = 0; Position < Requests.size(); ++Position )
+            {
+                auto& spResponse = (*Result.responses())[Position];
+                Detail::ClusterRedirect Redirect;
+                if( !spResponse || !Detail::parseClusterRedirect( *spResponse, Host(), Redirect ) )
+                    continue;
+
+                if( Redirect.Moved_ )
+                    Manager_.moved( Redirect.Slot_, Redirect.Node_ );
+
+                auto Transaction = std::find_if( Transactions.begin(), Transactions.end(), [Position]( const auto& Block ) { return Position >= Block.first && Position <= Block.second; } );
+                if( Transaction != Transactions.end() )
+                {
+                    retryTransaction( thePipeline, *Transaction, Redirect, Result, ec );
+                    if( ec )
+                        return Result;
+
+                    Position = Transaction->second;
+                    continue;
+                }
+
+                auto spRetry = transmit( *Requests[Position], ec );
+                if( ec )
+                    return Result;
+
+                Result.bufferContainer()->splice( Result.bufferContainer()->end(), *spRetry->bufferContainer() );
+                spResponse = spRetry->spTop();
+            }
+
+            return Result;
+        }
+
+        // Asynchronous requests are routed with the current slot map - redirects are not followed
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            prepareTopology();
+
+            // without a known node the request fails on connect and reports the error through the token
+            Host Node;
+            routeRequest( Command, Node );
+
+            return connection( Node ).async_command( Command, std::forward<CompletionToken>( token ) );
+        }
+
+        // calls Function with the connection of every known master
+        template <class FunctionT_>
+        void forEachMaster( FunctionT_ Function )
+        {
+            prepareTopology();
+
+            for( const auto& Node : Manager_.masters() )
+                Function( connection( Node ) );
+        }
+
+        const std::string& lastServerError() const
+        {
+            return LastServerError_;
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            LastServerError_ = LastServerError;
+        }
+
+    private:
+        // Sends the requests of a redirected transaction again to the node named by Redirect - after ASKING for an
+        // ASK redirect, which stays in effect for the whole transaction. Further redirects are not followed.
+        void retryTransaction( const Pipeline& thePipeline, const Detail::TransactionBlock& Block, const Detail::ClusterRedirect& Redirect, PipelineResult<NotificationSinkType_>& Result, boost::system::error_code& ec )
+        {
+            REDISPP_NOTIFY( NotificationSink_, debug, "ClusterConnection::transmit: {} redirect for the transaction at {} to '{}'", Redirect.Moved_ ? "MOVED" : "ASK", Block.first, Redirect.Node_ );
+
+            Pipeline Retry;
+            Request Asking( "ASKING" );
+            if( !Redirect.Moved_ )
+                Retry.add( Asking );
+            for( size_t Position = Block.first; Position <= Block.second; ++Position )
+                Retry.add( *thePipeline.requests()[Position] );
+
+            auto RetryResult = connection( Redirect.Node_ ).transmit( Retry, ec );
+            if( ec )
+                return;
+
+            size_t Offset = Redirect.Moved_ ? 0 : 1;
+            for( size_t Position = Block.first; Position <= Block.second; ++Position )
+                (*Result.responses())[Position] = (*RetryResult.responses())[Position - Block.first + Offset];
+            Result.bufferContainer()->splice( Result.bufferContainer()->end(), *RetryResult.bufferContainer() );
+        }
+
+        // Connection to a single node - the connection manager has to outlive the connection
+        struct NodeEntry
+        {
+            NodeEntry( boost::asio::io_service& io_service, const Host& Node, NotificationSinkType_ NotificationSink ) :
+                Manager_( Node ),
+                Connection_( io_service, Manager_, 0, NotificationSink )
+            {}
+
+            SingleHostConnectionManager Manager_;
+            NodeConnectionType Connection_;
+        };
+
+        void prepareTopology()
+        {
+            if( Manager_.initialized() && !Manager_.refreshRequested() )
+                return;
+
+            boost::system::error_code ec;
+            Manager_.refresh( io_service_, ec );
+            if( ec )
+                NotificationSink_.warning( "ClusterConnection: unable to load slot map: {}", ec.message() );
+        }
+
+        bool routeRequest( const Request& Command, Host& Node ) const
+        {
+            uint16_t Slot;
+            if( Detail::requestSlot( Command, Slot ) && Manager_.nodeForSlot( Slot, Node ) )
+                return true;
+
+            return Manager_.anyNode( Node );
+        }
+
+        NodeConnectionType& connection( const Host& Node )
+        {
+            auto& spEntry = Nodes_[Node];
+            if( !spEntry )
+            {
+                REDISPP_NOTIFY( NotificationSink_, trace, "ClusterConnection: opening connection to node '{}'", Node );
+                spEntry = std::make_unique<NodeEntry>( io_service_, Node, NotificationSink_ );
+            }
+            return spEntry->Connection_;
+        }
+
+        boost::asio::io_service& io_service_;
+        ManagerType& Manager_;
+        NotificationSinkType_ NotificationSink_;
+        std::map<Host, std::unique_ptr<NodeEntry>> Nodes_;
+        std::string LastServerError_;
+    };
+}
+
+#endif
@@ -0,0 +1,188 @@
+#pragma once
+
+#ifndef REDISPP_COMMANDKEYS_INCLUDED
+#define REDISPP_COMMANDKEYS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <cctype>
+#include <cstddef>
+
+#include <boost/asio/buffer.hpp>
+
+#include "redispp/Request.h"
+
+// Position of the key of a request - used to route requests to a cluster node or a shard. Most commands take their
+// key as first argument; the exceptions (scripts and functions with numkeys, XREAD/XREADGROUP with STREAMS,
+// subcommands like OBJECT ENCODING key, ...) and the commands without any key are listed in a table.
+
+namespace redis
+{
+    namespace Detail
+    {
+        enum class KeyPosition
+        {
+            // no key, e.g. PING, INFO, SCAN
+            None,
+            // the first argument
+            First,
+            // the argument after a subcommand, e.g. OBJECT ENCODING key
+            Second,
+            // numkeys as first argument followed by the keys, e.g. ZUNION numkeys key ...
+            NumKeysFirst,
+            // numkeys as second argument followed by the keys, e.g. EVALSHA sha1 numkeys key ...
+            NumKeysSecond,
+            // the argument following STREAMS, e.g. XREADGROUP GROUP group consumer STREAMS key ...
+            Streams,
+            // MIGRATE host port key|"" destination-db timeout ... [KEYS key ...]
+            Migrate
+        };
+
+        struct CommandKeyPosition
+        {
+            const char* pName;
+            KeyPosition Position;
+        };
+
+        // compares Argument case insensitive with the upper case Name
+        inline bool argumentIs( const boost::asio::const_buffer& Argument, const char* pName )
+        {
+            auto pData = boost::asio::buffer_cast<const char*>(Argument);
+            auto Size = boost::asio::buffer_size( Argument );
+
+            size_t Index = 0;
+            for( ; Index < Size && pName[Index]; ++Index )
+                if( ::toupper( static_cast<unsigned char>(pData[Index]) ) != pName[Index] )
+                    return false;
+            return Index == Size && !pName[Index];
+        }
+
+        // parses a non negative number argument like numkeys
+        inline bool argumentNumber( const boost::asio::const_buffer& Argument, size_t& Value )
+        {
+            auto pData = boost::asio::buffer_cast<const char*>(Argument);
+            auto Size = boost::asio::buffer_size( Argument );
+            if( !Size )
+                return false;
+
+            Value = 0;
+            for( size_t Index = 0; Index < Size; ++Index )
+            {
+                if( pData[Index] < '0' || pData[Index] > '9' )
+                    return false;
+                Value = Value * 10 + (pData[Index] - '0');
+            }
+            return true;
+        }
+
+        // returns the key position of the command Name - commands not listed take their key as first argument
+        inline KeyPosition commandKeyPosition( const boost::asio::const_buffer& Name )
+        {
+            static const CommandKeyPosition Positions[] = {
+                { "ACL", KeyPosition::None }, { "ASKING", KeyPosition::None }, { "AUTH", KeyPosition::None },
+                { "BGREWRITEAOF", KeyPosition::None }, { "BGSAVE", KeyPosition::None }, { "BLMPOP", KeyPosition::NumKeysSecond },
+                { "BZMPOP", KeyPosition::NumKeysSecond }, { "CLIENT", KeyPosition::None }, { "CLUSTER", KeyPosition::None },
+                { "COMMAND", KeyPosition::None }, { "CONFIG", KeyPosition::None }, { "DBSIZE", KeyPosition::None },
+                { "DEBUG", KeyPosition::None }, { "DISCARD", KeyPosition::None }, { "ECHO", KeyPosition::None },
+                { "EVAL", KeyPosition::NumKeysSecond }, { "EVALSHA", KeyPosition::NumKeysSecond }, { "EVALSHA_RO", KeyPosition::NumKeysSecond },
+                { "EVAL_RO", KeyPosition::NumKeysSecond }, { "EXEC", KeyPosition::None }, { "FCALL", KeyPosition::NumKeysSecond },
+                { "FCALL_RO", KeyPosition::NumKeysSecond }, { "FLUSHALL", KeyPosition::None }, { "FLUSHDB", KeyPosition::None },
+                { "FUNCTION", KeyPosition::None }, { "HELLO", KeyPosition::None }, { "INFO", KeyPosition::None },
+                { "KEYS", KeyPosition::None }, { "LASTSAVE", KeyPosition::None }, { "LATENCY", KeyPosition::None },
+                { "LMPOP", KeyPosition::NumKeysFirst }, { "MEMORY", KeyPosition::Second }, { "MIGRATE", KeyPosition::Migrate },
+                { "MODULE", KeyPosition::None }, { "MONITOR", KeyPosition::None }, { "MULTI", KeyPosition::None },
+                { "OBJECT", KeyPosition::Second }, { "PING", KeyPosition::None }, { "PSUBSCRIBE", KeyPosition::None },
+                { "PSYNC", KeyPosition::None }, { "PUBLISH", KeyPosition::None }, { "PUNSUBSCRIBE", KeyPosition::None },
+                { "QUIT", KeyPosition::None }, { "RANDOMKEY", KeyPosition::None }, { "READONLY", KeyPosition::None },
+                { "READWRITE", KeyPosition::None }, { "REPLICAOF", KeyPosition::None }, { "RESET", KeyPosition::None },
+                { "ROLE", KeyPosition::None }, { "SAVE", KeyPosition::None }, { "SCAN", KeyPosition::None },
+                { "SCRIPT", KeyPosition::None }, { "SELECT", KeyPosition::None }, { "SENTINEL", KeyPosition::None },
+                { "SHUTDOWN", KeyPosition::None }, { "SINTERCARD", KeyPosition::NumKeysFirst }, { "SLAVEOF", KeyPosition::None },
+                { "SLOWLOG", KeyPosition::None }, { "SUBSCRIBE", KeyPosition::None }, { "SWAPDB", KeyPosition::None },
+                { "SYNC", KeyPosition::None }, { "TIME", KeyPosition::None }, { "UNSUBSCRIBE", KeyPosition::None },
+                { "UNWATCH", KeyPosition::None }, { "WAIT", KeyPosition::None }, { "XGROUP", KeyPosition::Second },
+                { "XINFO", KeyPosition::Second }, { "XREAD", KeyPosition::Streams }, { "XREADGROUP", KeyPosition::Streams },
+                { "ZDIFF", KeyPosition::NumKeysFirst }, { "ZINTER", KeyPosition::NumKeysFirst }, { "ZINTERCARD", KeyPosition::NumKeysFirst },
+                { "ZMPOP", KeyPosition::NumKeysFirst }, { "ZUNION", KeyPosition::NumKeysFirst }
+            };
+
+            for( const auto& Entry : Positions )
+                if( argumentIs( Name, Entry.pName ) )
+                    return Entry.Position;
+            return KeyPosition::First;
+        }
+    }
+
+    // returns the index of the first key argument of Command (see Request::argument) - false if the command has no key
+    inline bool requestKeyIndex( const Request& Command, size_t& Index )
+    {
+        auto Count = Command.argumentCount();
+        if( Count < 2 )
+            return false;
+
+        size_t NumKeys;
+        switch( Detail::commandKeyPosition( Command.argument( 0 ) ) )
+        {
+        case Detail::KeyPosition::None:
+            return false;
+
+        case Detail::KeyPosition::First:
+            Index = 1;
+            break;
+
+        case Detail::KeyPosition::Second:
+            Index = 2;
+            break;
+
+        case Detail::KeyPosition::NumKeysFirst:
+            if( !Detail::argumentNumber( Command.argument( 1 ), NumKeys ) || !NumKeys )
+                return false;
+            Index = 2;
+            break;
+
+        case Detail::KeyPosition::NumKeysSecond:
+            if( Count < 3 || !Detail::argumentNumber( Command.argument( 2 ), NumKeys ) || !NumKeys )
+                return false;
+            Index = 3;
+            break;
+
+        case Detail::KeyPosition::Streams:
+        {
+            // XREADGROUP GROUP group consumer - the group or consumer may be named "streams"
+            size_t Option = Detail::argumentIs( Command.argument( 0 ), "XREADGROUP" ) ? 4 : 1;
+            while( Option < Count && !Detail::argumentIs( Command.argument( Option ), "STREAMS" ) )
+                ++Option;
+            Index = Option + 1;
+            break;
+        }
+
+        case Detail::KeyPosition::Migrate:
+            if( Count > 3 && boost::asio::buffer_size( Command.argument( 3 ) ) )
+            {
+                Index = 3;
+                break;
+            }
+
+            Index = 7;
+            while( Index < Count && !Detail::argumentIs( Command.argument( Index - 1 ), "KEYS" ) )
+                ++Index;
+            break;
+        }
+
+        return Index < Count;
+    }
+
+    // returns the first key of Command - false if the command has no key
+    inline bool requestKey( const Request& Command, boost::asio::const_buffer& Key )
+    {
+        size_t Index;
+        if( !requestKeyIndex( Command, Index ) )
+            return false;
+
+        Key = Command.argument( Index );
+        return true;
+    }
+}
+
+#endif
@@ -9,12 +9,16 @@
 #include "redispp/Error.h"
 
 #include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include <chrono>
+#include <cstring>
 #include <list>
 #include <map>
 #include <iterator>
 #include <type_traits>
+#include <vector>
+#include <limits>
 
 // The implementation of a command consists of four functions:
 // 1. a function that creates a redis::Request object from its parameters
@@ -106,6 +110,34 @@ namespace redis
 
             return result.get();
         }
+
+        // returns a view of the data of a response - valid as long as the buffers of the response
+        inline boost::asio::const_buffer responseBuffer( const Response& Data )
+        {
+            return boost::asio::buffer( Data.data(), Data.size() );
+        }
+
+        // returns a view of a request argument - the request refers to the data instead of copying it
+        inline boost::asio::const_buffer argumentBuffer( const std::string& Value )
+        {
+            return boost::asio::buffer( Value );
+        }
+
+        inline boost::asio::const_buffer argumentBuffer( const boost::string_view& Value )
+        {
+            return boost::asio::buffer( Value.data(), Value.size() );
+        }
+
+        // string literals and C strings would be ambiguous between std::string and string_view
+        inline boost::asio::const_buffer argumentBuffer( const char* pValue )
+        {
+            return boost::asio::buffer( pValue, std::strlen( pValue ) );
+        }
+
+        inline boost::asio::const_buffer argumentBuffer( const boost::asio::const_buffer& Value )
+        {
+            return Value;
+        }
     }
 
     // Common responses
@@ -127,10 +159,12 @@ namespace redis
             }
     }
 
+    // an integer beyond 64 bits is reported as protocol error as well
     inline int64_t IntResult( const Response& Data, boost::system::error_code& ec )
     {
-        if( Data.type() == Response::Type::Integer )
-            return Data.asint();
+        int64_t Value;
+        if( Data.type() == Response::Type::Integer && Detail::parseInteger( Data.data(), Data.size(), Value ) )
+            return Value;
         else
         {
             ec = ::redis::make_error_code( ErrorCodes::protocol_error );
@@ -140,17 +174,68 @@ namespace redis
 
     inline int64_t incrResult( const Response& Data, boost::system::error_code& ec )
     {
-        if( Data.type() != Response::Type::Integer )
+        int64_t Value;
+        if( Data.type() != Response::Type::Integer || !Detail::parseInteger( Data.data(), Data.size(), Value ) )
         {
             ec = ::redis::make_error_code( ErrorCodes::protocol_error );
             return 0;
         }
 
-        return std::stoll( std::string( Data.data(), Data.size() ) );
+        return Value;
+    }
+
+    // A floating point number sent as bulk string, e.g. a score - nil is returned as NaN
+    inline double DoubleResult( const Response& Data, boost::system::error_code& ec )
+    {
+        double Value;
+        if( Data.type() == Response::Type::BulkString && Detail::parseDouble( Data.data(), Data.size(), Value ) )
+            return Value;
+
+        if( Data.type() != Response::Type::Null )
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // An array of bulk strings, e.g. list elements - the buffers refer to the received data
+    inline std::vector<boost::asio::const_buffer> BufferArrayResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<boost::asio::const_buffer> Result;
+        if( Data.type() != Response::Type::Array )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.reserve( Data.elements().size() );
+        for( const auto& spElement : Data.elements() )
+            Result.push_back( Detail::responseBuffer( *spElement ) );
+
+        return Result;
     }
 
     // Specific command implementations
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                C L I E N T  I D
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    inline Request clientIdCommand()
+    {
+        return Request( "CLIENT", "ID" );
+    }
+
+    template <class Connection>
+    auto clientId( Connection& con, boost::system::error_code& ec )
+    {
+        return Detail::sync_universal( con, ec, &clientIdCommand, &IntResult );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_clientId( Connection& con, CompletionToken&& token )
+    {
+        return Detail::async_universal( con, token, &clientIdCommand, &IntResult );
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     //                                          C L I E N T  S E T N A M E
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -175,6 +260,45 @@ namespace redis
         return Detail::async_universal( con, token, &clientSetnameRequest<decltype(ConnectionName)>, &OKResult, std::ref(ConnectionName) );
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                          C L I E N T  T R A C K I N G
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Enables or disables server assisted client side caching - with a RedirectId, invalidations are sent to the
+    // connection with this client id (RESP2 redirect mode) instead of this connection
+    inline Request clientTrackingCommand( bool On, int64_t RedirectId )
+    {
+        Request r( "CLIENT", "TRACKING", On ? "on" : "off" );
+        if( On && RedirectId )
+            r << "REDIRECT" << RedirectId;
+        return r;
+    }
+
+    template <class Connection>
+    auto clientTracking( Connection& con, boost::system::error_code& ec, bool On, int64_t RedirectId = 0 )
+    {
+        return Detail::sync_universal( con, ec, &clientTrackingCommand, &OKResult, On, RedirectId );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_clientTracking( Connection& con, CompletionToken&& token, bool On, int64_t RedirectId = 0 )
+    {
+        return Detail::async_universal( con, token, &clientTrackingCommand, &OKResult, On, RedirectId );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                             C L I E N T  R E P L Y
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    enum class ClientReplyMode { On, Off, Skip };
+
+    // Off suppresses all further replies of the connection - errors included - Skip the reply to the next command.
+    // Only On is answered, so there are no synchronous or asynchronous variants - see FireAndForgetWriter
+    inline Request clientReplyCommand( ClientReplyMode Mode )
+    {
+        return Request( "CLIENT", "REPLY", Mode == ClientReplyMode::On ? "ON" : Mode == ClientReplyMode::Off ? "OFF" : "SKIP" );
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     //                                                     E X E C
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -228,6 +352,7 @@ namespace redis
     {
         Request r( "GET" );
         r << Key;
+        r.setReadOnly();
         return r;
     }
 
@@ -263,6 +388,7 @@ namespace redis
     {
         Request r( "EXISTS" );
         r << Key;
+        r.setReadOnly();
         return r;
     }
 
@@ -383,6 +509,32 @@ namespace redis
         return Detail::async_universal_void(con, token, &pingCommand, &pingResult );
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                     P T T L
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request pttlCommand( const T1_& Key )
+    {
+        Request r( "PTTL" );
+        r << Key;
+        r.setReadOnly();
+        return r;
+    }
+
+    // returns the remaining time to live in milliseconds, -1 if the key has no expiry, -2 if the key does not exist
+    template <class Connection, class T1_>
+    auto pttl( Connection& con, boost::system::error_code& ec, const T1_& Key )
+    {
+        return Detail::sync_universal( con, ec, &pttlCommand<decltype(Key)>, &IntResult, std::ref(Key) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_pttl( Connection& con, CompletionToken&& token, const T1_& Key )
+    {
+        return Detail::async_universal( con, token, &pttlCommand<decltype(Key)>, &IntResult, std::ref(Key) );
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     //                                                     R O L E
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
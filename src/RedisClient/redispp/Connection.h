@@ -5,14 +5,21 @@
 // See accompanying file LICENSE.txt for Lincense
 
 #include "redispp/Commands.h"
+#include "redispp/Metrics.h"
+#include "redispp/ParallelReceive.h"
 #include "redispp/Response.h"
 #include "redispp/SocketConnectionManager.h"
+#include "redispp/Tracing.h"
+
+#include <functional>
+#include <vector>
 
 namespace redis
 {
     class Pipeline
     {
         std::list<Request> Requests_;
+        std::vector<const Request*> Entries_;
         Request::BufferSequence_t Buffers_;
 
     public:
@@ -21,16 +28,26 @@ namespace redis
         Pipeline() {}
 
         Pipeline& operator<<( Request&& Command )
+        {
+            Requests_.emplace_back( std::move( Command ) );
+
+            return add( Requests_.back() );
+        }
+
+        // Adds a request without taking ownership - Command has to outlive the pipeline
+        Pipeline& add( const Request& Command )
         {
             const auto& Buffersequence( Command.bufferSequence() );
             Buffers_.insert( Buffers_.end(), Buffersequence.begin(), Buffersequence.end() );
 
-            Requests_.emplace_back( std::move( Command ) );
+            Entries_.push_back( &Command );
 
             return *this;
         }
         const Request::BufferSequence_t& bufferSequence() const { return Buffers_; }
-        size_t requestCount() const { return Requests_.size(); }
+        size_t requestCount() const { return Entries_.size(); }
+        // returns the requests of the pipeline in the order of transmission
+        const std::vector<const Request*>& requests() const { return Entries_; }
     };
 
     template<class NotificationSinkType_>
@@ -40,7 +57,7 @@ namespace redis
         std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType> spBufferContainer_;
         NotificationSinkType_ NotificationSink_;
     public:
-        PipelineResult( std::shared_ptr<Response::ElementContainer>& spResponses, std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>& spBufferContainer, NotificationSinkType_ NotificationSink ) :
+        PipelineResult( const std::shared_ptr<Response::ElementContainer>& spResponses, const std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>& spBufferContainer, NotificationSinkType_ NotificationSink ) :
             spResponses_( spResponses ),
             spBufferContainer_( spBufferContainer ),
             NotificationSink_( NotificationSink )
@@ -80,10 +97,17 @@ namespace redis
         {
             return *(spResponses_->at( Position ));
         }
+
+        // returns the number of responses
+        size_t size() const { return spResponses_->size(); }
+        // returns the container of all responses
+        const std::shared_ptr<Response::ElementContainer>& responses() const { return spResponses_; }
+        // returns the buffers the responses refer to
+        const std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>& bufferContainer() const { return spBufferContainer_; }
     };
 
-    template<class NotificationSinkType_=NullNotificationSink>
-    class ConnectionBase : std::enable_shared_from_this<ConnectionBase<NotificationSinkType_> >
+    template<class NotificationSinkType_=NullNotificationSink, class SocketType_=boost::asio::ip::tcp::socket>
+    class ConnectionBase : std::enable_shared_from_this<ConnectionBase<NotificationSinkType_, SocketType_> >
     {
         ConnectionBase(const ConnectionBase&) = delete;
         ConnectionBase& operator=(const ConnectionBase&) = delete;
@@ -110,50 +134,64 @@ namespace redis
     protected:
         boost::asio::io_service& io_service_;
         boost::asio::io_service::strand Strand_;
-        boost::asio::ip::tcp::socket Socket_;
+        SocketType_ Socket_;
         std::queue<typename ResponseHandler<NotificationSinkType_>::ResponseHandle> _ResponseQueue;
         int64_t Index_;
         NotificationSinkType_ NotificationSink_;
         std::string LastServerError_;
     };
 
-    template <class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
-    class Connection : private ConnectionBase<NotificationSinkType_>
+    // MetricsType_ collects latencies and byte counts - see Metrics.h. TracerType_ receives the timestamps of every
+    // request - see Tracing.h. The defaults NullMetrics and NullTracer compile away.
+    // The transport is the SocketType of the ConnectionManagerType - a TCP socket if it declares none
+    template <class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink, class MetricsType_=NullMetrics, class TracerType_=NullTracer>
+    class Connection : private ConnectionBase<NotificationSinkType_, typename Detail::socketType<ConnectionManagerType>::type>
     {
+        using Stopwatch = Detail::Stopwatch<Detail::metricsEnabled<MetricsType_>()>;
+        using Trace = Detail::RequestTrace<Detail::tracerEnabled<TracerType_>()>;
+
     public:
-        Connection( boost::asio::io_service& io_service, const ConnectionManagerType& Manager, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+        using SocketType = typename Detail::socketType<ConnectionManagerType>::type;
+
+        Connection( boost::asio::io_service& io_service, const ConnectionManagerType& Manager, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, MetricsType_ Metrics = MetricsType_{}, TracerType_ Tracer = TracerType_{} ) :
             ConnectionBase( io_service, Index, NotificationSink ),
-            ConnectionManagerInstance_(Manager.getInstance())
+            ConnectionManagerInstance_(Manager.getInstance()),
+            Metrics_( Metrics ),
+            Tracer_( Tracer )
         {}
 
+        // Called on every newly established connection after the database has been selected - before any request
+        // is sent. Used to restore connection state lost on a reconnect, e.g. client tracking
+        using ConnectHandlerType = std::function<void( Connection<Detail::BasicSocketConnectionManager<SocketType>, NotificationSinkType_>& NewConnection, boost::system::error_code& ec )>;
+
+        // replaces all connect handlers
+        void setConnectHandler( ConnectHandlerType ConnectHandler )
+        {
+            ConnectHandlers_.clear();
+            addConnectHandler( std::move( ConnectHandler ) );
+        }
+
+        // handlers are called in the order they were added - the first failing one fails the connect
+        void addConnectHandler( ConnectHandlerType ConnectHandler )
+        {
+            if( ConnectHandler )
+                ConnectHandlers_.push_back( std::move( ConnectHandler ) );
+        }
+
         auto transmit( const Request& Command, boost::system::error_code& ec )
         {
+            Stopwatch Watch;
+            Trace TheTrace;
             auto res = std::make_unique<typename ResponseHandler<NotificationSinkType_>>(ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_);
             for( ;;)
             {
-                if( !Socket_.is_open() )
+                if( !Socket_.is_open() && !connect( ec ) )
                 {
-                    auto Socket = ConnectionManagerInstance_.getConnectedSocket( io_service_, ec );
-                    if( ec )
-                        return res;
-                    else
-                    {
-                        if( Index_ )
-                        {
-                            Detail::SocketConnectionManager scm( Socket );
-                            Connection<Detail::SocketConnectionManager, NotificationSinkType_> CurrentConnection( io_service_, scm, 0, NotificationSink_ );
-
-                            redis::select( CurrentConnection, ec, Index_ );
-
-                            NotificationSink_.trace( "Connection::transmit: selected database '{}'", Index_ );
-
-                            Socket_ = CurrentConnection.passSocket();
-                        }
-                        else
-                            Socket_ = std::move( Socket );
-                    }
+                    commandCompleted( Command, Watch, TheTrace, true );
+                    return res;
                 }
 
+                TheTrace.mark( TracePoint::ConnectionAcquired );
                 auto BytesWritten = boost::asio::write( Socket_, Command.bufferSequence(), ec );
                 if( ec )
                 {
@@ -163,7 +201,9 @@ namespace redis
                     continue;
                 }
 
-                NotificationSink_.debug( "Connection::transmit: sent {} bytes of data", BytesWritten );
+                REDISPP_NOTIFY( NotificationSink_, debug, "Connection::transmit: sent {} bytes of data", BytesWritten );
+                Metrics_.bytesSent( Host_, BytesWritten );
+                TheTrace.mark( TracePoint::WriteCompleted );
 
                 break;
             }
@@ -175,80 +215,88 @@ namespace redis
                 if( ec )
                 {
                     Socket_.close();
+                    commandCompleted( Command, Watch, TheTrace, true );
                     return res;
                 }
 
-                NotificationSink_.debug( "Connection::transmit: received {} bytes of data", BytesRead );
+                REDISPP_NOTIFY( NotificationSink_, debug, "Connection::transmit: received {} bytes of data", BytesRead );
+                Metrics_.bytesReceived( Host_, BytesRead );
+                TheTrace.dataReceived();
 
             } while( !res->dataReceived( BytesRead ) );
 
+            TheTrace.mark( TracePoint::ParseCompleted );
+            commandCompleted( Command, Watch, TheTrace, res->top().type() == Response::Type::Error );
             return res;
         }
 
+        // the latency of a pipeline is recorded as command "PIPELINE"
         PipelineResult<NotificationSinkType_> transmit(const Pipeline& thePipeline, boost::system::error_code& ec)
         {
-            ResponseHandler<NotificationSinkType_> res;
-            size_t ExpectedResponses = thePipeline.requestCount();
-            auto spResponses = std::make_shared<std::vector<std::shared_ptr<redis::Response>>>( ExpectedResponses );
-
-            for( ;;)
+            Stopwatch Watch;
+            Trace TheTrace;
+            if( !send( thePipeline, ec, TheTrace ) )
             {
-                if( !Socket_.is_open() )
-                {
-                    auto Socket = ConnectionManagerInstance_.getConnectedSocket( io_service_, ec );
-                    if( ec )
-                        return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
-                    else
-                    {
-                        if( Index_ )
-                        {
-                            Detail::SocketConnectionManager scm( Socket );
-                            Connection<Detail::SocketConnectionManager, NotificationSinkType_> CurrentConnection( io_service_, scm, 0, NotificationSink_ );
+                ResponseHandler<NotificationSinkType_> res;
+                auto spResponses = std::make_shared<Response::ElementContainer>( thePipeline.requestCount() );
+                Metrics_.commandCompleted( "PIPELINE", Watch.elapsed(), true );
+                TheTrace.finish( Tracer_, "PIPELINE", true );
+                return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
+            }
 
-                            redis::select( CurrentConnection, ec, Index_ );
+            auto Result = receive( thePipeline.requestCount(), ec, TheTrace );
+            Metrics_.commandCompleted( "PIPELINE", Watch.elapsed(), static_cast<bool>( ec ) );
+            TheTrace.finish( Tracer_, "PIPELINE", static_cast<bool>( ec ) );
+            return Result;
+        }
 
-                            Socket_ = CurrentConnection.passSocket();
-                        }
-                        else
-                            Socket_ = std::move( Socket );
-                    }
-                }
+        // Like transmit above, but the responses are read by a separate I/O thread while this thread parses them - see
+        // ParallelReceive.h. pTimes receives the time spent by the stages
+        PipelineResult<NotificationSinkType_> transmit( const Pipeline& thePipeline, boost::system::error_code& ec, const ParallelReceiveSettings& Settings, ReceiveStageTimes* pTimes = nullptr )
+        {
+            Stopwatch Watch;
+            Trace TheTrace;
+            ResponseHandler<NotificationSinkType_> res;
+            auto spResponses = std::make_shared<Response::ElementContainer>( thePipeline.requestCount() );
 
-                boost::asio::write( Socket_, thePipeline.bufferSequence(), ec );
+            if( send( thePipeline, ec, TheTrace ) )
+            {
+                ReceiveStageTimes Times;
+                Detail::receiveParallel( Socket_, res, *spResponses, thePipeline.requestCount(), Settings, Times, TheTrace, ec );
+                Metrics_.bytesReceived( Host_, Times.Bytes );
                 if( ec )
-                {
                     Socket_.close();
-
-                    // Try again!
-                    continue;
-                }
-
-                break;
+                else
+                    TheTrace.mark( TracePoint::ParseCompleted );
+
+                REDISPP_NOTIFY( NotificationSink_, debug, "Connection::transmit: received {} bytes in {} reads - read {} us, read stalled {} us, parse {} us, parse stalled {} us",
+                                Times.Bytes, Times.Reads,
+                                std::chrono::duration_cast<std::chrono::microseconds>( Times.Read ).count(),
+                                std::chrono::duration_cast<std::chrono::microseconds>( Times.ReadStalled ).count(),
+                                std::chrono::duration_cast<std::chrono::microseconds>( Times.Parse ).count(),
+                                std::chrono::duration_cast<std::chrono::microseconds>( Times.ParseStalled ).count() );
+                if( pTimes )
+                    *pTimes = Times;
             }
 
-            bool ParseCompleted = false;
-
-            for( size_t CurrentResponse = 0; CurrentResponse < ExpectedResponses; ++CurrentResponse )
-            {
-                size_t BytesRead;
-                do
-                {
-                    BytesRead = Socket_.read_some( boost::asio::buffer( res.buffer() ), ec );
-                    if( ec )
-                    {
-                        Socket_.close();
-                        return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
-                    }
-
-                } while( !res.dataReceived( BytesRead ) );
+            Metrics_.commandCompleted( "PIPELINE", Watch.elapsed(), static_cast<bool>( ec ) );
+            TheTrace.finish( Tracer_, "PIPELINE", static_cast<bool>( ec ) );
+            return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
+        }
 
-                do
-                {
-                    spResponses->at(CurrentResponse++) = res.spTop();
-                } while( res.commit( true ) );
-            }
+        // Sends all requests of a pipeline without waiting for the responses - (re)connects if necessary.
+        // The responses have to be collected with receive.
+        bool send( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            Detail::RequestTrace<false> NoTrace;
+            return send( thePipeline, ec, NoTrace );
+        }
 
-            return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
+        // Receives the responses of previously sent requests
+        PipelineResult<NotificationSinkType_> receive( size_t ExpectedResponses, boost::system::error_code& ec )
+        {
+            Detail::RequestTrace<false> NoTrace;
+            return receive( ExpectedResponses, ec, NoTrace );
         }
 
         template <class	CompletionToken>
@@ -259,67 +307,82 @@ namespace redis
             handler_type handler(std::forward<decltype(token)>(token));
             boost::asio::async_result<decltype(handler)> result(handler);
 
+            // records the latency and the span before the handler is called
+            auto timedHandler = [this, &Command, Watch = Stopwatch(), handler](const boost::system::error_code& ec, Response Data, Trace& TheTrace) mutable {
+                commandCompleted( Command, Watch, TheTrace, ec || Data.type() == Response::Type::Error );
+                handler(ec, std::move(Data));
+            };
+
             if (!Socket_.is_open())
             {
                 ConnectionManagerInstance_.async_getConnectedSocket(io_service_,
-                                                  [this, &Command, handler](const boost::system::error_code& ec, std::shared_ptr<boost::asio::ip::tcp::socket>& spSocket) mutable {
+                                                  [this, &Command, TheTrace = Trace(), timedHandler](const boost::system::error_code& ec, std::shared_ptr<SocketType>& spSocket) mutable {
                     if (ec)
                     {
-                        handler(ec, Response());
+                        timedHandler(ec, Response(), TheTrace);
                     }
                     else
                     {
                         Socket_ = std::move(*spSocket);
+                        connected();
 
-                        internalSendData(Command, std::forward<handler_type>(handler));
+                        internalSendData(Command, TheTrace, std::move(timedHandler));
                     }
                 });
             }
             else
-                internalSendData(Command, std::forward<handler_type>(handler));
+                internalSendData(Command, Trace(), std::move(timedHandler));
 
             return result.get();
         }
 
         template <class	ConnectHandler>
-        void internalReceiveData(std::shared_ptr<ResponseHandler<NotificationSinkType_>>& spServerResponse, ConnectHandler& handler)
+        void internalReceiveData(std::shared_ptr<ResponseHandler<NotificationSinkType_>>& spServerResponse, Trace& TheTrace, ConnectHandler& handler)
         {
             Socket_.async_read_some(boost::asio::buffer(spServerResponse->buffer()),
-                                    [this, spServerResponse, handler](const boost::system::error_code& ec, std::size_t BytesReceived) mutable
+                                    [this, spServerResponse, TheTrace, handler](const boost::system::error_code& ec, std::size_t BytesReceived) mutable
             {
                 if (ec)
-                    handler(ec, Response());
+                    handler(ec, Response(), TheTrace);
                 else
                 {
+                    Metrics_.bytesReceived( Host_, BytesReceived );
+                    TheTrace.dataReceived();
                     if (!spServerResponse->dataReceived(BytesReceived))
-                        internalReceiveData( spServerResponse, handler );
+                        internalReceiveData( spServerResponse, TheTrace, handler );
                     else
-                        handler(ec, spServerResponse->top());
+                    {
+                        TheTrace.mark( TracePoint::ParseCompleted );
+                        handler(ec, spServerResponse->top(), TheTrace);
+                    }
                 }
             });
         }
 
         template <class	ConnectHandler>
-        void internalSendData(const Request& Command, ConnectHandler&& handler)
+        void internalSendData(const Request& Command, Trace TheTrace, ConnectHandler&& handler)
         {
             boost::system::error_code ec;
 
+            TheTrace.mark( TracePoint::ConnectionAcquired );
             Socket_.async_send(Command.bufferSequence(),
-                               [this, handler](const boost::system::error_code& ec, std::size_t bytes_transferred) mutable {
+                               [this, TheTrace, handler](const boost::system::error_code& ec, std::size_t bytes_transferred) mutable {
                 if (ec)
-                    handler(ec, Response());
+                    handler(ec, Response(), TheTrace);
                 else
                 {
+                    Metrics_.bytesSent( Host_, bytes_transferred );
+                    TheTrace.mark( TracePoint::WriteCompleted );
                     auto spServerResponse = std::make_shared<ResponseHandler<NotificationSinkType_>>();
 
-                    internalReceiveData(std::move(spServerResponse), std::forward<ConnectHandler>(handler));
+                    internalReceiveData(std::move(spServerResponse), TheTrace, std::forward<ConnectHandler>(handler));
                 }
             });
         }
 
-        boost::asio::ip::tcp::socket passSocket()
+        SocketType passSocket()
         {
-            return boost::asio::ip::tcp::socket( std::move(Socket_) );
+            return SocketType( std::move(Socket_) );
         }
 
         std::tuple<std::string, int> remote_endpoint()
@@ -339,9 +402,155 @@ namespace redis
         {
             LastServerError_ = LastServerError;
         }
+        NotificationSinkType_& notificationSink()
+        {
+            return NotificationSink_;
+        }
+
+        // counts the established connections - a changed value means a reconnect, which lost the server side state of
+        // the previous connection, e.g. a WATCH
+        uint64_t connectionGeneration() const
+        {
+            return ConnectionGeneration_;
+        }
 
     private:
+        template <class TraceT_>
+        bool send( const Pipeline& thePipeline, boost::system::error_code& ec, TraceT_& TheTrace )
+        {
+            for( ;;)
+            {
+                if( !Socket_.is_open() && !connect( ec ) )
+                    return false;
+
+                TheTrace.mark( TracePoint::ConnectionAcquired );
+                auto BytesWritten = boost::asio::write( Socket_, thePipeline.bufferSequence(), ec );
+                if( ec )
+                {
+                    Socket_.close();
+
+                    // Try again!
+                    continue;
+                }
+
+                Metrics_.bytesSent( Host_, BytesWritten );
+                TheTrace.mark( TracePoint::WriteCompleted );
+                return true;
+            }
+        }
+
+        template <class TraceT_>
+        PipelineResult<NotificationSinkType_> receive( size_t ExpectedResponses, boost::system::error_code& ec, TraceT_& TheTrace )
+        {
+            ResponseHandler<NotificationSinkType_> res;
+            auto spResponses = std::make_shared<Response::ElementContainer>( ExpectedResponses );
+
+            size_t CurrentResponse = 0;
+            while( CurrentResponse < ExpectedResponses )
+            {
+                size_t BytesRead;
+                do
+                {
+                    BytesRead = Socket_.read_some( boost::asio::buffer( res.buffer() ), ec );
+                    if( ec )
+                    {
+                        Socket_.close();
+                        return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
+                    }
+
+                    Metrics_.bytesReceived( Host_, BytesRead );
+                    TheTrace.dataReceived();
+
+                } while( !res.dataReceived( BytesRead ) );
+
+                do
+                {
+                    spResponses->at(CurrentResponse++) = res.spTop();
+                } while( CurrentResponse < ExpectedResponses && res.commit( true ) );
+            }
+
+            TheTrace.mark( TracePoint::ParseCompleted );
+            return PipelineResult<NotificationSinkType_>( spResponses, res.bufferContainer(), NotificationSink_ );
+        }
+
+        static boost::string_view commandName( const Request& Command )
+        {
+            auto Name = Command.argument( 0 );
+            return boost::string_view( boost::asio::buffer_cast<const char*>( Name ), boost::asio::buffer_size( Name ) );
+        }
+
+        // records the latency and passes the span to the tracer
+        void commandCompleted( const Request& Command, const Stopwatch& Watch, Trace& TheTrace, bool Failed )
+        {
+            if( Detail::metricsEnabled<MetricsType_>() )
+                Metrics_.commandCompleted( commandName( Command ), Watch.elapsed(), Failed );
+            if( Detail::tracerEnabled<TracerType_>() )
+                TheTrace.finish( Tracer_, commandName( Command ), Failed );
+        }
+
+        // counts a newly established connection for its host
+        void connected()
+        {
+            ++ConnectionGeneration_;
+            if( Detail::metricsEnabled<MetricsType_>() )
+            {
+                boost::system::error_code ec;
+                auto Endpoint = Socket_.remote_endpoint( ec );
+                Host_ = Metrics_.host( Endpoint.address().to_string() + ":" + std::to_string( Endpoint.port() ) );
+                Metrics_.connected( Host_ );
+            }
+        }
+
+        // establishes a new connection, selects the database and calls the connect handler
+        bool connect( boost::system::error_code& ec )
+        {
+            auto Socket = ConnectionManagerInstance_.getConnectedSocket( io_service_, ec );
+            if( ec )
+                return false;
+
+            if( !Index_ && ConnectHandlers_.empty() )
+            {
+                Socket_ = std::move( Socket );
+                connected();
+                return true;
+            }
+
+            Detail::BasicSocketConnectionManager<SocketType> scm( Socket );
+            Connection<Detail::BasicSocketConnectionManager<SocketType>, NotificationSinkType_> CurrentConnection( io_service_, scm, 0, NotificationSink_ );
+
+            if( Index_ )
+            {
+                redis::select( CurrentConnection, ec, Index_ );
+                if( ec )
+                    return false;
+
+                REDISPP_NOTIFY( NotificationSink_, trace, "Connection::connect: selected database '{}'", Index_ );
+            }
+
+            for( auto& ConnectHandler : ConnectHandlers_ )
+            {
+                ConnectHandler( CurrentConnection, ec );
+                if( ec )
+                {
+                    NotificationSink_.warning( "Connection::connect: connect handler failed: {}", ec.message() );
+                    return false;
+                }
+            }
+
+            // a connect handler without any request leaves the socket with the manager
+            Socket_ = CurrentConnection.passSocket();
+            if( !Socket_.is_open() )
+                Socket_ = scm.getInstance().getConnectedSocket( io_service_, ec );
+            connected();
+            return true;
+        }
+
         typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        std::vector<ConnectHandlerType> ConnectHandlers_;
+        uint64_t ConnectionGeneration_ = 0;
+        MetricsType_ Metrics_;
+        Detail::MetricsHostHandle<MetricsType_> Host_{};
+        TracerType_ Tracer_;
     };
 }
 
@@ -23,7 +23,11 @@ namespace redis
         no_data,
         no_usable_server,
         incomplete_response,
-        no_more_sentinels
+        no_more_sentinels,
+        wrong_role,
+        transaction_aborted,
+        keyless_request,
+        cross_node_transaction
     };
 
     class redis_error_category_imp : public base_error_category
@@ -47,6 +51,10 @@ namespace redis
                 case ErrorCodes::no_usable_server: return "No usable server found";
                 case ErrorCodes::incomplete_response: return "Not enough data for expected responses";
                 case ErrorCodes::no_more_sentinels: return "No more sentinels left to ask for master";
+                case ErrorCodes::wrong_role: return "Server does not have the expected role";
+                case ErrorCodes::transaction_aborted: return "Transaction aborted - a watched key was modified";
+                case ErrorCodes::keyless_request: return "Request without key and no shard for keyless requests";
+                case ErrorCodes::cross_node_transaction: return "Transaction with keys on several nodes";
                 default: return "Unknown error";
             }
         }
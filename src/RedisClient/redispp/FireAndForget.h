@@ -0,0 +1,248 @@
+#pragma once
+
+#ifndef REDISPP_FIREANDFORGET_INCLUDED
+#define REDISPP_FIREANDFORGET_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+#include "redispp/Commands.h"
+#include "redispp/Connection.h"
+#include "redispp/Error.h"
+#include "redispp/ReplyCounter.h"
+
+namespace redis
+{
+    enum class FireAndForgetMode
+    {
+        // the replies are counted by a ReplyCounter - nothing is decoded, only error replies are reported with the
+        // index of their command
+        Counted,
+        // CLIENT REPLY OFF - the server sends nothing at all, errors are lost
+        Off
+    };
+
+    // Writes commands whose results are not needed, e.g. telemetry counters, on a dedicated connection. No Response
+    // is built and nothing is kept per command, so any number of commands can be streamed:
+    //
+    //   redis::FireAndForgetWriter<redis::SingleHostConnectionManager> Writer( Manager );
+    //   Writer.send( redis::incrCommand( Key ), ec );
+    //   ...
+    //   Writer.flush( ec );
+    //
+    // In Counted mode the replies available are consumed after every write without waiting for them. If the
+    // connection fails, the commands not confirmed yet are lost - see lost() - and the next send reconnects. A
+    // database Index other than 0 is selected on every connection before any command is written.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class FireAndForgetWriter
+    {
+    public:
+        // called for every error reply with the index of its command, counted from the creation of the writer
+        using ErrorHandlerType = std::function<void( size_t CommandIndex, boost::string_view Message )>;
+
+        static constexpr size_t ReceiveBufferSize = 64 * 1024;
+
+        FireAndForgetWriter( const FireAndForgetWriter& ) = delete;
+        FireAndForgetWriter& operator=( const FireAndForgetWriter& ) = delete;
+
+        FireAndForgetWriter( const ConnectionManagerType& Manager, FireAndForgetMode Mode = FireAndForgetMode::Counted, ErrorHandlerType ErrorHandler = nullptr, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            Mode_( Mode ),
+            ErrorHandler_( std::move( ErrorHandler ) ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink ),
+            Socket_( io_service_ ),
+            ReceiveBuffer_( ReceiveBufferSize )
+        {}
+
+        bool send( const Request& Command, boost::system::error_code& ec )
+        {
+            return write( Command.bufferSequence(), 1, ec );
+        }
+
+        // all commands of the pipeline are written with a single write
+        bool send( const Pipeline& Commands, boost::system::error_code& ec )
+        {
+            return write( Commands.bufferSequence(), Commands.requestCount(), ec );
+        }
+
+        // waits until the server has processed all commands sent
+        bool flush( boost::system::error_code& ec )
+        {
+            ec.clear();
+            if( !Socket_.is_open() )
+                return true;
+
+            if( Mode_ == FireAndForgetMode::Counted )
+                return drain( true, ec );
+
+            // the reply to CLIENT REPLY ON arrives after all previous commands have been executed
+            ReplyCounter Confirmation;
+            if( !writeCommand( clientReplyCommand( ClientReplyMode::On ), ec ) )
+                return false;
+            while( !Confirmation.replies() )
+            {
+                auto BytesRead = Socket_.read_some( boost::asio::buffer( ReceiveBuffer_ ), ec );
+                if( ec )
+                    return fail( ec );
+                Confirmation.consume( ReceiveBuffer_.data(), BytesRead );
+            }
+            ConfirmedCommands_ = Commands_ - LostCommands_;
+
+            return writeCommand( clientReplyCommand( ClientReplyMode::Off ), ec );
+        }
+
+        // number of commands sent
+        size_t commands() const { return Commands_; }
+        // number of commands known to be processed by the server - Off mode: as of the last flush
+        size_t confirmed() const { return Mode_ == FireAndForgetMode::Counted ? ConfirmedCommands_ + Replies_.replies() : ConfirmedCommands_; }
+        // number of commands sent on failed connections without a confirmation - they may or may not have been
+        // executed
+        size_t lost() const { return LostCommands_; }
+        // number of error replies
+        size_t errors() const { return Errors_; }
+
+    private:
+        bool connect( boost::system::error_code& ec )
+        {
+            Socket_ = ConnectionManagerInstance_.getConnectedSocket( io_service_, ec );
+            if( ec )
+            {
+                NotificationSink_.error( "FireAndForgetWriter::connect: unable to connect: {}", ec.message() );
+                return false;
+            }
+
+            // the replies counted from now on belong to the commands sent on this connection
+            BaseCommands_ = Commands_;
+
+            if( Index_ && !select( ec ) )
+                return false;
+
+            return Mode_ == FireAndForgetMode::Counted || writeCommand( clientReplyCommand( ClientReplyMode::Off ), ec );
+        }
+
+        // selects the database - its reply is read before any command is written, so it is not counted
+        bool select( boost::system::error_code& ec )
+        {
+            if( !writeCommand( selectCommand( Index_ ), ec ) )
+                return false;
+
+            ReplyCounter Confirmation;
+            std::string Error;
+            while( !Confirmation.replies() )
+            {
+                auto BytesRead = Socket_.read_some( boost::asio::buffer( ReceiveBuffer_ ), ec );
+                if( ec )
+                    return fail( ec );
+
+                Confirmation.consume( ReceiveBuffer_.data(), BytesRead, [&Error]( size_t ReplyIndex, boost::string_view Message ) { Error = Message.to_string(); } );
+                if( Confirmation.failed() )
+                    return fail( ::redis::make_error_code( ErrorCodes::protocol_error ) );
+            }
+
+            if( !Error.empty() )
+            {
+                NotificationSink_.error( "FireAndForgetWriter::select: unable to select database {}: {}", Index_, Error );
+                return fail( ::redis::make_error_code( ErrorCodes::server_error ) );
+            }
+            return true;
+        }
+
+        template <class BufferSequenceT_>
+        bool write( const BufferSequenceT_& Buffers, size_t Commands, boost::system::error_code& ec )
+        {
+            ec.clear();
+            if( !Socket_.is_open() && !connect( ec ) )
+                return false;
+
+            boost::asio::write( Socket_, Buffers, ec );
+            if( ec )
+                return fail( ec );
+
+            Commands_ += Commands;
+            return Mode_ == FireAndForgetMode::Off || drain( false, ec );
+        }
+
+        // writes a command which is not counted
+        bool writeCommand( const Request& Command, boost::system::error_code& ec )
+        {
+            boost::asio::write( Socket_, Command.bufferSequence(), ec );
+            return ec ? fail( ec ) : true;
+        }
+
+        // consumes the replies available - with Wait until every command has been answered
+        bool drain( bool Wait, boost::system::error_code& ec )
+        {
+            while( BaseCommands_ + Replies_.replies() < Commands_ )
+            {
+                if( !Wait )
+                {
+                    auto Available = Socket_.available( ec );
+                    if( ec )
+                        return fail( ec );
+                    if( !Available )
+                        return true;
+                }
+
+                auto BytesRead = Socket_.read_some( boost::asio::buffer( ReceiveBuffer_ ), ec );
+                if( ec )
+                    return fail( ec );
+
+                Replies_.consume( ReceiveBuffer_.data(), BytesRead, [this]( size_t ReplyIndex, boost::string_view Message ) {
+                    ++Errors_;
+                    if( ErrorHandler_ )
+                        ErrorHandler_( BaseCommands_ + ReplyIndex, Message );
+                    else
+                        NotificationSink_.warning( "FireAndForgetWriter::drain: command {} failed: {}", BaseCommands_ + ReplyIndex, Message.to_string() );
+                } );
+
+                if( Replies_.failed() )
+                    return fail( ::redis::make_error_code( ErrorCodes::protocol_error ) );
+            }
+
+            return true;
+        }
+
+        bool fail( const boost::system::error_code& ec )
+        {
+            NotificationSink_.error( "FireAndForgetWriter::fail: {} commands not confirmed: {}", Commands_ - confirmed() - LostCommands_, ec.message() );
+
+            // the replies of this connection are lost - the commands without one count as lost
+            if( Mode_ == FireAndForgetMode::Counted )
+                ConfirmedCommands_ += Replies_.replies();
+            Replies_ = ReplyCounter();
+            LostCommands_ = Commands_ - ConfirmedCommands_;
+
+            boost::system::error_code Ignored;
+            Socket_.close( Ignored );
+            return false;
+        }
+
+        typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        const FireAndForgetMode Mode_;
+        ErrorHandlerType ErrorHandler_;
+        const int64_t Index_;
+        NotificationSinkType_ NotificationSink_;
+
+        boost::asio::io_service io_service_;
+        typename Detail::socketType<ConnectionManagerType>::type Socket_;
+        std::vector<char> ReceiveBuffer_;
+
+        size_t Commands_ = 0;
+        // index of the first command sent on the current connection
+        size_t BaseCommands_ = 0;
+        // commands confirmed before the current connection or, in Off mode, the last flush
+        size_t ConfirmedCommands_ = 0;
+        size_t LostCommands_ = 0;
+        size_t Errors_ = 0;
+        ReplyCounter Replies_;
+    };
+}
+
+#endif
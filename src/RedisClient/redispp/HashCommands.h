@@ -7,6 +7,12 @@
 // See accompanying file LICENSE.txt for Lincense
 
 #include "redispp/Commands.h"
+// HSCAN and the hscanRange of the field/value pairs of a hash
+#include "redispp/ScanCommands.h"
+
+#include <vector>
+#include <utility>
+#include <iterator>
 
 namespace redis
 {
@@ -43,6 +49,7 @@ namespace redis
     {
         Request r( "HGET" );
         r << Key << Field;
+        r.setReadOnly();
         return r;
     }
 
@@ -53,9 +60,72 @@ namespace redis
     }
 
     template <class Connection, class CompletionToken, class T1_, class T2_>
-    auto async_hset( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Field )
+    auto async_hget( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Field )
     {
-        return Detail::async_universal( con, token, &hsetCommand<decltype(Key), decltype(Field)>, &getResult, std::ref(Key), std::ref(Field) );
+        return Detail::async_universal( con, token, &hgetCommand<decltype(Key), decltype(Field)>, &getResult, std::ref(Key), std::ref(Field) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                 H G E T A L L
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    using FieldValueViews = std::vector<std::pair<boost::asio::const_buffer, boost::asio::const_buffer>>;
+
+    template <class T1_>
+    Request hgetallCommand( const T1_& Key )
+    {
+        Request r( "HGETALL" );
+        r << Key;
+        r.setReadOnly();
+        return r;
+    }
+
+    namespace Detail
+    {
+        // writes the field/value pairs of a HGETALL reply to Out - returns the number of pairs
+        template <class OutputIteratorT_>
+        size_t fieldValues( const Response& Data, OutputIteratorT_ Out, boost::system::error_code& ec )
+        {
+            if( Data.type() != Response::Type::Array || Data.elements().size() % 2 )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return 0;
+            }
+
+            for( size_t Index = 0; Index < Data.elements().size(); Index += 2 )
+                *Out++ = std::make_pair( responseBuffer( Data[Index] ), responseBuffer( Data[Index + 1] ) );
+
+            return Data.elements().size() / 2;
+        }
+    }
+
+    // returns all field/value pairs of the hash as views into the received data
+    inline FieldValueViews hgetallResult( const Response& Data, boost::system::error_code& ec )
+    {
+        FieldValueViews Result;
+        Result.reserve( Data.elements().size() / 2 );
+        Detail::fieldValues( Data, std::back_inserter( Result ), ec );
+        return Result;
+    }
+
+    template <class Connection, class T1_>
+    auto hgetall( Connection& con, boost::system::error_code& ec, const T1_& Key )
+    {
+        return Detail::sync_universal( con, ec, &hgetallCommand<T1_>, &hgetallResult, std::ref(Key) );
+    }
+
+    // writes the field/value pairs to Out, a caller provided output iterator of std::pair<const_buffer, const_buffer> -
+    // the result is the number of pairs
+    template <class Connection, class T1_, class OutputIteratorT_>
+    auto hgetall( Connection& con, boost::system::error_code& ec, const T1_& Key, OutputIteratorT_ Out )
+    {
+        return Detail::sync_universal( con, ec, &hgetallCommand<T1_>, [Out]( const Response& Data, boost::system::error_code& ec ) { return Detail::fieldValues( Data, Out, ec ); }, std::ref(Key) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_hgetall( Connection& con, CompletionToken&& token, const T1_& Key )
+    {
+        return Detail::async_universal( con, token, &hgetallCommand<T1_>, &hgetallResult, std::ref(Key) );
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -84,6 +154,70 @@ namespace redis
         return Detail::async_universal( con, token, &hincrbyCommand<decltype(Key)>, &incrResult, std::ref(Key), std::ref(Field), Increment );
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   H M G E T
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // [First, Last) is a range of fields - std::string, boost::string_view or const_buffer - which are not copied
+    template <class T1_, class IteratorT_>
+    Request hmgetCommand( const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        Request r( "HMGET" );
+        r << Key;
+        for( ; First != Last; ++First )
+            r << Detail::argumentBuffer( *First );
+        r.setReadOnly();
+        return r;
+    }
+
+    namespace Detail
+    {
+        // writes the values of a HMGET reply to Out - returns the number of values
+        template <class OutputIteratorT_>
+        size_t fieldValueOptionals( const Response& Data, OutputIteratorT_ Out, boost::system::error_code& ec )
+        {
+            if( Data.type() != Response::Type::Array )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return 0;
+            }
+
+            for( const auto& spValue : Data.elements() )
+                *Out++ = getResult( *spValue, ec );
+
+            return Data.elements().size();
+        }
+    }
+
+    // returns the values in the order of the fields - none for missing fields
+    inline std::vector<boost::optional<boost::asio::const_buffer>> hmgetResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<boost::optional<boost::asio::const_buffer>> Result;
+        Result.reserve( Data.elements().size() );
+        Detail::fieldValueOptionals( Data, std::back_inserter( Result ), ec );
+        return Result;
+    }
+
+    template <class Connection, class T1_, class IteratorT_>
+    auto hmget( Connection& con, boost::system::error_code& ec, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::sync_universal( con, ec, &hmgetCommand<T1_, IteratorT_>, &hmgetResult, std::ref(Key), First, Last );
+    }
+
+    // writes the values to Out, a caller provided output iterator of boost::optional<const_buffer> - the result is the
+    // number of values
+    template <class Connection, class T1_, class IteratorT_, class OutputIteratorT_>
+    auto hmget( Connection& con, boost::system::error_code& ec, const T1_& Key, IteratorT_ First, IteratorT_ Last, OutputIteratorT_ Out )
+    {
+        return Detail::sync_universal( con, ec, &hmgetCommand<T1_, IteratorT_>, [Out]( const Response& Data, boost::system::error_code& ec ) { return Detail::fieldValueOptionals( Data, Out, ec ); }, std::ref(Key), First, Last );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class IteratorT_>
+    auto async_hmget( Connection& con, CompletionToken&& token, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::async_universal( con, token, &hmgetCommand<T1_, IteratorT_>, &hmgetResult, std::ref(Key), First, Last );
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     //                                                   H S E T
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -108,6 +242,29 @@ namespace redis
         return Detail::async_universal( con, token, &hsetCommand<decltype(Key), decltype(Field), decltype(Value)>, &IntResult, std::ref(Key), std::ref(Field), std::ref(Value) );
     }
 
+    // [First, Last) is a range of field/value pairs, which are not copied. Returns the number of new fields.
+    template <class T1_, class IteratorT_>
+    Request hsetFieldsCommand( const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        Request r( "HSET" );
+        r << Key;
+        for( ; First != Last; ++First )
+            r << Detail::argumentBuffer( First->first ) << Detail::argumentBuffer( First->second );
+        return r;
+    }
+
+    template <class Connection, class T1_, class IteratorT_>
+    auto hsetFields( Connection& con, boost::system::error_code& ec, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::sync_universal( con, ec, &hsetFieldsCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class IteratorT_>
+    auto async_hsetFields( Connection& con, CompletionToken&& token, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::async_universal( con, token, &hsetFieldsCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     //                                                   H S E T N X
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef REDISPP_LIST_COMMANDS_INCLUDED
+#define REDISPP_LIST_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Commands.h"
+
+namespace redis
+{
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   L P U S H
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_, class T2_>
+    Request lpushCommand( const T1_& Key, const T2_& Value )
+    {
+        Request r( "LPUSH" );
+        r << Key << Value;
+        return r;
+    }
+
+    // returns the length of the list
+    template <class Connection, class T1_, class T2_>
+    auto lpush( Connection& con, boost::system::error_code& ec, const T1_& Key, const T2_& Value )
+    {
+        return Detail::sync_universal( con, ec, &lpushCommand<T1_, T2_>, &IntResult, std::ref(Key), std::ref(Value) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_>
+    auto async_lpush( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Value )
+    {
+        return Detail::async_universal( con, token, &lpushCommand<T1_, T2_>, &IntResult, std::ref(Key), std::ref(Value) );
+    }
+
+    // [First, Last) is a range of values, which are not copied - the last one ends up at the head of the list
+    template <class T1_, class IteratorT_>
+    Request lpushValuesCommand( const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        Request r( "LPUSH" );
+        r << Key;
+        for( ; First != Last; ++First )
+            r << Detail::argumentBuffer( *First );
+        return r;
+    }
+
+    template <class Connection, class T1_, class IteratorT_>
+    auto lpushValues( Connection& con, boost::system::error_code& ec, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::sync_universal( con, ec, &lpushValuesCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class IteratorT_>
+    auto async_lpushValues( Connection& con, CompletionToken&& token, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::async_universal( con, token, &lpushValuesCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  L R A N G E
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Start and Stop may be negative to count from the end
+    template <class T1_>
+    Request lrangeCommand( const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        Request r( "LRANGE" );
+        r << Key << Start << Stop;
+        r.setReadOnly();
+        return r;
+    }
+
+    template <class Connection, class T1_>
+    auto lrange( Connection& con, boost::system::error_code& ec, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::sync_universal( con, ec, &lrangeCommand<T1_>, &BufferArrayResult, std::ref(Key), Start, Stop );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_lrange( Connection& con, CompletionToken&& token, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::async_universal( con, token, &lrangeCommand<T1_>, &BufferArrayResult, std::ref(Key), Start, Stop );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   L T R I M
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request ltrimCommand( const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        Request r( "LTRIM" );
+        r << Key << Start << Stop;
+        return r;
+    }
+
+    template <class Connection, class T1_>
+    auto ltrim( Connection& con, boost::system::error_code& ec, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::sync_universal( con, ec, &ltrimCommand<T1_>, &OKResult, std::ref(Key), Start, Stop );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_ltrim( Connection& con, CompletionToken&& token, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::async_universal( con, token, &ltrimCommand<T1_>, &OKResult, std::ref(Key), Start, Stop );
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+#pragma once
+
+#ifndef REDISPP_LOCKFREEQUEUE_INCLUDED
+#define REDISPP_LOCKFREEQUEUE_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+namespace redis
+{
+    namespace Detail
+    {
+        // Size of a cache line - used to keep producer and consumer state apart
+        constexpr size_t CacheLineSize = 64;
+
+        inline size_t roundUpToPowerOfTwo( size_t Value )
+        {
+            size_t Result = 1;
+            while( Result < Value )
+                Result <<= 1;
+            return Result;
+        }
+
+        // Waiting strategy for threads polling a lock free queue: spin first, then yield the time slice and finally
+        // sleep briefly, so an idle consumer does not burn a core
+        class Backoff
+        {
+        public:
+            void pause()
+            {
+                if( Count_ >= YieldLimit_ )
+                    std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+                else
+                    if( Count_ >= SpinLimit_ )
+                        std::this_thread::yield();
+
+                if( Count_ < YieldLimit_ )
+                    ++Count_;
+            }
+
+            void reset()
+            {
+                Count_ = 0;
+            }
+
+        private:
+            static constexpr size_t SpinLimit_ = 64;
+            static constexpr size_t YieldLimit_ = 1024;
+            size_t Count_ = 0;
+        };
+    }
+
+    // Bounded wait free queue for exactly one producer and one consumer thread.
+    // The capacity is rounded up to a power of two.
+    template <class T_>
+    class SpscRing
+    {
+    public:
+        SpscRing( const SpscRing& ) = delete;
+        SpscRing& operator=( const SpscRing& ) = delete;
+
+        explicit SpscRing( size_t Capacity ) :
+            Mask_( Detail::roundUpToPowerOfTwo( Capacity ) - 1 ),
+            spSlots_( new T_[Mask_ + 1] )
+        {}
+
+        // producer side - returns false if the queue is full
+        bool push( T_&& Value )
+        {
+            auto Tail = Tail_.load( std::memory_order_relaxed );
+            if( Tail - HeadCache_ > Mask_ )
+            {
+                HeadCache_ = Head_.load( std::memory_order_acquire );
+                if( Tail - HeadCache_ > Mask_ )
+                    return false;
+            }
+
+            spSlots_[Tail & Mask_] = std::move( Value );
+            Tail_.store( Tail + 1, std::memory_order_release );
+            return true;
+        }
+
+        // consumer side - returns false if the queue is empty
+        bool pop( T_& Value )
+        {
+            auto Head = Head_.load( std::memory_order_relaxed );
+            if( Head == TailCache_ )
+            {
+                TailCache_ = Tail_.load( std::memory_order_acquire );
+                if( Head == TailCache_ )
+                    return false;
+            }
+
+            Value = std::move( spSlots_[Head & Mask_] );
+            Head_.store( Head + 1, std::memory_order_release );
+            return true;
+        }
+
+        size_t capacity() const { return Mask_ + 1; }
+
+    private:
+        const size_t Mask_;
+        std::unique_ptr<T_[]> spSlots_;
+
+        alignas(Detail::CacheLineSize) std::atomic<size_t> Head_{ 0 };
+        // consumer's copy of Tail_
+        size_t TailCache_ = 0;
+
+        alignas(Detail::CacheLineSize) std::atomic<size_t> Tail_{ 0 };
+        // producer's copy of Head_
+        size_t HeadCache_ = 0;
+    };
+
+    // Bounded lock free queue for any number of producers and one consumer thread.
+    // Every slot carries a sequence number telling producers and the consumer whose turn it is.
+    // The capacity is rounded up to a power of two.
+    template <class T_>
+    class MpscRing
+    {
+    public:
+        MpscRing( const MpscRing& ) = delete;
+        MpscRing& operator=( const MpscRing& ) = delete;
+
+        explicit MpscRing( size_t Capacity ) :
+            Mask_( Detail::roundUpToPowerOfTwo( Capacity ) - 1 ),
+            spCells_( new Cell[Mask_ + 1] )
+        {
+            for( size_t Index = 0; Index <= Mask_; ++Index )
+                spCells_[Index].Sequence_.store( Index, std::memory_order_relaxed );
+        }
+
+        // producer side, callable from any thread - returns false if the queue is full
+        bool push( T_&& Value )
+        {
+            Cell* pCell;
+            auto Position = Tail_.load( std::memory_order_relaxed );
+            for( ;;)
+            {
+                pCell = &spCells_[Position & Mask_];
+                auto Sequence = pCell->Sequence_.load( std::memory_order_acquire );
+                auto Difference = static_cast<intptr_t>(Sequence) - static_cast<intptr_t>(Position);
+                if( Difference == 0 )
+                {
+                    if( Tail_.compare_exchange_weak( Position, Position + 1, std::memory_order_relaxed ) )
+                        break;
+                }
+                else
+                    if( Difference < 0 )
+                        return false;
+                    else
+                        Position = Tail_.load( std::memory_order_relaxed );
+            }
+
+            pCell->Value_ = std::move( Value );
+            pCell->Sequence_.store( Position + 1, std::memory_order_release );
+            return true;
+        }
+
+        // consumer side - returns false if the queue is empty
+        bool pop( T_& Value )
+        {
+            auto& TheCell = spCells_[Head_ & Mask_];
+            if( TheCell.Sequence_.load( std::memory_order_acquire ) != Head_ + 1 )
+                return false;
+
+            Value = std::move( TheCell.Value_ );
+            TheCell.Sequence_.store( Head_ + Mask_ + 1, std::memory_order_release );
+            ++Head_;
+            return true;
+        }
+
+        size_t capacity() const { return Mask_ + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> Sequence_;
+            T_ Value_;
+        };
+
+        const size_t Mask_;
+        std::unique_ptr<Cell[]> spCells_;
+
+        alignas(Detail::CacheLineSize) std::atomic<size_t> Tail_{ 0 };
+        // only used by the consumer
+        alignas(Detail::CacheLineSize) size_t Head_ = 0;
+    };
+}
+
+#endif
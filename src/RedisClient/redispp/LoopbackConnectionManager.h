@@ -0,0 +1,294 @@
+#pragma once
+
+#ifndef REDISPP_LOOPBACKCONNECTIONMANAGER_INCLUDED
+#define REDISPP_LOOPBACKCONNECTIONMANAGER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+
+#include "redispp/MockServer.h"
+#include "redispp/Response.h"
+
+// Socketless transport: a Connection<LoopbackConnectionManager> talks to a MockEngine through an in-memory byte
+// pipe instead of a TCP socket. Written requests are parsed and executed immediately on the writing thread, the
+// replies are read back from memory - the synchronous path makes no system call. Measures the cost of the client
+// itself - encoding the Request, parsing with the ResponseHandler and dispatching the result - plus the engine
+// executing the command, e.g.
+//
+//   redis::MockEngine Engine;
+//   redis::LoopbackConnectionManager Loopback( Engine );
+//   redis::Connection<redis::LoopbackConnectionManager> con( io_service, Loopback );
+
+namespace redis
+{
+    namespace Detail
+    {
+        // the server end of a loopback connection
+        class LoopbackPeer
+        {
+        public:
+            LoopbackPeer( MockEngine& Engine ) :
+                Engine_( Engine )
+            {}
+
+            // parses the commands in Data and executes the complete ones
+            void write( const char* pData, size_t Size )
+            {
+                while( Size )
+                {
+                    auto Buffer = Parser_.buffer();
+                    auto Chunk = std::min( boost::asio::buffer_size( Buffer ), Size );
+                    std::memcpy( boost::asio::buffer_cast<char*>( Buffer ), pData, Chunk );
+                    pData += Chunk;
+                    Size -= Chunk;
+
+                    if( Parser_.dataReceived( Chunk ) )
+                    {
+                        do
+                        {
+                            Replies_ += Engine_.execute( Client_, mockCommand( Parser_.top() ) );
+                        } while( Parser_.commit() );
+                    }
+                }
+            }
+
+            // moves up to Size bytes of replies to pData
+            size_t read( char* pData, size_t Size )
+            {
+                auto Chunk = std::min( Size, Replies_.size() - ReadPosition_ );
+                std::memcpy( pData, Replies_.data() + ReadPosition_, Chunk );
+                ReadPosition_ += Chunk;
+
+                // all replies read - reuse the memory
+                if( ReadPosition_ == Replies_.size() )
+                {
+                    Replies_.clear();
+                    ReadPosition_ = 0;
+                }
+                return Chunk;
+            }
+
+            size_t available() const { return Replies_.size() - ReadPosition_; }
+
+        private:
+            MockEngine& Engine_;
+            MockEngine::Client Client_;
+            ResponseHandler<> Parser_;
+            std::string Replies_;
+            size_t ReadPosition_ = 0;
+        };
+    }
+
+    // Stands in for boost::asio::ip::tcp::socket in a Connection. Reading while no reply is pending fails with
+    // would_block instead of blocking - the engine answers every complete command immediately, so there is nothing to
+    // wait for. Completion handlers of asynchronous operations are posted to the io_service.
+    class LoopbackSocket
+    {
+    public:
+        using endpoint_type = boost::asio::ip::tcp::endpoint;
+
+        explicit LoopbackSocket( boost::asio::io_service& io_service ) :
+            pService_( &io_service )
+        {}
+
+        // a socket connected to Engine
+        LoopbackSocket( boost::asio::io_service& io_service, MockEngine& Engine ) :
+            pService_( &io_service ),
+            spPeer_( std::make_unique<Detail::LoopbackPeer>( Engine ) )
+        {}
+
+        LoopbackSocket( LoopbackSocket&& ) = default;
+        LoopbackSocket& operator=( LoopbackSocket&& ) = default;
+
+        boost::asio::io_service& get_io_service() { return *pService_; }
+
+        bool is_open() const { return !!spPeer_; }
+
+        void close()
+        {
+            spPeer_.reset();
+        }
+
+        void close( boost::system::error_code& ec )
+        {
+            ec.clear();
+            close();
+        }
+
+        // number of reply bytes readable
+        size_t available( boost::system::error_code& ec ) const
+        {
+            if( !spPeer_ )
+            {
+                ec = boost::asio::error::not_connected;
+                return 0;
+            }
+
+            ec.clear();
+            return spPeer_->available();
+        }
+
+        endpoint_type remote_endpoint() const
+        {
+            return endpoint_type( boost::asio::ip::address_v4::loopback(), 0 );
+        }
+
+        endpoint_type remote_endpoint( boost::system::error_code& ec ) const
+        {
+            ec.clear();
+            return remote_endpoint();
+        }
+
+        template <class ConstBufferSequence>
+        size_t write_some( const ConstBufferSequence& Buffers, boost::system::error_code& ec )
+        {
+            if( !spPeer_ )
+            {
+                ec = boost::asio::error::not_connected;
+                return 0;
+            }
+
+            ec.clear();
+            size_t BytesWritten = 0;
+            for( auto It = Buffers.begin(); It != Buffers.end(); ++It )
+            {
+                boost::asio::const_buffer Buffer( *It );
+                spPeer_->write( boost::asio::buffer_cast<const char*>( Buffer ), boost::asio::buffer_size( Buffer ) );
+                BytesWritten += boost::asio::buffer_size( Buffer );
+            }
+            return BytesWritten;
+        }
+
+        template <class ConstBufferSequence>
+        size_t write_some( const ConstBufferSequence& Buffers )
+        {
+            boost::system::error_code ec;
+            auto BytesWritten = write_some( Buffers, ec );
+            boost::asio::detail::throw_error( ec, "write_some" );
+            return BytesWritten;
+        }
+
+        template <class MutableBufferSequence>
+        size_t read_some( const MutableBufferSequence& Buffers, boost::system::error_code& ec )
+        {
+            if( !spPeer_ )
+            {
+                ec = boost::asio::error::not_connected;
+                return 0;
+            }
+            if( !spPeer_->available() )
+            {
+                ec = boost::asio::error::would_block;
+                return 0;
+            }
+
+            ec.clear();
+            size_t BytesRead = 0;
+            for( auto It = Buffers.begin(); It != Buffers.end() && spPeer_->available(); ++It )
+            {
+                boost::asio::mutable_buffer Buffer( *It );
+                BytesRead += spPeer_->read( boost::asio::buffer_cast<char*>( Buffer ), boost::asio::buffer_size( Buffer ) );
+            }
+            return BytesRead;
+        }
+
+        template <class MutableBufferSequence>
+        size_t read_some( const MutableBufferSequence& Buffers )
+        {
+            boost::system::error_code ec;
+            auto BytesRead = read_some( Buffers, ec );
+            boost::asio::detail::throw_error( ec, "read_some" );
+            return BytesRead;
+        }
+
+        template <class ConstBufferSequence, class WriteHandler>
+        void async_write_some( const ConstBufferSequence& Buffers, WriteHandler handler )
+        {
+            boost::system::error_code ec;
+            auto BytesWritten = write_some( Buffers, ec );
+            pService_->post( [handler, ec, BytesWritten]() mutable { handler( ec, BytesWritten ); } );
+        }
+
+        template <class ConstBufferSequence, class WriteHandler>
+        void async_send( const ConstBufferSequence& Buffers, WriteHandler handler )
+        {
+            async_write_some( Buffers, std::move( handler ) );
+        }
+
+        template <class MutableBufferSequence, class ReadHandler>
+        void async_read_some( const MutableBufferSequence& Buffers, ReadHandler handler )
+        {
+            boost::system::error_code ec;
+            auto BytesRead = read_some( Buffers, ec );
+            pService_->post( [handler, ec, BytesRead]() mutable { handler( ec, BytesRead ); } );
+        }
+
+    private:
+        boost::asio::io_service* pService_;
+        std::unique_ptr<Detail::LoopbackPeer> spPeer_;
+    };
+
+    // Connects every connection to the same MockEngine - see above
+    class LoopbackConnectionManager
+    {
+    public:
+        using SocketType = LoopbackSocket;
+
+        class Instance
+        {
+        public:
+            Instance( const Instance& ) = default;
+            Instance& operator=( const Instance& ) = delete;
+
+            Instance( const LoopbackConnectionManager& lcm ) :
+                LoopbackConnectionManager_( lcm )
+            {}
+
+            LoopbackSocket getConnectedSocket( boost::asio::io_service& io_service, boost::system::error_code& ec )
+            {
+                ec.clear();
+                return LoopbackSocket( io_service, LoopbackConnectionManager_.Engine_ );
+            }
+
+            template <class	CompletionToken>
+            auto async_getConnectedSocket( boost::asio::io_service& io_service, CompletionToken&& token )
+            {
+                using handler_type = typename boost::asio::handler_type<CompletionToken,
+                    void( boost::system::error_code ec, std::shared_ptr<LoopbackSocket> Socket )>::type;
+                handler_type handler( std::forward<CompletionToken&&>( token ) );
+                boost::asio::async_result<decltype(handler)> result( handler );
+
+                auto spSocket = std::make_shared<LoopbackSocket>( io_service, LoopbackConnectionManager_.Engine_ );
+                io_service.post( [handler, spSocket]() mutable {
+                    handler( boost::system::error_code(), spSocket );
+                } );
+
+                return result.get();
+            }
+        private:
+            const LoopbackConnectionManager& LoopbackConnectionManager_;
+        };
+
+        LoopbackConnectionManager( const LoopbackConnectionManager& ) = delete;
+        LoopbackConnectionManager& operator=( const LoopbackConnectionManager& ) = delete;
+
+        LoopbackConnectionManager( MockEngine& Engine ) :
+            Engine_( Engine )
+        {}
+
+        Instance getInstance() const
+        {
+            return Instance( *this );
+        }
+    private:
+        MockEngine& Engine_;
+    };
+}
+
+#endif
@@ -0,0 +1,384 @@
+#pragma once
+
+#ifndef REDISPP_METRICS_INCLUDED
+#define REDISPP_METRICS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Metrics are collected by a MetricsType_ passed to connections and connection managers next to the notification
+// sink. The default NullMetrics compiles away completely - not even the clock is read. RedisMetrics records latency
+// histograms per command, counters per host and the duration of Sentinel failovers.
+// A metrics type provides:
+//   static constexpr bool Enabled
+//   HostHandle host( const std::string& Endpoint ) - called once per connect, the handle is passed to the counters
+//   void connected( HostHandle ), bytesSent( HostHandle, size_t ), bytesReceived( HostHandle, size_t )
+//   void commandCompleted( boost::string_view Command, std::chrono::nanoseconds Latency, bool Failed )
+//   void failover( const std::string& MasterSet, std::chrono::nanoseconds Duration )
+
+namespace redis
+{
+    class NullMetrics
+    {
+    public:
+        static constexpr bool Enabled = false;
+
+        using HostHandle = int;
+
+        HostHandle host( const std::string& Endpoint ) { return 0; }
+        void connected( HostHandle Host ) {}
+        void bytesSent( HostHandle Host, size_t Bytes ) {}
+        void bytesReceived( HostHandle Host, size_t Bytes ) {}
+        void commandCompleted( boost::string_view Command, std::chrono::nanoseconds Latency, bool Failed ) {}
+        void failover( const std::string& MasterSet, std::chrono::nanoseconds Duration ) {}
+    };
+
+    namespace Detail
+    {
+        template <class MetricsT_>
+        constexpr bool metricsEnabled()
+        {
+            return std::decay<MetricsT_>::type::Enabled;
+        }
+
+        template <class MetricsT_>
+        using MetricsHostHandle = typename std::decay<MetricsT_>::type::HostHandle;
+
+        // measures the time since its construction - reads no clock when disabled
+        template <bool Enabled_>
+        class Stopwatch
+        {
+        public:
+            std::chrono::nanoseconds elapsed() const
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - Start_ );
+            }
+
+        private:
+            std::chrono::steady_clock::time_point Start_ = std::chrono::steady_clock::now();
+        };
+
+        template <>
+        class Stopwatch<false>
+        {
+        public:
+            std::chrono::nanoseconds elapsed() const { return std::chrono::nanoseconds::zero(); }
+        };
+
+        // index of the highest set bit - Value must not be 0
+        inline unsigned highestBit( uint64_t Value )
+        {
+#if defined(_MSC_VER)
+            unsigned long Index;
+            _BitScanReverse64( &Index, Value );
+            return static_cast<unsigned>( Index );
+#else
+            return 63 - static_cast<unsigned>( __builtin_clzll( Value ) );
+#endif
+        }
+    }
+
+    // Log-linear histogram of latencies in nanoseconds, like a HDR histogram with 16 to 32 buckets per power of two -
+    // the relative error of a recorded value is below 1/16. Values beyond about 73 minutes go to the last bucket.
+    // record is meant to be called by a single thread; any thread may read.
+    class LatencyHistogram
+    {
+    public:
+        static constexpr unsigned SubBucketBits = 5;
+        static constexpr uint64_t SubBucketCount = uint64_t( 1 ) << SubBucketBits;
+        static constexpr unsigned HighestBit = 42;
+        static constexpr size_t BucketCount = (HighestBit - (SubBucketBits - 1)) * (SubBucketCount / 2) + SubBucketCount;
+
+        static size_t bucketIndex( uint64_t Value )
+        {
+            if( Value < SubBucketCount )
+                return static_cast<size_t>( Value );
+
+            auto Shift = Detail::highestBit( Value ) - (SubBucketBits - 1);
+            auto Index = Shift * (SubBucketCount / 2) + (Value >> Shift);
+            return Index < BucketCount ? static_cast<size_t>( Index ) : BucketCount - 1;
+        }
+
+        // lowest value of a bucket
+        static uint64_t bucketValue( size_t Index )
+        {
+            if( Index < SubBucketCount )
+                return Index;
+
+            auto Shift = Index / (SubBucketCount / 2) - 1;
+            return (Index % (SubBucketCount / 2) + SubBucketCount / 2) << Shift;
+        }
+
+        // single writer - plain loads and stores instead of read-modify-write operations
+        void record( uint64_t Value, bool Failed )
+        {
+            increment( Buckets_[bucketIndex( Value )], 1 );
+            increment( Sum_, Value );
+            if( Failed )
+                increment( Failures_, 1 );
+            if( Value > Max_.load( std::memory_order_relaxed ) )
+                Max_.store( Value, std::memory_order_relaxed );
+        }
+
+        const std::array<std::atomic<uint64_t>, BucketCount>& buckets() const { return Buckets_; }
+        uint64_t sum() const { return Sum_.load( std::memory_order_relaxed ); }
+        uint64_t failures() const { return Failures_.load( std::memory_order_relaxed ); }
+        uint64_t maximum() const { return Max_.load( std::memory_order_relaxed ); }
+
+    private:
+        static void increment( std::atomic<uint64_t>& Counter, uint64_t Value )
+        {
+            Counter.store( Counter.load( std::memory_order_relaxed ) + Value, std::memory_order_relaxed );
+        }
+
+        std::array<std::atomic<uint64_t>, BucketCount> Buckets_{};
+        std::atomic<uint64_t> Sum_{ 0 };
+        std::atomic<uint64_t> Failures_{ 0 };
+        std::atomic<uint64_t> Max_{ 0 };
+    };
+
+    // merged copy of latency histograms
+    struct LatencySnapshot
+    {
+        std::vector<uint64_t> Buckets = std::vector<uint64_t>( LatencyHistogram::BucketCount );
+        uint64_t Count = 0;
+        uint64_t Failures = 0;
+        uint64_t Sum = 0;
+        uint64_t Maximum = 0;
+
+        void add( const LatencyHistogram& Histogram )
+        {
+            for( size_t Index = 0; Index < Buckets.size(); ++Index )
+            {
+                auto Value = Histogram.buckets()[Index].load( std::memory_order_relaxed );
+                Buckets[Index] += Value;
+                Count += Value;
+            }
+            Failures += Histogram.failures();
+            Sum += Histogram.sum();
+            Maximum = std::max( Maximum, Histogram.maximum() );
+        }
+
+        // latency in nanoseconds below which Percentile percent of the requests completed, e.g. 99.9
+        uint64_t percentile( double Percentile ) const
+        {
+            if( !Count )
+                return 0;
+
+            auto Target = static_cast<uint64_t>( Percentile / 100. * static_cast<double>( Count ) + 0.5 );
+            uint64_t Seen = 0;
+            for( size_t Index = 0; Index < Buckets.size(); ++Index )
+            {
+                Seen += Buckets[Index];
+                if( Seen >= std::max( Target, uint64_t( 1 ) ) )
+                    return std::min( Index + 1 < Buckets.size() ? LatencyHistogram::bucketValue( Index + 1 ) - 1 : Maximum, Maximum );
+            }
+            return Maximum;
+        }
+
+        uint64_t mean() const
+        {
+            return Count ? Sum / Count : 0;
+        }
+    };
+
+    struct HostMetrics
+    {
+        uint64_t Connects = 0;
+        uint64_t BytesSent = 0;
+        uint64_t BytesReceived = 0;
+    };
+
+    struct MetricsSnapshot
+    {
+        std::map<std::string, LatencySnapshot> Commands;
+        std::map<std::string, HostMetrics> Hosts;
+        std::map<std::string, LatencySnapshot> Failovers;
+
+        // one line per command, host and master set - latencies in microseconds
+        void writeTo( std::ostream& Out ) const
+        {
+            auto writeLatencies = [&Out]( const LatencySnapshot& Latencies )
+            {
+                Out << " count=" << Latencies.Count << " failures=" << Latencies.Failures
+                    << " mean=" << Latencies.mean() / 1000 << " p50=" << Latencies.percentile( 50. ) / 1000
+                    << " p99=" << Latencies.percentile( 99. ) / 1000 << " p999=" << Latencies.percentile( 99.9 ) / 1000
+                    << " max=" << Latencies.Maximum / 1000 << "\n";
+            };
+
+            for( const auto& Command : Commands )
+            {
+                Out << "command " << Command.first;
+                writeLatencies( Command.second );
+            }
+            for( const auto& Host : Hosts )
+                Out << "host " << Host.first << " connects=" << Host.second.Connects << " sent=" << Host.second.BytesSent << " received=" << Host.second.BytesReceived << "\n";
+            for( const auto& Failover : Failovers )
+            {
+                Out << "failover " << Failover.first;
+                writeLatencies( Failover.second );
+            }
+        }
+    };
+
+    // Thread safe metrics collector. Latencies are recorded into histograms owned by the recording thread, so threads
+    // do not contend; snapshot merges them. Only the first command of a name on a thread takes a lock.
+    // Pass it by reference, e.g. Connection<Manager, Sink, RedisMetrics&>.
+    class RedisMetrics
+    {
+        struct HostCounters
+        {
+            std::atomic<uint64_t> Connects_{ 0 };
+            std::atomic<uint64_t> BytesSent_{ 0 };
+            std::atomic<uint64_t> BytesReceived_{ 0 };
+        };
+
+        struct Shard
+        {
+            // only the owning thread inserts - under Mutex_, which snapshot holds while reading
+            std::map<std::string, std::unique_ptr<LatencyHistogram>, std::less<>> Commands_;
+        };
+
+    public:
+        static constexpr bool Enabled = true;
+
+        using HostHandle = HostCounters*;
+
+        RedisMetrics( const RedisMetrics& ) = delete;
+        RedisMetrics& operator=( const RedisMetrics& ) = delete;
+
+        RedisMetrics() :
+            Id_( nextId() )
+        {}
+
+        HostHandle host( const std::string& Endpoint )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            auto& spCounters = Hosts_[Endpoint];
+            if( !spCounters )
+                spCounters = std::make_unique<HostCounters>();
+            return spCounters.get();
+        }
+
+        void connected( HostHandle Host )
+        {
+            if( Host )
+                Host->Connects_.fetch_add( 1, std::memory_order_relaxed );
+        }
+
+        void bytesSent( HostHandle Host, size_t Bytes )
+        {
+            if( Host )
+                Host->BytesSent_.fetch_add( Bytes, std::memory_order_relaxed );
+        }
+
+        void bytesReceived( HostHandle Host, size_t Bytes )
+        {
+            if( Host )
+                Host->BytesReceived_.fetch_add( Bytes, std::memory_order_relaxed );
+        }
+
+        void commandCompleted( boost::string_view Command, std::chrono::nanoseconds Latency, bool Failed )
+        {
+            auto& TheShard = shard();
+            auto Found = TheShard.Commands_.find( Command );
+            if( Found == TheShard.Commands_.end() )
+            {
+                std::lock_guard<std::mutex> Lock( Mutex_ );
+                Found = TheShard.Commands_.emplace( std::string( Command.data(), Command.size() ), std::make_unique<LatencyHistogram>() ).first;
+            }
+
+            Found->second->record( static_cast<uint64_t>( Latency.count() ), Failed );
+        }
+
+        void failover( const std::string& MasterSet, std::chrono::nanoseconds Duration )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            auto& spHistogram = Failovers_[MasterSet];
+            if( !spHistogram )
+                spHistogram = std::make_unique<LatencyHistogram>();
+            spHistogram->record( static_cast<uint64_t>( Duration.count() ), false );
+        }
+
+        MetricsSnapshot snapshot() const
+        {
+            MetricsSnapshot Result;
+
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            for( const auto& Entry : Shards_ )
+                for( const auto& Command : Entry.second->Commands_ )
+                    Result.Commands[Command.first].add( *Command.second );
+
+            for( const auto& Host : Hosts_ )
+            {
+                auto& Counters = Result.Hosts[Host.first];
+                Counters.Connects = Host.second->Connects_.load( std::memory_order_relaxed );
+                Counters.BytesSent = Host.second->BytesSent_.load( std::memory_order_relaxed );
+                Counters.BytesReceived = Host.second->BytesReceived_.load( std::memory_order_relaxed );
+            }
+
+            for( const auto& Failover : Failovers_ )
+                Result.Failovers[Failover.first].add( *Failover.second );
+
+            return Result;
+        }
+
+    private:
+        static uint64_t nextId()
+        {
+            static std::atomic<uint64_t> Next{ 1 };
+            return Next.fetch_add( 1 );
+        }
+
+        // the shard of the calling thread - cached per thread for the last used collector
+        Shard& shard()
+        {
+            struct Cache
+            {
+                uint64_t Owner = 0;
+                Shard* pShard = nullptr;
+            };
+            thread_local Cache LastUsed;
+
+            if( LastUsed.Owner != Id_ )
+            {
+                std::lock_guard<std::mutex> Lock( Mutex_ );
+                auto& spShard = Shards_[std::this_thread::get_id()];
+                if( !spShard )
+                    spShard = std::make_unique<Shard>();
+                LastUsed.Owner = Id_;
+                LastUsed.pShard = spShard.get();
+            }
+
+            return *LastUsed.pShard;
+        }
+
+        const uint64_t Id_;
+        mutable std::mutex Mutex_;
+        std::map<std::thread::id, std::unique_ptr<Shard>> Shards_;
+        std::map<std::string, std::unique_ptr<HostCounters>> Hosts_;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> Failovers_;
+    };
+}
+
+#endif
@@ -0,0 +1,836 @@
+#pragma once
+
+#ifndef REDISPP_MOCKSERVER_INCLUDED
+#define REDISPP_MOCKSERVER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/optional.hpp>
+
+#include "redispp.h"
+#include "redispp/Response.h"
+
+namespace redis
+{
+    enum class MockRole { Master, Replica, Sentinel };
+
+    // Reaction of the mock server to a single command - returned by a script, see MockServer::setScript
+    struct MockAction
+    {
+        // delay before the reply is sent - the following replies of the connection wait as well
+        std::chrono::steady_clock::duration Latency = std::chrono::steady_clock::duration::zero();
+        // closes the connection instead of executing the command
+        bool Drop = false;
+        // raw RESP sent instead of executing the command, e.g. "-LOADING Redis is loading the dataset\r\n"
+        boost::optional<std::string> Reply;
+    };
+
+    namespace Detail
+    {
+        inline std::string respSimple( const std::string& Value ) { return "+" + Value + "\r\n"; }
+        inline std::string respError( const std::string& Value ) { return "-" + Value + "\r\n"; }
+        inline std::string respInteger( int64_t Value ) { return ":" + std::to_string( Value ) + "\r\n"; }
+        inline std::string respBulk( const std::string& Value ) { return "$" + std::to_string( Value.size() ) + "\r\n" + Value + "\r\n"; }
+        inline std::string respNull() { return "$-1\r\n"; }
+
+        // Elements are encoded already
+        inline std::string respArray( const std::vector<std::string>& Elements )
+        {
+            std::string Result = "*" + std::to_string( Elements.size() ) + "\r\n";
+            for( const auto& Element : Elements )
+                Result += Element;
+            return Result;
+        }
+
+        // SENTINEL style description of a host: ip, port and further name/value pairs
+        inline std::string respHostProperties( const Host& TheHost, std::vector<std::string> Properties = {} )
+        {
+            std::vector<std::string> Elements{ respBulk( "name" ), respBulk( std::get<0>( TheHost ) + ":" + std::to_string( std::get<1>( TheHost ) ) ),
+                                               respBulk( "ip" ), respBulk( std::get<0>( TheHost ) ),
+                                               respBulk( "port" ), respBulk( std::to_string( std::get<1>( TheHost ) ) ) };
+            for( const auto& Property : Properties )
+                Elements.push_back( respBulk( Property ) );
+            return respArray( Elements );
+        }
+
+        // the arguments of a command sent by a client
+        inline std::vector<std::string> mockCommand( const Response& Data )
+        {
+            std::vector<std::string> Arguments;
+            if( Data.type() == Response::Type::Array )
+                for( const auto& spArgument : Data.elements() )
+                    Arguments.push_back( spArgument->string() );
+            return Arguments;
+        }
+    }
+
+    // The command engine of the mock server: the data, the role and the Sentinel view of the master sets. It
+    // implements PING, ECHO, SELECT, GET, SET, DEL, EXISTS, INCR, INCRBY, DECR, HSET, HGET, HGETALL, HDEL, DBSIZE,
+    // FLUSHALL, MULTI, EXEC, DISCARD, WATCH, UNWATCH, CLIENT REPLY/SETNAME, ROLE and SENTINEL
+    // get-master-addr-by-name/sentinels/replicas. Expiry options of SET are accepted and ignored. A replica rejects writes, a sentinel only answers PING, ECHO,
+    // ROLE and SENTINEL.
+    //
+    // All members are thread safe.
+    class MockEngine
+    {
+    public:
+        using Command = std::vector<std::string>;
+
+        // state of a single client connection
+        struct Client
+        {
+            // MULTI: the queued commands
+            boost::optional<std::vector<Command>> Queued;
+            // WATCH: the versions of the watched keys
+            std::map<std::string, uint64_t> Watched;
+            // CLIENT REPLY OFF
+            bool RepliesOff = false;
+            // CLIENT REPLY SKIP: no reply to the next command
+            bool SkipNext = false;
+        };
+
+        MockEngine( const MockEngine& ) = delete;
+        MockEngine& operator=( const MockEngine& ) = delete;
+
+        explicit MockEngine( MockRole Role = MockRole::Master ) :
+            Role_( Role )
+        {}
+
+        // executes TheCommand on behalf of TheClient and returns the encoded reply - empty if replies are switched off
+        std::string execute( Client& TheClient, const Command& TheCommand )
+        {
+            Commands_.fetch_add( 1, std::memory_order_relaxed );
+
+            std::string Reply;
+            if( TheCommand.empty() )
+                Reply = Detail::respError( "ERR Protocol error: expected an array of bulk strings" );
+            else if( upper( TheCommand[0] ) == "CLIENT" && TheCommand.size() == 3 && upper( TheCommand[1] ) == "REPLY" )
+                return clientReply( TheClient, upper( TheCommand[2] ) );
+            else if( upper( TheCommand[0] ) == "CLIENT" )
+                Reply = TheCommand.size() == 3 && upper( TheCommand[1] ) == "SETNAME" ? Detail::respSimple( "OK" ) : Detail::respError( "ERR Unknown subcommand or wrong number of arguments for 'CLIENT'" );
+            else
+            {
+                std::lock_guard<std::mutex> Lock( Mutex_ );
+                Reply = dispatch( TheClient, TheCommand );
+            }
+
+            if( TheClient.RepliesOff )
+                return std::string();
+            if( TheClient.SkipNext )
+            {
+                TheClient.SkipNext = false;
+                return std::string();
+            }
+            return Reply;
+        }
+
+        // a replica rejects writes and reports Master in ROLE
+        void setRole( MockRole Role, const Host& Master = Host{} )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            Role_ = Role;
+            ReplicaOf_ = Master;
+        }
+
+        // Sentinel: the master reported for MasterSet
+        void setMaster( const std::string& MasterSet, const Host& Master )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            MasterSets_[MasterSet].Master = Master;
+        }
+
+        // Sentinel: the other sentinels monitoring MasterSet
+        void setSentinels( const std::string& MasterSet, const std::vector<Host>& Sentinels )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            MasterSets_[MasterSet].Sentinels = Sentinels;
+        }
+
+        // Sentinel: the replicas of MasterSet
+        void setReplicas( const std::string& MasterSet, const std::vector<Host>& Replicas )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            MasterSets_[MasterSet].Replicas = Replicas;
+        }
+
+        // the string stored at Key
+        boost::optional<std::string> value( const std::string& Key ) const
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            auto Found = Strings_.find( Key );
+            if( Found == Strings_.end() )
+                return boost::none;
+            return Found->second;
+        }
+
+        // number of commands executed
+        size_t commands() const { return Commands_.load( std::memory_order_relaxed ); }
+
+    private:
+        struct MasterSet
+        {
+            Host Master;
+            std::vector<Host> Sentinels;
+            std::vector<Host> Replicas;
+        };
+
+        static std::string upper( std::string Value )
+        {
+            std::transform( Value.begin(), Value.end(), Value.begin(), []( char c ) { return static_cast<char>( ::toupper( static_cast<unsigned char>( c ) ) ); } );
+            return Value;
+        }
+
+        static std::string wrongArguments( const std::string& Name )
+        {
+            return Detail::respError( "ERR wrong number of arguments for '" + Name + "' command" );
+        }
+
+        // CLIENT REPLY - only the connection state is touched, no lock needed
+        static std::string clientReply( Client& TheClient, const std::string& Mode )
+        {
+            if( Mode == "ON" )
+            {
+                TheClient.RepliesOff = TheClient.SkipNext = false;
+                return Detail::respSimple( "OK" );
+            }
+            if( Mode == "OFF" )
+                TheClient.RepliesOff = true;
+            else if( Mode == "SKIP" )
+                TheClient.SkipNext = !TheClient.RepliesOff;
+            else if( !TheClient.RepliesOff )
+                return Detail::respError( "ERR syntax error" );
+
+            // neither OFF nor SKIP are answered
+            return std::string();
+        }
+
+        // handles MULTI/EXEC - called with Mutex_ held
+        std::string dispatch( Client& TheClient, const Command& TheCommand )
+        {
+            auto Name = upper( TheCommand[0] );
+
+            if( TheClient.Queued )
+            {
+                if( Name == "EXEC" )
+                {
+                    auto Queued = std::move( *TheClient.Queued );
+                    TheClient.Queued = boost::none;
+                    if( !watchedUnchanged( TheClient ) )
+                        return "*-1\r\n";
+
+                    std::vector<std::string> Replies;
+                    for( const auto& QueuedCommand : Queued )
+                        Replies.push_back( run( upper( QueuedCommand[0] ), QueuedCommand ) );
+                    return Detail::respArray( Replies );
+                }
+                if( Name == "DISCARD" )
+                {
+                    TheClient.Queued = boost::none;
+                    TheClient.Watched.clear();
+                    return Detail::respSimple( "OK" );
+                }
+                if( Name == "MULTI" )
+                    return Detail::respError( "ERR MULTI calls can not be nested" );
+
+                TheClient.Queued->push_back( TheCommand );
+                return Detail::respSimple( "QUEUED" );
+            }
+
+            if( Name == "MULTI" )
+            {
+                TheClient.Queued.emplace();
+                return Detail::respSimple( "OK" );
+            }
+            if( Name == "EXEC" || Name == "DISCARD" )
+                return Detail::respError( "ERR " + Name + " without MULTI" );
+            if( Name == "WATCH" )
+            {
+                for( size_t Index = 1; Index < TheCommand.size(); ++Index )
+                    TheClient.Watched[TheCommand[Index]] = Versions_[TheCommand[Index]];
+                return Detail::respSimple( "OK" );
+            }
+            if( Name == "UNWATCH" )
+            {
+                TheClient.Watched.clear();
+                return Detail::respSimple( "OK" );
+            }
+
+            return run( Name, TheCommand );
+        }
+
+        bool watchedUnchanged( Client& TheClient )
+        {
+            bool Unchanged = true;
+            for( const auto& Watched : TheClient.Watched )
+                Unchanged = Unchanged && Versions_[Watched.first] == Watched.second;
+            TheClient.Watched.clear();
+            return Unchanged;
+        }
+
+        void modified( const std::string& Key )
+        {
+            ++Versions_[Key];
+        }
+
+        // executes a single command - called with Mutex_ held
+        std::string run( const std::string& Name, const Command& TheCommand )
+        {
+            using namespace Detail;
+
+            if( Name == "PING" )
+                return TheCommand.size() > 1 ? respBulk( TheCommand[1] ) : respSimple( "PONG" );
+            if( Name == "ECHO" )
+                return TheCommand.size() == 2 ? respBulk( TheCommand[1] ) : wrongArguments( "echo" );
+            if( Name == "ROLE" )
+                return role();
+
+            if( Role_ == MockRole::Sentinel )
+            {
+                if( Name == "SENTINEL" )
+                    return sentinel( TheCommand );
+                return respError( "ERR unknown command '" + TheCommand[0] + "'" );
+            }
+
+            static const char* WriteCommands[] = { "SET", "DEL", "INCR", "INCRBY", "DECR", "HSET", "HDEL", "FLUSHALL" };
+            if( Role_ == MockRole::Replica && std::find( std::begin( WriteCommands ), std::end( WriteCommands ), Name ) != std::end( WriteCommands ) )
+                return respError( "READONLY You can't write against a read only replica." );
+
+            if( Name == "SELECT" )
+                return TheCommand.size() == 2 ? respSimple( "OK" ) : wrongArguments( "select" );
+            if( Name == "GET" )
+            {
+                if( TheCommand.size() != 2 )
+                    return wrongArguments( "get" );
+                if( Hashes_.count( TheCommand[1] ) )
+                    return wrongType();
+                auto Found = Strings_.find( TheCommand[1] );
+                return Found == Strings_.end() ? respNull() : respBulk( Found->second );
+            }
+            if( Name == "SET" )
+            {
+                if( TheCommand.size() < 3 )
+                    return wrongArguments( "set" );
+                bool Exists = Strings_.count( TheCommand[1] ) || Hashes_.count( TheCommand[1] );
+                for( size_t Index = 3; Index < TheCommand.size(); ++Index )
+                {
+                    auto Option = upper( TheCommand[Index] );
+                    if( (Option == "NX" && Exists) || (Option == "XX" && !Exists) )
+                        return respNull();
+                }
+                Hashes_.erase( TheCommand[1] );
+                Strings_[TheCommand[1]] = TheCommand[2];
+                modified( TheCommand[1] );
+                return respSimple( "OK" );
+            }
+            if( Name == "DEL" || Name == "EXISTS" )
+            {
+                if( TheCommand.size() < 2 )
+                    return wrongArguments( upper( Name ) );
+                int64_t Count = 0;
+                for( size_t Index = 1; Index < TheCommand.size(); ++Index )
+                {
+                    const auto& Key = TheCommand[Index];
+                    if( Name == "EXISTS" )
+                        Count += Strings_.count( Key ) + Hashes_.count( Key );
+                    else if( Strings_.erase( Key ) + Hashes_.erase( Key ) )
+                    {
+                        ++Count;
+                        modified( Key );
+                    }
+                }
+                return respInteger( Count );
+            }
+            if( Name == "INCR" || Name == "DECR" || Name == "INCRBY" )
+            {
+                if( TheCommand.size() != (Name == "INCRBY" ? 3u : 2u) )
+                    return wrongArguments( Name );
+                if( Hashes_.count( TheCommand[1] ) )
+                    return wrongType();
+
+                int64_t Value = 0, Increment = Name == "DECR" ? -1 : 1;
+                auto Found = Strings_.find( TheCommand[1] );
+                if( (Found != Strings_.end() && !Detail::parseInteger( Found->second.data(), Found->second.size(), Value ))
+                    || (Name == "INCRBY" && !Detail::parseInteger( TheCommand[2].data(), TheCommand[2].size(), Increment )) )
+                    return respError( "ERR value is not an integer or out of range" );
+
+                Value += Increment;
+                Strings_[TheCommand[1]] = std::to_string( Value );
+                modified( TheCommand[1] );
+                return respInteger( Value );
+            }
+            if( Name == "HSET" )
+            {
+                if( TheCommand.size() < 4 || TheCommand.size() % 2 )
+                    return wrongArguments( "hset" );
+                if( Strings_.count( TheCommand[1] ) )
+                    return wrongType();
+                auto& Fields = Hashes_[TheCommand[1]];
+                int64_t Added = 0;
+                for( size_t Index = 2; Index < TheCommand.size(); Index += 2 )
+                {
+                    Added += Fields.count( TheCommand[Index] ) ? 0 : 1;
+                    Fields[TheCommand[Index]] = TheCommand[Index + 1];
+                }
+                modified( TheCommand[1] );
+                return respInteger( Added );
+            }
+            if( Name == "HGET" || Name == "HGETALL" || Name == "HDEL" )
+            {
+                if( TheCommand.size() < (Name == "HGETALL" ? 2u : 3u) )
+                    return wrongArguments( Name );
+                if( Strings_.count( TheCommand[1] ) )
+                    return wrongType();
+
+                auto Found = Hashes_.find( TheCommand[1] );
+                if( Name == "HGET" )
+                {
+                    if( Found == Hashes_.end() || !Found->second.count( TheCommand[2] ) )
+                        return respNull();
+                    return respBulk( Found->second[TheCommand[2]] );
+                }
+                if( Name == "HGETALL" )
+                {
+                    std::vector<std::string> Elements;
+                    if( Found != Hashes_.end() )
+                        for( const auto& Field : Found->second )
+                        {
+                            Elements.push_back( respBulk( Field.first ) );
+                            Elements.push_back( respBulk( Field.second ) );
+                        }
+                    return respArray( Elements );
+                }
+
+                int64_t Removed = 0;
+                if( Found != Hashes_.end() )
+                {
+                    for( size_t Index = 2; Index < TheCommand.size(); ++Index )
+                        Removed += Found->second.erase( TheCommand[Index] );
+                    if( Found->second.empty() )
+                        Hashes_.erase( Found );
+                    if( Removed )
+                        modified( TheCommand[1] );
+                }
+                return respInteger( Removed );
+            }
+            if( Name == "DBSIZE" )
+                return respInteger( static_cast<int64_t>( Strings_.size() + Hashes_.size() ) );
+            if( Name == "FLUSHALL" )
+            {
+                for( const auto& Entry : Strings_ )
+                    modified( Entry.first );
+                for( const auto& Entry : Hashes_ )
+                    modified( Entry.first );
+                Strings_.clear();
+                Hashes_.clear();
+                return respSimple( "OK" );
+            }
+
+            return respError( "ERR unknown command '" + TheCommand[0] + "'" );
+        }
+
+        static std::string wrongType()
+        {
+            return Detail::respError( "WRONGTYPE Operation against a key holding the wrong kind of value" );
+        }
+
+        std::string role() const
+        {
+            using namespace Detail;
+
+            switch( Role_ )
+            {
+            case MockRole::Master:
+                return respArray( { respBulk( "master" ), respInteger( 0 ), respArray( {} ) } );
+            case MockRole::Replica:
+                return respArray( { respBulk( "slave" ), respBulk( std::get<0>( ReplicaOf_ ) ), respInteger( std::get<1>( ReplicaOf_ ) ), respBulk( "connected" ), respInteger( 0 ) } );
+            default:
+            {
+                std::vector<std::string> Names;
+                for( const auto& Set : MasterSets_ )
+                    Names.push_back( respBulk( Set.first ) );
+                return respArray( { respBulk( "sentinel" ), respArray( Names ) } );
+            }
+            }
+        }
+
+        std::string sentinel( const Command& TheCommand ) const
+        {
+            using namespace Detail;
+
+            if( TheCommand.size() != 3 )
+                return wrongArguments( "sentinel" );
+
+            auto Subcommand = upper( TheCommand[1] );
+            auto Found = MasterSets_.find( TheCommand[2] );
+            if( Subcommand == "GET-MASTER-ADDR-BY-NAME" )
+            {
+                if( Found == MasterSets_.end() )
+                    return "*-1\r\n";
+                return respArray( { respBulk( std::get<0>( Found->second.Master ) ), respBulk( std::to_string( std::get<1>( Found->second.Master ) ) ) } );
+            }
+            if( Found == MasterSets_.end() )
+                return respError( "ERR No such master with that name" );
+
+            std::vector<std::string> Elements;
+            if( Subcommand == "SENTINELS" )
+            {
+                for( const auto& Sentinel : Found->second.Sentinels )
+                    Elements.push_back( respHostProperties( Sentinel, { "flags", "sentinel" } ) );
+                return respArray( Elements );
+            }
+            if( Subcommand == "REPLICAS" || Subcommand == "SLAVES" )
+            {
+                for( const auto& Replica : Found->second.Replicas )
+                    Elements.push_back( respHostProperties( Replica, { "flags", "slave", "master-link-status", "ok" } ) );
+                return respArray( Elements );
+            }
+
+            return respError( "ERR Unknown sentinel subcommand '" + TheCommand[1] + "'" );
+        }
+
+        std::atomic<size_t> Commands_{ 0 };
+
+        mutable std::mutex Mutex_;
+        MockRole Role_;
+        Host ReplicaOf_;
+        std::map<std::string, MasterSet> MasterSets_;
+
+        std::map<std::string, std::string> Strings_;
+        std::map<std::string, std::map<std::string, std::string>> Hashes_;
+        // modification counters for WATCH
+        std::map<std::string, uint64_t> Versions_;
+    };
+
+    // In-process stand-in for a Redis server, a replica or a Sentinel, listening on 127.0.0.1. It runs its own
+    // io_service thread and executes the commands with a MockEngine.
+    // Faults are injected by latency, partial writes, dropped connections and scripts; a Sentinel failover is
+    // played by switching the roles of two servers and the master reported by the sentinel, e.g.
+    //
+    //   OldMaster.setRole( redis::MockRole::Replica, NewMaster.host() );
+    //   NewMaster.setRole( redis::MockRole::Master );
+    //   Sentinel.setMaster( "mymaster", NewMaster.host() );
+    //   OldMaster.dropConnections();
+    //
+    // All members are thread safe.
+    class MockServer
+    {
+    public:
+        using Command = MockEngine::Command;
+        using ScriptType = std::function<MockAction( const Command& )>;
+
+        MockServer( const MockServer& ) = delete;
+        MockServer& operator=( const MockServer& ) = delete;
+
+        // Port 0 picks a free port - see port()
+        explicit MockServer( MockRole Role = MockRole::Master, unsigned short Port = 0 ) :
+            Work_( Service_ ),
+            Acceptor_( Service_, boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), Port ) ),
+            Engine_( Role )
+        {
+            Acceptor_.set_option( boost::asio::ip::tcp::acceptor::reuse_address( true ) );
+            Port_ = Acceptor_.local_endpoint().port();
+
+            accept();
+            Thread_ = std::thread( [this]() { Service_.run(); } );
+        }
+
+        ~MockServer()
+        {
+            Service_.stop();
+            Thread_.join();
+        }
+
+        unsigned short port() const { return Port_; }
+        Host host() const { return Host{ "127.0.0.1", Port_ }; }
+
+        MockEngine& engine() { return Engine_; }
+
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        //                                                   F A U L T S
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        // delays every reply
+        void setLatency( std::chrono::steady_clock::duration Latency )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            Latency_ = Latency;
+        }
+
+        // sends the replies in pieces of at most Bytes with a pause in between, so the client receives them in
+        // several reads - 0 sends them in one piece
+        void setMaximumWriteSize( size_t Bytes, std::chrono::steady_clock::duration Pause = std::chrono::milliseconds( 1 ) )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            MaximumWriteSize_ = Bytes;
+            WritePause_ = Pause;
+        }
+
+        // closes the connection receiving the Commands-th command from now on, instead of executing it - 0 disables
+        void dropAfter( size_t Commands )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            DropAfter_ = Commands;
+        }
+
+        // Script is called for every command before it is executed - its action overrides the other faults
+        void setScript( ScriptType Script )
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            Script_ = std::move( Script );
+        }
+
+        // closes all client connections
+        void dropConnections()
+        {
+            Service_.post( [this]()
+            {
+                for( auto& wpSession : Sessions_ )
+                    if( auto spSession = wpSession.lock() )
+                        spSession->close();
+                Sessions_.clear();
+            } );
+        }
+
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        //                                                  S T A T E
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        // see MockEngine
+        void setRole( MockRole Role, const Host& Master = Host{} ) { Engine_.setRole( Role, Master ); }
+        void setMaster( const std::string& MasterSet, const Host& Master ) { Engine_.setMaster( MasterSet, Master ); }
+        void setSentinels( const std::string& MasterSet, const std::vector<Host>& Sentinels ) { Engine_.setSentinels( MasterSet, Sentinels ); }
+        void setReplicas( const std::string& MasterSet, const std::vector<Host>& Replicas ) { Engine_.setReplicas( MasterSet, Replicas ); }
+        boost::optional<std::string> value( const std::string& Key ) const { return Engine_.value( Key ); }
+
+        // number of commands received
+        size_t commands() const { return Commands_.load( std::memory_order_relaxed ); }
+        // number of connections accepted
+        size_t connections() const { return Connections_.load( std::memory_order_relaxed ); }
+
+    private:
+        class Session : public std::enable_shared_from_this<Session>
+        {
+        public:
+            Session( MockServer& Server ) :
+                Server_( Server ),
+                Socket_( Server.Service_ ),
+                Timer_( Server.Service_ )
+            {}
+
+            void start()
+            {
+                boost::system::error_code ec;
+                Socket_.set_option( boost::asio::ip::tcp::no_delay( true ), ec );
+                read();
+            }
+
+            void close()
+            {
+                boost::system::error_code ec;
+                Socket_.close( ec );
+                Timer_.cancel( ec );
+            }
+
+        private:
+            friend class MockServer;
+
+            void read()
+            {
+                auto spThis = shared_from_this();
+                Socket_.async_read_some( boost::asio::buffer( Parser_.buffer() ), [this, spThis]( const boost::system::error_code& ec, size_t BytesReceived )
+                {
+                    if( ec )
+                    {
+                        close();
+                        return;
+                    }
+
+                    if( Parser_.dataReceived( BytesReceived ) )
+                    {
+                        do
+                        {
+                            Pending_.push_back( Detail::mockCommand( Parser_.top() ) );
+                        } while( Parser_.commit() );
+                    }
+
+                    if( !Busy_ )
+                        next();
+                    read();
+                } );
+            }
+
+            // executes the pending commands in order - replies without delay are sent with a single write
+            void next()
+            {
+                Busy_ = true;
+
+                auto spThis = shared_from_this();
+                std::string Out;
+                while( !Pending_.empty() )
+                {
+                    auto Action = Server_.execute( Client_, Pending_.front() );
+                    Pending_.pop_front();
+
+                    if( Action.Drop )
+                    {
+                        send( std::move( Out ), [this, spThis]() { close(); } );
+                        return;
+                    }
+
+                    if( Action.Latency > std::chrono::steady_clock::duration::zero() )
+                    {
+                        send( std::move( Out ), [this, spThis, Action]()
+                        {
+                            Timer_.expires_from_now( Action.Latency );
+                            Timer_.async_wait( [this, spThis, Action]( const boost::system::error_code& ec )
+                            {
+                                if( ec )
+                                    return;
+                                send( *Action.Reply, [this, spThis]() { next(); } );
+                            } );
+                        } );
+                        return;
+                    }
+
+                    Out += *Action.Reply;
+                }
+
+                send( std::move( Out ), [this, spThis]()
+                {
+                    if( Pending_.empty() )
+                        Busy_ = false;
+                    else
+                        next();
+                } );
+            }
+
+            // writes Data - in pieces if partial writes are configured - and calls Then
+            void send( std::string Data, std::function<void()> Then )
+            {
+                if( Data.empty() )
+                {
+                    Then();
+                    return;
+                }
+
+                size_t MaximumWriteSize;
+                std::chrono::steady_clock::duration Pause;
+                {
+                    std::lock_guard<std::mutex> Lock( Server_.Mutex_ );
+                    MaximumWriteSize = Server_.MaximumWriteSize_;
+                    Pause = Server_.WritePause_;
+                }
+
+                auto spData = std::make_shared<std::string>( std::move( Data ) );
+                auto Piece = MaximumWriteSize ? std::min( MaximumWriteSize, spData->size() ) : spData->size();
+                auto spThis = shared_from_this();
+                boost::asio::async_write( Socket_, boost::asio::buffer( spData->data(), Piece ), [this, spThis, spData, Piece, Pause, Then]( const boost::system::error_code& ec, size_t )
+                {
+                    if( ec )
+                    {
+                        close();
+                        return;
+                    }
+
+                    if( Piece == spData->size() )
+                    {
+                        Then();
+                        return;
+                    }
+
+                    Timer_.expires_from_now( Pause );
+                    Timer_.async_wait( [this, spThis, spData, Piece, Then]( const boost::system::error_code& ec )
+                    {
+                        if( !ec )
+                            send( spData->substr( Piece ), Then );
+                    } );
+                } );
+            }
+
+            MockServer& Server_;
+            boost::asio::ip::tcp::socket Socket_;
+            boost::asio::steady_timer Timer_;
+            ResponseHandler<> Parser_;
+            std::deque<Command> Pending_;
+            bool Busy_ = false;
+            MockEngine::Client Client_;
+        };
+
+        void accept()
+        {
+            auto spSession = std::make_shared<Session>( *this );
+            Acceptor_.async_accept( spSession->Socket_, [this, spSession]( const boost::system::error_code& ec )
+            {
+                if( ec )
+                    return;
+
+                Connections_.fetch_add( 1, std::memory_order_relaxed );
+                Sessions_.remove_if( []( const std::weak_ptr<Session>& wpSession ) { return wpSession.expired(); } );
+                Sessions_.push_back( spSession );
+                spSession->start();
+
+                accept();
+            } );
+        }
+
+        // applies the faults and executes TheCommand - the returned action always has a reply unless it drops
+        MockAction execute( MockEngine::Client& TheClient, const Command& TheCommand )
+        {
+            Commands_.fetch_add( 1, std::memory_order_relaxed );
+
+            MockAction Action;
+            {
+                std::lock_guard<std::mutex> Lock( Mutex_ );
+                if( Script_ )
+                    Action = Script_( TheCommand );
+                if( !Action.Drop && DropAfter_ && !--DropAfter_ )
+                    Action.Drop = true;
+                if( Action.Latency == std::chrono::steady_clock::duration::zero() )
+                    Action.Latency = Latency_;
+            }
+            if( !Action.Drop && !Action.Reply )
+                Action.Reply = Engine_.execute( TheClient, TheCommand );
+
+            return Action;
+        }
+
+        boost::asio::io_service Service_;
+        boost::asio::io_service::work Work_;
+        boost::asio::ip::tcp::acceptor Acceptor_;
+        unsigned short Port_ = 0;
+        std::thread Thread_;
+        // only used on the server thread
+        std::list<std::weak_ptr<Session>> Sessions_;
+
+        std::atomic<size_t> Commands_{ 0 };
+        std::atomic<size_t> Connections_{ 0 };
+
+        MockEngine Engine_;
+
+        mutable std::mutex Mutex_;
+        std::chrono::steady_clock::duration Latency_ = std::chrono::steady_clock::duration::zero();
+        size_t MaximumWriteSize_ = 0;
+        std::chrono::steady_clock::duration WritePause_ = std::chrono::milliseconds( 1 );
+        size_t DropAfter_ = 0;
+        ScriptType Script_;
+    };
+}
+
+#endif
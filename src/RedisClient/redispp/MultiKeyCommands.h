@@ -0,0 +1,193 @@
+#pragma once
+
+#ifndef REDISPP_MULTIKEY_COMMANDS_INCLUDED
+#define REDISPP_MULTIKEY_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+
+#include <vector>
+#include <utility>
+
+// Commands taking an iterator range of keys or key/value pairs. The keys and values are not copied - the request
+// refers to them, so they have to stay unchanged until the command returns. Large ranges are split into several
+// commands of at most Limit keys, sent as a single pipeline, so they take one round trip but no command blocks the
+// server for long. A split MSET is no longer atomic.
+// All responses of a pipeline are received into the same buffers; the results refer to them and stay valid as long
+// as the PipelineResult returned together with them.
+
+namespace redis
+{
+    // default maximum number of keys per command
+    constexpr size_t MultiKeyCommandLimit = 1024;
+
+    namespace Detail
+    {
+        // Appends a request of Command for every Limit keys of [First, Last) to Commands.
+        // Append adds the arguments of one element to a request.
+        template <class IteratorT_, class AppendT_>
+        void splitCommand( Pipeline& Commands, const std::string& Command, IteratorT_ First, IteratorT_ Last, size_t Limit, AppendT_ Append, bool ReadOnly )
+        {
+            Limit = std::max( Limit, size_t( 1 ) );
+            while( First != Last )
+            {
+                Request r( Command );
+                for( size_t Count = 0; Count < Limit && First != Last; ++Count, ++First )
+                    Append( r, *First );
+                r.setReadOnly( ReadOnly );
+                Commands << std::move( r );
+            }
+        }
+
+        template <class IteratorT_>
+        void splitKeyCommand( Pipeline& Commands, const std::string& Command, IteratorT_ First, IteratorT_ Last, size_t Limit, bool ReadOnly )
+        {
+            splitCommand( Commands, Command, First, Last, Limit, []( Request& r, const auto& Key ) { r << argumentBuffer( Key ); }, ReadOnly );
+        }
+
+        // transmits the pipeline and checks the responses for errors - the first server error is saved in the connection
+        template <class Connection>
+        auto transmitChecked( Connection& con, const Pipeline& Commands, boost::system::error_code& ec )
+        {
+            auto Result = con.transmit( Commands, ec );
+            if( ec )
+                return Result;
+
+            for( const auto& spResponse : *Result.responses() )
+            {
+                if( spResponse && spResponse->type() == Response::Type::Error )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::server_error );
+                    con.setLastServerError( spResponse->string() );
+                    break;
+                }
+            }
+
+            return Result;
+        }
+
+        // adds the integer results of all responses - DEL, UNLINK and EXISTS
+        template <class Connection>
+        auto transmitCounting( Connection& con, const Pipeline& Commands, boost::system::error_code& ec )
+        {
+            auto Result = transmitChecked( con, Commands, ec );
+
+            int64_t Sum = 0;
+            if( !ec )
+            {
+                for( const auto& spResponse : *Result.responses() )
+                {
+                    Sum += IntResult( *spResponse, ec );
+                    if( ec )
+                        break;
+                }
+            }
+
+            return std::make_pair( std::move( Result ), ec ? int64_t( 0 ) : Sum );
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                     D E L
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // returns the number of deleted keys
+    template <class Connection, class IteratorT_>
+    auto del( Connection& con, boost::system::error_code& ec, IteratorT_ First, IteratorT_ Last, size_t Limit = MultiKeyCommandLimit )
+    {
+        Pipeline Commands;
+        Detail::splitKeyCommand( Commands, "DEL", First, Last, Limit, false );
+        return Detail::transmitCounting( con, Commands, ec );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  E X I S T S
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // returns the number of existing keys - keys contained several times are counted several times
+    template <class Connection, class IteratorT_>
+    auto exists( Connection& con, boost::system::error_code& ec, IteratorT_ First, IteratorT_ Last, size_t Limit = MultiKeyCommandLimit )
+    {
+        Pipeline Commands;
+        Detail::splitKeyCommand( Commands, "EXISTS", First, Last, Limit, true );
+        return Detail::transmitCounting( con, Commands, ec );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                    M G E T
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // returns the values in the order of the keys - none for missing keys and keys of another type
+    template <class Connection, class IteratorT_>
+    auto mget( Connection& con, boost::system::error_code& ec, IteratorT_ First, IteratorT_ Last, size_t Limit = MultiKeyCommandLimit )
+    {
+        Pipeline Commands;
+        Detail::splitKeyCommand( Commands, "MGET", First, Last, Limit, true );
+
+        auto Result = Detail::transmitChecked( con, Commands, ec );
+
+        std::vector<boost::optional<boost::asio::const_buffer>> Values;
+        if( !ec )
+        {
+            for( const auto& spResponse : *Result.responses() )
+            {
+                if( spResponse->type() != Response::Type::Array )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    break;
+                }
+
+                for( const auto& spValue : spResponse->elements() )
+                    Values.push_back( getResult( *spValue, ec ) );
+            }
+        }
+
+        if( ec )
+            Values.clear();
+
+        return std::make_pair( std::move( Result ), std::move( Values ) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                    M S E T
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // [First, Last) is a range of key/value pairs - Limit is the maximum number of pairs per command.
+    // Returns true if all commands succeeded.
+    template <class Connection, class IteratorT_>
+    auto mset( Connection& con, boost::system::error_code& ec, IteratorT_ First, IteratorT_ Last, size_t Limit = MultiKeyCommandLimit )
+    {
+        Pipeline Commands;
+        Detail::splitCommand( Commands, "MSET", First, Last, Limit, []( Request& r, const auto& Entry )
+        {
+            r << Detail::argumentBuffer( Entry.first ) << Detail::argumentBuffer( Entry.second );
+        }, false );
+
+        auto Result = Detail::transmitChecked( con, Commands, ec );
+
+        bool Success = !ec;
+        if( Success )
+            for( const auto& spResponse : *Result.responses() )
+                Success = OKResult( *spResponse, ec ) && Success;
+
+        return std::make_pair( std::move( Result ), Success && !ec );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  U N L I N K
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Like DEL, but the memory is reclaimed in the background - returns the number of removed keys
+    template <class Connection, class IteratorT_>
+    auto unlink( Connection& con, boost::system::error_code& ec, IteratorT_ First, IteratorT_ Last, size_t Limit = MultiKeyCommandLimit )
+    {
+        Pipeline Commands;
+        Detail::splitKeyCommand( Commands, "UNLINK", First, Last, Limit, false );
+        return Detail::transmitCounting( con, Commands, ec );
+    }
+}
+
+#endif
@@ -0,0 +1,686 @@
+#pragma once
+
+#ifndef REDISPP_NEARCACHE_INCLUDED
+#define REDISPP_NEARCACHE_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <boost/optional.hpp>
+#include <boost/asio/deadline_timer.hpp>
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+#include "redispp/HashCommands.h"
+#include "redispp/KeyHash.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    // Counters of a NearCache
+    struct NearCacheStatistics
+    {
+        uint64_t Hits = 0;
+        uint64_t Misses = 0;
+        // entries dropped because the server reported a modification
+        uint64_t Invalidations = 0;
+        // entries dropped to stay within the memory budget
+        uint64_t Evictions = 0;
+        // values not cached because they were accessed less frequently than the entries they would have replaced
+        uint64_t Rejections = 0;
+        size_t Entries = 0;
+        size_t Bytes = 0;
+    };
+
+    namespace Detail
+    {
+        // Approximate access frequency of keys for the TinyLFU admission policy: a count-min sketch with four rows
+        // of saturating 8 bit counters. All counters are halved after SampleSize increments, so the sketch
+        // follows changes of the access pattern.
+        class FrequencySketch
+        {
+        public:
+            FrequencySketch( size_t Width ) :
+                Mask_( roundUp( std::max( Width, size_t( 64 ) ) ) - 1 ),
+                Counters_( (Mask_ + 1) * Depth_ ),
+                SampleSize_( (Mask_ + 1) * 10 )
+            {}
+
+            void increment( uint32_t Hash )
+            {
+                for( size_t Row = 0; Row < Depth_; ++Row )
+                {
+                    auto& Counter = Counters_[Row * (Mask_ + 1) + index( Hash, Row )];
+                    if( Counter < 255 )
+                        ++Counter;
+                }
+
+                if( ++Samples_ >= SampleSize_ )
+                {
+                    for( auto& Counter : Counters_ )
+                        Counter >>= 1;
+                    Samples_ /= 2;
+                }
+            }
+
+            uint8_t frequency( uint32_t Hash ) const
+            {
+                uint8_t Result = 255;
+                for( size_t Row = 0; Row < Depth_; ++Row )
+                    Result = std::min( Result, Counters_[Row * (Mask_ + 1) + index( Hash, Row )] );
+                return Result;
+            }
+
+        private:
+            static constexpr size_t Depth_ = 4;
+
+            static size_t roundUp( size_t Value )
+            {
+                size_t Result = 1;
+                while( Result < Value )
+                    Result <<= 1;
+                return Result;
+            }
+
+            size_t index( uint32_t Hash, size_t Row ) const
+            {
+                static const uint32_t Seeds[Depth_] = { 0x97cb3127u, 0xab7c5f6du, 0xc0a3f1c5u, 0x7f4a7c15u };
+                uint32_t RowHash = (Hash ^ Seeds[Row]) * 0x9e3779b1u;
+                return (RowHash ^ (RowHash >> 15)) & Mask_;
+            }
+
+            size_t Mask_;
+            std::vector<uint8_t> Counters_;
+            size_t SampleSize_;
+            size_t Samples_ = 0;
+        };
+
+        inline std::string cacheKeyString( const std::string& Key )
+        {
+            return Key;
+        }
+
+        inline std::string cacheKeyString( const boost::asio::const_buffer& Key )
+        {
+            return std::string( boost::asio::buffer_cast<const char*>(Key), boost::asio::buffer_size( Key ) );
+        }
+    }
+
+    // Process wide near cache for the values of GET and HGET, kept consistent with server assisted client side
+    // caching: a dedicated connection subscribes to the invalidation channel and the data connections
+    // (see CachingConnection) enable CLIENT TRACKING with REDIRECT to it (RESP2 redirect mode).
+    //
+    // The memory used by the entries is bounded by MemoryBudget. Least recently used entries are evicted, but a new
+    // value is only admitted if its key was requested more often than the keys it would evict (TinyLFU).
+    // Entries expire with the TTL of their key and at the latest after MaximumLifetime. The entries of the databases
+    // are kept apart; an invalidation, which does not name the database, drops the key in all of them.
+    // While the invalidation connection is down, nothing is cached and the cache is flushed on every reconnect.
+    //
+    // All functions are thread safe; the invalidations are processed by a thread owned by the cache.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class NearCache
+    {
+    public:
+        // Estimated fixed overhead of an entry in bytes - added to the size of key, field and value
+        static constexpr size_t EntryOverhead = 128;
+
+        // Returned by beginFetch and passed to completeFetch
+        struct FetchToken
+        {
+            std::string Key;
+            int64_t Index;
+            uint64_t Sequence;
+            uint64_t Generation;
+        };
+
+        NearCache( const NearCache& ) = delete;
+        NearCache& operator=( const NearCache& ) = delete;
+
+        NearCache( const ConnectionManagerType& Manager, size_t MemoryBudget, std::chrono::milliseconds MaximumLifetime = std::chrono::seconds( 60 ), NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            MemoryBudget_( MemoryBudget ),
+            MaximumLifetime_( MaximumLifetime ),
+            NotificationSink_( NotificationSink ),
+            Sketch_( MemoryBudget / EntryOverhead ),
+            Socket_( ListenerService_ ),
+            ReconnectTimer_( ListenerService_ ),
+            Work_( ListenerService_ )
+        {
+            ListenerService_.post( [this]() { connectListener(); } );
+            ListenerThread_ = std::thread( [this]() { ListenerService_.run(); } );
+        }
+
+        ~NearCache()
+        {
+            ListenerService_.stop();
+            ListenerThread_.join();
+        }
+
+        // returns the client id invalidations have to be redirected to and the generation of the invalidation
+        // connection - 0 if the invalidation connection is down
+        int64_t listener( uint64_t& Generation ) const
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            Generation = ListenerId_ ? Generation_ : 0;
+            return ListenerId_;
+        }
+
+        // returns true and the cached value of Key in database Index on a hit - a nullptr value means the key does not exist
+        bool lookup( int64_t Index, const std::string& Key, const std::string& Field, bool Hash, std::shared_ptr<const std::string>& spValue )
+        {
+            auto Now = std::chrono::steady_clock::now();
+            CacheKey EntryKey{ Key, Index, Field, Hash };
+
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            Sketch_.increment( EntryKey.hash() );
+
+            auto EntryIterator = Entries_.find( EntryKey );
+            if( EntryIterator == Entries_.end() || EntryIterator->second.Expires_ <= Now )
+            {
+                if( EntryIterator != Entries_.end() )
+                    erase( EntryIterator );
+
+                ++Statistics_.Misses;
+                return false;
+            }
+
+            Lru_.splice( Lru_.begin(), Lru_, EntryIterator->second.LruPosition_ );
+            spValue = EntryIterator->second.spValue_;
+
+            ++Statistics_.Hits;
+            return true;
+        }
+
+        // registers a read of Key in database Index from the server - modifications reported before completeFetch prevent caching
+        FetchToken beginFetch( int64_t Index, const std::string& Key, uint64_t Generation )
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            ++InFlight_[Key].Count_;
+            return FetchToken{ Key, Index, Sequence_, Generation };
+        }
+
+        // stores the value read from the server - TimeToLive is the result of PTTL
+        void completeFetch( const FetchToken& Token, const std::string& Field, bool Hash, const std::shared_ptr<const std::string>& spValue, int64_t TimeToLive )
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+
+            auto InFlightIterator = InFlight_.find( Token.Key );
+            bool Invalidated = InFlightIterator->second.LastInvalidation_ > Token.Sequence;
+            if( --InFlightIterator->second.Count_ == 0 )
+                InFlight_.erase( InFlightIterator );
+
+            if( Invalidated || !ListenerId_ || Token.Generation != Generation_ )
+                return;
+
+            auto Lifetime = MaximumLifetime_;
+            if( TimeToLive > 0 )
+                Lifetime = std::min( Lifetime, std::chrono::milliseconds( TimeToLive ) );
+
+            CacheKey EntryKey{ Token.Key, Token.Index, Field, Hash };
+            size_t Size = EntryOverhead + Token.Key.size() + Field.size() + (spValue ? spValue->size() : 0);
+            if( Size > MemoryBudget_ )
+            {
+                ++Statistics_.Rejections;
+                return;
+            }
+
+            auto EntryIterator = Entries_.find( EntryKey );
+            if( EntryIterator != Entries_.end() )
+                erase( EntryIterator );
+
+            // TinyLFU admission: only evict entries requested less frequently than the new one
+            auto Frequency = Sketch_.frequency( EntryKey.hash() );
+            while( Statistics_.Bytes + Size > MemoryBudget_ )
+            {
+                auto VictimIterator = Entries_.find( *Lru_.back() );
+                if( Sketch_.frequency( VictimIterator->first.hash() ) > Frequency )
+                {
+                    ++Statistics_.Rejections;
+                    return;
+                }
+
+                erase( VictimIterator );
+                ++Statistics_.Evictions;
+            }
+
+            EntryIterator = Entries_.emplace( std::move( EntryKey ), Entry() ).first;
+            Lru_.push_front( &EntryIterator->first );
+            EntryIterator->second.spValue_ = spValue;
+            EntryIterator->second.Expires_ = std::chrono::steady_clock::now() + Lifetime;
+            EntryIterator->second.Size_ = Size;
+            EntryIterator->second.LruPosition_ = Lru_.begin();
+
+            Statistics_.Bytes += Size;
+            ++Statistics_.Entries;
+        }
+
+        // drops all cached values of Key
+        void invalidate( const std::string& Key )
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            invalidateKey( Key );
+        }
+
+        // drops all cached values
+        void flush()
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            flushAll();
+        }
+
+        NearCacheStatistics statistics() const
+        {
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+            return Statistics_;
+        }
+
+    private:
+        struct CacheKey
+        {
+            std::string Key_;
+            int64_t Index_;
+            std::string Field_;
+            bool Hash_;
+
+            bool operator<( const CacheKey& rhs ) const
+            {
+                if( Key_ != rhs.Key_ )
+                    return Key_ < rhs.Key_;
+                if( Index_ != rhs.Index_ )
+                    return Index_ < rhs.Index_;
+                if( Hash_ != rhs.Hash_ )
+                    return Hash_ < rhs.Hash_;
+                return Field_ < rhs.Field_;
+            }
+
+            uint32_t hash() const
+            {
+                return ringHash( Key_.data(), Key_.size() ) ^ (ringHash( Field_.data(), Field_.size() ) * 31) ^ (static_cast<uint32_t>(Index_) * 0x27d4eb2du) ^ (Hash_ ? 0x5bd1e995u : 0);
+            }
+        };
+
+        struct Entry
+        {
+            std::shared_ptr<const std::string> spValue_;
+            std::chrono::steady_clock::time_point Expires_;
+            size_t Size_ = 0;
+            typename std::list<const CacheKey*>::iterator LruPosition_;
+        };
+
+        struct InFlightFetches
+        {
+            size_t Count_ = 0;
+            uint64_t LastInvalidation_ = 0;
+        };
+
+        typedef std::map<CacheKey, Entry> EntryContainer;
+
+        // following functions are called with Mutex_ held
+
+        void erase( typename EntryContainer::iterator EntryIterator )
+        {
+            Statistics_.Bytes -= EntryIterator->second.Size_;
+            --Statistics_.Entries;
+            Lru_.erase( EntryIterator->second.LruPosition_ );
+            Entries_.erase( EntryIterator );
+        }
+
+        void invalidateKey( const std::string& Key )
+        {
+            auto InFlightIterator = InFlight_.find( Key );
+            if( InFlightIterator != InFlight_.end() )
+                InFlightIterator->second.LastInvalidation_ = ++Sequence_;
+
+            // the entries of a key - the value and all hash fields in every database - are adjacent
+            auto EntryIterator = Entries_.lower_bound( CacheKey{ Key, (std::numeric_limits<int64_t>::min)(), std::string(), false } );
+            while( EntryIterator != Entries_.end() && EntryIterator->first.Key_ == Key )
+            {
+                auto Current = EntryIterator++;
+                erase( Current );
+                ++Statistics_.Invalidations;
+            }
+        }
+
+        void flushAll()
+        {
+            ++Sequence_;
+            for( auto& InFlightEntry : InFlight_ )
+                InFlightEntry.second.LastInvalidation_ = Sequence_;
+
+            Statistics_.Invalidations += Entries_.size();
+            Statistics_.Entries = 0;
+            Statistics_.Bytes = 0;
+            Entries_.clear();
+            Lru_.clear();
+        }
+
+        // following functions are called on the listener thread
+
+        void connectListener()
+        {
+            boost::system::error_code ec;
+            auto Socket = ConnectionManagerInstance_.getConnectedSocket( ListenerService_, ec );
+
+            int64_t Id = 0;
+            if( !ec )
+            {
+                Detail::SocketConnectionManager scm( Socket );
+                Connection<Detail::SocketConnectionManager, NotificationSinkType_> ListenerConnection( ListenerService_, scm, 0, NotificationSink_ );
+
+                Id = redis::clientId( ListenerConnection, ec ).second;
+                if( !ec )
+                {
+                    auto spResponse = ListenerConnection.transmit( Request( "SUBSCRIBE", "__redis__:invalidate" ), ec );
+                    if( !ec && spResponse->top().type() != Response::Type::Array )
+                        ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                }
+
+                Socket_ = ListenerConnection.passSocket();
+            }
+
+            if( ec )
+            {
+                NotificationSink_.warning( "NearCache::connectListener: unable to subscribe to invalidations: {} - caching disabled", ec.message() );
+
+                Socket_.close();
+                ReconnectTimer_.expires_from_now( boost::posix_time::seconds( 1 ) );
+                ReconnectTimer_.async_wait( [this]( const boost::system::error_code& ec ) {
+                    if( !ec )
+                        connectListener();
+                } );
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> TheLock( Mutex_ );
+                flushAll();
+                ListenerId_ = Id;
+                ++Generation_;
+            }
+
+            REDISPP_NOTIFY( NotificationSink_, trace, "NearCache::connectListener: receiving invalidations on client id {}", Id );
+
+            spListenerResponse_ = std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+            receiveInvalidations();
+        }
+
+        void receiveInvalidations()
+        {
+            Socket_.async_read_some( boost::asio::buffer( spListenerResponse_->buffer() ), [this]( const boost::system::error_code& ec, std::size_t BytesReceived ) {
+                if( ec )
+                {
+                    NotificationSink_.warning( "NearCache::receiveInvalidations: invalidation connection lost: {}", ec.message() );
+
+                    {
+                        std::lock_guard<std::mutex> TheLock( Mutex_ );
+                        ListenerId_ = 0;
+                        flushAll();
+                    }
+
+                    Socket_.close();
+                    connectListener();
+                    return;
+                }
+
+                if( spListenerResponse_->dataReceived( BytesReceived ) )
+                {
+                    do
+                    {
+                        processMessage( spListenerResponse_->top() );
+                    } while( spListenerResponse_->commit() );
+                }
+
+                receiveInvalidations();
+            } );
+        }
+
+        // message: [ "message", "__redis__:invalidate", [ key, ... ] ] - a null instead of the keys means flush
+        void processMessage( const Response& Message )
+        {
+            if( Message.type() != Response::Type::Array || Message.elements().size() != 3 || Message[0].string() != "message" )
+                return;
+
+            std::lock_guard<std::mutex> TheLock( Mutex_ );
+
+            const auto& Keys = Message[2];
+            if( Keys.type() != Response::Type::Array )
+            {
+                flushAll();
+                return;
+            }
+
+            for( const auto& spKey : Keys.elements() )
+                invalidateKey( spKey->string() );
+        }
+
+        typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        size_t MemoryBudget_;
+        std::chrono::milliseconds MaximumLifetime_;
+        NotificationSinkType_ NotificationSink_;
+
+        mutable std::mutex Mutex_;
+        EntryContainer Entries_;
+        std::list<const CacheKey*> Lru_;
+        Detail::FrequencySketch Sketch_;
+        std::map<std::string, InFlightFetches> InFlight_;
+        uint64_t Sequence_ = 0;
+        int64_t ListenerId_ = 0;
+        uint64_t Generation_ = 0;
+        NearCacheStatistics Statistics_;
+
+        boost::asio::io_service ListenerService_;
+        boost::asio::ip::tcp::socket Socket_;
+        boost::asio::deadline_timer ReconnectTimer_;
+        boost::asio::io_service::work Work_;
+        std::unique_ptr<ResponseHandler<NotificationSinkType_>> spListenerResponse_;
+        std::thread ListenerThread_;
+    };
+
+    // Connection with a NearCache in front of GET and HGET (see redis::get and redis::hget overloads below).
+    // Cache hits are answered without any network traffic; misses read the value together with its TTL in one
+    // round trip. While the invalidation connection of the cache is down, the reads are sent as they are.
+    // Everything else - including the asynchronous commands - is passed to the underlying connection.
+    // Values are cached for the database Index the connection was opened with - it must not be changed with SELECT.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class CachingConnection
+    {
+    public:
+        using CacheType = NearCache<ConnectionManagerType, NotificationSinkType_>;
+        using ConnectionType = Connection<ConnectionManagerType, NotificationSinkType_>;
+        // The value holder keeps a cached value alive while the buffer of the result refers to it
+        using ResultType = std::pair<std::shared_ptr<const std::string>, boost::optional<boost::asio::const_buffer>>;
+
+        CachingConnection( const CachingConnection& ) = delete;
+        CachingConnection& operator=( const CachingConnection& ) = delete;
+
+        CachingConnection( boost::asio::io_service& io_service, const ConnectionManagerType& Manager, CacheType& Cache, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            Cache_( Cache ),
+            Connection_( io_service, Manager, Index, NotificationSink ),
+            NotificationSink_( NotificationSink ),
+            Index_( Index )
+        {
+            Connection_.addConnectHandler( [this]( auto& NewConnection, boost::system::error_code& ec ) { enableTracking( NewConnection, ec ); } );
+        }
+
+        auto transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            return Connection_.transmit( Command, ec );
+        }
+
+        auto transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            return Connection_.transmit( thePipeline, ec );
+        }
+
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            return Connection_.async_command( Command, std::forward<CompletionToken>( token ) );
+        }
+
+        template <class T1_>
+        ResultType cachedGet( const T1_& Key, boost::system::error_code& ec )
+        {
+            return cachedRead( getCommand( Key ), Detail::cacheKeyString( Key ), std::string(), false, ec );
+        }
+
+        template <class T1_, class T2_>
+        ResultType cachedHget( const T1_& Key, const T2_& Field, boost::system::error_code& ec )
+        {
+            return cachedRead( hgetCommand( Key, Field ), Detail::cacheKeyString( Key ), Detail::cacheKeyString( Field ), true, ec );
+        }
+
+        ConnectionType& connection()
+        {
+            return Connection_;
+        }
+
+        const std::string& lastServerError() const
+        {
+            return Connection_.lastServerError();
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            Connection_.setLastServerError( LastServerError );
+        }
+
+    private:
+        // Connect handler: tracking is a property of the server side connection and has to be enabled on every reconnect.
+        // Keys read by a previous connection are no longer tracked, so their cached values are dropped.
+        void enableTracking( Connection<Detail::SocketConnectionManager, NotificationSinkType_>& NewConnection, boost::system::error_code& ec )
+        {
+            if( Connected_ )
+                Cache_.flush();
+            Connected_ = true;
+
+            uint64_t Generation;
+            auto ListenerId = Cache_.listener( Generation );
+            TrackingGeneration_ = 0;
+            if( !ListenerId )
+                return;
+
+            redis::clientTracking( NewConnection, ec, true, ListenerId );
+            if( !ec )
+                TrackingGeneration_ = Generation;
+        }
+
+        ResultType cachedRead( Request&& Command, const std::string& Key, const std::string& Field, bool Hash, boost::system::error_code& ec )
+        {
+            uint64_t Generation;
+            auto ListenerId = Cache_.listener( Generation );
+
+            // the invalidation connection was (re)established since tracking was enabled - redirect to the new client id
+            if( ListenerId && TrackingGeneration_ != Generation )
+            {
+                redis::clientTracking( Connection_, ec, true, ListenerId );
+                if( ec )
+                    return ResultType();
+                TrackingGeneration_ = Generation;
+            }
+
+            // nothing is cached without invalidations - the TTL is not needed
+            if( !ListenerId )
+                return uncachedRead( Command, ec );
+
+            std::shared_ptr<const std::string> spValue;
+            if( Cache_.lookup( Index_, Key, Field, Hash, spValue ) )
+                return valueResult( spValue );
+
+            auto Token = Cache_.beginFetch( Index_, Key, Generation );
+
+            Pipeline ReadPipeline;
+            ReadPipeline.add( Command );
+            Request TimeToLiveCommand( pttlCommand( Key ) );
+            ReadPipeline.add( TimeToLiveCommand );
+
+            auto Result = Connection_.transmit( ReadPipeline, ec );
+            if( !ec )
+            {
+                if( Result[0].type() == Response::Type::Error )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::server_error );
+                    Connection_.setLastServerError( Result[0].string() );
+                }
+                else
+                {
+                    auto Value = getResult( Result[0], ec );
+                    if( Value )
+                        spValue = std::make_shared<const std::string>( boost::asio::buffer_cast<const char*>(*Value), boost::asio::buffer_size( *Value ) );
+                }
+            }
+
+            // completeFetch has to be called for every beginFetch - only a successful read is cached
+            auto TimeToLive = (!ec && Result[1].type() == Response::Type::Integer) ? Result[1].asint() : 0;
+            if( ec || TrackingGeneration_ != Generation )
+                Token.Generation = 0;
+            Cache_.completeFetch( Token, Field, Hash, spValue, TimeToLive );
+
+            if( ec )
+                return ResultType();
+
+            return valueResult( spValue );
+        }
+
+        ResultType uncachedRead( const Request& Command, boost::system::error_code& ec )
+        {
+            auto spResponse = Connection_.transmit( Command, ec );
+            if( ec )
+                return ResultType();
+
+            if( spResponse->top().type() == Response::Type::Error )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::server_error );
+                Connection_.setLastServerError( spResponse->top().string() );
+                return ResultType();
+            }
+
+            auto Value = getResult( spResponse->top(), ec );
+            if( !Value )
+                return ResultType();
+
+            return valueResult( std::make_shared<const std::string>( boost::asio::buffer_cast<const char*>(*Value), boost::asio::buffer_size( *Value ) ) );
+        }
+
+        static ResultType valueResult( const std::shared_ptr<const std::string>& spValue )
+        {
+            if( !spValue )
+                return ResultType();
+
+            return ResultType( spValue, boost::asio::buffer( *spValue ) );
+        }
+
+        CacheType& Cache_;
+        ConnectionType Connection_;
+        NotificationSinkType_ NotificationSink_;
+        const int64_t Index_;
+        uint64_t TrackingGeneration_ = 0;
+        bool Connected_ = false;
+    };
+
+    // GET and HGET on a CachingConnection are answered from the near cache
+
+    template <class ConnectionManagerType, class NotificationSinkType_, class T1_>
+    auto get( CachingConnection<ConnectionManagerType, NotificationSinkType_>& con, boost::system::error_code& ec, const T1_& Key )
+    {
+        return con.cachedGet( Key, ec );
+    }
+
+    template <class ConnectionManagerType, class NotificationSinkType_, class T1_, class T2_>
+    auto hget( CachingConnection<ConnectionManagerType, NotificationSinkType_>& con, boost::system::error_code& ec, const T1_& Key, const T2_& Field )
+    {
+        return con.cachedHget( Key, Field, ec );
+    }
+}
+
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+
+#ifndef REDISPP_PARALLELRECEIVE_INCLUDED
+#define REDISPP_PARALLELRECEIVE_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "redispp/Error.h"
+#include "redispp/LockFreeQueue.h"
+#include "redispp/ReplyCounter.h"
+#include "redispp/Response.h"
+#include "redispp/Tracing.h"
+
+// Double buffered receive of pipeline responses: an I/O thread keeps reading the socket into a fixed set of receive
+// buffers while the calling thread parses the filled ones, so reading and parsing overlap - worthwhile for pipelines
+// whose replies are hundreds of megabytes, e.g. exports. The buffers are passed back and forth through two SpscRings;
+// if the parser falls behind, the I/O thread waits for a free buffer, so no more than Chunks * ChunkSize bytes are
+// read ahead. The I/O thread counts the replies with a ReplyCounter and stops reading after the last one.
+
+namespace redis
+{
+    struct ParallelReceiveSettings
+    {
+        // size of a receive buffer - the maximum size of a read
+        size_t ChunkSize = 256 * 1024;
+        // number of receive buffers
+        size_t Chunks = 8;
+    };
+
+    // where the time of a parallel receive went
+    struct ReceiveStageTimes
+    {
+        // I/O thread reading the socket - includes waiting for the server and counting the replies
+        TraceClock::duration Read = TraceClock::duration::zero();
+        // I/O thread waiting for a free buffer - the parser is the bottleneck
+        TraceClock::duration ReadStalled = TraceClock::duration::zero();
+        // parsing the buffers
+        TraceClock::duration Parse = TraceClock::duration::zero();
+        // parser waiting for a filled buffer - the socket is the bottleneck
+        TraceClock::duration ParseStalled = TraceClock::duration::zero();
+        // start of the receive until the last response is parsed
+        TraceClock::duration Total = TraceClock::duration::zero();
+        size_t Bytes = 0;
+        // number of reads
+        size_t Reads = 0;
+    };
+
+    namespace Detail
+    {
+        struct ReceiveChunk
+        {
+            std::vector<char> Data;
+            size_t Size = 0;
+            boost::system::error_code ec;
+        };
+
+        // Joins the I/O thread on every way out of receiveParallel - a thread still joinable while an exception of the
+        // parser unwinds would call std::terminate. Stop makes the I/O thread finish after its current read instead of
+        // waiting for a free buffer the parser no longer returns.
+        class ReaderJoin
+        {
+        public:
+            ReaderJoin( std::thread& Reader, std::atomic<bool>& Stop ) :
+                Reader_( Reader ),
+                Stop_( Stop )
+            {}
+            ReaderJoin( const ReaderJoin& ) = delete;
+            ReaderJoin& operator=( const ReaderJoin& ) = delete;
+
+            ~ReaderJoin()
+            {
+                join();
+            }
+
+            void join()
+            {
+                Stop_.store( true, std::memory_order_release );
+                if( Reader_.joinable() )
+                    Reader_.join();
+            }
+
+        private:
+            std::thread& Reader_;
+            std::atomic<bool>& Stop_;
+        };
+
+        // Reads the responses to ExpectedResponses requests from Socket into Responses - see above. Socket must not
+        // be used by another thread until the function returns.
+        template <class SocketT_, class ResponseHandlerT_, class TraceT_>
+        void receiveParallel( SocketT_& Socket, ResponseHandlerT_& res, Response::ElementContainer& Responses, size_t ExpectedResponses, const ParallelReceiveSettings& Settings, ReceiveStageTimes& Times, TraceT_& TheTrace, boost::system::error_code& ec )
+        {
+            ec.clear();
+            auto Start = TraceClock::now();
+
+            std::vector<ReceiveChunk> Chunks( std::max<size_t>( Settings.Chunks, 2 ) );
+            // parser -> I/O thread
+            SpscRing<ReceiveChunk*> Free( Chunks.size() );
+            // I/O thread -> parser
+            SpscRing<ReceiveChunk*> Filled( Chunks.size() );
+            for( auto& Chunk : Chunks )
+            {
+                Chunk.Data.resize( std::max<size_t>( Settings.ChunkSize, 1 ) );
+                Free.push( &Chunk );
+            }
+
+            // set by the I/O thread after its last buffer has been passed
+            std::atomic<bool> ReadFinished{ false };
+            // set when the parser is done - early if it failed
+            std::atomic<bool> Stop{ false };
+
+            // the rings hold all buffers, so pushing never fails
+            std::thread Reader( [&]() {
+                ReplyCounter Counter;
+                Backoff Wait;
+                while( Counter.replies() < ExpectedResponses )
+                {
+                    auto StallStart = TraceClock::now();
+                    ReceiveChunk* pChunk = nullptr;
+                    while( !Free.pop( pChunk ) && !Stop.load( std::memory_order_acquire ) )
+                        Wait.pause();
+                    if( !pChunk )
+                        break;
+                    Wait.reset();
+
+                    auto ReadStart = TraceClock::now();
+                    Times.ReadStalled += ReadStart - StallStart;
+
+                    pChunk->Size = Socket.read_some( boost::asio::buffer( pChunk->Data ), pChunk->ec );
+                    if( !pChunk->ec )
+                    {
+                        Counter.consume( pChunk->Data.data(), pChunk->Size );
+                        if( Counter.failed() )
+                            pChunk->ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    }
+                    Times.Read += TraceClock::now() - ReadStart;
+                    Times.Bytes += pChunk->Size;
+                    ++Times.Reads;
+
+                    auto Failed = !!pChunk->ec;
+                    Filled.push( std::move( pChunk ) );
+                    if( Failed )
+                        break;
+                }
+                ReadFinished.store( true, std::memory_order_release );
+            } );
+            ReaderJoin Join( Reader, Stop );
+
+            Backoff Wait;
+            size_t CurrentResponse = 0;
+            while( CurrentResponse < ExpectedResponses )
+            {
+                auto StallStart = TraceClock::now();
+                ReceiveChunk* pChunk = nullptr;
+                while( !Filled.pop( pChunk ) )
+                {
+                    // the I/O thread has seen all replies but the parser has not - check once more, it may have
+                    // passed its last buffer right before finishing
+                    if( ReadFinished.load( std::memory_order_acquire ) && !Filled.pop( pChunk ) )
+                    {
+                        pChunk = nullptr;
+                        break;
+                    }
+                    Wait.pause();
+                }
+                Wait.reset();
+
+                auto ParseStart = TraceClock::now();
+                Times.ParseStalled += ParseStart - StallStart;
+
+                if( !pChunk )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::incomplete_response );
+                    break;
+                }
+                if( pChunk->ec )
+                {
+                    ec = pChunk->ec;
+                    break;
+                }
+                TheTrace.dataReceived();
+
+                // The ResponseHandler parses in its own buffers, which the completed responses refer to and which it
+                // reallocates for unfinished ones, so the I/O thread cannot read into them ahead of the parser. The copy
+                // is the first write to this memory and costs a tenth to a quarter of the parse time.
+                const char* pData = pChunk->Data.data();
+                size_t Remaining = pChunk->Size;
+                while( Remaining && CurrentResponse < ExpectedResponses )
+                {
+                    auto Buffer = res.buffer();
+                    auto BytesCopied = std::min( boost::asio::buffer_size( Buffer ), Remaining );
+                    std::memcpy( boost::asio::buffer_cast<char*>( Buffer ), pData, BytesCopied );
+                    pData += BytesCopied;
+                    Remaining -= BytesCopied;
+
+                    if( res.dataReceived( BytesCopied ) )
+                    {
+                        do
+                        {
+                            Responses.at( CurrentResponse++ ) = res.spTop();
+                        } while( CurrentResponse < ExpectedResponses && res.commit( true ) );
+                    }
+                }
+
+                Free.push( std::move( pChunk ) );
+                Times.Parse += TraceClock::now() - ParseStart;
+            }
+
+            Join.join();
+            Times.Total = TraceClock::now() - Start;
+        }
+    }
+}
+
+#endif
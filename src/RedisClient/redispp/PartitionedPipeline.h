@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef REDISPP_PARTITIONEDPIPELINE_INCLUDED
+#define REDISPP_PARTITIONEDPIPELINE_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "redispp/Connection.h"
+#include "redispp/CommandKeys.h"
+
+namespace redis
+{
+    namespace Detail
+    {
+        // First and last position of a MULTI ... EXEC (or DISCARD) block within a pipeline
+        using TransactionBlock = std::pair<size_t, size_t>;
+
+        // returns the transactions of a pipeline - an unterminated one ends with the last request
+        inline std::vector<TransactionBlock> transactionBlocks( const std::vector<const Request*>& Requests )
+        {
+            std::vector<TransactionBlock> Blocks;
+            for( size_t Position = 0; Position < Requests.size(); ++Position )
+            {
+                if( !argumentIs( Requests[Position]->argument( 0 ), "MULTI" ) )
+                    continue;
+
+                auto Start = Position;
+                while( Position + 1 < Requests.size() && !argumentIs( Requests[Position]->argument( 0 ), "EXEC" ) && !argumentIs( Requests[Position]->argument( 0 ), "DISCARD" ) )
+                    ++Position;
+                Blocks.emplace_back( Start, Position );
+            }
+            return Blocks;
+        }
+
+        // Assigns every request of a transaction to the connection of its requests with a key, so the whole
+        // block is sent to one server - blocks without a key are left to assignKeylessRequests.
+        // returns false if the keys of a transaction belong to different connections
+        template <class ConnectionType>
+        bool assignTransactions( const std::vector<TransactionBlock>& Blocks, std::vector<ConnectionType*>& Targets )
+        {
+            for( const auto& Block : Blocks )
+            {
+                ConnectionType* pConnection = nullptr;
+                for( size_t Position = Block.first; Position <= Block.second; ++Position )
+                {
+                    if( !Targets[Position] )
+                        continue;
+                    if( pConnection && Targets[Position] != pConnection )
+                        return false;
+                    pConnection = Targets[Position];
+                }
+
+                std::fill( Targets.begin() + Block.first, Targets.begin() + Block.second + 1, pConnection );
+            }
+            return true;
+        }
+
+        // Assigns requests without a key (e.g. PING), marked with nullptr, to the connection of the next
+        // request with a key - trailing ones to the connection of the previous one.
+        // Transactions have to be assigned with assignTransactions first, so MULTI and EXEC stay with their commands.
+        // returns false if no request has a connection at all
+        template <class ConnectionType>
+        bool assignKeylessRequests( std::vector<ConnectionType*>& Targets )
+        {
+            ConnectionType* pNext = nullptr;
+            for( auto TargetIterator = Targets.rbegin(); TargetIterator != Targets.rend(); ++TargetIterator )
+            {
+                if( *TargetIterator )
+                    pNext = *TargetIterator;
+                else
+                    *TargetIterator = pNext;
+            }
+
+            ConnectionType* pPrevious = nullptr;
+            for( auto& pTarget : Targets )
+            {
+                if( !pTarget )
+                    pTarget = pPrevious;
+                pPrevious = pTarget;
+            }
+
+            return Targets.empty() || Targets.front() != nullptr;
+        }
+
+        // Transmits the requests of a pipeline over several connections.
+        // Route( Position, Command ) returns the connection for the request at Position of the pipeline.
+        // All partial pipelines are written before any response is read, so the servers work on them in parallel.
+        // The responses are returned in the original order; the buffers of all partial results are moved into
+        // a single buffer container, so the merged result keeps every response valid.
+        template <class ConnectionType, class NotificationSinkType_, class RouteT_>
+        PipelineResult<NotificationSinkType_> transmitPartitioned( const Pipeline& thePipeline, boost::system::error_code& ec, RouteT_ Route, NotificationSinkType_ NotificationSink )
+        {
+            struct Partition
+            {
+                ConnectionType* pConnection_;
+                Pipeline Requests_;
+                std::vector<size_t> Positions_;
+                bool Sent_ = false;
+            };
+
+            std::vector<std::unique_ptr<Partition>> Partitions;
+
+            const auto& Requests = thePipeline.requests();
+            for( size_t Position = 0; Position < Requests.size(); ++Position )
+            {
+                ConnectionType* pConnection = &Route( Position, *Requests[Position] );
+
+                auto PartitionIterator = std::find_if( Partitions.begin(), Partitions.end(), [pConnection]( const auto& spPartition ) { return spPartition->pConnection_ == pConnection; } );
+                if( PartitionIterator == Partitions.end() )
+                {
+                    Partitions.push_back( std::make_unique<Partition>() );
+                    Partitions.back()->pConnection_ = pConnection;
+                    PartitionIterator = --Partitions.end();
+                }
+
+                (*PartitionIterator)->Requests_.add( *Requests[Position] );
+                (*PartitionIterator)->Positions_.push_back( Position );
+            }
+
+            REDISPP_NOTIFY( NotificationSink, debug, "transmitPartitioned: {} requests split into {} partial pipelines", Requests.size(), Partitions.size() );
+
+            auto spResponses = std::make_shared<Response::ElementContainer>( Requests.size() );
+            auto spBuffers = std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>();
+
+            // first write everything ...
+            boost::system::error_code FirstError;
+            for( auto& spPartition : Partitions )
+            {
+                boost::system::error_code PartitionEc;
+                spPartition->Sent_ = spPartition->pConnection_->send( spPartition->Requests_, PartitionEc );
+                if( PartitionEc && !FirstError )
+                    FirstError = PartitionEc;
+            }
+
+            // ... then collect the responses - even after an error, so no connection is left with unread responses
+            for( auto& spPartition : Partitions )
+            {
+                if( !spPartition->Sent_ )
+                    continue;
+
+                boost::system::error_code PartitionEc;
+                auto PartialResult = spPartition->pConnection_->receive( spPartition->Positions_.size(), PartitionEc );
+                if( PartitionEc && !FirstError )
+                    FirstError = PartitionEc;
+
+                spBuffers->splice( spBuffers->end(), *PartialResult.bufferContainer() );
+                for( size_t Index = 0; Index < spPartition->Positions_.size(); ++Index )
+                    (*spResponses)[spPartition->Positions_[Index]] = (*PartialResult.responses())[Index];
+            }
+
+            ec = FirstError;
+
+            return PipelineResult<NotificationSinkType_>( spResponses, spBuffers, NotificationSink );
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,313 @@
+#pragma once
+
+#ifndef REDISPP_READROUTINGCONNECTION_INCLUDED
+#define REDISPP_READROUTINGCONNECTION_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "redispp/Connection.h"
+#include "redispp/SingleHostConnectionManager.h"
+#include "redispp/SentinelConnectionManager.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    namespace Detail
+    {
+        // error replies of a replica which is not able to serve reads at the moment, e.g. while it loads its dataset
+        inline bool replicaUnavailable( const Response& Data )
+        {
+            if( Data.type() != Response::Type::Error )
+                return false;
+
+            static const char* Prefixes[] = { "LOADING", "MASTERDOWN", "BUSY" };
+            auto Message = Data.string();
+            return std::any_of( std::begin( Prefixes ), std::end( Prefixes ), [&Message]( const char* pPrefix ) { return Message.compare( 0, std::strlen( pPrefix ), pPrefix ) == 0; } );
+        }
+    }
+
+    // A connection to a sentinel monitored master set, which sends requests marked as read-only
+    // (see Request::setReadOnly) to one of the replicas, selected by a ReadPolicy.
+    // Everything else - and every read if no usable replica is known - goes to the master. The replicas are
+    // rediscovered in the background, reads use the list known so far meanwhile. A replica failing or answering
+    // with LOADING, MASTERDOWN or BUSY is skipped for a while and the read sent to the master.
+    template<class NotificationSinkType_=NullNotificationSink>
+    class ReadRoutingConnection
+    {
+    public:
+        using ManagerType = SentinelConnectionManager<NotificationSinkType_>;
+
+        ReadRoutingConnection( const ReadRoutingConnection& ) = delete;
+        ReadRoutingConnection& operator=( const ReadRoutingConnection& ) = delete;
+
+        ReadRoutingConnection( boost::asio::io_service& io_service, const ManagerType& Manager, ReadPolicy Policy = ReadPolicy::RoundRobin, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, std::chrono::milliseconds ReplicaRefreshInterval = std::chrono::seconds( 30 ) ) :
+            io_service_( io_service ),
+            Manager_( Manager ),
+            Master_( io_service, Manager, Index, NotificationSink ),
+            Policy_( Policy ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink ),
+            ReplicaRefreshInterval_( ReplicaRefreshInterval )
+        {}
+
+        // waits for a running discovery of the replicas
+        ~ReadRoutingConnection()
+        {
+            if( Discovery_.joinable() )
+                Discovery_.join();
+        }
+
+        // Proxy forcing all requests - read-only or not - to the master. Usable everywhere a connection is expected:
+        //   auto OnMaster = con.masterReads();
+        //   redis::get( OnMaster, ec, Key );
+        class MasterReads
+        {
+        public:
+            MasterReads( ReadRoutingConnection& Connection ) :
+                Connection_( Connection )
+            {}
+
+            auto transmit( const Request& Command, boost::system::error_code& ec ) { return Connection_.Master_.transmit( Command, ec ); }
+            auto transmit( const Pipeline& thePipeline, boost::system::error_code& ec ) { return Connection_.Master_.transmit( thePipeline, ec ); }
+
+            template <class	CompletionToken>
+            auto async_command( const Request& Command, CompletionToken&& token ) { return Connection_.Master_.async_command( Command, std::forward<CompletionToken>( token ) ); }
+
+            const std::string& lastServerError() const { return Connection_.lastServerError(); }
+            void setLastServerError( const std::string& LastServerError ) { Connection_.setLastServerError( LastServerError ); }
+
+        private:
+            ReadRoutingConnection& Connection_;
+        };
+
+        MasterReads masterReads()
+        {
+            return MasterReads( *this );
+        }
+
+        auto transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            if( Command.readOnly() )
+            {
+                Host Replica;
+                ReplicaSet::StatisticsHandle spStatistics;
+                if( selectReplica( Replica, spStatistics ) )
+                {
+                    auto& ReplicaConnection = replicaNode( Replica ).Connection_;
+
+                    spStatistics->Outstanding.fetch_add( 1, std::memory_order_relaxed );
+                    auto Start = std::chrono::steady_clock::now();
+
+                    auto Result = ReplicaConnection.transmit( Command, ec );
+                    bool Unavailable = !ec && Detail::replicaUnavailable( Result->top() );
+
+                    spStatistics->Outstanding.fetch_sub( 1, std::memory_order_relaxed );
+                    Manager_.replicas().completed( *spStatistics, std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - Start ), !ec && !Unavailable );
+
+                    if( !ec && !Unavailable )
+                        return Result;
+
+                    NotificationSink_.warning( "ReadRoutingConnection::transmit: replica '{}' failed: {} - falling back to master", Replica, ec ? ec.message() : Result->top().string() );
+
+                    ec.clear();
+                }
+            }
+
+            return Master_.transmit( Command, ec );
+        }
+
+        // Pipelines may mix reads and writes, so they are always sent to the master
+        auto transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            return Master_.transmit( thePipeline, ec );
+        }
+
+        // Asynchronous requests are routed like synchronous ones - a read failing on a replica is sent to the master
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            using handler_type = typename boost::asio::handler_type<CompletionToken,
+                void( boost::system::error_code, Response Data )>::type;
+            handler_type handler( std::forward<decltype(token)>( token ) );
+            boost::asio::async_result<decltype(handler)> result( handler );
+
+            Host Replica;
+            ReplicaSet::StatisticsHandle spStatistics;
+            if( Command.readOnly() && selectReplica( Replica, spStatistics ) )
+            {
+                spStatistics->Outstanding.fetch_add( 1, std::memory_order_relaxed );
+
+                // the node is not removed while requests are outstanding
+                auto& Node = replicaNode( Replica );
+                ++Node.Outstanding_;
+
+                // Command has to outlive the request, so it is still valid for the fallback
+                Node.Connection_.async_command( Command, [this, &Command, &Node, spStatistics, Start = std::chrono::steady_clock::now(), handler]( const boost::system::error_code& ec, Response Data ) mutable {
+                    --Node.Outstanding_;
+                    spStatistics->Outstanding.fetch_sub( 1, std::memory_order_relaxed );
+                    bool Unavailable = !ec && Detail::replicaUnavailable( Data );
+                    Manager_.replicas().completed( *spStatistics, std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - Start ), !ec && !Unavailable );
+
+                    if( !ec && !Unavailable )
+                    {
+                        handler( ec, std::move( Data ) );
+                        return;
+                    }
+
+                    NotificationSink_.warning( "ReadRoutingConnection::async_command: replica '{}' failed: {} - falling back to master", Node.Replica_, ec ? ec.message() : Data.string() );
+
+                    Master_.async_command( Command, std::move( handler ) );
+                } );
+            }
+            else
+                Master_.async_command( Command, std::move( handler ) );
+
+            return result.get();
+        }
+
+        Connection<ManagerType, NotificationSinkType_>& master()
+        {
+            return Master_;
+        }
+
+        // number of replicas with a connection of their own
+        size_t replicaConnections() const
+        {
+            return Replicas_.size();
+        }
+
+        const std::string& lastServerError() const
+        {
+            return LastServerError_;
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            LastServerError_ = LastServerError;
+        }
+
+    private:
+        // Connection to a single replica - the connection manager has to outlive the connection
+        struct ReplicaNode
+        {
+            ReplicaNode( boost::asio::io_service& io_service, const Host& Replica, int64_t Index, NotificationSinkType_ NotificationSink ) :
+                Replica_( Replica ),
+                Manager_( Replica ),
+                Connection_( io_service, Manager_, Index, NotificationSink )
+            {}
+
+            Host Replica_;
+            SingleHostConnectionManager Manager_;
+            Connection<SingleHostConnectionManager, NotificationSinkType_> Connection_;
+            // asynchronous requests waiting for a reply
+            size_t Outstanding_ = 0;
+        };
+
+        bool selectReplica( Host& Replica, ReplicaSet::StatisticsHandle& spStatistics )
+        {
+            if( Policy_ == ReadPolicy::Master )
+                return false;
+
+            // (re)discover the replicas if they are unknown or the list is outdated - at most once per interval and connection
+            auto Now = std::chrono::steady_clock::now();
+            if( Now >= NextReplicaRefresh_ )
+            {
+                NextReplicaRefresh_ = Now + ReplicaRefreshInterval_;
+
+                if( Now - Manager_.replicas().lastUpdate() > ReplicaRefreshInterval_ )
+                    discoverReplicas();
+            }
+
+            pruneReplicas();
+            return Manager_.replicas().select( Policy_, Replica, spStatistics );
+        }
+
+        // asks the sentinels on a thread of its own, so neither the caller nor the io_service is blocked
+        void discoverReplicas()
+        {
+            if( Discovering_.load() )
+                return;
+
+            if( Discovery_.joinable() )
+                Discovery_.join();
+
+            Discovering_.store( true );
+            Discovery_ = std::thread( [this]()
+            {
+                boost::asio::io_service Service;
+                boost::system::error_code ec;
+                Manager_.refreshReplicas( Service, ec );
+                if( ec )
+                    NotificationSink_.warning( "ReadRoutingConnection::discoverReplicas: unable to discover replicas: {}", ec.message() );
+
+                Discovering_.store( false );
+            } );
+        }
+
+        // closes the connections to replicas no longer reported by the sentinels
+        void pruneReplicas()
+        {
+            auto Update = Manager_.replicas().lastUpdate();
+            if( Update == PrunedUpdate_ )
+                return;
+
+            bool Busy = false;
+            Replicas_.erase( std::remove_if( Replicas_.begin(), Replicas_.end(), [this, &Busy]( const auto& spNode )
+            {
+                if( Manager_.replicas().contains( spNode->Replica_ ) )
+                    return false;
+
+                // removed with the next update
+                if( spNode->Outstanding_ )
+                {
+                    Busy = true;
+                    return false;
+                }
+
+                REDISPP_NOTIFY( NotificationSink_, trace, "ReadRoutingConnection::pruneReplicas: replica '{}' no longer known", spNode->Replica_ );
+                return true;
+            } ), Replicas_.end() );
+
+            if( !Busy )
+                PrunedUpdate_ = Update;
+        }
+
+        ReplicaNode& replicaNode( const Host& Replica )
+        {
+            for( auto& spNode : Replicas_ )
+                if( spNode->Replica_ == Replica )
+                    return *spNode;
+
+            Replicas_.push_back( std::make_unique<ReplicaNode>( io_service_, Replica, Index_, NotificationSink_ ) );
+
+            REDISPP_NOTIFY( NotificationSink_, trace, "ReadRoutingConnection::replicaNode: using replica '{}' for reads", Replica );
+
+            return *Replicas_.back();
+        }
+
+        boost::asio::io_service& io_service_;
+        const ManagerType& Manager_;
+        Connection<ManagerType, NotificationSinkType_> Master_;
+        std::vector<std::unique_ptr<ReplicaNode>> Replicas_;
+        ReadPolicy Policy_;
+        int64_t Index_;
+        NotificationSinkType_ NotificationSink_;
+        std::chrono::milliseconds ReplicaRefreshInterval_;
+        std::chrono::steady_clock::time_point NextReplicaRefresh_;
+        // update of the replica list the connections were last pruned for
+        std::chrono::steady_clock::time_point PrunedUpdate_;
+        std::atomic<bool> Discovering_{ false };
+        std::thread Discovery_;
+        std::string LastServerError_;
+    };
+}
+
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+
+#ifndef REDISPP_REPLYCOUNTER_INCLUDED
+#define REDISPP_REPLYCOUNTER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include <boost/utility/string_view.hpp>
+
+namespace redis
+{
+    // Streaming RESP parser which only counts complete top level replies - no Response tree is built and no data is
+    // copied, bulk strings are skipped. The data may be fed in chunks of any size; replies may span chunks.
+    // Since requests are RESP arrays as well, it also counts the commands of pre-encoded request data.
+    class ReplyCounter
+    {
+    public:
+        // maximum length of an error message passed to the error handler
+        static constexpr size_t MaximumErrorLength = 512;
+
+        // Parses Data and returns the number of replies completed by it. ErrorHandler is called with the index of the
+        // reply and its message for every top level error reply: void( size_t ReplyIndex, boost::string_view Message )
+        template <class ErrorHandlerT_>
+        size_t consume( const char* pData, size_t Size, ErrorHandlerT_&& ErrorHandler )
+        {
+            const auto RepliesBefore = Replies_;
+            const char* pEnd = pData + Size;
+
+            while( pData < pEnd && !Failed_ )
+            {
+                switch( State_ )
+                {
+                case State::Type:
+                    Type_ = *pData++;
+                    Line_.clear();
+                    if( Type_ != '+' && Type_ != '-' && Type_ != ':' && Type_ != '$' && Type_ != '*' )
+                        Failed_ = true;
+                    else
+                        State_ = State::Line;
+                    break;
+
+                case State::Line:
+                {
+                    auto pNewline = static_cast<const char*>(std::memchr( pData, '\n', pEnd - pData ));
+                    if( !pNewline )
+                    {
+                        appendLine( pData, pEnd );
+                        pData = pEnd;
+                        break;
+                    }
+
+                    appendLine( pData, pNewline );
+                    pData = pNewline + 1;
+                    if( !Line_.empty() && Line_.back() == '\r' )
+                        Line_.pop_back();
+
+                    lineCompleted( ErrorHandler );
+                    break;
+                }
+
+                case State::Bulk:
+                {
+                    auto Skipped = std::min( BulkRemaining_, static_cast<size_t>(pEnd - pData) );
+                    pData += Skipped;
+                    BulkRemaining_ -= Skipped;
+                    if( !BulkRemaining_ )
+                        elementCompleted();
+                    break;
+                }
+                }
+            }
+
+            return Replies_ - RepliesBefore;
+        }
+
+        size_t consume( const char* pData, size_t Size )
+        {
+            return consume( pData, Size, []( size_t, boost::string_view ) {} );
+        }
+
+        // number of complete replies so far
+        size_t replies() const { return Replies_; }
+        // true if no reply is partially parsed - check failed() as well, a failed parse stops in any state
+        bool idle() const { return State_ == State::Type && Open_.empty(); }
+        // true if the data was no valid RESP - no further data is parsed
+        bool failed() const { return Failed_; }
+
+    private:
+        enum class State { Type, Line, Bulk };
+
+        void appendLine( const char* pBegin, const char* pEnd )
+        {
+            // only numbers and error messages are needed
+            if( Type_ == '+' || Line_.size() >= MaximumErrorLength )
+                return;
+
+            Line_.append( pBegin, std::min( static_cast<size_t>(pEnd - pBegin), MaximumErrorLength - Line_.size() ) );
+        }
+
+        template <class ErrorHandlerT_>
+        void lineCompleted( ErrorHandlerT_& ErrorHandler )
+        {
+            switch( Type_ )
+            {
+            case '-':
+                // errors nested in arrays are data, e.g. the results of EXEC
+                if( Open_.empty() )
+                    ErrorHandler( Replies_, boost::string_view( Line_ ) );
+                elementCompleted();
+                break;
+
+            case '$':
+            {
+                auto Length = number();
+                if( Failed_ )
+                    return;
+                if( Length < 0 )
+                    elementCompleted();
+                else
+                {
+                    // data and CRLF
+                    BulkRemaining_ = static_cast<size_t>(Length) + 2;
+                    State_ = State::Bulk;
+                }
+                break;
+            }
+
+            case '*':
+            {
+                auto Elements = number();
+                if( Failed_ )
+                    return;
+                if( Elements <= 0 )
+                    elementCompleted();
+                else
+                {
+                    Open_.push_back( Elements );
+                    State_ = State::Type;
+                }
+                break;
+            }
+
+            default:
+                elementCompleted();
+            }
+        }
+
+        int64_t number()
+        {
+            char* pEnd;
+            auto Result = std::strtoll( Line_.c_str(), &pEnd, 10 );
+            if( Line_.empty() || *pEnd )
+                Failed_ = true;
+            return Result;
+        }
+
+        // completes the arrays the element was the last one of
+        void elementCompleted()
+        {
+            State_ = State::Type;
+            while( !Open_.empty() )
+            {
+                if( --Open_.back() )
+                    return;
+                Open_.pop_back();
+            }
+            ++Replies_;
+        }
+
+        State State_ = State::Type;
+        char Type_ = 0;
+        std::string Line_;
+        size_t BulkRemaining_ = 0;
+        // elements still expected by the open arrays
+        std::vector<int64_t> Open_;
+        size_t Replies_ = 0;
+        bool Failed_ = false;
+    };
+}
+
+#endif
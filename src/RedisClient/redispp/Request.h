@@ -5,6 +5,7 @@
 // See accompanying file LICENSE.txt for Lincense
 
 #include <vector>
+#include <list>
 #include <string>
 
 #include <boost/asio/buffer.hpp>
@@ -80,6 +81,22 @@ namespace redis
             return *this;
         }
 
+        // Marks the request as a read-only command, which may be served by a replica
+        Request& setReadOnly( bool ReadOnly = true )
+        {
+            ReadOnly_ = ReadOnly;
+            return *this;
+        }
+
+        // returns true if the request was marked as a read-only command
+        bool readOnly() const { return ReadOnly_; }
+
+        // returns the number of arguments - including the command name
+        size_t argumentCount() const { return (Components_.size() - 1) / 3; }
+
+        // returns the argument at Index - the command name is argument 0, the key of most commands is argument 1
+        boost::asio::const_buffer argument( size_t Index ) const { return Components_.at( Index * 3 + 2 ); }
+
         const BufferSequence_t& bufferSequence() const
         {
             Strings_.emplace_back( "*" + std::to_string( (Components_.size() - 1) / 3 ) + Strings_.front() );
@@ -91,6 +108,7 @@ namespace redis
         mutable BufferSequence_t Components_;
         mutable std::string Arraycount_;
         mutable std::list<std::string> Strings_;
+        bool ReadOnly_ = false;
 
         static constexpr const char* pCRLF_ = "\r\n";
 
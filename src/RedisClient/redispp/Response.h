@@ -8,6 +8,18 @@
 #include <list>
 #include <stack>
 #include <memory>
+#include <string>
+#include <cstdint>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 
 #include <boost/asio/buffer.hpp>
 
@@ -19,6 +31,64 @@
 
 namespace redis
 {
+    namespace Detail
+    {
+        // Parses a decimal integer without allocating - like std::stoll, parsing stops at the first non digit.
+        // Returns false if there is no number or it does not fit into 64 bits.
+        inline bool parseInteger( const char* pData, size_t Length, int64_t& Value )
+        {
+            const char* pEnd = pData + Length;
+            bool Negative = false;
+            if( pData != pEnd && ( *pData == '-' || *pData == '+' ) )
+                Negative = *pData++ == '-';
+
+            if( pData == pEnd || *pData < '0' || *pData > '9' )
+                return false;
+
+            // the magnitude of the minimum is one more than the maximum
+            const uint64_t Limit = static_cast<uint64_t>((std::numeric_limits<int64_t>::max)()) + (Negative ? 1 : 0);
+            uint64_t Result = 0;
+            for( ; pData != pEnd && *pData >= '0' && *pData <= '9'; ++pData )
+            {
+                auto Digit = static_cast<uint64_t>(*pData - '0');
+                if( Result > (Limit - Digit) / 10 )
+                    return false;
+                Result = Result * 10 + Digit;
+            }
+
+            Value = static_cast<int64_t>(Negative ? 0 - Result : Result);
+            return true;
+        }
+
+        // Parses a floating point number, e.g. a score, without allocating - uses std::from_chars if the standard
+        // library supports it for floating point types. Returns false if there is no number.
+        inline bool parseDouble( const char* pData, size_t Length, double& Value )
+        {
+            // infinite scores are written as "inf" and "-inf", but "+inf" is accepted as well
+            if( Length && *pData == '+' )
+            {
+                ++pData;
+                --Length;
+            }
+
+#if defined(__cpp_lib_to_chars)
+            return std::from_chars( pData, pData + Length, Value ).ec == std::errc();
+#else
+            // strtod needs a terminated string
+            char Buffer[64];
+            if( !Length || Length >= sizeof( Buffer ) )
+                return false;
+
+            std::memcpy( Buffer, pData, Length );
+            Buffer[Length] = 0;
+
+            char* pEnd;
+            Value = std::strtod( Buffer, &pEnd );
+            return pEnd != Buffer;
+#endif
+        }
+    }
+
     // Entity representing a part or all of the Response from a Redis server
     class Response
     {
@@ -38,19 +108,26 @@ namespace redis
         Response() :
             Type_( Type::Null ),
             pData_( nullptr ),
-            Length_( 0 )
+            Length_( 0 ),
+            pWire_( nullptr ),
+            WireLength_( 0 )
         {}
 
-        Response( Type PartType, const char* pData, size_t Length ) :
+        // pWire and WireLength are the received bytes of the element - for arrays only the header
+        Response( Type PartType, const char* pData, size_t Length, const char* pWire = nullptr, size_t WireLength = 0 ) :
             Type_( PartType ),
             pData_( pData ),
-            Length_( Length )
+            Length_( Length ),
+            pWire_( pWire ),
+            WireLength_( WireLength )
         {}
 
-        Response( ElementContainer&& Elements ) :
+        Response( ElementContainer&& Elements, const char* pWire = nullptr, size_t WireLength = 0 ) :
             Type_( Type::Array ),
             pData_( nullptr ),
             Length_( 0 ),
+            pWire_( pWire ),
+            WireLength_( WireLength ),
             Elements_( std::move( Elements ) )
         {}
 
@@ -96,8 +173,23 @@ namespace redis
         size_t size() const { return Length_; }
         // returns the data as a STL string
         std::string string() const { return Length_ ? std::string( pData_, Length_ ) : std::string(); }
-        // returns the data as an signed 64 bit integer - no validation is made if the response really holds an integer
-        int64_t asint() const { return std::stoll( string() ); }
+        // returns the data as an signed 64 bit integer - no validation is made if the response really holds an integer.
+        // Throws std::invalid_argument for data which is no number or out of range, see Detail::parseInteger
+        int64_t asint() const
+        {
+            int64_t Value;
+            if( !Detail::parseInteger( pData_, Length_, Value ) )
+                throw std::invalid_argument( "response holds no integer" );
+            return Value;
+        }
+        // returns the data as a double, e.g. a score - no validation is made if the response really holds a number
+        double asdouble() const
+        {
+            double Value;
+            if( !Detail::parseDouble( pData_, Length_, Value ) )
+                throw std::invalid_argument( "response holds no number" );
+            return Value;
+        }
         // returns the container of nested responses
         const ElementContainer& elements() const { return Elements_; }
         const ElementContainer::value_type::element_type& operator[]( size_t Index ) const 
@@ -106,10 +198,61 @@ namespace redis
                 throw std::runtime_error( "index out of bound for nested response" );
             return *Elements_.operator[]( Index );
         }
+
+        // Appends the bytes of this element as received - type indicator, length, data and CRLFs of the element and
+        // all nested elements - to Buffers, e.g. to forward a reply verbatim with a gather write. Scalar elements
+        // are contiguous; an array may be split where its reply spanned receive buffers. Pieces adjacent to the
+        // last buffer in Buffers are merged into it, so a reply received into a single buffer yields one buffer.
+        // Valid as long as the buffers of the response. Responses not created by a ResponseHandler have no bytes.
+        void wire( std::vector<boost::asio::const_buffer>& Buffers ) const
+        {
+            appendWire( Buffers, pWire_, WireLength_ );
+            for( const auto& spElement : Elements_ )
+                spElement->wire( Buffers );
+        }
+
+        std::vector<boost::asio::const_buffer> wire() const
+        {
+            std::vector<boost::asio::const_buffer> Buffers;
+            wire( Buffers );
+            return Buffers;
+        }
+
+        // number of bytes of wire()
+        size_t wireSize() const
+        {
+            auto Size = WireLength_;
+            for( const auto& spElement : Elements_ )
+                Size += spElement->wireSize();
+            return Size;
+        }
+
     private:
+        static void appendWire( std::vector<boost::asio::const_buffer>& Buffers, const char* pWire, size_t WireLength )
+        {
+            if( !WireLength )
+                return;
+
+            if( !Buffers.empty() )
+            {
+                auto pLast = boost::asio::buffer_cast<const char*>( Buffers.back() );
+                auto LastSize = boost::asio::buffer_size( Buffers.back() );
+                if( pLast + LastSize == pWire )
+                {
+                    Buffers.back() = boost::asio::const_buffer( pLast, LastSize + WireLength );
+                    return;
+                }
+            }
+
+            Buffers.emplace_back( pWire, WireLength );
+        }
+
         Type Type_;
         const char* pData_;
         size_t Length_;
+        // received bytes - for arrays the header only
+        const char* pWire_;
+        size_t WireLength_;
         ElementContainer Elements_;
     };
 
@@ -184,7 +327,7 @@ namespace redis
             size_t BytesReceived
         )
         {
-            NotificationSink_.debug( "ResponseHandler::dataReceived(): BytesReceived: {} - ParsePosition:{} ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} Buffersize:{}", BytesReceived, ParsePosition_, ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, boost::asio::buffer_size( raw_buffer() ) );
+            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): BytesReceived: {} - ParsePosition:{} ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} Buffersize:{}", BytesReceived, ParsePosition_, ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, boost::asio::buffer_size( raw_buffer() ) );
 
             // Currently active boost::asio::mutable_buffer
             boost::asio::mutable_buffer CurrentBuffer = raw_buffer();
@@ -212,7 +355,7 @@ namespace redis
             bool ToplevelFinished = false;
             for( ; pCurrent < pEnd && !ToplevelFinished; ++pCurrent, ++ParsePosition_, ++ParsedBytesInBuffer_ )
             {
-                //NotificationSink_.debug( "pCurrent {} pEnd:{} ToplevelFinished:{} ParsePosition:{} ParsedBytesInBuffer:{}", reinterpret_cast<size_t>(pCurrent), reinterpret_cast<size_t>(pEnd), ToplevelFinished, ParsePosition_, ParsedBytesInBuffer_ );
+                //REDISPP_NOTIFY( NotificationSink_, debug, "pCurrent {} pEnd:{} ToplevelFinished:{} ParsePosition:{} ParsedBytesInBuffer:{}", reinterpret_cast<size_t>(pCurrent), reinterpret_cast<size_t>(pEnd), ToplevelFinished, ParsePosition_, ParsedBytesInBuffer_ );
 
                 // Is this a CR LF combination?
                 if( CRSeen_ && *pCurrent == '\n' )
@@ -221,6 +364,8 @@ namespace redis
                     InternalBufferType::const_pointer pTopEntryStart = raw_buffer_pointer() + Offset_ + StartPosition_;
                     // Length of parsed Entry - ParsedBytesInBuffer_ with compensation for CRLF
                     size_t Length = ParsedBytesInBuffer_ - 2;
+                    // Received bytes of the line - type indicator to LF
+                    size_t LineLength = pCurrent + 1 - pTopEntryStart;
 
                     // The shared pointer for the part
                     std::shared_ptr<Response> spPart;
@@ -230,20 +375,20 @@ namespace redis
                     {
                         case '+':
                             // + denotes a simple string - it stretches from the first byte following the typeindicator to the CRLF
-                            spPart = std::make_shared<Response>( Response::Type::SimpleString, pTopEntryStart + 1, Length );
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): simple string parsed '{}'", std::string(pTopEntryStart + 1, Length) );
+                            spPart = std::make_shared<Response>( Response::Type::SimpleString, pTopEntryStart + 1, Length, pTopEntryStart, LineLength );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): simple string parsed '{}'", std::string(pTopEntryStart + 1, Length) );
                             break;
 
                         case '-':
                             // - denotes an error - the attached message stretches from the first byte following the typeindicator to the CRLF
-                            spPart = std::make_shared<Response>( Response::Type::Error, pTopEntryStart + 1, Length );
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): error parsed '{}'", std::string(pTopEntryStart + 1, Length) );
+                            spPart = std::make_shared<Response>( Response::Type::Error, pTopEntryStart + 1, Length, pTopEntryStart, LineLength );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): error parsed '{}'", std::string(pTopEntryStart + 1, Length) );
                             break;
 
                         case ':':
                             // : denotes an integer - the value stretches from the first byte following the typeindicator to the CRLF
-                            spPart = std::make_shared<Response>( Response::Type::Integer, pTopEntryStart + 1, Length );
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): integer parsed '{}'", std::string(pTopEntryStart + 1, Length) );
+                            spPart = std::make_shared<Response>( Response::Type::Integer, pTopEntryStart + 1, Length, pTopEntryStart, LineLength );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): integer parsed '{}'", std::string(pTopEntryStart + 1, Length) );
                             break;
 
                         case '$':
@@ -256,7 +401,7 @@ namespace redis
                             // Support for "Null Bulk String" - returns a null object according to spec
                             if( BulkstringSize == -1 )
                             {
-                                spPart = std::make_shared<Response>();
+                                spPart = std::make_shared<Response>( Response::Type::Null, nullptr, 0, pTopEntryStart, LineLength );
                                 break;
                             }
                             // CRLF following the data
@@ -267,17 +412,17 @@ namespace redis
                             // Simple case: bulkstring is complete in buffer
                             if( RemainingBytes >= BulkstringSize )
                             {
-                                NotificationSink_.debug( "ResponseHandler::dataReceived(): bulkstring parsed, all bytes in buffer '{}'", std::string(pCurrent + 1, BulkstringSize - 2) );
+                                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): bulkstring parsed, all bytes in buffer '{}'", std::string(pCurrent + 1, BulkstringSize - 2) );
 
                                 // check \r\n
-                                spPart = std::make_shared<Response>( Response::Type::BulkString, pCurrent + 1, BulkstringSize - 2 );
+                                spPart = std::make_shared<Response>( Response::Type::BulkString, pCurrent + 1, BulkstringSize - 2, pTopEntryStart, LineLength + BulkstringSize );
                                 pCurrent += BulkstringSize;
                                 ParsePosition_ += BulkstringSize;
                                 ParsedBytesInBufferAdjustment_ = 0;
                                 break;
                             }
 
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): bulkstring parsed, not all bytes in buffer - BulkstringSize: {} RemainingBytes: {}", BulkstringSize, RemainingBytes );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): bulkstring parsed, not all bytes in buffer - BulkstringSize: {} RemainingBytes: {}", BulkstringSize, RemainingBytes );
 
                             // not all needed data is available - wait for more ...
                             BytesToExpect = BulkstringSize - RemainingBytes;
@@ -298,18 +443,18 @@ namespace redis
                             // Number of items in array
                             off_t Items = local_atoi( pTopEntryStart + 1, pTopEntryStart + 1 + Length );
 
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): array parsed, itemcount {}", Items );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): array parsed, itemcount {}", Items );
 
                             // Support for "Null Array" - returns a null object according to spec
                             if( Items == -1 )
                             {
-                                spPart = std::make_shared<Response>();
+                                spPart = std::make_shared<Response>( Response::Type::Null, nullptr, 0, pTopEntryStart, LineLength );
                                 break;
                             }
                             // Empty array
                             if( Items == 0 )
                             {
-                                spPart = std::make_shared<Response>( Response::ElementContainer{} );
+                                spPart = std::make_shared<Response>( Response::ElementContainer{}, pTopEntryStart, LineLength );
                                 break;
                             }
 
@@ -324,8 +469,9 @@ namespace redis
                                 StartPosition_ = ParsePosition_ + 1;
                             //ParsePosition_ = -1;
 
-                            // add to stack of elements
-                            Partstack_.emplace( Items );
+                            // add to stack of elements - the header stays in this buffer, even if the elements
+                            // are moved to a larger one
+                            Partstack_.emplace( Items, pTopEntryStart, LineLength );
 
                             break;
                         }
@@ -338,7 +484,7 @@ namespace redis
                     // Part parsed?
                     if( spPart )
                     {
-                        NotificationSink_.debug( "ResponseHandler::dataReceived(): part of response completely parsed" );
+                        REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): part of response completely parsed" );
 
                         // reset indicators
                         CRSeen_ = false;
@@ -351,7 +497,7 @@ namespace redis
 
                         while( !Partstack_.empty() )
                         {
-                            NotificationSink_.debug( "ResponseHandler::dataReceived(): Removing part from partstack" );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): Removing part from partstack" );
 
                             // every byte starts a new element and pushes an entry on the stack
                             // as we now have finished the latest element, we remove it from the stack
@@ -379,7 +525,7 @@ namespace redis
 
                                 // if all elements have beeen seen, move the nested partlist to the current part
                                 if( TopEntry.CurrentEntry_ >= TopEntry.spParts_->size() )
-                                    spPart = std::make_shared<Response>( std::move( *TopEntry.spParts_ ) );
+                                    spPart = std::make_shared<Response>( std::move( *TopEntry.spParts_ ), TopEntry.pHeader_, TopEntry.HeaderLength_ );
                                 else
                                     break;
                             }
@@ -398,7 +544,7 @@ namespace redis
                     // then save the current position as the first position for the next component
                     StartPosition_ = ParsePosition_;
 
-                    NotificationSink_.debug( "ResponseHandler::dataReceived(): CRLF (or first call) seen - setting StartPosition {}", StartPosition_ );
+                    REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): CRLF (or first call) seen - setting StartPosition {}", StartPosition_ );
 
                     // reset the flag
                     CRLFSeen_ = false;
@@ -424,14 +570,14 @@ namespace redis
             {
                 //BuffersizeRemaining -= Offset_;
 
-                NotificationSink_.debug( "ResponseHandler::dataReceived(): not finished BuffersizeRemaining:{} ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} BytesToExpect:{} ParsePosition:{}", BuffersizeRemaining, ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, BytesToExpect, ParsePosition_ );
+                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): not finished BuffersizeRemaining:{} ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} BytesToExpect:{} ParsePosition:{}", BuffersizeRemaining, ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, BytesToExpect, ParsePosition_ );
 
                 // Is no buffer left or will the expected data not fit in the current buffer?
                 auto RequiredSize = ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ + Offset_ + StartPosition_ + BytesToExpect + 1;
 
                 auto bs = boost::asio::buffer_size( raw_buffer() );
 
-                NotificationSink_.debug( "ResponseHandler::dataReceived(): not finished parsing - RequiredSize:{} Buffersize:{} BytesToExpect:{} StartPosition:{}", RequiredSize, bs, BytesToExpect, StartPosition_ );
+                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): not finished parsing - RequiredSize:{} Buffersize:{} BytesToExpect:{} StartPosition:{}", RequiredSize, bs, BytesToExpect, StartPosition_ );
 
                 if( RequiredSize > bs )
                 //if( !BuffersizeRemaining || BuffersizeRemaining < BytesToExpect )
@@ -446,7 +592,7 @@ namespace redis
                     // Add a new buffer with the computed size
                     spBufferContainer_->emplace_back( RequiredBuffersize );
 
-                    NotificationSink_.debug( "ResponseHandler::dataReceived(): allocation new buffer - RequiredBuffersize:{} transfered bytes:{}", RequiredBuffersize, ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ );
+                    REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): allocation new buffer - RequiredBuffersize:{} transfered bytes:{}", RequiredBuffersize, ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ );
 
                     // copy the still needed data from the old buffer to the new buffer
                     memcpy( raw_buffer_pointer(), pTopEntryStart, ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ );
@@ -468,7 +614,7 @@ namespace redis
             }
             else
             {
-                NotificationSink_.debug( "ResponseHandler::dataReceived(): finished parsing" );
+                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::dataReceived(): finished parsing" );
             }
 
             return FinishedParsing;
@@ -477,18 +623,19 @@ namespace redis
         // Return a boost::asio::mutable_buffer where data to be processed by this class should be placed
         boost::asio::mutable_buffer buffer()
         {
-            if( (ParsedBytesInBuffer_ + UnparsedBytesInBuffer_) == boost::asio::buffer_size( raw_buffer() ) )
+            // no space left behind the data in the current buffer?
+            if( (ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ + Offset_ + StartPosition_) >= boost::asio::buffer_size( raw_buffer() ) )
             {
                 spBufferContainer_->emplace_back( Buffersize_ );
 
-                NotificationSink_.debug( "ResponseHandler::buffer(): allocation new buffer level {} - ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Buffersize:{}", spBufferContainer_->size(), ParsedBytesInBuffer_, UnparsedBytesInBuffer_, boost::asio::buffer_size( raw_buffer() ) );
+                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::buffer(): allocation new buffer level {} - ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Buffersize:{}", spBufferContainer_->size(), ParsedBytesInBuffer_, UnparsedBytesInBuffer_, boost::asio::buffer_size( raw_buffer() ) );
                 ParsePosition_ = 0;
                 Offset_ = 0;
                 StartPosition_ = 0;
                 ParsedBytesInBuffer_ = 0;
             }
             else
-                NotificationSink_.debug( "ResponseHandler::buffer(): using current buffer level {} - ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} Buffersize:{}", spBufferContainer_->size(), ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, boost::asio::buffer_size( raw_buffer() ) );
+                REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::buffer(): using current buffer level {} - ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} StartPosition:{} Buffersize:{}", spBufferContainer_->size(), ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, StartPosition_, boost::asio::buffer_size( raw_buffer() ) );
 
             return raw_buffer() + ParsedBytesInBuffer_ + UnparsedBytesInBuffer_ + Offset_ + StartPosition_;
         }
@@ -497,7 +644,7 @@ namespace redis
         // returns true if a parse at the topmost level has finished
         bool commit( bool KeepBuffer = false )
         {
-            NotificationSink_.debug( "ResponseHandler::commit(): ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} Buffersize:{} Keepbuffer:{}", ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, boost::asio::buffer_size( raw_buffer() ), KeepBuffer );
+            REDISPP_NOTIFY( NotificationSink_, debug, "ResponseHandler::commit(): ParsedBytesInBuffer:{} UnparsedBytesInBuffer:{} Offset:{} Buffersize:{} Keepbuffer:{}", ParsedBytesInBuffer_, UnparsedBytesInBuffer_, Offset_, boost::asio::buffer_size( raw_buffer() ), KeepBuffer );
 
             // Simple case: No valid data in buffer
             if( !UnparsedBytesInBuffer_ )
@@ -506,8 +653,11 @@ namespace redis
                     reset();
 
                 spTop_.reset();
-                ParsedBytesInBuffer_ = ParsePosition_;
+                // the next chunk is placed behind the parsed data
+                Offset_ += ParsePosition_;
                 ParsePosition_ = 0;
+                ParsedBytesInBuffer_ = 0;
+                StartPosition_ = 0;
 
                 return false;
             }
@@ -547,6 +697,63 @@ namespace redis
 
         std::shared_ptr<BufferContainerType> bufferContainer() { return spBufferContainer_; }
 
+        // Hands the received bytes of an unfinished response over to Target - a new handler - which continues the
+        // parse, so the buffers can be replaced at any time, not only when the handler is idle. The completed
+        // responses keep referring to the old buffers; this handler starts over with a new one.
+        void moveTail( ResponseHandler& Target )
+        {
+            // the stack holds the header and the completed elements of every unfinished array - innermost on top
+            std::vector<std::vector<boost::asio::const_buffer>> Levels;
+            while( !Partstack_.empty() )
+            {
+                auto& Entry = Partstack_.top();
+
+                std::vector<boost::asio::const_buffer> Pieces;
+                if( Entry.HeaderLength_ )
+                    Pieces.emplace_back( Entry.pHeader_, Entry.HeaderLength_ );
+                if( Entry.spParts_ )
+                    for( size_t Index = 0; Index < Entry.CurrentEntry_; ++Index )
+                        (*Entry.spParts_)[Index]->wire( Pieces );
+
+                Levels.push_back( std::move( Pieces ) );
+                Partstack_.pop();
+            }
+
+            // followed by the bytes of the unfinished element - they are always in the active buffer
+            auto Start = Offset_ + StartPosition_;
+            auto End = Start + ParsedBytesInBuffer_ + UnparsedBytesInBuffer_;
+            if( End > Start )
+            {
+                Levels.emplace( Levels.begin() );
+                Levels.front().emplace_back( raw_buffer_pointer() + Start, End - Start );
+            }
+
+            for( auto LevelIterator = Levels.rbegin(); LevelIterator != Levels.rend(); ++LevelIterator )
+            {
+                for( const auto& Piece : *LevelIterator )
+                {
+                    auto pData = boost::asio::buffer_cast<const char*>( Piece );
+                    auto Remaining = boost::asio::buffer_size( Piece );
+                    while( Remaining )
+                    {
+                        auto Buffer = Target.buffer();
+                        auto BytesCopied = std::min( boost::asio::buffer_size( Buffer ), Remaining );
+                        memcpy( boost::asio::buffer_cast<char*>( Buffer ), pData, BytesCopied );
+                        pData += BytesCopied;
+                        Remaining -= BytesCopied;
+
+                        // the response is unfinished, so the tail never completes it
+                        Target.dataReceived( BytesCopied );
+                    }
+                }
+            }
+
+            // the completed responses keep the old buffers
+            spBufferContainer_ = std::make_shared<BufferContainerType>();
+            spBufferContainer_->emplace_back( InitialBuffersize_ );
+            internalReset();
+        }
+
     private:
         // Entity representing an entry on the parsestack
         struct ParseStackEntry
@@ -555,11 +762,16 @@ namespace redis
             std::shared_ptr<Response::ElementContainer> spParts_;
             // Index of the current entry in the spParts_ container
             size_t CurrentEntry_ = 0;
+            // Received bytes of the array header
+            const char* pHeader_ = nullptr;
+            size_t HeaderLength_ = 0;
 
             ParseStackEntry()
             {}
-            ParseStackEntry( size_t Items ) :
-                spParts_( std::make_shared<Response::ElementContainer>( Items ) )
+            ParseStackEntry( size_t Items, const char* pHeader, size_t HeaderLength ) :
+                spParts_( std::make_shared<Response::ElementContainer>( Items ) ),
+                pHeader_( pHeader ),
+                HeaderLength_( HeaderLength )
             {}
             ParseStackEntry( const ParseStackEntry& ) = delete;
             ParseStackEntry& operator=( const ParseStackEntry& ) = delete;
@@ -0,0 +1,464 @@
+#pragma once
+
+#ifndef REDISPP_SCAN_COMMANDS_INCLUDED
+#define REDISPP_SCAN_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <iterator>
+#include <utility>
+#include <functional>
+
+namespace redis
+{
+    struct ScanOptions
+    {
+        // glob-style pattern the returned elements have to match - empty: all
+        std::string Match;
+        // amount of work the server does per call - 0: server default (10)
+        size_t Count = 0;
+        // type of the returned keys, e.g. "hash" - SCAN only
+        std::string Type;
+    };
+
+    // One page of a scan - the elements refer to the received data
+    struct ScanResult
+    {
+        // cursor for the next call - "0" when the scan is complete
+        std::string Cursor;
+        std::vector<boost::asio::const_buffer> Elements;
+    };
+
+    namespace Detail
+    {
+        inline void addScanOptions( Request& r, const ScanOptions& Options, bool WithType )
+        {
+            if( !Options.Match.empty() )
+                r << "MATCH" << Options.Match;
+            if( Options.Count )
+                r << "COUNT" << static_cast<int64_t>(Options.Count);
+            if( WithType && !Options.Type.empty() )
+                r << "TYPE" << Options.Type;
+        }
+
+        // validates a scan reply: [ cursor, [ elements ] ] - returns the elements or nullptr
+        inline const Response* scanPage( const Response& Data, std::string& Cursor, boost::system::error_code& ec )
+        {
+            if( Data.type() != Response::Type::Array || Data.elements().size() != 2 || Data[0].type() != Response::Type::BulkString || Data[1].type() != Response::Type::Array )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return nullptr;
+            }
+
+            Cursor = Data[0].string();
+            return &Data[1];
+        }
+
+        // Elements of a page forming one item of a ScanRange - keys and set members are single elements,
+        // hash field/value and sorted set member/score pairs are two consecutive elements
+        template <class ItemType_>
+        struct ScanItem;
+
+        template <>
+        struct ScanItem<boost::asio::const_buffer>
+        {
+            static constexpr size_t Stride = 1;
+            static boost::asio::const_buffer get( const Response& Elements, size_t Position )
+            {
+                return responseBuffer( Elements[Position] );
+            }
+        };
+
+        template <>
+        struct ScanItem<std::pair<boost::asio::const_buffer, boost::asio::const_buffer>>
+        {
+            static constexpr size_t Stride = 2;
+            static std::pair<boost::asio::const_buffer, boost::asio::const_buffer> get( const Response& Elements, size_t Position )
+            {
+                return std::make_pair( responseBuffer( Elements[Position] ), responseBuffer( Elements[Position + 1] ) );
+            }
+        };
+
+        // calls Function with every node of a cluster or shard of a sharded connection
+        template <class MultiConnectionT_, class FunctionT_>
+        auto forEachNode( MultiConnectionT_& con, FunctionT_ Function ) -> decltype( con.forEachMaster( Function ) )
+        {
+            con.forEachMaster( Function );
+        }
+
+        template <class MultiConnectionT_, class FunctionT_>
+        auto forEachNode( MultiConnectionT_& con, FunctionT_ Function ) -> decltype( con.forEachShard( Function ) )
+        {
+            con.forEachShard( Function );
+        }
+    }
+
+    inline ScanResult scanResult( const Response& Data, boost::system::error_code& ec )
+    {
+        ScanResult Result;
+        auto pElements = Detail::scanPage( Data, Result.Cursor, ec );
+        if( !pElements )
+            return Result;
+
+        Result.Elements.reserve( pElements->elements().size() );
+        for( const auto& spElement : pElements->elements() )
+            Result.Elements.push_back( Detail::responseBuffer( *spElement ) );
+
+        return Result;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   H S C A N
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request hscanCommand( const T1_& Key, const std::string& Cursor, const ScanOptions& Options )
+    {
+        Request r( "HSCAN" );
+        r << Key << Cursor;
+        Detail::addScanOptions( r, Options, false );
+        r.setReadOnly();
+        return r;
+    }
+
+    // the elements are alternating fields and values
+    template <class Connection, class T1_>
+    auto hscan( Connection& con, boost::system::error_code& ec, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::sync_universal( con, ec, &hscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_hscan( Connection& con, CompletionToken&& token, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::async_universal( con, token, &hscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                    S C A N
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    inline Request scanCommand( const std::string& Cursor, const ScanOptions& Options )
+    {
+        Request r( "SCAN" );
+        r << Cursor;
+        Detail::addScanOptions( r, Options, true );
+        r.setReadOnly();
+        return r;
+    }
+
+    template <class Connection>
+    auto scan( Connection& con, boost::system::error_code& ec, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::sync_universal( con, ec, &scanCommand, &scanResult, std::ref(Cursor), std::ref(Options) );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_scan( Connection& con, CompletionToken&& token, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::async_universal( con, token, &scanCommand, &scanResult, std::ref(Cursor), std::ref(Options) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   S S C A N
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request sscanCommand( const T1_& Key, const std::string& Cursor, const ScanOptions& Options )
+    {
+        Request r( "SSCAN" );
+        r << Key << Cursor;
+        Detail::addScanOptions( r, Options, false );
+        r.setReadOnly();
+        return r;
+    }
+
+    template <class Connection, class T1_>
+    auto sscan( Connection& con, boost::system::error_code& ec, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::sync_universal( con, ec, &sscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_sscan( Connection& con, CompletionToken&& token, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::async_universal( con, token, &sscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   Z S C A N
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request zscanCommand( const T1_& Key, const std::string& Cursor, const ScanOptions& Options )
+    {
+        Request r( "ZSCAN" );
+        r << Key << Cursor;
+        Detail::addScanOptions( r, Options, false );
+        r.setReadOnly();
+        return r;
+    }
+
+    // the elements are alternating members and scores
+    template <class Connection, class T1_>
+    auto zscan( Connection& con, boost::system::error_code& ec, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::sync_universal( con, ec, &zscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_zscan( Connection& con, CompletionToken&& token, const T1_& Key, const std::string& Cursor, const ScanOptions& Options = ScanOptions{} )
+    {
+        return Detail::async_universal( con, token, &zscanCommand<T1_>, &scanResult, std::ref(Key), std::ref(Cursor), std::ref(Options) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                S C A N   R A N G E S
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Lazy range over all items of a scan. The pages are requested on demand, but one ahead: as soon as a page has been
+    // received the request for the next one is sent, so the round trip overlaps with processing the current page.
+    // The items refer to the received data of their page and are valid until the iterator leaves the page.
+    // The connection must not be used otherwise while a page is outstanding - i.e. until the range has been iterated
+    // completely or destroyed. The iteration stops on an error, which is reported by error() - a failed request for the
+    // next page only after the items of the current one.
+    // The iterators refer to the range, which therefore can be neither copied nor moved: bind the result of the
+    // factories below to auto&& or iterate it directly.
+    template <class ConnectionType, class ItemType_ = boost::asio::const_buffer>
+    class ScanRange
+    {
+    public:
+        using RequestFactoryType = std::function<Request( const std::string& Cursor )>;
+
+        class iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = ItemType_;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const ItemType_*;
+            using reference = const ItemType_&;
+
+            iterator() = default;
+            explicit iterator( ScanRange* pRange ) : pRange_( pRange ) {}
+
+            reference operator*() const { return pRange_->Current_; }
+            pointer operator->() const { return &pRange_->Current_; }
+
+            iterator& operator++()
+            {
+                if( !pRange_->advance() )
+                    pRange_ = nullptr;
+                return *this;
+            }
+
+            bool operator==( const iterator& rhs ) const { return pRange_ == rhs.pRange_; }
+            bool operator!=( const iterator& rhs ) const { return pRange_ != rhs.pRange_; }
+
+        private:
+            ScanRange* pRange_ = nullptr;
+        };
+
+        ScanRange( const ScanRange& ) = delete;
+        ScanRange& operator=( const ScanRange& ) = delete;
+
+        ScanRange( ConnectionType& con, RequestFactoryType RequestFactory ) :
+            pConnection_( &con ),
+            RequestFactory_( std::move( RequestFactory ) )
+        {}
+
+        ScanRange( ScanRange&& ) = delete;
+        ScanRange& operator=( ScanRange&& ) = delete;
+
+        // collects an outstanding page, so the connection stays usable
+        ~ScanRange()
+        {
+            if( Outstanding_ )
+            {
+                boost::system::error_code ec;
+                pConnection_->receive( 1, ec );
+            }
+        }
+
+        // starts the scan - can be called once
+        iterator begin()
+        {
+            if( Started_ )
+                return iterator();
+
+            Started_ = true;
+            if( !request( "0", ec_ ) || !advance() )
+                return iterator();
+
+            return iterator( this );
+        }
+
+        iterator end()
+        {
+            return iterator();
+        }
+
+        const boost::system::error_code& error() const
+        {
+            return ec_;
+        }
+
+    private:
+        using PageType = decltype(std::declval<ConnectionType&>().receive( 1, std::declval<boost::system::error_code&>() ));
+        using ItemTraits = Detail::ScanItem<ItemType_>;
+
+        // moves to the next item - receives pages until it finds one or the scan is complete
+        bool advance()
+        {
+            for( ;;)
+            {
+                if( pElements_ && Position_ + ItemTraits::Stride <= pElements_->elements().size() )
+                {
+                    Current_ = ItemTraits::get( *pElements_, Position_ );
+                    Position_ += ItemTraits::Stride;
+                    return true;
+                }
+
+                // the current page is consumed - now the failed request for the next one ends the scan
+                if( !Outstanding_ )
+                {
+                    if( PrefetchError_ )
+                        ec_ = PrefetchError_;
+                    return false;
+                }
+
+                // pages may be empty although the scan is not complete
+                if( !receive() )
+                    return false;
+            }
+        }
+
+        bool receive()
+        {
+            Outstanding_ = false;
+            pElements_ = nullptr;
+            spPage_ = std::make_unique<PageType>( pConnection_->receive( 1, ec_ ) );
+            if( ec_ )
+                return false;
+
+            const auto& Data = (*spPage_)[0];
+            if( Data.type() == Response::Type::Error )
+            {
+                ec_ = ::redis::make_error_code( ErrorCodes::server_error );
+                pConnection_->setLastServerError( Data.string() );
+                return false;
+            }
+
+            std::string Cursor;
+            pElements_ = Detail::scanPage( Data, Cursor, ec_ );
+            Position_ = 0;
+            if( !pElements_ )
+                return false;
+
+            // prefetch - a failure is reported once the items of this page have been returned
+            if( Cursor != "0" )
+                request( Cursor, PrefetchError_ );
+
+            return true;
+        }
+
+        bool request( const std::string& Cursor, boost::system::error_code& ec )
+        {
+            Pipeline Next;
+            Next << RequestFactory_( Cursor );
+            if( !pConnection_->send( Next, ec ) )
+                return false;
+
+            Outstanding_ = true;
+            return true;
+        }
+
+        ConnectionType* pConnection_;
+        RequestFactoryType RequestFactory_;
+        std::unique_ptr<PageType> spPage_;
+        const Response* pElements_ = nullptr;
+        size_t Position_ = 0;
+        ItemType_ Current_;
+        bool Started_ = false;
+        bool Outstanding_ = false;
+        boost::system::error_code ec_;
+        boost::system::error_code PrefetchError_;
+    };
+
+    // The factories return the ranges without moving them (see ScanRange)
+
+    // all keys of the database
+    template <class ConnectionType>
+    ScanRange<ConnectionType> scanRange( ConnectionType& con, const ScanOptions& Options = ScanOptions{} )
+    {
+        return { con, [Options]( const std::string& Cursor ) { return scanCommand( Cursor, Options ); } };
+    }
+
+    // field/value pairs of a hash
+    template <class ConnectionType>
+    ScanRange<ConnectionType, std::pair<boost::asio::const_buffer, boost::asio::const_buffer>> hscanRange( ConnectionType& con, const std::string& Key, const ScanOptions& Options = ScanOptions{} )
+    {
+        return { con, [Key, Options]( const std::string& Cursor ) { return hscanCommand( Key, Cursor, Options ); } };
+    }
+
+    // members of a set
+    template <class ConnectionType>
+    ScanRange<ConnectionType> sscanRange( ConnectionType& con, const std::string& Key, const ScanOptions& Options = ScanOptions{} )
+    {
+        return { con, [Key, Options]( const std::string& Cursor ) { return sscanCommand( Key, Cursor, Options ); } };
+    }
+
+    // member/score pairs of a sorted set
+    template <class ConnectionType>
+    ScanRange<ConnectionType, std::pair<boost::asio::const_buffer, boost::asio::const_buffer>> zscanRange( ConnectionType& con, const std::string& Key, const ScanOptions& Options = ScanOptions{} )
+    {
+        return { con, [Key, Options]( const std::string& Cursor ) { return zscanCommand( Key, Cursor, Options ); } };
+    }
+
+    // Walks the keyspaces of all masters of a ClusterConnection or all shards of a ShardedConnection in parallel - one
+    // thread per node, each with a prefetching ScanRange. Function is called concurrently for every key.
+    // Returns the first error of a node - the other nodes are scanned completely anyway.
+    template <class MultiConnectionT_, class FunctionT_>
+    boost::system::error_code parallelScan( MultiConnectionT_& con, const ScanOptions& Options, FunctionT_ Function )
+    {
+        std::vector<std::function<void()>> Walks;
+        std::mutex ResultMutex;
+        boost::system::error_code Result;
+
+        Detail::forEachNode( con, [&]( auto& Node )
+        {
+            Walks.push_back( [&, pNode = &Node]()
+            {
+                auto&& Keys = scanRange( *pNode, Options );
+                for( const auto& Key : Keys )
+                    Function( Key );
+
+                if( Keys.error() )
+                {
+                    std::lock_guard<std::mutex> Lock( ResultMutex );
+                    if( !Result )
+                        Result = Keys.error();
+                }
+            } );
+        } );
+
+        std::vector<std::thread> Threads;
+        for( auto& Walk : Walks )
+            Threads.emplace_back( Walk );
+        for( auto& Thread : Threads )
+            Thread.join();
+
+        return Result;
+    }
+}
+
+#endif
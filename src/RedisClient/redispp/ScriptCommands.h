@@ -0,0 +1,301 @@
+#pragma once
+
+#ifndef REDISPP_SCRIPT_COMMANDS_INCLUDED
+#define REDISPP_SCRIPT_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+
+#include <boost/uuid/detail/sha1.hpp>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Lua scripts and functions. Scripts are called by their SHA1 digest, which is computed locally, so the script body is
+// only sent if the server does not know the script yet - after a restart, a failover or a SCRIPT FLUSH. A ScriptRegistry
+// loads all its scripts on every new connection, so even that does not happen on the hot path.
+// Keys and Arguments are containers of std::string, boost::string_view or const_buffer - they are not copied.
+
+namespace redis
+{
+    namespace Detail
+    {
+        // lower case hex SHA1 digest, as used by EVALSHA
+        inline std::string sha1Hex( const std::string& Source )
+        {
+            boost::uuids::detail::sha1 Hash;
+            Hash.process_bytes( Source.data(), Source.size() );
+
+            boost::uuids::detail::sha1::digest_type Digest;
+            Hash.get_digest( Digest );
+
+            // the digest is made of 32 bit words in older and of bytes in newer boost versions
+            constexpr int Width = static_cast<int>( sizeof( Digest[0] ) * 2 );
+            std::string Result;
+            char Buffer[16];
+            for( const auto& Part : Digest )
+            {
+                std::snprintf( Buffer, sizeof( Buffer ), "%0*lx", Width, static_cast<unsigned long>( Part ) );
+                Result += Buffer;
+            }
+
+            return Result;
+        }
+
+        template <class KeysT_, class ArgumentsT_>
+        void appendKeysAndArguments( Request& r, const KeysT_& Keys, const ArgumentsT_& Arguments )
+        {
+            r << static_cast<int64_t>( Keys.size() );
+            for( const auto& Key : Keys )
+                r << argumentBuffer( Key );
+            for( const auto& Argument : Arguments )
+                r << argumentBuffer( Argument );
+        }
+
+        inline bool isNoScriptError( const std::string& ServerError )
+        {
+            return ServerError.compare( 0, 8, "NOSCRIPT" ) == 0;
+        }
+    }
+
+    // A Lua script together with its SHA1 digest - cheap to copy, the source is shared
+    class Script
+    {
+    public:
+        explicit Script( std::string Source ) :
+            spSource_( std::make_shared<const std::string>( std::move( Source ) ) ),
+            Sha1_( Detail::sha1Hex( *spSource_ ) )
+        {}
+
+        const std::string& source() const
+        {
+            return *spSource_;
+        }
+
+        const std::string& sha1() const
+        {
+            return Sha1_;
+        }
+
+    private:
+        std::shared_ptr<const std::string> spSource_;
+        std::string Sha1_;
+    };
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                     E V A L
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // sends the whole script - prefer evalScript, which only does so if the server does not know the script
+    template <class KeysT_, class ArgumentsT_>
+    Request evalCommand( const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments )
+    {
+        Request r( "EVAL" );
+        r << Detail::argumentBuffer( TheScript.source() );
+        Detail::appendKeysAndArguments( r, Keys, Arguments );
+        return r;
+    }
+
+    // pResponseFunction decodes the reply of the script, e.g. &IntResult or &BufferArrayResult
+    template <class Connection, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto eval( Connection& con, boost::system::error_code& ec, const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction )
+    {
+        return Detail::sync_universal( con, ec, &evalCommand<KeysT_, ArgumentsT_>, pResponseFunction, std::ref(TheScript), std::ref(Keys), std::ref(Arguments) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  E V A L S H A
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class KeysT_, class ArgumentsT_>
+    Request evalshaCommand( const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments )
+    {
+        Request r( "EVALSHA" );
+        r << Detail::argumentBuffer( TheScript.sha1() );
+        Detail::appendKeysAndArguments( r, Keys, Arguments );
+        return r;
+    }
+
+    // fails with a NOSCRIPT server error, if the server does not know the script
+    template <class Connection, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto evalsha( Connection& con, boost::system::error_code& ec, const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction )
+    {
+        return Detail::sync_universal( con, ec, &evalshaCommand<KeysT_, ArgumentsT_>, pResponseFunction, std::ref(TheScript), std::ref(Keys), std::ref(Arguments) );
+    }
+
+    // no NOSCRIPT fallback - load the script with a ScriptRegistry on connect
+    template <class Connection, class CompletionToken, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto async_evalsha( Connection& con, CompletionToken&& token, const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction )
+    {
+        return Detail::async_universal( con, token, &evalshaCommand<KeysT_, ArgumentsT_>, pResponseFunction, std::ref(TheScript), std::ref(Keys), std::ref(Arguments) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                              S C R I P T  L O A D
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    inline Request scriptLoadCommand( const Script& TheScript )
+    {
+        Request r( "SCRIPT" );
+        r << "LOAD" << Detail::argumentBuffer( TheScript.source() );
+        return r;
+    }
+
+    // returns the SHA1 digest computed by the server
+    inline std::string scriptLoadResult( const Response& Data, boost::system::error_code& ec )
+    {
+        if( Data.type() != Response::Type::BulkString )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return std::string();
+        }
+
+        return Data.string();
+    }
+
+    template <class Connection>
+    auto scriptLoad( Connection& con, boost::system::error_code& ec, const Script& TheScript )
+    {
+        return Detail::sync_universal( con, ec, &scriptLoadCommand, &scriptLoadResult, std::ref(TheScript) );
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_scriptLoad( Connection& con, CompletionToken&& token, const Script& TheScript )
+    {
+        return Detail::async_universal( con, token, &scriptLoadCommand, &scriptLoadResult, std::ref(TheScript) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                    F C A L L
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // calls a function of a loaded library - FCALL_RO, which may be sent to replicas, if ReadOnly is set
+    template <class KeysT_, class ArgumentsT_>
+    Request fcallCommand( const std::string& Function, const KeysT_& Keys, const ArgumentsT_& Arguments, bool ReadOnly )
+    {
+        Request r( ReadOnly ? "FCALL_RO" : "FCALL" );
+        r << Function;
+        Detail::appendKeysAndArguments( r, Keys, Arguments );
+        r.setReadOnly( ReadOnly );
+        return r;
+    }
+
+    template <class Connection, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto fcall( Connection& con, boost::system::error_code& ec, const std::string& Function, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction, bool ReadOnly = false )
+    {
+        return Detail::sync_universal( con, ec, &fcallCommand<KeysT_, ArgumentsT_>, pResponseFunction, std::ref(Function), std::ref(Keys), std::ref(Arguments), ReadOnly );
+    }
+
+    template <class Connection, class CompletionToken, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto async_fcall( Connection& con, CompletionToken&& token, const std::string& Function, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction, bool ReadOnly = false )
+    {
+        return Detail::async_universal( con, token, &fcallCommand<KeysT_, ArgumentsT_>, pResponseFunction, std::ref(Function), std::ref(Keys), std::ref(Arguments), ReadOnly );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                 evalScript
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Calls the script with EVALSHA. If the server does not know it, the script is loaded and the call is repeated - the
+    // body is only sent in this case.
+    template <class Connection, class KeysT_, class ArgumentsT_, class ResponseT_>
+    auto evalScript( Connection& con, boost::system::error_code& ec, const Script& TheScript, const KeysT_& Keys, const ArgumentsT_& Arguments, ResponseT_ pResponseFunction )
+    {
+        auto Result = evalsha( con, ec, TheScript, Keys, Arguments, pResponseFunction );
+        if( ec != ::redis::make_error_code( ErrorCodes::server_error ) || !Detail::isNoScriptError( con.lastServerError() ) )
+            return Result;
+
+        ec.clear();
+        scriptLoad( con, ec, TheScript );
+        if( ec )
+            return Result;
+
+        return evalsha( con, ec, TheScript, Keys, Arguments, pResponseFunction );
+    }
+
+    // Thread safe set of scripts, which are loaded on every new connection of the connections it is attached to - including
+    // reconnects after a failover reported by a SentinelConnectionManager. Only the synchronous commands reconnect through
+    // the connect handler.
+    class ScriptRegistry
+    {
+    public:
+        // returns the registered script - adding the same source twice returns the same script
+        Script add( std::string Source )
+        {
+            Script NewScript( std::move( Source ) );
+
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            for( const auto& Existing : Scripts_ )
+                if( Existing.sha1() == NewScript.sha1() )
+                    return Existing;
+
+            Scripts_.push_back( NewScript );
+            return NewScript;
+        }
+
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> Lock( Mutex_ );
+            return Scripts_.size();
+        }
+
+        // loads all scripts with a single pipeline
+        template <class Connection>
+        bool load( Connection& con, boost::system::error_code& ec ) const
+        {
+            Pipeline Commands;
+            {
+                std::lock_guard<std::mutex> Lock( Mutex_ );
+                for( const auto& TheScript : Scripts_ )
+                    Commands << scriptLoadCommand( TheScript );
+            }
+
+            if( !Commands.requestCount() )
+                return true;
+
+            auto Result = con.transmit( Commands, ec );
+            if( ec )
+                return false;
+
+            for( const auto& spResponse : *Result.responses() )
+            {
+                if( spResponse->type() == Response::Type::Error )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::server_error );
+                    con.setLastServerError( spResponse->string() );
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Loads the scripts on every new connection of con, in addition to its other connect handlers - the registry has
+        // to outlive the connection. A script the server rejects does not fail the connect: it is reported as warning and
+        // evalScript falls back to loading it on demand.
+        template <class Connection>
+        void attach( Connection& con ) const
+        {
+            con.addConnectHandler( [this]( auto& NewConnection, boost::system::error_code& ec )
+            {
+                if( !load( NewConnection, ec ) && ec == ::redis::make_error_code( ErrorCodes::server_error ) )
+                {
+                    NewConnection.notificationSink().warning( "ScriptRegistry: loading the scripts failed: {}", NewConnection.lastServerError() );
+                    ec.clear();
+                }
+            } );
+        }
+
+    private:
+        mutable std::mutex Mutex_;
+        std::vector<Script> Scripts_;
+    };
+}
+
+#endif
@@ -106,6 +106,40 @@ namespace redis
         return Detail::async_universal(con, token, &sentinelSentinelsCommand<decltype(Mastername)>, &sentinelSentinelsResult, std::ref(Mastername));
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                            S E N T I N E L (Replicas)
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_>
+    Request sentinelReplicasCommand( const T1_& Mastername )
+    {
+        Request r( "SENTINEL", "replicas" );
+        r << Mastername;
+        return r;
+    }
+
+    // The reply has the same layout as the reply of SENTINEL sentinels: a list of name/value maps, one for each replica
+    inline auto sentinelReplicasResult( const Response& Data, boost::system::error_code& ec )
+    {
+        // A master without replicas is no protocol error
+        if( Data.type() == Response::Type::Array && Data.elements().empty() )
+            return decltype(sentinelSentinelsResult( Data, ec ))();
+
+        return sentinelSentinelsResult( Data, ec );
+    }
+
+    template <class Connection, class T1_>
+    auto sentinel_replicas(Connection& con, boost::system::error_code& ec, const T1_& Mastername)
+    {
+        return Detail::sync_universal(con, ec, &sentinelReplicasCommand<decltype(Mastername)>, &sentinelReplicasResult, std::ref(Mastername));
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_sentinel_replicas(Connection& con, CompletionToken&& token, const T1_& Mastername)
+    {
+        return Detail::async_universal(con, token, &sentinelReplicasCommand<decltype(Mastername)>, &sentinelReplicasResult, std::ref(Mastername));
+    }
+
 }
 
 #endif
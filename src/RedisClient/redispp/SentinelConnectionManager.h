@@ -9,22 +9,225 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <shared_mutex>
+
+#include <boost/optional.hpp>
 
 #include "redispp/Connection.h"
 #include "redispp/Commands.h"
 #include "redispp/SentinelCommands.h"
 #include "redispp/MultipleHostsConnectionManager.h"
 #include "redispp/Error.h"
+#include "redispp/Metrics.h"
 
 namespace redis
 {
-    template<class NotificationSinkType_=NullNotificationSink>
+    // Policy used to select the server for read-only commands
+    enum class ReadPolicy { Master, RoundRobin, LeastOutstanding, LowestLatency };
+
+    // Thread safe set of the replicas of a master set, together with the statistics used to route reads to them
+    class ReplicaSet
+    {
+    public:
+        // Statistics of a single replica - shared by all connections reading from it
+        struct Statistics
+        {
+            // number of requests currently waiting for a reply from this replica
+            std::atomic<int64_t> Outstanding{ 0 };
+            // exponentially weighted moving average of the round trip time in microseconds - 0 means not measured yet
+            std::atomic<int64_t> LatencyMicroseconds{ 0 };
+            // time (steady_clock ticks) until which the replica is skipped after an error
+            std::atomic<std::chrono::steady_clock::rep> UnusableUntil{ 0 };
+        };
+        using StatisticsHandle = std::shared_ptr<Statistics>;
+
+        ReplicaSet( const ReplicaSet& ) = delete;
+        ReplicaSet& operator=( const ReplicaSet& ) = delete;
+
+        ReplicaSet( std::chrono::milliseconds ErrorBackoff = std::chrono::seconds( 5 ) ) :
+            ErrorBackoff_( ErrorBackoff )
+        {}
+
+        // replaces the known replicas - statistics of replicas already known are kept
+        void set( const std::list<Host>& Replicas )
+        {
+            std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+
+            std::vector<Entry> NewEntries;
+            NewEntries.reserve( Replicas.size() );
+            for( const auto& Replica : Replicas )
+            {
+                auto Existing = std::find_if( Entries_.begin(), Entries_.end(), [&Replica]( const auto& Current ) { return Current.Replica_ == Replica; } );
+                NewEntries.push_back( { Replica, Existing != Entries_.end() ? Existing->spStatistics_ : std::make_shared<Statistics>() } );
+            }
+            Entries_ = std::move( NewEntries );
+            LastUpdate_ = std::chrono::steady_clock::now();
+        }
+
+        // returns the time of the last call to set - a default constructed time_point if the replicas were never discovered
+        std::chrono::steady_clock::time_point lastUpdate() const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return LastUpdate_;
+        }
+
+        size_t size() const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return Entries_.size();
+        }
+
+        bool contains( const Host& Replica ) const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return std::any_of( Entries_.begin(), Entries_.end(), [&Replica]( const auto& Current ) { return Current.Replica_ == Replica; } );
+        }
+
+        // selects a usable replica according to Policy - returns false if there is none
+        bool select( ReadPolicy Policy, Host& Replica, StatisticsHandle& spStatistics )
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+
+            if( Policy == ReadPolicy::Master || Entries_.empty() )
+                return false;
+
+            auto Now = std::chrono::steady_clock::now().time_since_epoch().count();
+            size_t Start = NextEntry_++;
+            const Entry* pSelected = nullptr;
+            int64_t SelectedValue = 0;
+
+            for( size_t Count = 0; Count < Entries_.size(); ++Count )
+            {
+                const auto& Current = Entries_[(Start + Count) % Entries_.size()];
+                if( Current.spStatistics_->UnusableUntil.load( std::memory_order_relaxed ) > Now )
+                    continue;
+
+                int64_t Value = 0;
+                if( Policy == ReadPolicy::LeastOutstanding )
+                    Value = Current.spStatistics_->Outstanding.load( std::memory_order_relaxed );
+                else
+                    if( Policy == ReadPolicy::LowestLatency )
+                        Value = Current.spStatistics_->LatencyMicroseconds.load( std::memory_order_relaxed );
+
+                // round robin takes the first usable entry, the other policies the one with the lowest value
+                if( !pSelected || Value < SelectedValue )
+                {
+                    pSelected = &Current;
+                    SelectedValue = Value;
+                    if( Policy == ReadPolicy::RoundRobin )
+                        break;
+                }
+            }
+
+            if( !pSelected )
+                return false;
+
+            Replica = pSelected->Replica_;
+            spStatistics = pSelected->spStatistics_;
+            return true;
+        }
+
+        // records the outcome of a request served by a replica
+        void completed( Statistics& ReplicaStatistics, std::chrono::microseconds Latency, bool Success )
+        {
+            if( !Success )
+            {
+                ReplicaStatistics.UnusableUntil.store( (std::chrono::steady_clock::now() + ErrorBackoff_).time_since_epoch().count(), std::memory_order_relaxed );
+                return;
+            }
+
+            // EWMA with a weight of 1/8 for the newest sample
+            auto Previous = ReplicaStatistics.LatencyMicroseconds.load( std::memory_order_relaxed );
+            auto Sample = std::max<int64_t>( Latency.count(), 1 );
+            ReplicaStatistics.LatencyMicroseconds.store( Previous ? Previous + (Sample - Previous) / 8 : Sample, std::memory_order_relaxed );
+        }
+
+    private:
+        struct Entry
+        {
+            Host Replica_;
+            StatisticsHandle spStatistics_;
+        };
+
+        mutable std::shared_timed_mutex Mutex_;
+        std::vector<Entry> Entries_;
+        std::atomic<size_t> NextEntry_{ 0 };
+        std::chrono::milliseconds ErrorBackoff_;
+        std::chrono::steady_clock::time_point LastUpdate_;
+    };
+
+    // MetricsType_ records the duration of failovers - from the failed connect to the cached master until the new
+    // master is confirmed
+    template<class NotificationSinkType_=NullNotificationSink, class MetricsType_=NullMetrics>
     class SentinelConnectionManager
     {
     public:
         typedef std::tuple<std::string, int> Host;
         typedef typename MultipleHostsConnectionManager<NotificationSinkType_>::HostContainer HostContainer;
 
+        // Default time a master confirmed by a sentinel is used without asking the sentinels again
+        static constexpr std::chrono::milliseconds DefaultMasterCacheValidity() { return std::chrono::seconds( 30 ); }
+
+        // Thread safe cache of the last master endpoint reported by a sentinel and confirmed by the ROLE command.
+        // It is shared by all Instances of a SentinelConnectionManager, so steady-state connects go straight to the master.
+        class MasterEndpointCache
+        {
+        public:
+            MasterEndpointCache( const MasterEndpointCache& ) = delete;
+            MasterEndpointCache& operator=( const MasterEndpointCache& ) = delete;
+
+            MasterEndpointCache( std::chrono::milliseconds Validity ) :
+                Validity_( Validity )
+            {}
+
+            // returns the cached master - or nothing if there is no entry or the validity window has passed
+            boost::optional<Host> get() const
+            {
+                std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                if( !Valid_ || std::chrono::steady_clock::now() >= Expires_ )
+                    return boost::none;
+                return Master_;
+            }
+
+            // stores a confirmed master and restarts the validity window
+            void set( const Host& Master )
+            {
+                if( Validity_ <= std::chrono::milliseconds::zero() )
+                    return;
+
+                std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                Master_ = Master;
+                Expires_ = std::chrono::steady_clock::now() + Validity_;
+                Valid_ = true;
+            }
+
+            // forgets the cached master unconditionally
+            void invalidate()
+            {
+                std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                Valid_ = false;
+            }
+
+            // forgets the cached master only if it is still the given one - a newer entry stored by
+            // another thread in the meantime is kept
+            void invalidate( const Host& Master )
+            {
+                std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+                if( Master_ == Master )
+                    Valid_ = false;
+            }
+
+        private:
+            mutable std::shared_timed_mutex Mutex_;
+            std::chrono::milliseconds Validity_;
+            std::chrono::steady_clock::time_point Expires_;
+            Host Master_;
+            bool Valid_ = false;
+        };
+
         class Instance
         {
             constexpr double TimeoutInSeconds() const {
@@ -34,15 +237,40 @@ namespace redis
             Instance( const Instance& ) = default;
             Instance& operator=( const Instance& ) = delete;
 
-            Instance( typename MultipleHostsConnectionManager<NotificationSinkType_>::HostContainer& InitialHosts, const std::string& MasterSet, NotificationSinkType_ NotificationSink ) :
+            Instance( typename MultipleHostsConnectionManager<NotificationSinkType_>::HostContainer& InitialHosts, const std::string& MasterSet, MasterEndpointCache& MasterCache, ReplicaSet& Replicas, NotificationSinkType_ NotificationSink, MetricsType_ Metrics = MetricsType_{} ) :
                 InitialHosts_( InitialHosts ),
                 Hosts_( InitialHosts.get() ),
                 MasterSet_( MasterSet ),
-                NotificationSink_(NotificationSink)
+                MasterCache_( MasterCache ),
+                Replicas_( Replicas ),
+                NotificationSink_(NotificationSink),
+                Metrics_( Metrics )
             {}
 
             boost::asio::ip::tcp::socket getConnectedSocket( boost::asio::io_service& io_service, boost::system::error_code& ec )
             {
+                Detail::Stopwatch<Detail::metricsEnabled<MetricsType_>()> FailoverWatch;
+                bool Failover = false;
+
+                // Steady state: use the cached master without asking any sentinel
+                auto CachedMaster = MasterCache_.get();
+                if( CachedMaster )
+                {
+                    auto Socket = connectToMaster( io_service, *CachedMaster, ec );
+                    if( !ec )
+                    {
+                        REDISPP_NOTIFY( NotificationSink_, trace, "SentinelConnectionManager::getConnectedSocket: using cached master '{}'", *CachedMaster );
+
+                        return Socket;
+                    }
+
+                    NotificationSink_.warning( "SentinelConnectionManager::getConnectedSocket: cached master '{}' not usable: {} - asking sentinels", *CachedMaster, ec.message() );
+
+                    MasterCache_.invalidate( *CachedMaster );
+                    ec.clear();
+                    Failover = true;
+                }
+
                 MultipleHostsConnectionManager<NotificationSinkType_> mhcm( io_service, Hosts_, NotificationSink_ );
                 redis::Connection<redis::MultipleHostsConnectionManager<NotificationSinkType_>, NotificationSinkType_> SentinelConnection( io_service, mhcm, 0, NotificationSink_ );
 
@@ -63,8 +291,8 @@ namespace redis
                     {
                         auto rh = SentinelConnection.remote_endpoint();
 
-                        NotificationSink_.debug( "SentinelConnectionManager::getConnectedSocket: Using Sentinel '{}'", rh );
-                        NotificationSink_.debug( "SentinelConnectionManager::getConnectedSocket: Got Master '{}' for set '{}'", GetMasterAddrByNameResult.second, MasterSet_ );
+                        REDISPP_NOTIFY( NotificationSink_, debug, "SentinelConnectionManager::getConnectedSocket: Using Sentinel '{}'", rh );
+                        REDISPP_NOTIFY( NotificationSink_, debug, "SentinelConnectionManager::getConnectedSocket: Got Master '{}' for set '{}'", GetMasterAddrByNameResult.second, MasterSet_ );
 
                         GetMasterAddrByNameResult.first->commit();
 
@@ -79,30 +307,31 @@ namespace redis
 
                             InitialHosts_.set( Hosts_ );
 
-                            NotificationSink_.debug( "SentinelConnectionManager::getConnectedSocket: Sentinel list updated - now {} sentinels available for next connection", Hosts_.size() );
+                            REDISPP_NOTIFY( NotificationSink_, debug, "SentinelConnectionManager::getConnectedSocket: Sentinel list updated - now {} sentinels available for next connection", Hosts_.size() );
                         }
 
-                        SingleHostConnectionManager shcm( GetMasterAddrByNameResult.second );
-                        redis::Connection<redis::SingleHostConnectionManager, NotificationSinkType_> MasterConnection( io_service, shcm, 0, NotificationSink_ );
+                        // Update Replica List - failures are not fatal for the master connection
+                        boost::system::error_code ReplicaEc;
+                        updateReplicas( SentinelConnection, ReplicaEc );
 
-                        // Test if the master aggrees with its role
-                        auto Role = redis::role( MasterConnection, ec );
-                        if( !ec && Role.second == "master" )
+                        auto MasterSocket = connectToMaster( io_service, GetMasterAddrByNameResult.second, ec );
+                        if( !ec )
                         {
                             // Return the active connection to the caller
 
-                            NotificationSink_.trace( "SentinelConnectionManager::getConnectedSocket: Master '{}' agreed to role - using it for further requests", GetMasterAddrByNameResult.second );
+                            REDISPP_NOTIFY( NotificationSink_, trace, "SentinelConnectionManager::getConnectedSocket: Master '{}' agreed to role - using it for further requests", GetMasterAddrByNameResult.second );
+
+                            MasterCache_.set( GetMasterAddrByNameResult.second );
+                            if( Failover )
+                                Metrics_.failover( MasterSet_, FailoverWatch.elapsed() );
 
-                            return MasterConnection.passSocket();
+                            return MasterSocket;
                         }
                         else
                         {
                             using namespace std::literals;
 
-                            if( ec )
-                                NotificationSink_.warning( "SentinelConnectionManager::getConnectedSocket: server returned error during role command: {} ", ec.message() );
-                            else
-                                NotificationSink_.warning( "SentinelConnectionManager::getConnectedSocket: server returned wrong role '{}' ", Role.second );
+                            NotificationSink_.warning( "SentinelConnectionManager::getConnectedSocket: master '{}' not usable: {} ", GetMasterAddrByNameResult.second, ec.message() );
 
                             // Wait a short amount of time
                             std::this_thread::sleep_for( 1s );
@@ -124,11 +353,110 @@ namespace redis
                 return boost::asio::ip::tcp::socket( io_service );
             }
 
+            // The discovery takes several blocking round trips to the sentinels and the master - it runs on a thread
+            // of its own with a copy of the instance, so the io_service is not blocked; only the handler is posted to
+            // io_service. The SentinelConnectionManager has to outlive the discovery.
+            template <class	CompletionToken>
+            auto async_getConnectedSocket( boost::asio::io_service& io_service, CompletionToken&& token )
+            {
+                using handler_type = typename boost::asio::handler_type<CompletionToken,
+                    void( boost::system::error_code ec, std::shared_ptr<boost::asio::ip::tcp::socket> Socket )>::type;
+                handler_type handler( std::forward<CompletionToken&&>( token ) );
+                boost::asio::async_result<decltype(handler)> result( handler );
+
+                // the work keeps io_service running until the handler has been posted
+                std::thread( [Discovery = *this, &io_service, handler, Work = boost::asio::io_service::work( io_service )]() mutable
+                {
+                    boost::system::error_code ec;
+                    auto spSocket = std::make_shared<boost::asio::ip::tcp::socket>( Discovery.getConnectedSocket( io_service, ec ) );
+                    io_service.post( [handler, ec, spSocket]() mutable {
+                        handler( ec, spSocket );
+                    } );
+                } ).detach();
+
+                return result.get();
+            }
+
+            // Asks the sentinels for the replicas of the master set and updates the shared ReplicaSet
+            void refreshReplicas( boost::asio::io_service& io_service, boost::system::error_code& ec )
+            {
+                MultipleHostsConnectionManager<NotificationSinkType_> mhcm( io_service, Hosts_, NotificationSink_ );
+                redis::Connection<redis::MultipleHostsConnectionManager<NotificationSinkType_>, NotificationSinkType_> SentinelConnection( io_service, mhcm, 0, NotificationSink_ );
+
+                for( size_t Hostcount = Hosts_.size(); Hostcount; --Hostcount )
+                {
+                    updateReplicas( SentinelConnection, ec );
+                    if( !ec )
+                        return;
+
+                    NotificationSink_.warning( "SentinelConnectionManager::refreshReplicas: server returned error during replicas command: {} ", ec.message() );
+
+                    SentinelConnection.instance().shiftHosts();
+                }
+            }
+
         private:
+            template <class SentinelConnectionType>
+            void updateReplicas( SentinelConnectionType& SentinelConnection, boost::system::error_code& ec )
+            {
+                auto GetReplicasResult = redis::sentinel_replicas( SentinelConnection, ec, MasterSet_ );
+                if( ec )
+                    return;
+
+                std::list<Host> Replicas;
+                for( const auto& ReplicaProperties : GetReplicasResult.second )
+                {
+                    auto Flags = ReplicaProperties.find( "flags" );
+                    auto LinkStatus = ReplicaProperties.find( "master-link-status" );
+                    auto Ip = ReplicaProperties.find( "ip" );
+                    auto Port = ReplicaProperties.find( "port" );
+
+                    if( Ip == ReplicaProperties.end() || Port == ReplicaProperties.end() )
+                        continue;
+
+                    // skip replicas the sentinel considers down or out of sync
+                    if( Flags != ReplicaProperties.end() && ( Flags->second.find( "s_down" ) != std::string::npos || Flags->second.find( "o_down" ) != std::string::npos || Flags->second.find( "disconnected" ) != std::string::npos ) )
+                        continue;
+                    if( LinkStatus != ReplicaProperties.end() && LinkStatus->second != "ok" )
+                        continue;
+
+                    Replicas.emplace_back( Ip->second, std::stoi( Port->second ) );
+                }
+
+                Replicas_.set( Replicas );
+
+                REDISPP_NOTIFY( NotificationSink_, debug, "SentinelConnectionManager::updateReplicas: replica list updated - now {} replicas available for reads", Replicas.size() );
+            }
+
+            // Connects to Master and checks that the server agrees with its role
+            boost::asio::ip::tcp::socket connectToMaster( boost::asio::io_service& io_service, const Host& Master, boost::system::error_code& ec )
+            {
+                SingleHostConnectionManager shcm( Master );
+                redis::Connection<redis::SingleHostConnectionManager, NotificationSinkType_> MasterConnection( io_service, shcm, 0, NotificationSink_ );
+
+                // Test if the master aggrees with its role
+                auto Role = redis::role( MasterConnection, ec );
+                if( ec )
+                    return boost::asio::ip::tcp::socket( io_service );
+
+                if( Role.second != "master" )
+                {
+                    NotificationSink_.warning( "SentinelConnectionManager::getConnectedSocket: server '{}' returned wrong role '{}' ", Master, Role.second );
+
+                    ec = ::redis::make_error_code( ErrorCodes::wrong_role );
+                    return boost::asio::ip::tcp::socket( io_service );
+                }
+
+                return MasterConnection.passSocket();
+            }
+
             typename MultipleHostsConnectionManager<NotificationSinkType_>::HostContainer& InitialHosts_;
             typename HostContainer::ContainerType Hosts_;
             const std::string& MasterSet_;
+            MasterEndpointCache& MasterCache_;
+            ReplicaSet& Replicas_;
             NotificationSinkType_ NotificationSink_;
+            MetricsType_ Metrics_;
             std::shared_ptr<MultipleHostsConnectionManager<NotificationSinkType_> > spInnerConnectionManager_;
         };
 
@@ -136,25 +464,47 @@ namespace redis
         SentinelConnectionManager(const SentinelConnectionManager&) = delete;
         SentinelConnectionManager& operator=(const SentinelConnectionManager&) = delete;
 
-        SentinelConnectionManager( boost::asio::io_service& io_service, const typename HostContainer::ContainerType& Hosts, const std::string& MasterSet, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+        SentinelConnectionManager( boost::asio::io_service& io_service, const typename HostContainer::ContainerType& Hosts, const std::string& MasterSet, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, std::chrono::milliseconds MasterCacheValidity = DefaultMasterCacheValidity(), MetricsType_ Metrics = MetricsType_{} ) :
+            Strand_(io_service),
             Hosts_(Hosts),
             MasterSet_( MasterSet ),
             NotificationSink_(NotificationSink),
-            Strand_(io_service)
+            Metrics_( Metrics ),
+            MasterCache_(MasterCacheValidity)
         {
         }
 
-        SentinelConnectionManager(boost::asio::io_service& io_service, typename HostContainer::ContainerType&& Hosts, const std::string& MasterSet, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+        SentinelConnectionManager(boost::asio::io_service& io_service, typename HostContainer::ContainerType&& Hosts, const std::string& MasterSet, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, std::chrono::milliseconds MasterCacheValidity = DefaultMasterCacheValidity(), MetricsType_ Metrics = MetricsType_{} ) :
+            Strand_(io_service),
             Hosts_(std::move(Hosts)),
             MasterSet_(MasterSet),
             NotificationSink_(NotificationSink),
-            Strand_(io_service)
+            Metrics_( Metrics ),
+            MasterCache_(MasterCacheValidity)
         {
         }
 
         Instance getInstance() const
         {
-            return Instance( Hosts_, MasterSet_, NotificationSink_ );
+            return Instance( Hosts_, MasterSet_, MasterCache_, Replicas_, NotificationSink_, Metrics_ );
+        }
+
+        // returns the replicas discovered so far
+        ReplicaSet& replicas() const
+        {
+            return Replicas_;
+        }
+
+        // Asks the sentinels for the current replicas of the master set
+        void refreshReplicas( boost::asio::io_service& io_service, boost::system::error_code& ec ) const
+        {
+            getInstance().refreshReplicas( io_service, ec );
+        }
+
+        // Forces the next connect of any Instance to ask the sentinels for the current master
+        void invalidateMasterCache()
+        {
+            MasterCache_.invalidate();
         }
 
     private:
@@ -162,6 +512,9 @@ namespace redis
         mutable typename MultipleHostsConnectionManager<NotificationSinkType_>::HostContainer Hosts_;
         std::string MasterSet_;
         NotificationSinkType_ NotificationSink_;
+        MetricsType_ Metrics_;
+        mutable MasterEndpointCache MasterCache_;
+        mutable ReplicaSet Replicas_;
     };
 }
 
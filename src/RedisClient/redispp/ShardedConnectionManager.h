@@ -0,0 +1,372 @@
+#pragma once
+
+#ifndef REDISPP_SHARDEDCONNECTIONMANAGER_INCLUDED
+#define REDISPP_SHARDEDCONNECTIONMANAGER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <shared_mutex>
+
+#include <boost/optional.hpp>
+
+#include "redispp/Connection.h"
+#include "redispp/SingleHostConnectionManager.h"
+#include "redispp/PartitionedPipeline.h"
+#include "redispp/KeyHash.h"
+#include "redispp/CommandKeys.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    // Client side partitioning of keys over several standalone servers (shards) with a ketama style
+    // consistent hash ring: every shard is placed on the ring PointsPerWeight * Weight times, a key belongs
+    // to the first shard point following the hash of the key. Adding or removing a shard therefore only moves
+    // the keys of its own points - about 1/N of the keyspace. Hash tags ({...}) are respected like in a cluster.
+    template<class NotificationSinkType_=NullNotificationSink>
+    class ShardedConnectionManager
+    {
+    public:
+        struct Shard
+        {
+            Host Node;
+            unsigned Weight;
+        };
+        typedef std::list<Shard> ShardContainer;
+
+        // Number of ring points per unit of weight
+        static constexpr unsigned PointsPerWeight = 160;
+
+        ShardedConnectionManager( const ShardedConnectionManager& ) = delete;
+        ShardedConnectionManager& operator=( const ShardedConnectionManager& ) = delete;
+
+        ShardedConnectionManager( const ShardContainer& Shards, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            Shards_( Shards ),
+            NotificationSink_( NotificationSink )
+        {
+            if( Shards_.empty() )
+                throw std::out_of_range( "Shardcontainer does not contain any shards." );
+
+            rebuildRing();
+        }
+
+        // adds a shard or changes the weight of an existing one
+        void addShard( const Host& Node, unsigned Weight = 1 )
+        {
+            std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            auto ShardIterator = std::find_if( Shards_.begin(), Shards_.end(), [&Node]( const Shard& Entry ) { return Entry.Node == Node; } );
+            if( ShardIterator == Shards_.end() )
+                Shards_.push_back( Shard{ Node, Weight } );
+            else
+                ShardIterator->Weight = Weight;
+
+            rebuildRing();
+        }
+
+        void removeShard( const Host& Node )
+        {
+            std::unique_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            Shards_.remove_if( [&Node]( const Shard& Entry ) { return Entry.Node == Node; } );
+
+            rebuildRing();
+        }
+
+        // returns the shard a key belongs to - false if there is no shard
+        bool shardForKey( const boost::asio::const_buffer& Key, Host& Node ) const
+        {
+            auto Hash = keyRingHash( Key );
+
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            if( Ring_.empty() )
+                return false;
+
+            auto PointIterator = std::lower_bound( Ring_.begin(), Ring_.end(), std::make_pair( Hash, size_t( 0 ) ) );
+            if( PointIterator == Ring_.end() )
+                PointIterator = Ring_.begin();
+
+            Node = Nodes_[PointIterator->second];
+            return true;
+        }
+
+        bool shardForKey( const std::string& Key, Host& Node ) const
+        {
+            return shardForKey( boost::asio::buffer( Key ), Node );
+        }
+
+        ShardContainer shards() const
+        {
+            std::shared_lock<std::shared_timed_mutex> TheLock( Mutex_ );
+            return Shards_;
+        }
+
+    private:
+        // called with the unique lock held (or from the constructor)
+        void rebuildRing()
+        {
+            std::vector<Host> Nodes;
+            std::vector<std::pair<uint32_t, size_t>> Ring;
+
+            for( const auto& Entry : Shards_ )
+            {
+                auto NodeIndex = Nodes.size();
+                Nodes.push_back( Entry.Node );
+
+                std::string PointPrefix( std::get<0>(Entry.Node) + ":" + std::to_string( std::get<1>(Entry.Node) ) + "-" );
+                for( unsigned Point = 0; Point < PointsPerWeight * Entry.Weight; ++Point )
+                {
+                    std::string PointName( PointPrefix + std::to_string( Point ) );
+                    Ring.emplace_back( ringHash( PointName.data(), PointName.size() ), NodeIndex );
+                }
+            }
+
+            std::sort( Ring.begin(), Ring.end() );
+
+            REDISPP_NOTIFY( NotificationSink_, trace, "ShardedConnectionManager: ring rebuilt with {} shards and {} points", Nodes.size(), Ring.size() );
+
+            Nodes_ = std::move( Nodes );
+            Ring_ = std::move( Ring );
+        }
+
+        mutable std::shared_timed_mutex Mutex_;
+        ShardContainer Shards_;
+        NotificationSinkType_ NotificationSink_;
+        std::vector<Host> Nodes_;
+        std::vector<std::pair<uint32_t, size_t>> Ring_;
+    };
+
+    // Connection to a set of shards with one connection per shard.
+    // Requests are routed by their key (see requestKey); pipelines and multi key reads are split per shard,
+    // written to all shards before any response is read and merged in the original order.
+    // Requests without a key (PING, INFO, SCAN, ...) are sent to the shard set with setKeylessShard and fail
+    // with keyless_request if none is set - inside a pipeline they stay with their neighbours, e.g. MULTI/EXEC.
+    // Like Connection, a ShardedConnection must not be shared between threads - the manager may.
+    template<class NotificationSinkType_=NullNotificationSink>
+    class ShardedConnection
+    {
+    public:
+        using ManagerType = ShardedConnectionManager<NotificationSinkType_>;
+        using ShardConnectionType = Connection<SingleHostConnectionManager, NotificationSinkType_>;
+
+        ShardedConnection( const ShardedConnection& ) = delete;
+        ShardedConnection& operator=( const ShardedConnection& ) = delete;
+
+        ShardedConnection( boost::asio::io_service& io_service, const ManagerType& Manager, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            io_service_( io_service ),
+            Manager_( Manager ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink )
+        {}
+
+        std::unique_ptr<ResponseHandler<NotificationSinkType_>> transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            Host Node;
+            if( !routeRequest( Command, Node, ec ) )
+            {
+                return std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+            }
+
+            return connection( Node ).transmit( Command, ec );
+        }
+
+        PipelineResult<NotificationSinkType_> transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            const auto& Requests = thePipeline.requests();
+
+            std::vector<ShardConnectionType*> Targets( Requests.size(), nullptr );
+            for( size_t Position = 0; Position < Requests.size(); ++Position )
+            {
+                Host Node;
+                boost::asio::const_buffer Key;
+                if( requestKey( *Requests[Position], Key ) && Manager_.shardForKey( Key, Node ) )
+                    Targets[Position] = &connection( Node );
+            }
+
+            if( !Detail::assignTransactions( Detail::transactionBlocks( Requests ), Targets ) )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::cross_node_transaction );
+                return PipelineResult<NotificationSinkType_>( std::make_shared<Response::ElementContainer>( Requests.size() ), std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>(), NotificationSink_ );
+            }
+
+            if( !Detail::assignKeylessRequests( Targets ) )
+            {
+                Host Node;
+                if( !keylessShard( Node, ec ) )
+                {
+                    return PipelineResult<NotificationSinkType_>( std::make_shared<Response::ElementContainer>( Requests.size() ), std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>(), NotificationSink_ );
+                }
+                std::fill( Targets.begin(), Targets.end(), &connection( Node ) );
+            }
+
+            return Detail::transmitPartitioned<ShardConnectionType>( thePipeline, ec, [&Targets]( size_t Position, const Request& ) -> ShardConnectionType& { return *Targets[Position]; }, NotificationSink_ );
+        }
+
+        // Reads several keys with one MGET per shard. The values refer to the buffers of the returned PipelineResult,
+        // which has to be kept alive while the values are used.
+        template <class KeyContainerT_>
+        std::pair<PipelineResult<NotificationSinkType_>, std::vector<boost::optional<boost::asio::const_buffer>>> mget( const KeyContainerT_& Keys, boost::system::error_code& ec )
+        {
+            std::map<Host, std::pair<Request, std::vector<size_t>>> Shards;
+
+            size_t KeyCount = 0;
+            for( const auto& Key : Keys )
+            {
+                Host Node;
+                if( !Manager_.shardForKey( Key, Node ) )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
+                    return std::make_pair( PipelineResult<NotificationSinkType_>( std::make_shared<Response::ElementContainer>(), std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>(), NotificationSink_ ), std::vector<boost::optional<boost::asio::const_buffer>>() );
+                }
+
+                auto ShardIterator = Shards.find( Node );
+                if( ShardIterator == Shards.end() )
+                    ShardIterator = Shards.emplace( Node, std::make_pair( Request( "MGET" ), std::vector<size_t>() ) ).first;
+
+                ShardIterator->second.first << Key;
+                ShardIterator->second.second.push_back( KeyCount++ );
+            }
+
+            Pipeline ShardPipeline;
+            std::vector<ShardConnectionType*> Targets;
+            for( auto& ShardEntry : Shards )
+            {
+                ShardPipeline.add( ShardEntry.second.first );
+                Targets.push_back( &connection( ShardEntry.first ) );
+            }
+
+            auto Result = Detail::transmitPartitioned<ShardConnectionType>( ShardPipeline, ec, [&Targets]( size_t Position, const Request& ) -> ShardConnectionType& { return *Targets[Position]; }, NotificationSink_ );
+
+            std::vector<boost::optional<boost::asio::const_buffer>> Values( KeyCount );
+            if( ec )
+                return std::make_pair( Result, std::move( Values ) );
+
+            size_t ShardIndex = 0;
+            for( const auto& ShardEntry : Shards )
+            {
+                const auto& spShardResponse = (*Result.responses())[ShardIndex++];
+                const auto& Positions = ShardEntry.second.second;
+                if( !spShardResponse || spShardResponse->type() != Response::Type::Array || spShardResponse->elements().size() != Positions.size() )
+                {
+                    if( spShardResponse && spShardResponse->type() == Response::Type::Error )
+                        ec = ::redis::make_error_code( ErrorCodes::server_error );
+                    else
+                        ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return std::make_pair( Result, std::move( Values ) );
+                }
+
+                for( size_t Index = 0; Index < Positions.size(); ++Index )
+                {
+                    const auto& Value = (*spShardResponse)[Index];
+                    if( Value.type() == Response::Type::BulkString )
+                        Values[Positions[Index]] = boost::asio::buffer( Value.data(), Value.size() );
+                }
+            }
+
+            return std::make_pair( Result, std::move( Values ) );
+        }
+
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            // without a shard - a keyless request without setKeylessShard as well - the request fails on connect
+            // and reports the error through the token
+            Host Node;
+            boost::system::error_code ec;
+            routeRequest( Command, Node, ec );
+
+            return connection( Node ).async_command( Command, std::forward<CompletionToken>( token ) );
+        }
+
+        // Requests without a key are sent to Node - it does not have to be one of the shards
+        void setKeylessShard( const Host& Node )
+        {
+            KeylessShard_ = Node;
+        }
+
+        // Requests without a key fail with keyless_request - the default
+        void clearKeylessShard()
+        {
+            KeylessShard_ = boost::none;
+        }
+
+        // calls Function with the connection of every shard
+        template <class FunctionT_>
+        void forEachShard( FunctionT_ Function )
+        {
+            for( const auto& Entry : Manager_.shards() )
+                Function( connection( Entry.Node ) );
+        }
+
+        const std::string& lastServerError() const
+        {
+            return LastServerError_;
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            LastServerError_ = LastServerError;
+        }
+
+    private:
+        // Connection to a single shard - the connection manager has to outlive the connection
+        struct ShardEntry
+        {
+            ShardEntry( boost::asio::io_service& io_service, const Host& Node, int64_t Index, NotificationSinkType_ NotificationSink ) :
+                Manager_( Node ),
+                Connection_( io_service, Manager_, Index, NotificationSink )
+            {}
+
+            SingleHostConnectionManager Manager_;
+            ShardConnectionType Connection_;
+        };
+
+        bool keylessShard( Host& Node, boost::system::error_code& ec ) const
+        {
+            if( !KeylessShard_ )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::keyless_request );
+                return false;
+            }
+            Node = *KeylessShard_;
+            return true;
+        }
+
+        bool routeRequest( const Request& Command, Host& Node, boost::system::error_code& ec ) const
+        {
+            boost::asio::const_buffer Key;
+            if( !requestKey( Command, Key ) )
+                return keylessShard( Node, ec );
+
+            if( Manager_.shardForKey( Key, Node ) )
+                return true;
+
+            ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
+            return false;
+        }
+
+        ShardConnectionType& connection( const Host& Node )
+        {
+            auto& spEntry = Shards_[Node];
+            if( !spEntry )
+            {
+                REDISPP_NOTIFY( NotificationSink_, trace, "ShardedConnection: opening connection to shard '{}'", Node );
+                spEntry = std::make_unique<ShardEntry>( io_service_, Node, Index_, NotificationSink_ );
+            }
+            return spEntry->Connection_;
+        }
+
+        boost::asio::io_service& io_service_;
+        const ManagerType& Manager_;
+        int64_t Index_;
+        NotificationSinkType_ NotificationSink_;
+        std::map<Host, std::unique_ptr<ShardEntry>> Shards_;
+        boost::optional<Host> KeylessShard_;
+        std::string LastServerError_;
+    };
+}
+
+#endif
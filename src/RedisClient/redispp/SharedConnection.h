@@ -0,0 +1,539 @@
+#pragma once
+
+#ifndef REDISPP_SHAREDCONNECTION_INCLUDED
+#define REDISPP_SHAREDCONNECTION_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "redispp/Connection.h"
+#include "redispp/LockFreeQueue.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    // Counters of a SharedConnection
+    struct SharedConnectionStatistics
+    {
+        // submitted requests and pipelines
+        uint64_t Submissions = 0;
+        // writes to the socket - Submissions / Writes is the average batch size
+        uint64_t Writes = 0;
+        // number of times a submitting thread had to wait for a full queue
+        uint64_t Stalls = 0;
+        uint64_t Reconnects = 0;
+    };
+
+    // Connection, which may be used by any number of threads at the same time - with the synchronous and asynchronous
+    // commands. Submitting threads push their requests into a lock free multiple producer queue. A single I/O thread
+    // owns the socket: it drains the queue, writes all queued requests with a single write and matches the responses
+    // in order. Synchronous callers spin briefly on their own completion flag and then block on it, so a slow server
+    // does not keep them busy; a submitter finding the queue full blocks until the I/O thread has taken requests.
+    // A pipeline is a single submission, so its requests are not interleaved with requests of other threads - a
+    // MULTI/EXEC transaction sent as a pipeline stays intact. Commands spanning several requests, e.g. a WATCH
+    // followed by a MULTI, need a Connection of their own.
+    // On a connection loss all outstanding requests fail - they may or may not have been executed - and the
+    // connection is reestablished with the next request. The reconnect, including the SELECT of the database, runs
+    // synchronously on the I/O thread, so all submissions wait for it.
+    // The synchronous commands must not be called on the I/O thread, e.g. from an asynchronous handler - they would wait
+    // for the thread they block. They fail with resource_deadlock_would_occur instead.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class SharedConnection
+    {
+    public:
+        static constexpr size_t DefaultQueueCapacity = 4096;
+        // maximum number of submissions sent with a single write
+        static constexpr size_t MaximumBatch = 512;
+        // Size of received data after which the receive buffers are replaced
+        static constexpr size_t RotationThreshold = 256 * 1024;
+        // checks of the completion flag or the queue before a thread blocks
+        static constexpr size_t SpinLimit = 128;
+
+    private:
+        using BufferContainerHandle = std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>;
+
+    public:
+        // result of a transmit - compatible with the result of Connection::transmit, so all command functions can be
+        // used with a SharedConnection. Keeps the received buffers alive.
+        class Reply
+        {
+        public:
+            Reply( std::shared_ptr<Response::ElementContainer> spResponses, BufferContainerHandle spBuffers ) :
+                spResponses_( std::move( spResponses ) ),
+                spBuffers_( std::move( spBuffers ) )
+            {}
+
+            const Response& top() const
+            {
+                static const Response NoResponse;
+                return spResponses_ && !spResponses_->empty() && spResponses_->front() ? *spResponses_->front() : NoResponse;
+            }
+
+        private:
+            std::shared_ptr<Response::ElementContainer> spResponses_;
+            BufferContainerHandle spBuffers_;
+        };
+
+    private:
+        // completion of a submission - on the stack of a synchronous caller or owned by the I/O thread for an
+        // asynchronous one
+        struct Completion
+        {
+            std::atomic<bool> Done_{ false };
+            // a synchronous caller blocks on Signal_ after spinning
+            std::mutex Mutex_;
+            std::condition_variable Signal_;
+            boost::system::error_code ec_;
+            std::shared_ptr<Response::ElementContainer> spResponses_;
+            BufferContainerHandle spBuffers_;
+            std::function<void( const boost::system::error_code& ec, const Reply& Data )> Handler_;
+        };
+
+        struct Submission
+        {
+            const Request::BufferSequence_t* pBuffers_ = nullptr;
+            size_t Responses_ = 0;
+            Completion* pCompletion_ = nullptr;
+        };
+
+        struct InFlight
+        {
+            Completion* pCompletion_;
+            size_t Expected_;
+            size_t Received_;
+            // buffers of responses received before the receive buffers were replaced
+            BufferContainerHandle spEarlierBuffers_;
+        };
+
+    public:
+        SharedConnection( const SharedConnection& ) = delete;
+        SharedConnection& operator=( const SharedConnection& ) = delete;
+
+        // uses an I/O thread of its own
+        SharedConnection( const ConnectionManagerType& Manager, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, size_t QueueCapacity = DefaultQueueCapacity ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink ),
+            Queue_( QueueCapacity ),
+            spOwnService_( std::make_unique<boost::asio::io_service>() ),
+            IOService_( *spOwnService_ ),
+            Socket_( IOService_ ),
+            spWork_( std::make_unique<boost::asio::io_service::work>( IOService_ ) )
+        {
+            Thread_ = std::thread( [this]() { IOService_.run(); } );
+        }
+
+        // runs on the thread of IOService, which has to be stopped before the connection is destroyed
+        SharedConnection( boost::asio::io_service& IOService, const ConnectionManagerType& Manager, int64_t Index = 0, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, size_t QueueCapacity = DefaultQueueCapacity ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            Index_( Index ),
+            NotificationSink_( NotificationSink ),
+            Queue_( QueueCapacity ),
+            IOService_( IOService ),
+            Socket_( IOService_ )
+        {}
+
+        // all submissions have to be completed - outstanding ones fail with operation_aborted
+        ~SharedConnection()
+        {
+            if( spOwnService_ )
+            {
+                IOService_.stop();
+                Thread_.join();
+            }
+
+            boost::system::error_code ec = boost::asio::error::operation_aborted;
+            failInFlight( ec );
+            failQueued( ec );
+        }
+
+        // thread safe - blocks until the response has been received
+        auto transmit( const Request& Command, boost::system::error_code& ec )
+        {
+            Completion Done;
+            Done.spResponses_ = std::make_shared<Response::ElementContainer>( 1 );
+            if( !onIOThread( ec ) )
+            {
+                submit( Command.bufferSequence(), 1, &Done );
+                wait( Done, ec );
+            }
+
+            return std::make_unique<Reply>( std::move( Done.spResponses_ ), std::move( Done.spBuffers_ ) );
+        }
+
+        // thread safe - the requests of the pipeline are written without any other requests in between
+        PipelineResult<NotificationSinkType_> transmit( const Pipeline& thePipeline, boost::system::error_code& ec )
+        {
+            Completion Done;
+            Done.spResponses_ = std::make_shared<Response::ElementContainer>( thePipeline.requestCount() );
+            if( thePipeline.requestCount() && !onIOThread( ec ) )
+            {
+                submit( thePipeline.bufferSequence(), thePipeline.requestCount(), &Done );
+                wait( Done, ec );
+            }
+
+            if( !Done.spBuffers_ )
+                Done.spBuffers_ = std::make_shared<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>();
+
+            return PipelineResult<NotificationSinkType_>( Done.spResponses_, Done.spBuffers_, NotificationSink_ );
+        }
+
+        // thread safe - the handler is called on the I/O thread, Command has to stay valid until then
+        template <class	CompletionToken>
+        auto async_command( const Request& Command, CompletionToken&& token )
+        {
+            using handler_type = typename boost::asio::handler_type<CompletionToken,
+                void( boost::system::error_code, const Response& Data )>::type;
+            handler_type handler( std::forward<decltype(token)>( token ) );
+            boost::asio::async_result<decltype(handler)> result( handler );
+
+            async_transmit( Command, [handler]( const boost::system::error_code& ec, const Reply& Data ) mutable { handler( ec, Data.top() ); } );
+
+            return result.get();
+        }
+
+        // thread safe - Handler( ec, const Reply& ) is called on the I/O thread, Command has to stay valid until then.
+        // The reply may be kept to use the response later, e.g. on another thread.
+        template <class HandlerT_>
+        void async_transmit( const Request& Command, HandlerT_&& Handler )
+        {
+            auto spCompletion = std::make_unique<Completion>();
+            spCompletion->spResponses_ = std::make_shared<Response::ElementContainer>( 1 );
+            spCompletion->Handler_ = std::forward<HandlerT_>( Handler );
+
+            // owned by the I/O thread from now on
+            submit( Command.bufferSequence(), 1, spCompletion.release() );
+        }
+
+        // last server error of any thread using the connection
+        std::string lastServerError() const
+        {
+            std::lock_guard<std::mutex> Lock( ServerErrorMutex_ );
+            return LastServerError_;
+        }
+        void setLastServerError( const std::string& LastServerError )
+        {
+            std::lock_guard<std::mutex> Lock( ServerErrorMutex_ );
+            LastServerError_ = LastServerError;
+        }
+
+        SharedConnectionStatistics statistics() const
+        {
+            SharedConnectionStatistics Result;
+            Result.Submissions = Submissions_.load( std::memory_order_relaxed );
+            Result.Writes = Writes_.load( std::memory_order_relaxed );
+            Result.Stalls = Stalls_.load( std::memory_order_relaxed );
+            Result.Reconnects = Reconnects_.load( std::memory_order_relaxed );
+            return Result;
+        }
+
+    private:
+        // called on the submitting threads
+
+        void submit( const Request::BufferSequence_t& Buffers, size_t Responses, Completion* pCompletion )
+        {
+            Submission Item{ &Buffers, Responses, pCompletion };
+
+            size_t Spins = 0;
+            while( !Queue_.push( std::move( Item ) ) )
+            {
+                if( ++Spins < SpinLimit )
+                    continue;
+
+                // the queue is full - wait for the I/O thread to take requests, see spaceAvailable
+                Stalls_.fetch_add( 1, std::memory_order_relaxed );
+                QueueWaiters_.fetch_add( 1 );
+                {
+                    std::unique_lock<std::mutex> Lock( QueueMutex_ );
+                    QueueSignal_.wait( Lock, [this, &Item]() { return Queue_.push( std::move( Item ) ); } );
+                }
+                QueueWaiters_.fetch_sub( 1 );
+                break;
+            }
+
+            Submissions_.fetch_add( 1, std::memory_order_relaxed );
+
+            // only the first submission after a drain wakes up the I/O thread
+            if( !DrainScheduled_.exchange( true ) )
+                IOService_.post( [this]() { drain(); } );
+        }
+
+        // a synchronous call on the I/O thread would never complete
+        bool onIOThread( boost::system::error_code& ec ) const
+        {
+            if( IOThread_.load( std::memory_order_relaxed ) != std::this_thread::get_id() )
+                return false;
+
+            ec = boost::system::errc::make_error_code( boost::system::errc::resource_deadlock_would_occur );
+            return true;
+        }
+
+        void wait( Completion& Done, boost::system::error_code& ec )
+        {
+            for( size_t Spins = 0; Spins < SpinLimit && !Done.Done_.load( std::memory_order_acquire ); ++Spins )
+                ;
+
+            // taken even if the flag is set already: the I/O thread releases the mutex as the last access to Done
+            std::unique_lock<std::mutex> Lock( Done.Mutex_ );
+            Done.Signal_.wait( Lock, [&Done]() { return Done.Done_.load( std::memory_order_acquire ); } );
+
+            ec = Done.ec_;
+        }
+
+        // following functions are called on the I/O thread
+
+        void drain()
+        {
+            IOThread_.store( std::this_thread::get_id(), std::memory_order_relaxed );
+
+            // submissions pushed from now on schedule another drain
+            DrainScheduled_.store( false );
+            write();
+        }
+
+        // writes all queued submissions with one write - a running write calls it again on completion
+        void write()
+        {
+            if( Writing_ )
+                return;
+
+            if( !Socket_.is_open() && !connect() )
+                return;
+
+            WriteBuffers_.clear();
+            Submission Item;
+            size_t Count = 0;
+            while( Count < MaximumBatch && Queue_.pop( Item ) )
+            {
+                WriteBuffers_.insert( WriteBuffers_.end(), Item.pBuffers_->begin(), Item.pBuffers_->end() );
+                InFlight_.push_back( InFlight{ Item.pCompletion_, Item.Responses_, 0 } );
+                ++Count;
+            }
+
+            if( !Count )
+                return;
+
+            spaceAvailable();
+
+            Writing_ = true;
+            Writes_.fetch_add( 1, std::memory_order_relaxed );
+
+            boost::asio::async_write( Socket_, WriteBuffers_, [this, Generation = Generation_]( const boost::system::error_code& ec, std::size_t BytesWritten ) {
+                Writing_ = false;
+                if( ec && Generation == Generation_ )
+                {
+                    NotificationSink_.warning( "SharedConnection::write: connection lost: {}", ec.message() );
+                    disconnect( ec );
+                }
+
+                REDISPP_NOTIFY( NotificationSink_, debug, "SharedConnection::write: sent {} bytes of data", BytesWritten );
+                write();
+            } );
+        }
+
+        // blocks the I/O thread - the SELECT is sent synchronously
+        bool connect()
+        {
+            boost::system::error_code ec;
+            auto Socket = ConnectionManagerInstance_.getConnectedSocket( IOService_, ec );
+            if( !ec && Index_ )
+            {
+                Detail::SocketConnectionManager scm( Socket );
+                Connection<Detail::SocketConnectionManager, NotificationSinkType_> CurrentConnection( IOService_, scm, 0, NotificationSink_ );
+
+                redis::select( CurrentConnection, ec, Index_ );
+                Socket = CurrentConnection.passSocket();
+            }
+
+            if( ec )
+            {
+                NotificationSink_.warning( "SharedConnection::connect: unable to connect: {}", ec.message() );
+                failQueued( ec );
+                return false;
+            }
+
+            REDISPP_NOTIFY( NotificationSink_, trace, "SharedConnection::connect: connected" );
+
+            Socket_ = std::move( Socket );
+            spResponse_ = std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+            BytesSinceRotation_ = 0;
+            receive();
+            return true;
+        }
+
+        void disconnect( const boost::system::error_code& ec )
+        {
+            boost::system::error_code ec2;
+            Socket_.close( ec2 );
+
+            // pending handlers of the old socket are ignored
+            ++Generation_;
+            Reconnects_.fetch_add( 1, std::memory_order_relaxed );
+            failInFlight( ec );
+        }
+
+        void receive()
+        {
+            Socket_.async_read_some( boost::asio::buffer( spResponse_->buffer() ), [this, Generation = Generation_]( const boost::system::error_code& ec, std::size_t BytesReceived ) {
+                if( Generation != Generation_ )
+                    return;
+
+                if( ec )
+                {
+                    NotificationSink_.warning( "SharedConnection::receive: connection lost: {}", ec.message() );
+                    disconnect( ec );
+
+                    // reconnect if requests are waiting
+                    write();
+                    return;
+                }
+
+                BytesSinceRotation_ += BytesReceived;
+
+                if( spResponse_->dataReceived( BytesReceived ) )
+                {
+                    do
+                    {
+                        deliver( spResponse_->spTop() );
+                    } while( spResponse_->commit( true ) );
+
+                    // replace the buffers - a partial response moves along, a partially answered submission keeps the
+                    // buffers of its earlier responses
+                    if( BytesSinceRotation_ >= RotationThreshold )
+                    {
+                        if( !InFlight_.empty() && InFlight_.front().Received_ )
+                            InFlight_.front().spEarlierBuffers_ = keepAlive( InFlight_.front().spEarlierBuffers_, spResponse_->bufferContainer() );
+
+                        auto spFresh = std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+                        spResponse_->moveTail( *spFresh );
+                        spResponse_ = std::move( spFresh );
+                        BytesSinceRotation_ = 0;
+                    }
+                }
+
+                receive();
+            } );
+        }
+
+        void deliver( std::shared_ptr<Response> spData )
+        {
+            if( InFlight_.empty() )
+            {
+                NotificationSink_.warning( "SharedConnection::deliver: unexpected response" );
+                return;
+            }
+
+            auto& Front = InFlight_.front();
+            (*Front.pCompletion_->spResponses_)[Front.Received_++] = std::move( spData );
+            if( Front.Received_ < Front.Expected_ )
+                return;
+
+            auto pCompletion = Front.pCompletion_;
+            pCompletion->spBuffers_ = keepAlive( Front.spEarlierBuffers_, spResponse_->bufferContainer() );
+            InFlight_.pop_front();
+            complete( pCompletion, boost::system::error_code() );
+        }
+
+        void complete( Completion* pCompletion, const boost::system::error_code& ec )
+        {
+            pCompletion->ec_ = ec;
+            if( !pCompletion->Handler_ )
+            {
+                // the synchronous caller owns the completion - it must not be touched after the mutex is released
+                std::lock_guard<std::mutex> Lock( pCompletion->Mutex_ );
+                pCompletion->Done_.store( true, std::memory_order_release );
+                pCompletion->Signal_.notify_one();
+                return;
+            }
+
+            std::unique_ptr<Completion> spCompletion( pCompletion );
+            spCompletion->Handler_( ec, Reply( spCompletion->spResponses_, spCompletion->spBuffers_ ) );
+        }
+
+        void failInFlight( const boost::system::error_code& ec )
+        {
+            while( !InFlight_.empty() )
+            {
+                auto pCompletion = InFlight_.front().pCompletion_;
+                InFlight_.pop_front();
+                complete( pCompletion, ec );
+            }
+        }
+
+        void failQueued( const boost::system::error_code& ec )
+        {
+            Submission Item;
+            while( Queue_.pop( Item ) )
+                complete( Item.pCompletion_, ec );
+
+            spaceAvailable();
+        }
+
+        // wakes up the submitters waiting for a full queue
+        void spaceAvailable()
+        {
+            // pairs with the increment of QueueWaiters_ before the push of a submitter
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if( !QueueWaiters_.load() )
+                return;
+
+            std::lock_guard<std::mutex> Lock( QueueMutex_ );
+            QueueSignal_.notify_all();
+        }
+
+        // returns a handle to Current, which keeps Earlier alive as well
+        static BufferContainerHandle keepAlive( const BufferContainerHandle& spEarlier, const BufferContainerHandle& spCurrent )
+        {
+            if( !spEarlier )
+                return spCurrent;
+
+            auto spBoth = std::make_shared<std::pair<BufferContainerHandle, BufferContainerHandle>>( spEarlier, spCurrent );
+            return BufferContainerHandle( spBoth, spCurrent.get() );
+        }
+
+        typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        int64_t Index_;
+        NotificationSinkType_ NotificationSink_;
+
+        MpscRing<Submission> Queue_;
+        std::atomic<bool> DrainScheduled_{ false };
+        // submitters waiting for a full queue
+        std::atomic<size_t> QueueWaiters_{ 0 };
+        std::mutex QueueMutex_;
+        std::condition_variable QueueSignal_;
+
+        std::atomic<uint64_t> Submissions_{ 0 };
+        std::atomic<uint64_t> Writes_{ 0 };
+        std::atomic<uint64_t> Stalls_{ 0 };
+        std::atomic<uint64_t> Reconnects_{ 0 };
+
+        mutable std::mutex ServerErrorMutex_;
+        std::string LastServerError_;
+
+        std::unique_ptr<boost::asio::io_service> spOwnService_;
+        boost::asio::io_service& IOService_;
+        boost::asio::ip::tcp::socket Socket_;
+        std::unique_ptr<boost::asio::io_service::work> spWork_;
+        std::unique_ptr<ResponseHandler<NotificationSinkType_>> spResponse_;
+        std::deque<InFlight> InFlight_;
+        Request::BufferSequence_t WriteBuffers_;
+        bool Writing_ = false;
+        size_t Generation_ = 0;
+        size_t BytesSinceRotation_ = 0;
+        // the thread running the handlers - set by each drain
+        std::atomic<std::thread::id> IOThread_{ std::thread::id() };
+        std::thread Thread_;
+    };
+}
+
+#endif
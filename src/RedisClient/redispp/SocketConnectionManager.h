@@ -11,32 +11,36 @@ namespace redis
 {
     namespace Detail
     {
-        class SocketConnectionManager
+        // Passes an already connected socket to a connection - SocketT_ is the transport, e.g. a TCP socket
+        template <class SocketT_>
+        class BasicSocketConnectionManager
         {
         public:
+            using SocketType = SocketT_;
+
             class Instance
             {
             public:
                 Instance( const Instance& ) = default;
                 Instance& operator=( const Instance& ) = delete;
 
-                Instance( boost::asio::ip::tcp::socket& Socket ) :
+                Instance( SocketType& Socket ) :
                     Socket_( Socket )
                 {}
 
-                boost::asio::ip::tcp::socket getConnectedSocket( boost::asio::io_service& io_service, boost::system::error_code& ec )
+                SocketType getConnectedSocket( boost::asio::io_service& io_service, boost::system::error_code& ec )
                 {
-                    return boost::asio::ip::tcp::socket( std::move( Socket_ ) );
+                    return SocketType( std::move( Socket_ ) );
                 }
 
             private:
-                boost::asio::ip::tcp::socket& Socket_;
+                SocketType& Socket_;
             };
 
-            SocketConnectionManager( const SocketConnectionManager& ) = delete;
-            SocketConnectionManager& operator=( const SocketConnectionManager& ) = delete;
+            BasicSocketConnectionManager( const BasicSocketConnectionManager& ) = delete;
+            BasicSocketConnectionManager& operator=( const BasicSocketConnectionManager& ) = delete;
 
-            SocketConnectionManager( boost::asio::ip::tcp::socket& Socket ) :
+            BasicSocketConnectionManager( SocketType& Socket ) :
                 Socket_( std::move( Socket ) )
             {}
 
@@ -45,7 +49,25 @@ namespace redis
                 return Instance( Socket_ );
             }
         private:
-            mutable boost::asio::ip::tcp::socket Socket_;
+            mutable SocketType Socket_;
+        };
+
+        using SocketConnectionManager = BasicSocketConnectionManager<boost::asio::ip::tcp::socket>;
+
+        template <class T_>
+        struct voidType { using type = void; };
+
+        // the transport of a connection manager - its SocketType if declared, a TCP socket otherwise
+        template <class ConnectionManagerT_, class = void>
+        struct socketType
+        {
+            using type = boost::asio::ip::tcp::socket;
+        };
+
+        template <class ConnectionManagerT_>
+        struct socketType<ConnectionManagerT_, typename voidType<typename ConnectionManagerT_::SocketType>::type>
+        {
+            using type = typename ConnectionManagerT_::SocketType;
         };
     }
 }
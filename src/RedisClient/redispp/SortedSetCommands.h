@@ -0,0 +1,220 @@
+#pragma once
+
+#ifndef REDISPP_SORTEDSET_COMMANDS_INCLUDED
+#define REDISPP_SORTEDSET_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Commands.h"
+
+#include <vector>
+#include <utility>
+#include <cstdio>
+
+namespace redis
+{
+    // Members with their scores - the members refer to the received data
+    using ScoredMembers = std::vector<std::pair<boost::asio::const_buffer, double>>;
+
+    namespace Detail
+    {
+        // formats a score, so it is read back unchanged
+        inline std::string scoreArgument( double Score )
+        {
+            char Buffer[32];
+#if defined(__cpp_lib_to_chars)
+            auto Result = std::to_chars( Buffer, Buffer + sizeof( Buffer ), Score );
+            return std::string( Buffer, Result.ptr );
+#else
+            auto Length = std::snprintf( Buffer, sizeof( Buffer ), "%.17g", Score );
+            return std::string( Buffer, Length > 0 ? static_cast<size_t>(Length) : 0 );
+#endif
+        }
+    }
+
+    // the flat member/score array of a WITHSCORES reply
+    inline ScoredMembers scoredMembersResult( const Response& Data, boost::system::error_code& ec )
+    {
+        ScoredMembers Result;
+        if( Data.type() != Response::Type::Array || Data.elements().size() % 2 )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.reserve( Data.elements().size() / 2 );
+        for( size_t Index = 0; Index < Data.elements().size(); Index += 2 )
+        {
+            const auto& Score = Data[Index + 1];
+            double Value;
+            if( !Detail::parseDouble( Score.data(), Score.size(), Value ) )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return ScoredMembers();
+            }
+
+            Result.emplace_back( Detail::responseBuffer( Data[Index] ), Value );
+        }
+
+        return Result;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   Z A D D
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_, class T2_>
+    Request zaddCommand( const T1_& Key, double Score, const T2_& Member )
+    {
+        Request r( "ZADD" );
+        r << Key << Detail::scoreArgument( Score ) << Member;
+        return r;
+    }
+
+    // returns the number of new members
+    template <class Connection, class T1_, class T2_>
+    auto zadd( Connection& con, boost::system::error_code& ec, const T1_& Key, double Score, const T2_& Member )
+    {
+        return Detail::sync_universal( con, ec, &zaddCommand<T1_, T2_>, &IntResult, std::ref(Key), Score, std::ref(Member) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_>
+    auto async_zadd( Connection& con, CompletionToken&& token, const T1_& Key, double Score, const T2_& Member )
+    {
+        return Detail::async_universal( con, token, &zaddCommand<T1_, T2_>, &IntResult, std::ref(Key), Score, std::ref(Member) );
+    }
+
+    // [First, Last) is a range of member/score pairs - the members are not copied
+    template <class T1_, class IteratorT_>
+    Request zaddMembersCommand( const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        Request r( "ZADD" );
+        r << Key;
+        for( ; First != Last; ++First )
+            r << Detail::scoreArgument( First->second ) << Detail::argumentBuffer( First->first );
+        return r;
+    }
+
+    template <class Connection, class T1_, class IteratorT_>
+    auto zaddMembers( Connection& con, boost::system::error_code& ec, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::sync_universal( con, ec, &zaddMembersCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class IteratorT_>
+    auto async_zaddMembers( Connection& con, CompletionToken&& token, const T1_& Key, IteratorT_ First, IteratorT_ Last )
+    {
+        return Detail::async_universal( con, token, &zaddMembersCommand<T1_, IteratorT_>, &IntResult, std::ref(Key), First, Last );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                 Z I N C R B Y
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    template <class T1_, class T2_>
+    Request zincrbyCommand( const T1_& Key, double Increment, const T2_& Member )
+    {
+        Request r( "ZINCRBY" );
+        r << Key << Detail::scoreArgument( Increment ) << Member;
+        return r;
+    }
+
+    // returns the new score
+    template <class Connection, class T1_, class T2_>
+    auto zincrby( Connection& con, boost::system::error_code& ec, const T1_& Key, double Increment, const T2_& Member )
+    {
+        return Detail::sync_universal( con, ec, &zincrbyCommand<T1_, T2_>, &DoubleResult, std::ref(Key), Increment, std::ref(Member) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_>
+    auto async_zincrby( Connection& con, CompletionToken&& token, const T1_& Key, double Increment, const T2_& Member )
+    {
+        return Detail::async_universal( con, token, &zincrbyCommand<T1_, T2_>, &DoubleResult, std::ref(Key), Increment, std::ref(Member) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                  Z R A N G E
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // members by rank - Start and Stop may be negative to count from the end
+    template <class T1_>
+    Request zrangeCommand( const T1_& Key, int64_t Start, int64_t Stop, bool WithScores )
+    {
+        Request r( "ZRANGE" );
+        r << Key << Start << Stop;
+        if( WithScores )
+            r << "WITHSCORES";
+        r.setReadOnly();
+        return r;
+    }
+
+    template <class Connection, class T1_>
+    auto zrange( Connection& con, boost::system::error_code& ec, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::sync_universal( con, ec, &zrangeCommand<T1_>, &BufferArrayResult, std::ref(Key), Start, Stop, false );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_zrange( Connection& con, CompletionToken&& token, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::async_universal( con, token, &zrangeCommand<T1_>, &BufferArrayResult, std::ref(Key), Start, Stop, false );
+    }
+
+    template <class Connection, class T1_>
+    auto zrangeWithScores( Connection& con, boost::system::error_code& ec, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::sync_universal( con, ec, &zrangeCommand<T1_>, &scoredMembersResult, std::ref(Key), Start, Stop, true );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_zrangeWithScores( Connection& con, CompletionToken&& token, const T1_& Key, int64_t Start, int64_t Stop )
+    {
+        return Detail::async_universal( con, token, &zrangeCommand<T1_>, &scoredMembersResult, std::ref(Key), Start, Stop, true );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                            Z R A N G E B Y S C O R E
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Minimum and Maximum are given as Redis expects them, e.g. "-inf", "(1.5" or "100".
+    // A negative Count returns all members from Offset on.
+    template <class T1_>
+    Request zrangebyscoreCommand( const T1_& Key, const std::string& Minimum, const std::string& Maximum, bool WithScores, int64_t Offset, int64_t Count )
+    {
+        Request r( "ZRANGEBYSCORE" );
+        r << Key << Minimum << Maximum;
+        if( WithScores )
+            r << "WITHSCORES";
+        if( Offset || Count >= 0 )
+            r << "LIMIT" << Offset << Count;
+        r.setReadOnly();
+        return r;
+    }
+
+    template <class Connection, class T1_>
+    auto zrangebyscore( Connection& con, boost::system::error_code& ec, const T1_& Key, const std::string& Minimum, const std::string& Maximum, int64_t Offset = 0, int64_t Count = -1 )
+    {
+        return Detail::sync_universal( con, ec, &zrangebyscoreCommand<T1_>, &BufferArrayResult, std::ref(Key), std::ref(Minimum), std::ref(Maximum), false, Offset, Count );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_zrangebyscore( Connection& con, CompletionToken&& token, const T1_& Key, const std::string& Minimum, const std::string& Maximum, int64_t Offset = 0, int64_t Count = -1 )
+    {
+        return Detail::async_universal( con, token, &zrangebyscoreCommand<T1_>, &BufferArrayResult, std::ref(Key), std::ref(Minimum), std::ref(Maximum), false, Offset, Count );
+    }
+
+    template <class Connection, class T1_>
+    auto zrangebyscoreWithScores( Connection& con, boost::system::error_code& ec, const T1_& Key, const std::string& Minimum, const std::string& Maximum, int64_t Offset = 0, int64_t Count = -1 )
+    {
+        return Detail::sync_universal( con, ec, &zrangebyscoreCommand<T1_>, &scoredMembersResult, std::ref(Key), std::ref(Minimum), std::ref(Maximum), true, Offset, Count );
+    }
+
+    template <class Connection, class CompletionToken, class T1_>
+    auto async_zrangebyscoreWithScores( Connection& con, CompletionToken&& token, const T1_& Key, const std::string& Minimum, const std::string& Maximum, int64_t Offset = 0, int64_t Count = -1 )
+    {
+        return Detail::async_universal( con, token, &zrangebyscoreCommand<T1_>, &scoredMembersResult, std::ref(Key), std::ref(Minimum), std::ref(Maximum), true, Offset, Count );
+    }
+}
+
+#endif
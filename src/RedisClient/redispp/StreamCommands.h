@@ -0,0 +1,393 @@
+#pragma once
+
+#ifndef REDISPP_STREAM_COMMANDS_INCLUDED
+#define REDISPP_STREAM_COMMANDS_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Commands.h"
+
+#include <vector>
+#include <utility>
+
+// The results of the stream commands refer to the received data with boost::asio::const_buffer objects - they stay
+// valid as long as the ResponseHandler returned together with the result
+
+namespace redis
+{
+    // A single entry of a stream
+    struct StreamEntry
+    {
+        boost::asio::const_buffer Id;
+        // field/value pairs in the order stored in the entry
+        std::vector<std::pair<boost::asio::const_buffer, boost::asio::const_buffer>> Fields;
+    };
+
+    // Entries read from one stream
+    struct StreamEntries
+    {
+        boost::asio::const_buffer Stream;
+        std::vector<StreamEntry> Entries;
+    };
+
+    namespace Detail
+    {
+        // entry: [ id, [ field, value, ... ] ]
+        inline bool decodeStreamEntry( const Response& Data, StreamEntry& Entry, boost::system::error_code& ec )
+        {
+            if( Data.type() != Response::Type::Array || Data.elements().size() != 2 || Data[0].type() != Response::Type::BulkString )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return false;
+            }
+
+            Entry.Id = responseBuffer( Data[0] );
+
+            const auto& Fields = Data[1];
+            // the fields of a deleted, but still pending entry are null
+            if( Fields.type() != Response::Type::Array )
+                return true;
+
+            Entry.Fields.reserve( Fields.elements().size() / 2 );
+            for( size_t Index = 0; Index + 1 < Fields.elements().size(); Index += 2 )
+                Entry.Fields.emplace_back( responseBuffer( Fields[Index] ), responseBuffer( Fields[Index + 1] ) );
+
+            return true;
+        }
+
+        inline std::vector<StreamEntry> decodeStreamEntries( const Response& Data, boost::system::error_code& ec )
+        {
+            std::vector<StreamEntry> Result;
+            if( Data.type() != Response::Type::Array )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return Result;
+            }
+
+            Result.reserve( Data.elements().size() );
+            for( const auto& spEntry : Data.elements() )
+            {
+                // entries deleted since they were delivered are returned as null by XAUTOCLAIM in Redis 6.2
+                if( spEntry->type() == Response::Type::Null )
+                    continue;
+
+                Result.emplace_back();
+                if( !decodeStreamEntry( *spEntry, Result.back(), ec ) )
+                    return std::vector<StreamEntry>();
+            }
+
+            return Result;
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   X A C K
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Ids is a container of entry ids - std::string or boost::asio::const_buffer
+    template <class T1_, class T2_, class IdContainerT_>
+    Request xackCommand( const T1_& Key, const T2_& Group, const IdContainerT_& Ids )
+    {
+        Request r( "XACK" );
+        r << Key << Group;
+        for( const auto& Id : Ids )
+            r << Id;
+        return r;
+    }
+
+    // returns the number of acknowledged entries
+    template <class Connection, class T1_, class T2_, class IdContainerT_>
+    auto xack( Connection& con, boost::system::error_code& ec, const T1_& Key, const T2_& Group, const IdContainerT_& Ids )
+    {
+        return Detail::sync_universal( con, ec, &xackCommand<T1_, T2_, IdContainerT_>, &IntResult, std::ref(Key), std::ref(Group), std::ref(Ids) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_, class IdContainerT_>
+    auto async_xack( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Group, const IdContainerT_& Ids )
+    {
+        return Detail::async_universal( con, token, &xackCommand<T1_, T2_, IdContainerT_>, &IntResult, std::ref(Key), std::ref(Group), std::ref(Ids) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   X A D D
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Fields is a container of field/value pairs. With MaximumLength, the stream is trimmed approximately (MAXLEN ~)
+    template <class T1_, class FieldContainerT_>
+    Request xaddCommand( const T1_& Key, const FieldContainerT_& Fields, const std::string& Id = "*", size_t MaximumLength = 0 )
+    {
+        Request r( "XADD" );
+        r << Key;
+        if( MaximumLength )
+            r << "MAXLEN" << "~" << static_cast<int64_t>(MaximumLength);
+        r << Id;
+        for( const auto& Field : Fields )
+            r << Field.first << Field.second;
+        return r;
+    }
+
+    // returns the id of the new entry
+    inline std::string xaddResult( const Response& Data, boost::system::error_code& ec )
+    {
+        if( Data.type() != Response::Type::BulkString )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return std::string();
+        }
+
+        return Data.string();
+    }
+
+    template <class Connection, class T1_, class FieldContainerT_>
+    auto xadd( Connection& con, boost::system::error_code& ec, const T1_& Key, const FieldContainerT_& Fields, const std::string& Id = "*", size_t MaximumLength = 0 )
+    {
+        return Detail::sync_universal( con, ec, &xaddCommand<T1_, FieldContainerT_>, &xaddResult, std::ref(Key), std::ref(Fields), std::ref(Id), MaximumLength );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class FieldContainerT_>
+    auto async_xadd( Connection& con, CompletionToken&& token, const T1_& Key, const FieldContainerT_& Fields, const std::string& Id = "*", size_t MaximumLength = 0 )
+    {
+        return Detail::async_universal( con, token, &xaddCommand<T1_, FieldContainerT_>, &xaddResult, std::ref(Key), std::ref(Fields), std::ref(Id), MaximumLength );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                              X A U T O C L A I M
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    struct XAutoclaimResult
+    {
+        // cursor for the next call - "0-0" when the pending entries list has been scanned completely
+        boost::asio::const_buffer NextStart;
+        std::vector<StreamEntry> Entries;
+    };
+
+    // claims up to Count entries of the group pending longer than MinimumIdleTime for Consumer, starting at Start
+    template <class T1_, class T2_, class T3_>
+    Request xautoclaimCommand( const T1_& Key, const T2_& Group, const T3_& Consumer, std::chrono::milliseconds MinimumIdleTime, const std::string& Start, size_t Count )
+    {
+        Request r( "XAUTOCLAIM" );
+        r << Key << Group << Consumer << MinimumIdleTime.count() << Start;
+        if( Count )
+            r << "COUNT" << static_cast<int64_t>(Count);
+        return r;
+    }
+
+    // reply: [ next start, [ entries ], [ deleted ids ] ] - the deleted ids (Redis 7) are ignored
+    inline XAutoclaimResult xautoclaimResult( const Response& Data, boost::system::error_code& ec )
+    {
+        XAutoclaimResult Result;
+        if( Data.type() != Response::Type::Array || Data.elements().size() < 2 )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.NextStart = Detail::responseBuffer( Data[0] );
+        Result.Entries = Detail::decodeStreamEntries( Data[1], ec );
+        return Result;
+    }
+
+    template <class Connection, class T1_, class T2_, class T3_>
+    auto xautoclaim( Connection& con, boost::system::error_code& ec, const T1_& Key, const T2_& Group, const T3_& Consumer, std::chrono::milliseconds MinimumIdleTime, const std::string& Start = "0-0", size_t Count = 0 )
+    {
+        return Detail::sync_universal( con, ec, &xautoclaimCommand<T1_, T2_, T3_>, &xautoclaimResult, std::ref(Key), std::ref(Group), std::ref(Consumer), MinimumIdleTime, std::ref(Start), Count );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_, class T3_>
+    auto async_xautoclaim( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Group, const T3_& Consumer, std::chrono::milliseconds MinimumIdleTime, const std::string& Start = "0-0", size_t Count = 0 )
+    {
+        return Detail::async_universal( con, token, &xautoclaimCommand<T1_, T2_, T3_>, &xautoclaimResult, std::ref(Key), std::ref(Group), std::ref(Consumer), MinimumIdleTime, std::ref(Start), Count );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                               X P E N D I N G
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Summary of the pending entries of a group
+    struct XPendingSummary
+    {
+        int64_t Count = 0;
+        boost::asio::const_buffer SmallestId;
+        boost::asio::const_buffer GreatestId;
+        // consumers with pending entries and their number of pending entries
+        std::vector<std::pair<boost::asio::const_buffer, int64_t>> Consumers;
+    };
+
+    // A single pending entry
+    struct XPendingEntry
+    {
+        boost::asio::const_buffer Id;
+        boost::asio::const_buffer Consumer;
+        std::chrono::milliseconds IdleTime;
+        int64_t Deliveries;
+    };
+
+    template <class T1_, class T2_>
+    Request xpendingCommand( const T1_& Key, const T2_& Group )
+    {
+        Request r( "XPENDING" );
+        r << Key << Group;
+        r.setReadOnly();
+        return r;
+    }
+
+    // reply: [ count, smallest id, greatest id, [ [ consumer, count ], ... ] ]
+    inline XPendingSummary xpendingResult( const Response& Data, boost::system::error_code& ec )
+    {
+        XPendingSummary Result;
+        if( Data.type() != Response::Type::Array || Data.elements().size() != 4 || Data[0].type() != Response::Type::Integer )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.Count = Data[0].asint();
+        Result.SmallestId = Detail::responseBuffer( Data[1] );
+        Result.GreatestId = Detail::responseBuffer( Data[2] );
+        if( Data[3].type() == Response::Type::Array )
+        {
+            for( const auto& spConsumer : Data[3].elements() )
+            {
+                if( spConsumer->type() != Response::Type::Array || spConsumer->elements().size() != 2 )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                    return XPendingSummary();
+                }
+                // the count is sent as a bulk string
+                Result.Consumers.emplace_back( Detail::responseBuffer( (*spConsumer)[0] ), (*spConsumer)[1].asint() );
+            }
+        }
+
+        return Result;
+    }
+
+    template <class Connection, class T1_, class T2_>
+    auto xpending( Connection& con, boost::system::error_code& ec, const T1_& Key, const T2_& Group )
+    {
+        return Detail::sync_universal( con, ec, &xpendingCommand<T1_, T2_>, &xpendingResult, std::ref(Key), std::ref(Group) );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_>
+    auto async_xpending( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Group )
+    {
+        return Detail::async_universal( con, token, &xpendingCommand<T1_, T2_>, &xpendingResult, std::ref(Key), std::ref(Group) );
+    }
+
+    // Extended form: up to Count pending entries between Start and End, idle for at least MinimumIdleTime -
+    // only those of Consumer, if it is not empty
+    template <class T1_, class T2_>
+    Request xpendingRangeCommand( const T1_& Key, const T2_& Group, const std::string& Start, const std::string& End, size_t Count, const std::string& Consumer, std::chrono::milliseconds MinimumIdleTime )
+    {
+        Request r( "XPENDING" );
+        r << Key << Group;
+        if( MinimumIdleTime.count() > 0 )
+            r << "IDLE" << MinimumIdleTime.count();
+        r << Start << End << static_cast<int64_t>(Count);
+        if( !Consumer.empty() )
+            r << Consumer;
+        r.setReadOnly();
+        return r;
+    }
+
+    // reply: [ [ id, consumer, idle time, deliveries ], ... ]
+    inline std::vector<XPendingEntry> xpendingRangeResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<XPendingEntry> Result;
+        if( Data.type() != Response::Type::Array )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.reserve( Data.elements().size() );
+        for( const auto& spEntry : Data.elements() )
+        {
+            const auto& Entry = *spEntry;
+            if( Entry.type() != Response::Type::Array || Entry.elements().size() != 4 || Entry[2].type() != Response::Type::Integer || Entry[3].type() != Response::Type::Integer )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return std::vector<XPendingEntry>();
+            }
+
+            Result.push_back( XPendingEntry{ Detail::responseBuffer( Entry[0] ), Detail::responseBuffer( Entry[1] ), std::chrono::milliseconds( Entry[2].asint() ), Entry[3].asint() } );
+        }
+
+        return Result;
+    }
+
+    template <class Connection, class T1_, class T2_>
+    auto xpendingRange( Connection& con, boost::system::error_code& ec, const T1_& Key, const T2_& Group, const std::string& Start, const std::string& End, size_t Count, const std::string& Consumer = std::string(), std::chrono::milliseconds MinimumIdleTime = std::chrono::milliseconds::zero() )
+    {
+        return Detail::sync_universal( con, ec, &xpendingRangeCommand<T1_, T2_>, &xpendingRangeResult, std::ref(Key), std::ref(Group), std::ref(Start), std::ref(End), Count, std::ref(Consumer), MinimumIdleTime );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_>
+    auto async_xpendingRange( Connection& con, CompletionToken&& token, const T1_& Key, const T2_& Group, const std::string& Start, const std::string& End, size_t Count, const std::string& Consumer = std::string(), std::chrono::milliseconds MinimumIdleTime = std::chrono::milliseconds::zero() )
+    {
+        return Detail::async_universal( con, token, &xpendingRangeCommand<T1_, T2_>, &xpendingRangeResult, std::ref(Key), std::ref(Group), std::ref(Start), std::ref(End), Count, std::ref(Consumer), MinimumIdleTime );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                              X R E A D G R O U P
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Reads up to Count entries of the stream Key after Id (">": entries never delivered to the group) for Consumer.
+    // With a non negative BlockTime the server waits up to BlockTime for new entries (0: forever).
+    template <class T1_, class T2_, class T3_>
+    Request xreadgroupCommand( const T1_& Group, const T2_& Consumer, const T3_& Key, const std::string& Id = ">", size_t Count = 0, std::chrono::milliseconds BlockTime = std::chrono::milliseconds( -1 ) )
+    {
+        Request r( "XREADGROUP", "GROUP" );
+        r << Group << Consumer;
+        if( Count )
+            r << "COUNT" << static_cast<int64_t>(Count);
+        if( BlockTime.count() >= 0 )
+            r << "BLOCK" << BlockTime.count();
+        r << "STREAMS" << Key << Id;
+        return r;
+    }
+
+    // reply: [ [ stream, [ entries ] ], ... ] - null if the BLOCK time elapsed without data
+    inline std::vector<StreamEntries> xreadgroupResult( const Response& Data, boost::system::error_code& ec )
+    {
+        std::vector<StreamEntries> Result;
+        if( Data.type() == Response::Type::Null )
+            return Result;
+
+        if( Data.type() != Response::Type::Array )
+        {
+            ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+            return Result;
+        }
+
+        Result.reserve( Data.elements().size() );
+        for( const auto& spStream : Data.elements() )
+        {
+            if( spStream->type() != Response::Type::Array || spStream->elements().size() != 2 )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                return std::vector<StreamEntries>();
+            }
+
+            Result.push_back( StreamEntries{ Detail::responseBuffer( (*spStream)[0] ), Detail::decodeStreamEntries( (*spStream)[1], ec ) } );
+            if( ec )
+                return std::vector<StreamEntries>();
+        }
+
+        return Result;
+    }
+
+    template <class Connection, class T1_, class T2_, class T3_>
+    auto xreadgroup( Connection& con, boost::system::error_code& ec, const T1_& Group, const T2_& Consumer, const T3_& Key, const std::string& Id = ">", size_t Count = 0, std::chrono::milliseconds BlockTime = std::chrono::milliseconds( -1 ) )
+    {
+        return Detail::sync_universal( con, ec, &xreadgroupCommand<T1_, T2_, T3_>, &xreadgroupResult, std::ref(Group), std::ref(Consumer), std::ref(Key), std::ref(Id), Count, BlockTime );
+    }
+
+    template <class Connection, class CompletionToken, class T1_, class T2_, class T3_>
+    auto async_xreadgroup( Connection& con, CompletionToken&& token, const T1_& Group, const T2_& Consumer, const T3_& Key, const std::string& Id = ">", size_t Count = 0, std::chrono::milliseconds BlockTime = std::chrono::milliseconds( -1 ) )
+    {
+        return Detail::async_universal( con, token, &xreadgroupCommand<T1_, T2_, T3_>, &xreadgroupResult, std::ref(Group), std::ref(Consumer), std::ref(Key), std::ref(Id), Count, BlockTime );
+    }
+}
+
+#endif
@@ -0,0 +1,321 @@
+#pragma once
+
+#ifndef REDISPP_STREAMWORKER_INCLUDED
+#define REDISPP_STREAMWORKER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "redispp/Connection.h"
+#include "redispp/StreamCommands.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    struct StreamWorkerOptions
+    {
+        // maximum number of entries fetched with one XREADGROUP/XAUTOCLAIM
+        size_t BatchSize = 100;
+        // time the server waits for new entries before the worker looks around (claiming, stopping)
+        std::chrono::milliseconds BlockTime = std::chrono::seconds( 2 );
+        size_t Threads = 4;
+        // entries pending longer than this are claimed - has to exceed the processing time of an entry
+        std::chrono::milliseconds ClaimIdleTime = std::chrono::seconds( 60 );
+        // pause between two scans of the pending entries list
+        std::chrono::milliseconds ClaimInterval = std::chrono::seconds( 10 );
+        // number of batches processed while the next one is fetched
+        size_t BatchesInFlight = 2;
+        // pause after a failed fetch
+        std::chrono::milliseconds RetryDelay = std::chrono::seconds( 1 );
+    };
+
+    // Counters of a StreamWorker
+    struct StreamWorkerStatistics
+    {
+        uint64_t Fetched = 0;
+        uint64_t Claimed = 0;
+        uint64_t Processed = 0;
+        // entries the handler rejected or threw on - they stay pending and are claimed again later
+        uint64_t Failed = 0;
+        uint64_t Acknowledged = 0;
+    };
+
+    // Consumer of a consumer group of a stream. A fetch thread reads batches of new entries with XREADGROUP and hands
+    // them to a thread pool. Entries are not copied: the handler gets views into the received data, kept alive until
+    // the last entry of the batch has been handled. The ids of handled entries are collected and acknowledged with an
+    // XACK pipelined in front of the next fetch, so acknowledging does not cost a round trip of its own.
+    // Every ClaimInterval the pending entries list is scanned with XAUTOCLAIM and entries idle for ClaimIdleTime -
+    // left over by crashed consumers or failed handlers - are processed again by this worker.
+    // The group has to exist (XGROUP CREATE). Entries are handled at least once - handlers should be idempotent.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class StreamWorker
+    {
+    public:
+        // returns true if the entry has been handled and should be acknowledged
+        using EntryHandlerType = std::function<bool( const StreamEntry& Entry )>;
+
+        StreamWorker( const StreamWorker& ) = delete;
+        StreamWorker& operator=( const StreamWorker& ) = delete;
+
+        StreamWorker( const ConnectionManagerType& Manager, const std::string& Stream, const std::string& Group, const std::string& Consumer, EntryHandlerType Handler, const StreamWorkerOptions& Options = StreamWorkerOptions{}, NotificationSinkType_ NotificationSink = NotificationSinkType_{} ) :
+            Stream_( Stream ),
+            Group_( Group ),
+            Consumer_( Consumer ),
+            Handler_( std::move( Handler ) ),
+            Options_( Options ),
+            NotificationSink_( NotificationSink ),
+            Connection_( ConnectionService_, Manager, 0, NotificationSink ),
+            spWork_( std::make_unique<boost::asio::io_service::work>( Pool_ ) )
+        {
+            for( size_t Index = 0; Index < std::max( Options_.Threads, size_t( 1 ) ); ++Index )
+                PoolThreads_.emplace_back( [this]() { Pool_.run(); } );
+
+            FetchThread_ = std::thread( [this]() { fetch(); } );
+        }
+
+        // Stops fetching - which may take up to BlockTime - handles the entries already fetched and acknowledges them
+        ~StreamWorker()
+        {
+            Stop_.store( true );
+            {
+                std::lock_guard<std::mutex> Lock( InFlightMutex_ );
+                InFlightChanged_.notify_all();
+            }
+            FetchThread_.join();
+
+            spWork_.reset();
+            for( auto& Thread : PoolThreads_ )
+                Thread.join();
+
+            auto Acks = takeAcks();
+            if( !Acks.empty() )
+            {
+                boost::system::error_code ec;
+                auto Result = xack( Connection_, ec, Stream_, Group_, Acks );
+                if( ec || Result.first->top().type() == Response::Type::Error )
+                    NotificationSink_.warning( "StreamWorker::~StreamWorker: failed to acknowledge {} entries", Acks.size() );
+            }
+        }
+
+        StreamWorkerStatistics statistics() const
+        {
+            StreamWorkerStatistics Result;
+            Result.Fetched = Fetched_.load( std::memory_order_relaxed );
+            Result.Claimed = Claimed_.load( std::memory_order_relaxed );
+            Result.Processed = Processed_.load( std::memory_order_relaxed );
+            Result.Failed = Failed_.load( std::memory_order_relaxed );
+            Result.Acknowledged = Acknowledged_.load( std::memory_order_relaxed );
+            return Result;
+        }
+
+    private:
+        // Entries of one fetch - they refer to the buffers of the pipeline result
+        struct Batch
+        {
+            Batch( PipelineResult<NotificationSinkType_>&& Result, std::vector<StreamEntry>&& Entries ) :
+                Result_( std::move( Result ) ),
+                Entries_( std::move( Entries ) ),
+                Remaining_( Entries_.size() )
+            {}
+
+            PipelineResult<NotificationSinkType_> Result_;
+            std::vector<StreamEntry> Entries_;
+            std::atomic<size_t> Remaining_;
+        };
+
+        void fetch()
+        {
+            std::string ClaimStart( "0-0" );
+            // claim right away - entries of a previous run of this consumer may be pending
+            auto NextClaim = std::chrono::steady_clock::now();
+
+            while( waitForBatchSlot() )
+            {
+                auto Acks = takeAcks();
+                bool Claiming = std::chrono::steady_clock::now() >= NextClaim;
+
+                Pipeline Requests;
+                if( !Acks.empty() )
+                    Requests << xackCommand( Stream_, Group_, Acks );
+                if( Claiming )
+                    Requests << xautoclaimCommand( Stream_, Group_, Consumer_, Options_.ClaimIdleTime, ClaimStart, Options_.BatchSize );
+                else
+                    Requests << xreadgroupCommand( Group_, Consumer_, Stream_, ">", Options_.BatchSize, Options_.BlockTime );
+
+                boost::system::error_code ec;
+                auto Result = Connection_.transmit( Requests, ec );
+                if( ec )
+                {
+                    NotificationSink_.warning( "StreamWorker::fetch: transmission failed '{}'", ec.message() );
+                    returnAcks( std::move( Acks ) );
+                    std::this_thread::sleep_for( Options_.RetryDelay );
+                    continue;
+                }
+
+                if( !Acks.empty() )
+                {
+                    if( Result[0].type() == Response::Type::Error )
+                    {
+                        NotificationSink_.warning( "StreamWorker::fetch: XACK failed '{}'", Result[0].string() );
+                        returnAcks( std::move( Acks ) );
+                    }
+                    else
+                        Acknowledged_.fetch_add( Acks.size(), std::memory_order_relaxed );
+                }
+
+                const auto& Data = Result[Requests.requestCount() - 1];
+                if( Data.type() == Response::Type::Error )
+                {
+                    NotificationSink_.error( "StreamWorker::fetch: fetching entries failed '{}'", Data.string() );
+                    std::this_thread::sleep_for( Options_.RetryDelay );
+                    continue;
+                }
+
+                std::vector<StreamEntry> Entries;
+                if( Claiming )
+                {
+                    auto Claimed = xautoclaimResult( Data, ec );
+                    if( !ec )
+                    {
+                        ClaimStart.assign( boost::asio::buffer_cast<const char*>(Claimed.NextStart), boost::asio::buffer_size( Claimed.NextStart ) );
+                        // the scan of the pending entries list is complete
+                        if( ClaimStart == "0-0" )
+                            NextClaim = std::chrono::steady_clock::now() + Options_.ClaimInterval;
+
+                        Claimed_.fetch_add( Claimed.Entries.size(), std::memory_order_relaxed );
+                        Entries = std::move( Claimed.Entries );
+                    }
+                }
+                else
+                {
+                    auto Streams = xreadgroupResult( Data, ec );
+                    for( auto& TheStream : Streams )
+                    {
+                        Fetched_.fetch_add( TheStream.Entries.size(), std::memory_order_relaxed );
+                        if( Entries.empty() )
+                            Entries = std::move( TheStream.Entries );
+                        else
+                            Entries.insert( Entries.end(), TheStream.Entries.begin(), TheStream.Entries.end() );
+                    }
+                }
+
+                if( ec )
+                {
+                    NotificationSink_.error( "StreamWorker::fetch: unexpected reply '{}'", ec.message() );
+                    std::this_thread::sleep_for( Options_.RetryDelay );
+                    continue;
+                }
+
+                dispatch( std::make_shared<Batch>( std::move( Result ), std::move( Entries ) ) );
+            }
+        }
+
+        // waits until fewer than BatchesInFlight batches are being processed - returns false when stopping
+        bool waitForBatchSlot()
+        {
+            std::unique_lock<std::mutex> Lock( InFlightMutex_ );
+            InFlightChanged_.wait( Lock, [this]() { return Stop_.load() || InFlight_ < std::max( Options_.BatchesInFlight, size_t( 1 ) ); } );
+            return !Stop_.load();
+        }
+
+        void dispatch( const std::shared_ptr<Batch>& spBatch )
+        {
+            if( spBatch->Entries_.empty() )
+                return;
+
+            {
+                std::lock_guard<std::mutex> Lock( InFlightMutex_ );
+                ++InFlight_;
+            }
+
+            for( size_t Index = 0; Index < spBatch->Entries_.size(); ++Index )
+                Pool_.post( [this, spBatch, Index]() { process( *spBatch, spBatch->Entries_[Index] ); } );
+        }
+
+        // called on a pool thread
+        void process( Batch& TheBatch, const StreamEntry& Entry )
+        {
+            bool Acknowledge = false;
+            try
+            {
+                Acknowledge = Handler_( Entry );
+            }
+            catch( const std::exception& e )
+            {
+                NotificationSink_.warning( "StreamWorker::process: handler failed '{}'", e.what() );
+            }
+
+            if( Acknowledge )
+            {
+                Processed_.fetch_add( 1, std::memory_order_relaxed );
+                std::lock_guard<std::mutex> Lock( AckMutex_ );
+                Acks_.emplace_back( boost::asio::buffer_cast<const char*>(Entry.Id), boost::asio::buffer_size( Entry.Id ) );
+            }
+            else
+                Failed_.fetch_add( 1, std::memory_order_relaxed );
+
+            if( TheBatch.Remaining_.fetch_sub( 1 ) == 1 )
+            {
+                std::lock_guard<std::mutex> Lock( InFlightMutex_ );
+                --InFlight_;
+                InFlightChanged_.notify_all();
+            }
+        }
+
+        std::vector<std::string> takeAcks()
+        {
+            std::vector<std::string> Result;
+            std::lock_guard<std::mutex> Lock( AckMutex_ );
+            Result.swap( Acks_ );
+            return Result;
+        }
+
+        // puts back ids whose XACK failed - they are sent again with the next fetch
+        void returnAcks( std::vector<std::string>&& Acks )
+        {
+            std::lock_guard<std::mutex> Lock( AckMutex_ );
+            Acks_.insert( Acks_.end(), std::make_move_iterator( Acks.begin() ), std::make_move_iterator( Acks.end() ) );
+        }
+
+        const std::string Stream_;
+        const std::string Group_;
+        const std::string Consumer_;
+        EntryHandlerType Handler_;
+        const StreamWorkerOptions Options_;
+        NotificationSinkType_ NotificationSink_;
+
+        // used by the fetch thread only - the connection is used synchronously
+        boost::asio::io_service ConnectionService_;
+        Connection<ConnectionManagerType, NotificationSinkType_> Connection_;
+
+        boost::asio::io_service Pool_;
+        std::unique_ptr<boost::asio::io_service::work> spWork_;
+        std::vector<std::thread> PoolThreads_;
+        std::thread FetchThread_;
+        std::atomic<bool> Stop_{ false };
+
+        std::mutex InFlightMutex_;
+        std::condition_variable InFlightChanged_;
+        size_t InFlight_ = 0;
+
+        std::mutex AckMutex_;
+        std::vector<std::string> Acks_;
+
+        std::atomic<uint64_t> Fetched_{ 0 };
+        std::atomic<uint64_t> Claimed_{ 0 };
+        std::atomic<uint64_t> Processed_{ 0 };
+        std::atomic<uint64_t> Failed_{ 0 };
+        std::atomic<uint64_t> Acknowledged_{ 0 };
+    };
+}
+
+#endif
@@ -0,0 +1,405 @@
+#pragma once
+
+#ifndef REDISPP_SUBSCRIBER_INCLUDED
+#define REDISPP_SUBSCRIBER_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include <boost/utility/string_view.hpp>
+#include <boost/asio/deadline_timer.hpp>
+
+#include "redispp/Connection.h"
+#include "redispp/LockFreeQueue.h"
+#include "redispp/KeyHash.h"
+#include "redispp/Error.h"
+
+namespace redis
+{
+    // A message received by a Subscriber. The buffers refer directly to the received data and stay valid
+    // until the message handler returns.
+    struct SubscriberMessage
+    {
+        boost::asio::const_buffer Channel;
+        // the matching pattern of a PSUBSCRIBE - empty for a SUBSCRIBE
+        boost::asio::const_buffer Pattern;
+        boost::asio::const_buffer Payload;
+    };
+
+    // Counters of a Subscriber
+    struct SubscriberStatistics
+    {
+        uint64_t Received = 0;
+        uint64_t Dispatched = 0;
+        // messages without a handler - e.g. received while an UNSUBSCRIBE was in flight
+        uint64_t Unrouted = 0;
+        // number of times the receive thread had to wait for a full consumer queue
+        uint64_t Stalls = 0;
+        uint64_t Reconnects = 0;
+    };
+
+    // Dedicated connection in subscribed state (SUBSCRIBE/PSUBSCRIBE). A receive thread parses the message frames
+    // and routes them through a channel/pattern table to consumer threads, handing them over with lock free single
+    // producer/single consumer rings. Messages are not copied: handlers get views into the receive buffers, which are
+    // leased to the queued messages and replaced once they have grown beyond RotationThreshold - a partially received
+    // message is moved to the new buffers. All messages of a channel are handled by the same consumer thread, in order.
+    // After a connection loss - or a failover, depending on the connection manager - the connection is reestablished
+    // and all subscriptions are renewed. Messages published in the meantime are lost, as always with Pub/Sub.
+    // The routing table is immutable: (un)subscribing publishes a modified copy, so the receive thread routes
+    // without taking a lock.
+    template<class ConnectionManagerType, class NotificationSinkType_=NullNotificationSink>
+    class Subscriber
+    {
+    public:
+        using MessageHandlerType = std::function<void( const SubscriberMessage& Message )>;
+
+        static constexpr size_t DefaultQueueCapacity = 65536;
+        // Size of received data after which the receive buffers are replaced
+        static constexpr size_t RotationThreshold = 256 * 1024;
+
+        Subscriber( const Subscriber& ) = delete;
+        Subscriber& operator=( const Subscriber& ) = delete;
+
+        Subscriber( const ConnectionManagerType& Manager, size_t ConsumerThreads = 1, NotificationSinkType_ NotificationSink = NotificationSinkType_{}, size_t QueueCapacity = DefaultQueueCapacity ) :
+            ConnectionManagerInstance_( Manager.getInstance() ),
+            NotificationSink_( NotificationSink ),
+            Socket_( ReceiveService_ ),
+            ReconnectTimer_( ReceiveService_ ),
+            Work_( ReceiveService_ )
+        {
+            for( size_t Index = 0; Index < std::max( ConsumerThreads, size_t( 1 ) ); ++Index )
+                Consumers_.push_back( std::make_unique<Consumer>( QueueCapacity ) );
+            for( auto& spConsumer : Consumers_ )
+                spConsumer->Thread_ = std::thread( [this, pConsumer = spConsumer.get()]() { consume( *pConsumer ); } );
+
+            ReceiveService_.post( [this]() { connect(); } );
+            ReceiveThread_ = std::thread( [this]() { ReceiveService_.run(); } );
+        }
+
+        ~Subscriber()
+        {
+            Stop_.store( true );
+            ReceiveService_.stop();
+            ReceiveThread_.join();
+
+            for( auto& spConsumer : Consumers_ )
+                spConsumer->Thread_.join();
+        }
+
+        // Handler is called on a consumer thread for every message published to Channel
+        void subscribe( const std::string& Channel, MessageHandlerType Handler )
+        {
+            addRoute( &Routes::Channels_, "SUBSCRIBE", Channel, std::move( Handler ) );
+        }
+
+        // Handler is called on a consumer thread for every message published to a channel matching Pattern
+        void psubscribe( const std::string& Pattern, MessageHandlerType Handler )
+        {
+            addRoute( &Routes::Patterns_, "PSUBSCRIBE", Pattern, std::move( Handler ) );
+        }
+
+        // removes all handlers of Channel
+        void unsubscribe( const std::string& Channel )
+        {
+            removeRoutes( &Routes::Channels_, "UNSUBSCRIBE", Channel );
+        }
+
+        // removes all handlers of Pattern
+        void punsubscribe( const std::string& Pattern )
+        {
+            removeRoutes( &Routes::Patterns_, "PUNSUBSCRIBE", Pattern );
+        }
+
+        SubscriberStatistics statistics() const
+        {
+            SubscriberStatistics Result;
+            Result.Received = Received_.load( std::memory_order_relaxed );
+            Result.Dispatched = Dispatched_.load( std::memory_order_relaxed );
+            Result.Unrouted = Unrouted_.load( std::memory_order_relaxed );
+            Result.Stalls = Stalls_.load( std::memory_order_relaxed );
+            Result.Reconnects = Reconnects_.load( std::memory_order_relaxed );
+            return Result;
+        }
+
+    private:
+        using BufferContainerHandle = std::shared_ptr<typename ResponseHandler<NotificationSinkType_>::BufferContainerType>;
+
+        // A message on its way to a consumer - the buffer container is leased until the handler returns
+        struct Delivery
+        {
+            SubscriberMessage Message_;
+            std::shared_ptr<const MessageHandlerType> spHandler_;
+            BufferContainerHandle spBuffers_;
+        };
+
+        struct Consumer
+        {
+            Consumer( size_t QueueCapacity ) :
+                Queue_( QueueCapacity )
+            {}
+
+            SpscRing<Delivery> Queue_;
+            std::thread Thread_;
+        };
+
+        // routing table: channel or pattern to handlers - compared with string views, so a lookup does not allocate
+        using RouteTable = std::map<std::string, std::vector<std::shared_ptr<const MessageHandlerType>>, std::less<>>;
+
+        struct Routes
+        {
+            RouteTable Channels_;
+            RouteTable Patterns_;
+        };
+        using RoutesHandle = std::shared_ptr<const Routes>;
+
+        RoutesHandle routes() const
+        {
+            return std::atomic_load_explicit( &spRoutes_, std::memory_order_acquire );
+        }
+
+        // copies the current routes, lets Modify change the copy and publishes it - false if nothing was changed
+        template <class ModifyT_>
+        bool updateRoutes( ModifyT_ Modify )
+        {
+            std::lock_guard<std::mutex> TheLock( RoutesMutex_ );
+            auto spModified = std::make_shared<Routes>( *routes() );
+            if( !Modify( *spModified ) )
+                return false;
+
+            std::atomic_store_explicit( &spRoutes_, RoutesHandle( std::move( spModified ) ), std::memory_order_release );
+            return true;
+        }
+
+        void addRoute( RouteTable Routes::*pTable, const char* pCommand, const std::string& Name, MessageHandlerType Handler )
+        {
+            bool NewName = false;
+            updateRoutes( [&]( Routes& Modified ) {
+                auto& Handlers = (Modified.*pTable)[Name];
+                NewName = Handlers.empty();
+                Handlers.push_back( std::make_shared<const MessageHandlerType>( std::move( Handler ) ) );
+                return true;
+            } );
+
+            if( NewName )
+                ReceiveService_.post( [this, pCommand, Name]() { sendCommand( Request( pCommand, Name ) ); } );
+        }
+
+        void removeRoutes( RouteTable Routes::*pTable, const char* pCommand, const std::string& Name )
+        {
+            if( !updateRoutes( [&]( Routes& Modified ) { return (Modified.*pTable).erase( Name ) != 0; } ) )
+                return;
+
+            ReceiveService_.post( [this, pCommand, Name]() { sendCommand( Request( pCommand, Name ) ); } );
+        }
+
+        // following functions are called on the receive thread
+
+        void sendCommand( const Request& Command )
+        {
+            if( !Connected_ )
+                return;
+
+            // a failed write also fails the pending read, which reconnects and renews all subscriptions
+            boost::system::error_code ec;
+            boost::asio::write( Socket_, Command.bufferSequence(), ec );
+            if( ec )
+                NotificationSink_.warning( "Subscriber::sendCommand: {}", ec.message() );
+        }
+
+        void connect()
+        {
+            boost::system::error_code ec;
+            Socket_ = ConnectionManagerInstance_.getConnectedSocket( ReceiveService_, ec );
+            if( ec )
+            {
+                NotificationSink_.warning( "Subscriber::connect: unable to connect: {}", ec.message() );
+
+                ReconnectTimer_.expires_from_now( boost::posix_time::seconds( 1 ) );
+                ReconnectTimer_.async_wait( [this]( const boost::system::error_code& ec ) {
+                    if( !ec )
+                        connect();
+                } );
+                return;
+            }
+
+            // renew all subscriptions with a single write - the confirmations are skipped by the receive loop
+            Pipeline Subscriptions;
+            auto spRoutes = routes();
+            for( const auto& Route : spRoutes->Channels_ )
+                Subscriptions << Request( "SUBSCRIBE", Route.first );
+            for( const auto& Route : spRoutes->Patterns_ )
+                Subscriptions << Request( "PSUBSCRIBE", Route.first );
+
+            if( Subscriptions.requestCount() )
+                boost::asio::write( Socket_, Subscriptions.bufferSequence(), ec );
+
+            REDISPP_NOTIFY( NotificationSink_, trace, "Subscriber::connect: connected - {} subscriptions renewed", Subscriptions.requestCount() );
+
+            Connected_ = true;
+            spResponse_ = std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+            BytesSinceRotation_ = 0;
+            receive();
+        }
+
+        void receive()
+        {
+            Socket_.async_read_some( boost::asio::buffer( spResponse_->buffer() ), [this]( const boost::system::error_code& ec, std::size_t BytesReceived ) {
+                if( ec )
+                {
+                    NotificationSink_.warning( "Subscriber::receive: connection lost: {} - reconnecting", ec.message() );
+
+                    Connected_ = false;
+                    Reconnects_.fetch_add( 1, std::memory_order_relaxed );
+                    Socket_.close();
+                    connect();
+                    return;
+                }
+
+                BytesSinceRotation_ += BytesReceived;
+
+                if( spResponse_->dataReceived( BytesReceived ) )
+                {
+                    // keep the buffers - the dispatched messages refer to them
+                    do
+                    {
+                        dispatch( spResponse_->top() );
+                    } while( spResponse_->commit( true ) );
+
+                    // hand the filled buffers over to the leases of the queued messages and start with fresh ones -
+                    // a busy channel rarely leaves the handler idle, so the partial message moves along
+                    if( BytesSinceRotation_ >= RotationThreshold )
+                    {
+                        auto spFresh = std::make_unique<ResponseHandler<NotificationSinkType_>>( ResponseHandler<NotificationSinkType_>::DefaultBuffersize, NotificationSink_ );
+                        spResponse_->moveTail( *spFresh );
+                        spResponse_ = std::move( spFresh );
+                        BytesSinceRotation_ = 0;
+                    }
+                }
+
+                if( !Stop_.load( std::memory_order_relaxed ) )
+                    receive();
+            } );
+        }
+
+        // frames: [ "message", channel, payload ] and [ "pmessage", pattern, channel, payload ]
+        void dispatch( const Response& Frame )
+        {
+            if( Frame.type() != Response::Type::Array || Frame.elements().size() < 3 )
+                return;
+
+            const auto& Kind = Frame[0];
+            boost::string_view KindView( Kind.data(), Kind.size() );
+
+            SubscriberMessage Message;
+            RouteTable Routes::*pTable;
+            const Response* pRouteKey;
+            if( KindView == "message" )
+            {
+                pTable = &Routes::Channels_;
+                pRouteKey = &Frame[1];
+                Message.Channel = boost::asio::buffer( Frame[1].data(), Frame[1].size() );
+                Message.Payload = boost::asio::buffer( Frame[2].data(), Frame[2].size() );
+            }
+            else
+                if( KindView == "pmessage" && Frame.elements().size() == 4 )
+                {
+                    pTable = &Routes::Patterns_;
+                    pRouteKey = &Frame[1];
+                    Message.Pattern = boost::asio::buffer( Frame[1].data(), Frame[1].size() );
+                    Message.Channel = boost::asio::buffer( Frame[2].data(), Frame[2].size() );
+                    Message.Payload = boost::asio::buffer( Frame[3].data(), Frame[3].size() );
+                }
+                else
+                    return; // subscribe/unsubscribe confirmations
+
+            Received_.fetch_add( 1, std::memory_order_relaxed );
+
+            // all messages of a channel go to the same consumer, which keeps them in order
+            auto& TheConsumer = *Consumers_[ringHash( boost::asio::buffer_cast<const char*>(Message.Channel), boost::asio::buffer_size( Message.Channel ) ) % Consumers_.size()];
+
+            // the snapshot stays valid while waiting for a full queue - a handler may (un)subscribe meanwhile
+            auto spRoutes = routes();
+            const auto& Table = (*spRoutes).*pTable;
+            auto RouteIterator = Table.find( boost::string_view( pRouteKey->data(), pRouteKey->size() ) );
+            if( RouteIterator == Table.end() )
+            {
+                Unrouted_.fetch_add( 1, std::memory_order_relaxed );
+                return;
+            }
+
+            for( const auto& spHandler : RouteIterator->second )
+            {
+                Delivery Item{ Message, spHandler, spResponse_->bufferContainer() };
+
+                Detail::Backoff Waiting;
+                while( !TheConsumer.Queue_.push( std::move( Item ) ) )
+                {
+                    if( Stop_.load( std::memory_order_relaxed ) )
+                        return;
+
+                    Stalls_.fetch_add( 1, std::memory_order_relaxed );
+                    Waiting.pause();
+                }
+
+                Dispatched_.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+
+        // called on the consumer threads
+        void consume( Consumer& TheConsumer )
+        {
+            Delivery Item;
+            Detail::Backoff Waiting;
+            while( !Stop_.load( std::memory_order_relaxed ) )
+            {
+                if( !TheConsumer.Queue_.pop( Item ) )
+                {
+                    Waiting.pause();
+                    continue;
+                }
+
+                Waiting.reset();
+                (*Item.spHandler_)( Item.Message_ );
+
+                // end the lease of the buffers
+                Item = Delivery();
+            }
+        }
+
+        typename ConnectionManagerType::Instance ConnectionManagerInstance_;
+        NotificationSinkType_ NotificationSink_;
+
+        // serializes the modifications of the routes - the receive thread reads the published snapshot
+        std::mutex RoutesMutex_;
+        RoutesHandle spRoutes_ = std::make_shared<const Routes>();
+
+        std::vector<std::unique_ptr<Consumer>> Consumers_;
+        std::atomic<bool> Stop_{ false };
+
+        std::atomic<uint64_t> Received_{ 0 };
+        std::atomic<uint64_t> Dispatched_{ 0 };
+        std::atomic<uint64_t> Unrouted_{ 0 };
+        std::atomic<uint64_t> Stalls_{ 0 };
+        std::atomic<uint64_t> Reconnects_{ 0 };
+
+        boost::asio::io_service ReceiveService_;
+        boost::asio::ip::tcp::socket Socket_;
+        boost::asio::deadline_timer ReconnectTimer_;
+        boost::asio::io_service::work Work_;
+        std::unique_ptr<ResponseHandler<NotificationSinkType_>> spResponse_;
+        size_t BytesSinceRotation_ = 0;
+        bool Connected_ = false;
+        std::thread ReceiveThread_;
+    };
+}
+
+#endif
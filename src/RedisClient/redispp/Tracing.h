@@ -0,0 +1,133 @@
+#pragma once
+
+#ifndef REDISPP_TRACING_INCLUDED
+#define REDISPP_TRACING_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include <array>
+#include <chrono>
+#include <type_traits>
+
+#include <boost/utility/string_view.hpp>
+
+// Lifecycle tracing of single requests. A connection with a TracerType_ timestamps every request at each TracePoint
+// and passes the finished RequestSpan to
+//   void span( const RequestSpan& Span )
+// of the tracer - right before the handler is called, so the span is only valid during the call. The default
+// NullTracer compiles away completely, including the clock reads.
+
+namespace redis
+{
+    // steady_clock is monotonic and, on the supported platforms, read without a system call
+    using TraceClock = std::chrono::steady_clock;
+
+    enum class TracePoint
+    {
+        // the request was passed to the connection
+        Enqueued,
+        // a connected socket is available - includes connecting and selecting the database if necessary
+        ConnectionAcquired,
+        // the request has been written to the socket
+        WriteCompleted,
+        // the first read returned data
+        FirstResponseByte,
+        // the response is complete
+        ParseCompleted,
+        // the handler is called - for synchronous commands: transmit returns
+        HandlerInvoked
+    };
+
+    struct RequestSpan
+    {
+        static constexpr size_t PointCount = static_cast<size_t>( TracePoint::HandlerInvoked ) + 1;
+
+        // command name - "PIPELINE" for pipelines
+        boost::string_view Command;
+        bool Failed = false;
+        // points not reached - e.g. because connecting failed - are left at the epoch of the clock
+        std::array<TraceClock::time_point, PointCount> Timestamps{};
+
+        TraceClock::time_point at( TracePoint Point ) const
+        {
+            return Timestamps[static_cast<size_t>( Point )];
+        }
+
+        bool reached( TracePoint Point ) const
+        {
+            return at( Point ) != TraceClock::time_point{};
+        }
+
+        // time between two reached points
+        TraceClock::duration between( TracePoint From, TracePoint To ) const
+        {
+            return reached( From ) && reached( To ) ? at( To ) - at( From ) : TraceClock::duration::zero();
+        }
+    };
+
+    class NullTracer
+    {
+    public:
+        static constexpr bool Enabled = false;
+
+        void span( const RequestSpan& Span ) {}
+    };
+
+    namespace Detail
+    {
+        template <class TracerT_>
+        constexpr bool tracerEnabled()
+        {
+            return std::decay<TracerT_>::type::Enabled;
+        }
+
+        // timestamps of one request on its way through a connection
+        template <bool Enabled_>
+        class RequestTrace
+        {
+        public:
+            RequestTrace()
+            {
+                mark( TracePoint::Enqueued );
+            }
+
+            void mark( TracePoint Point )
+            {
+                Span_.Timestamps[static_cast<size_t>( Point )] = TraceClock::now();
+            }
+
+            // marks FirstResponseByte on the first read only
+            void dataReceived()
+            {
+                if( !Span_.reached( TracePoint::FirstResponseByte ) )
+                    mark( TracePoint::FirstResponseByte );
+            }
+
+            template <class TracerT_>
+            void finish( TracerT_& Tracer, boost::string_view Command, bool Failed )
+            {
+                mark( TracePoint::HandlerInvoked );
+                Span_.Command = Command;
+                Span_.Failed = Failed;
+                Tracer.span( Span_ );
+            }
+
+        private:
+            RequestSpan Span_;
+        };
+
+        template <>
+        class RequestTrace<false>
+        {
+        public:
+            void mark( TracePoint Point ) {}
+            void dataReceived() {}
+
+            template <class TracerT_>
+            void finish( TracerT_& Tracer, boost::string_view Command, bool Failed ) {}
+        };
+    }
+}
+
+#endif
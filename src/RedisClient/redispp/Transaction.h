@@ -0,0 +1,211 @@
+#pragma once
+
+#ifndef REDISPP_TRANSACTION_INCLUDED
+#define REDISPP_TRANSACTION_INCLUDED
+
+// Copyright Soenke K. Schau 2016-2017
+// See accompanying file LICENSE.txt for Lincense
+
+#include "redispp/Connection.h"
+#include "redispp/Commands.h"
+
+#include <boost/optional.hpp>
+
+#include <list>
+#include <tuple>
+#include <utility>
+
+namespace redis
+{
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                   W A T C H
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    // Keys is a container of std::string, boost::string_view or const_buffer
+    template <class KeysT_>
+    Request watchCommand( const KeysT_& Keys )
+    {
+        Request r( "WATCH" );
+        for( const auto& Key : Keys )
+            r << Detail::argumentBuffer( Key );
+        return r;
+    }
+
+    template <class Connection, class KeysT_>
+    bool watch( Connection& con, boost::system::error_code& ec, const KeysT_& Keys )
+    {
+        return Detail::sync_universal( con, ec, &watchCommand<KeysT_>, &OKResult, std::ref(Keys) ).second;
+    }
+
+    template <class Connection, class CompletionToken, class KeysT_>
+    auto async_watch( Connection& con, CompletionToken&& token, const KeysT_& Keys )
+    {
+        return Detail::async_universal( con, token, &watchCommand<KeysT_>, &OKResult, std::ref(Keys) );
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    //                                                 U N W A T C H
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    inline Request unwatchCommand()
+    {
+        return Request( "UNWATCH" );
+    }
+
+    template <class Connection>
+    bool unwatch( Connection& con, boost::system::error_code& ec )
+    {
+        return Detail::sync_universal( con, ec, &unwatchCommand, &OKResult ).second;
+    }
+
+    template <class Connection, class CompletionToken>
+    auto async_unwatch( Connection& con, CompletionToken&& token )
+    {
+        return Detail::async_universal( con, token, &unwatchCommand, &OKResult );
+    }
+
+    // A MULTI/EXEC transaction with typed results. Every command is queued together with the result function decoding
+    // its reply, e.g.
+    //
+    //   auto Result = redis::Transaction<>()
+    //       .add( redis::setCommand( Key, "0", 60s, redis::SetOptions::SetIfNotExist ), &redis::OKResult )
+    //       .add( redis::incrCommand( Key ), &redis::incrResult )
+    //       .exec( con, ec );
+    //   auto Counter = std::get<1>( Result.second );
+    //
+    // MULTI, the commands and EXEC are sent with a single write and take one round trip. exec returns the
+    // PipelineResult, which keeps the received buffers alive, and a tuple with the result of every command.
+    template <class ... ResultFunctionTypes_>
+    class Transaction
+    {
+        template <class ... OtherTypes_> friend class Transaction;
+
+    public:
+        using ResultType = std::tuple<decltype( std::declval<ResultFunctionTypes_>()( std::declval<const Response&>(), std::declval<boost::system::error_code&>() ) )...>;
+
+        Transaction() = default;
+        Transaction( Transaction&& ) = default;
+        Transaction& operator=( Transaction&& ) = default;
+
+        // queues Command - pResponseFunction decodes its reply from the EXEC array, e.g. &IntResult
+        template <class ResponseT_>
+        Transaction<ResultFunctionTypes_..., ResponseT_> add( Request&& Command, ResponseT_ pResponseFunction ) &&
+        {
+            Requests_.emplace_back( std::move( Command ) );
+            return Transaction<ResultFunctionTypes_..., ResponseT_>( std::move( Requests_ ), std::tuple_cat( std::move( ResultFunctions_ ), std::make_tuple( pResponseFunction ) ) );
+        }
+
+        // number of queued commands
+        size_t size() const { return Requests_.size(); }
+
+        // Sends MULTI, the queued commands and EXEC as a pipeline. Fails with
+        //  - transaction_aborted, if a watched key was modified
+        //  - server_error, if a command was rejected while queueing (EXECABORT) or failed during execution. The error
+        //    is saved in the connection, the results of the commands before the failed one are set
+        template <class Connection>
+        auto exec( Connection& con, boost::system::error_code& ec ) const
+        {
+            Pipeline Commands;
+            Commands << multiCommand();
+            for( const auto& Command : Requests_ )
+                Commands.add( Command );
+            Commands << execCommand();
+
+            auto Result = con.transmit( Commands, ec );
+
+            ResultType Values;
+            if( !ec )
+            {
+                const auto& Replies = Result[Commands.requestCount() - 1];
+                if( Replies.type() == Response::Type::Error )
+                {
+                    ec = ::redis::make_error_code( ErrorCodes::server_error );
+                    con.setLastServerError( Replies.string() );
+                }
+                else if( Replies.type() == Response::Type::Null )
+                    ec = ::redis::make_error_code( ErrorCodes::transaction_aborted );
+                else if( Replies.type() != Response::Type::Array || Replies.elements().size() != sizeof...( ResultFunctionTypes_ ) )
+                    ec = ::redis::make_error_code( ErrorCodes::protocol_error );
+                else
+                    decode( con, Replies, Values, ec, std::index_sequence_for<ResultFunctionTypes_...>() );
+            }
+
+            return std::make_pair( std::move( Result ), std::move( Values ) );
+        }
+
+    private:
+        Transaction( std::list<Request>&& Requests, std::tuple<ResultFunctionTypes_...>&& ResultFunctions ) :
+            Requests_( std::move( Requests ) ),
+            ResultFunctions_( std::move( ResultFunctions ) )
+        {}
+
+        template <class Connection, size_t ... Indices_>
+        void decode( Connection& con, const Response& Replies, ResultType& Values, boost::system::error_code& ec, std::index_sequence<Indices_...> ) const
+        {
+            using Expander = int[];
+            (void)Expander{ 0, ( decodeReply<Indices_>( con, Replies, Values, ec ), 0 )... };
+        }
+
+        template <size_t Index_, class Connection>
+        void decodeReply( Connection& con, const Response& Replies, ResultType& Values, boost::system::error_code& ec ) const
+        {
+            if( ec )
+                return;
+
+            const auto& Reply = Replies[Index_];
+            if( Reply.type() == Response::Type::Error )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::server_error );
+                con.setLastServerError( Reply.string() );
+                return;
+            }
+
+            std::get<Index_>( Values ) = std::get<Index_>( ResultFunctions_ )( Reply, ec );
+        }
+
+        std::list<Request> Requests_;
+        std::tuple<ResultFunctionTypes_...> ResultFunctions_;
+    };
+
+    // Optimistic locking: watches Keys, calls Body( con, ec ), which reads the current state and returns the
+    // Transaction to execute, and executes it. If a watched key was modified in the meantime, everything is repeated -
+    // at most MaximumAttempts times. A reconnect after the WATCH, e.g. by a read of Body, lost the watch, so the attempt
+    // counts as aborted as well. Returns none if WATCH or Body failed or no transaction was executed, otherwise the result
+    // of the last exec - with transaction_aborted if all attempts were aborted.
+    // con has to be a Connection. A reconnect while MULTI ... EXEC is being sent is not detected.
+    template <class Connection, class KeysT_, class BodyT_>
+    auto watchedTransaction( Connection& con, boost::system::error_code& ec, const KeysT_& Keys, BodyT_ Body, size_t MaximumAttempts = 16 )
+    {
+        boost::optional<decltype( Body( con, ec ).exec( con, ec ) )> Result;
+
+        for( size_t Attempt = 0; Attempt < MaximumAttempts; ++Attempt )
+        {
+            ec.clear();
+            if( !watch( con, ec, Keys ) || ec )
+                return Result;
+
+            const auto Generation = con.connectionGeneration();
+            auto TheTransaction = Body( con, ec );
+            if( ec )
+            {
+                boost::system::error_code ec2;
+                unwatch( con, ec2 );
+                return Result;
+            }
+
+            if( con.connectionGeneration() != Generation )
+            {
+                ec = ::redis::make_error_code( ErrorCodes::transaction_aborted );
+                continue;
+            }
+
+            Result.emplace( TheTransaction.exec( con, ec ) );
+            if( ec != ::redis::make_error_code( ErrorCodes::transaction_aborted ) )
+                break;
+        }
+
+        return Result;
+    }
+}
+
+#endif
@@ -81,15 +81,15 @@ namespace redis
                     auto ConnectedSocket = SingleHostConnectionManager( SingleHost ).getInstance().getConnectedSocket( io_service, ec );
                     if( !ec )
                     {
-                        NotificationSink_.trace( "MultipleHostsConnectionManager: Successfully connected to host '{}'", SingleHost );
+                        REDISPP_NOTIFY( NotificationSink_, trace, "MultipleHostsConnectionManager: Successfully connected to host '{}'", SingleHost );
 
                         return ConnectedSocket;
                     }
                     else
-                        NotificationSink_.trace( "MultipleHostsConnectionManager: unable to establish connection to host '{}'", SingleHost );
+                        REDISPP_NOTIFY( NotificationSink_, trace, "MultipleHostsConnectionManager: unable to establish connection to host '{}'", SingleHost );
                 }
 
-                NotificationSink_.trace( "MultipleHostsConnectionManager: unable to establish any connection!" );
+                REDISPP_NOTIFY( NotificationSink_, trace, "MultipleHostsConnectionManager: unable to establish any connection!" );
 
                 ec = ::redis::make_error_code( ErrorCodes::no_usable_server );
 
@@ -4,8 +4,37 @@
 #include "redispp/Response.h"
 #include "redispp/Request.h"
 #include "redispp/Error.h"
+#include "redispp/KeyHash.h"
+#include "redispp/CommandKeys.h"
+#include "redispp/ClusterConnectionManager.h"
+#include "redispp/ShardedConnectionManager.h"
+#include "redispp/NearCache.h"
+#include "redispp/LockFreeQueue.h"
+#include "redispp/StreamCommands.h"
+#include "redispp/ScanCommands.h"
+#include "redispp/ReplyCounter.h"
+#include "redispp/BulkLoader.h"
+#include "redispp/MultiKeyCommands.h"
+#include "redispp/HashCommands.h"
+#include "redispp/SortedSetCommands.h"
+#include "redispp/ScriptCommands.h"
+#include "redispp/Transaction.h"
+#include "redispp/SharedConnection.h"
+#include "redispp/ClientRuntime.h"
+#include "redispp/Metrics.h"
+#include "redispp/Tracing.h"
+#include "redispp/MockServer.h"
+#include "redispp/LoopbackConnectionManager.h"
+#include "redispp/FireAndForget.h"
+#include "redispp/SentinelConnectionManager.h"
+#include "redispp/Subscriber.h"
+#include "redispp/ReadRoutingConnection.h"
 
+#include <future>
 #include <iostream>
+#include <map>
+#include <set>
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -116,6 +145,63 @@ bool testit_complete(const std::string& Teststring, HandlerType&& handler)
 
 auto static good = [](auto ParseId, const auto& myresult) { return true;};
 
+// counts the notifications it gets - interested in warnings and errors only
+struct WarningCountingSink
+{
+    static constexpr redis::NotificationLevel MinimumLevel = redis::NotificationLevel::warning;
+
+    size_t* pCount;
+
+    template <typename... Args>
+    void debug( const Args & ... args ) { ++*pCount; }
+    template <typename... Args>
+    void warning( const Args & ... args ) { ++*pCount; }
+};
+
+// level chosen at runtime
+struct RuntimeLevelSink
+{
+    redis::NotificationLevel Level;
+
+    bool enabled( redis::NotificationLevel Requested ) const { return Requested >= Level; }
+
+    template <typename... Args>
+    void debug( const Args & ... args ) {}
+    template <typename... Args>
+    void trace( const Args & ... args ) {}
+};
+
+// keeps the spans passed by a connection
+struct SpanRecorder
+{
+    static constexpr bool Enabled = true;
+
+    void span( const redis::RequestSpan& Span )
+    {
+        Spans.push_back( Span );
+        Commands.emplace_back( Span.Command.data(), Span.Command.size() );
+    }
+
+    std::vector<redis::RequestSpan> Spans;
+    std::vector<std::string> Commands;
+};
+
+// answers every pipeline with the canned replies
+struct ReplayConnection
+{
+    std::string Replies;
+    std::string LastServerError;
+    redis::ResponseHandler<> Handler;
+
+    redis::PipelineResult<redis::NullNotificationSink> transmit( const redis::Pipeline& Commands, boost::system::error_code& ec )
+    {
+        auto spResponses = std::make_shared<redis::Response::ElementContainer>( testitmultiple( Replies, Handler, Commands.requestCount(), ec ) );
+        return redis::PipelineResult<redis::NullNotificationSink>( spResponses, Handler.bufferContainer(), redis::NullNotificationSink() );
+    }
+
+    void setLastServerError( const std::string& ServerError ) { LastServerError = ServerError; }
+};
+
 namespace UnitTest1
 {		
     TEST_CLASS(UnitTest1)
@@ -337,5 +423,2049 @@ namespace UnitTest1
             Assert::IsTrue(bufferSequenceToString(e.bufferSequence()) == "*3\r\n$1\r\ne\r\n$1\r\nf\r\n$2\r\njj\r\n");
         }
 
+
+        TEST_METHOD(Redis_Cluster_HashSlot)
+        {
+            Assert::IsTrue(redis::Detail::crc16("123456789", 9) == 0x31c3);
+            Assert::IsTrue(redis::hashSlot(std::string("foo")) == 12182);
+
+            // hash tags
+            Assert::IsTrue(redis::hashSlot(std::string("{user1000}.following")) == redis::hashSlot(std::string("user1000")));
+            Assert::IsTrue(redis::hashSlot(std::string("foo{bar}{zap}")) == redis::hashSlot(std::string("bar")));
+            Assert::IsTrue(redis::hashSlot(std::string("foo{{bar}}zap")) == redis::hashSlot(std::string("{bar")));
+            Assert::IsTrue(redis::hashSlot(std::string("foo{}{bar}")) == (redis::Detail::crc16("foo{}{bar}", 10) & (redis::ClusterSlotCount - 1)));
+        }
+
+
+        TEST_METHOD(Redis_Sharding_ConsistentHashing)
+        {
+            redis::ShardedConnectionManager<> Manager({ { redis::Host("host0", 6379), 1 }, { redis::Host("host1", 6379), 1 }, { redis::Host("host2", 6379), 1 }, { redis::Host("host3", 6379), 1 } });
+
+            std::vector<redis::Host> Before;
+            for (int Index = 0; Index < 10000; ++Index)
+            {
+                redis::Host Node;
+                Assert::IsTrue(Manager.shardForKey("key:" + std::to_string(Index), Node));
+                Before.push_back(Node);
+            }
+
+            // a fifth shard takes over about a fifth of the keys - and only from the other shards
+            Manager.addShard(redis::Host("host4", 6379));
+            int Moved = 0;
+            for (int Index = 0; Index < 10000; ++Index)
+            {
+                redis::Host Node;
+                Manager.shardForKey("key:" + std::to_string(Index), Node);
+                if (Node != Before[Index])
+                {
+                    Assert::IsTrue(Node == redis::Host("host4", 6379));
+                    ++Moved;
+                }
+            }
+            Assert::IsTrue(Moved > 1000 && Moved < 3000);
+
+            // hash tags
+            redis::Host TaggedNode, Node;
+            Manager.shardForKey(std::string("{user1000}.following"), TaggedNode);
+            Manager.shardForKey(std::string("{user1000}.followers"), Node);
+            Assert::IsTrue(TaggedNode == Node);
+        }
+
+
+        TEST_METHOD(Redis_NearCache_FrequencySketch)
+        {
+            redis::Detail::FrequencySketch Sketch(1024);
+
+            for (int Index = 0; Index < 10; ++Index)
+                Sketch.increment(redis::ringHash("hot", 3));
+            Sketch.increment(redis::ringHash("cold", 4));
+
+            Assert::IsTrue(Sketch.frequency(redis::ringHash("hot", 3)) >= 10);
+            Assert::IsTrue(Sketch.frequency(redis::ringHash("cold", 4)) < Sketch.frequency(redis::ringHash("hot", 3)));
+
+            // counters are halved periodically, so old popularity fades
+            for (int Index = 0; Index < 10 * 1024; ++Index)
+                Sketch.increment(redis::ringHash(std::to_string(Index).data(), std::to_string(Index).size()));
+            Assert::IsTrue(Sketch.frequency(redis::ringHash("hot", 3)) < 10);
+        }
+
+
+        TEST_METHOD( Redis_NearCache_Databases )
+        {
+            // the mock answers the tracking handshake, but never sends invalidations
+            redis::MockServer Server;
+            redis::MockEngine::Client Admin;
+            Server.engine().execute( Admin, { "SET", "key", "first" } );
+            Server.setScript( []( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                if( TheCommand[0] == "CLIENT" && TheCommand[1] == "ID" )
+                    Action.Reply = redis::Detail::respInteger( 7 );
+                else if( TheCommand[0] == "CLIENT" )
+                    Action.Reply = redis::Detail::respSimple( "OK" );
+                else if( TheCommand[0] == "SUBSCRIBE" )
+                    Action.Reply = redis::Detail::respArray( { redis::Detail::respBulk( "subscribe" ), redis::Detail::respBulk( TheCommand[1] ), redis::Detail::respInteger( 1 ) } );
+                else if( TheCommand[0] == "PTTL" )
+                    Action.Reply = redis::Detail::respInteger( -1 );
+                return Action;
+            } );
+
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::NearCache<redis::SingleHostConnectionManager> Cache( Manager, 1024 * 1024 );
+            uint64_t Generation = 0;
+            for( size_t Wait = 0; Wait < 100 && !Cache.listener( Generation ); ++Wait )
+                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            Assert::IsTrue( Cache.listener( Generation ) == 7 );
+
+            boost::asio::io_service io_service;
+            redis::CachingConnection<redis::SingleHostConnectionManager> First( io_service, Manager, Cache, 0 ), Second( io_service, Manager, Cache, 1 );
+            auto value = []( const auto& Result ) { return Result.second ? std::string( boost::asio::buffer_cast<const char*>( *Result.second ), boost::asio::buffer_size( *Result.second ) ) : std::string(); };
+
+            boost::system::error_code ec;
+            Assert::IsTrue( value( redis::get( First, ec, std::string( "key" ) ) ) == "first" );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Cache.statistics().Entries == 1 );
+
+            // the value cached for database 0 is not returned for database 1
+            Server.engine().execute( Admin, { "SET", "key", "second" } );
+            Assert::IsTrue( value( redis::get( Second, ec, std::string( "key" ) ) ) == "second" );
+            Assert::IsTrue( value( redis::get( First, ec, std::string( "key" ) ) ) == "first" );
+            Assert::IsTrue( Cache.statistics().Entries == 2 && Cache.statistics().Hits == 1 );
+
+            // an invalidation drops the key in every database
+            Cache.invalidate( "key" );
+            Assert::IsTrue( Cache.statistics().Entries == 0 );
+        }
+
+        TEST_METHOD( Redis_NearCache_Without_Tracking )
+        {
+            // the mock does not know CLIENT ID - the cache never receives invalidations
+            redis::MockServer Server;
+            redis::MockEngine::Client Admin;
+            Server.engine().execute( Admin, { "SET", "key", "value" } );
+            std::mutex Mutex;
+            std::vector<std::string> Names;
+            Server.setScript( [&]( const redis::MockServer::Command& TheCommand ) {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Names.push_back( TheCommand[0] );
+                return redis::MockAction();
+            } );
+
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::NearCache<redis::SingleHostConnectionManager> Cache( Manager, 1024 * 1024 );
+            boost::asio::io_service io_service;
+            redis::CachingConnection<redis::SingleHostConnectionManager> con( io_service, Manager, Cache );
+
+            // the reads are sent as they are, without the PTTL needed for caching
+            boost::system::error_code ec;
+            for( size_t Count = 0; Count < 2; ++Count )
+            {
+                auto Result = redis::get( con, ec, std::string( "key" ) );
+                Assert::IsFalse( !!ec );
+                Assert::IsTrue( Result.second && std::string( boost::asio::buffer_cast<const char*>( *Result.second ), boost::asio::buffer_size( *Result.second ) ) == "value" );
+            }
+            std::lock_guard<std::mutex> Lock( Mutex );
+            Assert::IsTrue( std::count( Names.begin(), Names.end(), "GET" ) == 2 );
+            Assert::IsTrue( std::count( Names.begin(), Names.end(), "PTTL" ) == 0 );
+            Assert::IsTrue( Cache.statistics().Entries == 0 );
+        }
+
+
+        TEST_METHOD(Redis_LockFreeQueue_Capacity_And_Order)
+        {
+            redis::SpscRing<int> Spsc(3);
+            redis::MpscRing<int> Mpsc(3);
+            Assert::IsTrue(Spsc.capacity() == 4 && Mpsc.capacity() == 4);
+
+            for (int Index = 0; Index < 4; ++Index)
+            {
+                Assert::IsTrue(Spsc.push(int(Index)));
+                Assert::IsTrue(Mpsc.push(int(Index)));
+            }
+            Assert::IsFalse(Spsc.push(4));
+            Assert::IsFalse(Mpsc.push(4));
+
+            int Value;
+            for (int Index = 0; Index < 4; ++Index)
+            {
+                Assert::IsTrue(Spsc.pop(Value) && Value == Index);
+                Assert::IsTrue(Mpsc.pop(Value) && Value == Index);
+            }
+            Assert::IsFalse(Spsc.pop(Value));
+            Assert::IsFalse(Mpsc.pop(Value));
+
+            // wrap around
+            Assert::IsTrue(Spsc.push(5) && Spsc.pop(Value) && Value == 5);
+            Assert::IsTrue(Mpsc.push(5) && Mpsc.pop(Value) && Value == 5);
+        }
+
+
+        TEST_METHOD( Redis_Streams_Decode_Entries )
+        {
+            auto BufferString = []( const boost::asio::const_buffer& Buffer ) { return std::string( boost::asio::buffer_cast<const char*>(Buffer), boost::asio::buffer_size( Buffer ) ); };
+
+            // XREADGROUP: one stream with two entries
+            Assert::IsTrue( testit( "*1\r\n*2\r\n$6\r\norders\r\n*2\r\n"
+                "*2\r\n$3\r\n1-0\r\n*4\r\n$4\r\nitem\r\n$5\r\napple\r\n$3\r\nqty\r\n$1\r\n3\r\n"
+                "*2\r\n$3\r\n2-0\r\n*2\r\n$4\r\nitem\r\n$4\r\npear\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Streams = redis::xreadgroupResult( Data, ec );
+                return !ec && Streams.size() == 1 && BufferString( Streams[0].Stream ) == "orders"
+                    && Streams[0].Entries.size() == 2
+                    && BufferString( Streams[0].Entries[0].Id ) == "1-0"
+                    && Streams[0].Entries[0].Fields.size() == 2
+                    && BufferString( Streams[0].Entries[0].Fields[1].first ) == "qty"
+                    && BufferString( Streams[0].Entries[0].Fields[1].second ) == "3"
+                    && BufferString( Streams[0].Entries[1].Fields[0].second ) == "pear";
+            } ) );
+
+            // XREADGROUP: BLOCK timed out
+            Assert::IsTrue( testit( "*-1\r\n", redis::ResponseHandler<>(), [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                return !ec && redis::xreadgroupResult( Data, ec ).empty();
+            } ) );
+
+            // XAUTOCLAIM: cursor, one claimed and one deleted entry, deleted ids
+            Assert::IsTrue( testit( "*3\r\n$3\r\n0-0\r\n*2\r\n*2\r\n$3\r\n5-1\r\n*2\r\n$1\r\na\r\n$1\r\nb\r\n*-1\r\n*0\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Claimed = redis::xautoclaimResult( Data, ec );
+                return !ec && BufferString( Claimed.NextStart ) == "0-0" && Claimed.Entries.size() == 1 && BufferString( Claimed.Entries[0].Id ) == "5-1";
+            } ) );
+
+            // XPENDING summary
+            Assert::IsTrue( testit( "*4\r\n:3\r\n$3\r\n1-0\r\n$3\r\n3-0\r\n*1\r\n*2\r\n$6\r\nworker\r\n$1\r\n3\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Summary = redis::xpendingResult( Data, ec );
+                return !ec && Summary.Count == 3 && Summary.Consumers.size() == 1 && Summary.Consumers[0].second == 3 && BufferString( Summary.GreatestId ) == "3-0";
+            } ) );
+        }
+
+        TEST_METHOD( Redis_Scan_Decode_Page )
+        {
+            Assert::IsTrue( testit( "*2\r\n$5\r\n17920\r\n*3\r\n$4\r\nkey1\r\n$4\r\nkey2\r\n$5\r\nkey10\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Page = redis::scanResult( Data, ec );
+                return !ec && Page.Cursor == "17920" && Page.Elements.size() == 3 && boost::asio::buffer_size( Page.Elements[2] ) == 5;
+            } ) );
+
+            // the last page may be empty
+            Assert::IsTrue( testit( "*2\r\n$1\r\n0\r\n*0\r\n", redis::ResponseHandler<>(), [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Page = redis::scanResult( Data, ec );
+                return !ec && Page.Cursor == "0" && Page.Elements.empty();
+            } ) );
+
+            // no scan reply
+            Assert::IsTrue( testit( ":1\r\n", redis::ResponseHandler<>(), [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                redis::scanResult( Data, ec );
+                return ec == redis::make_error_code( redis::ErrorCodes::protocol_error );
+            } ) );
+        }
+
+        TEST_METHOD( Redis_ScanRange_MockServer )
+        {
+            // three pages - the second one is empty, although the scan is not complete
+            redis::MockServer Server;
+            Server.setScript( []( const redis::MockServer::Command& TheCommand ) {
+                using namespace redis::Detail;
+                redis::MockAction Action;
+                if( TheCommand[0] != "SCAN" )
+                    return Action;
+                if( TheCommand[1] == "0" )
+                    Action.Reply = respArray( { respBulk( "3" ), respArray( { respBulk( "a" ), respBulk( "b" ) } ) } );
+                else if( TheCommand[1] == "3" )
+                    Action.Reply = respArray( { respBulk( "7" ), respArray( {} ) } );
+                else
+                    Action.Reply = respArray( { respBulk( "0" ), respArray( { respBulk( "c" ) } ) } );
+                return Action;
+            } );
+
+            boost::asio::io_service io_service;
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::Connection<redis::SingleHostConnectionManager> con( io_service, Manager );
+            auto BufferString = []( const boost::asio::const_buffer& Buffer ) { return std::string( boost::asio::buffer_cast<const char*>( Buffer ), boost::asio::buffer_size( Buffer ) ); };
+
+            std::vector<std::string> Keys;
+            {
+                auto&& Range = redis::scanRange( con );
+                for( const auto& Key : Range )
+                    Keys.push_back( BufferString( Key ) );
+                Assert::IsFalse( !!Range.error() );
+            }
+            Assert::IsTrue( Keys == std::vector<std::string>( { "a", "b", "c" } ) );
+
+            // the connection is usable afterwards
+            boost::system::error_code ec;
+            redis::set( con, ec, std::string( "key" ), std::string( "value" ) );
+            Assert::IsFalse( !!ec );
+
+            // the request for the second page fails - the items of the first one are returned before the error
+            struct FailingConnection
+            {
+                redis::Connection<redis::SingleHostConnectionManager>& Connection_;
+                size_t Sends_ = 0;
+
+                bool send( const redis::Pipeline& thePipeline, boost::system::error_code& ec )
+                {
+                    if( ++Sends_ == 2 )
+                    {
+                        ec = redis::make_error_code( redis::ErrorCodes::no_usable_server );
+                        return false;
+                    }
+                    return Connection_.send( thePipeline, ec );
+                }
+                auto receive( size_t ExpectedResponses, boost::system::error_code& ec ) { return Connection_.receive( ExpectedResponses, ec ); }
+                void setLastServerError( const std::string& LastServerError ) { Connection_.setLastServerError( LastServerError ); }
+            } Failing{ con };
+
+            Keys.clear();
+            auto&& Range = redis::scanRange( Failing );
+            for( const auto& Key : Range )
+                Keys.push_back( BufferString( Key ) );
+            Assert::IsTrue( Keys == std::vector<std::string>( { "a", "b" } ) );
+            Assert::IsTrue( Range.error() == redis::make_error_code( redis::ErrorCodes::no_usable_server ) );
+        }
+
+        TEST_METHOD( Redis_ReplyCounter_Chunked )
+        {
+            std::string Replies( "+OK\r\n-ERR wrong type\r\n:5\r\n$3\r\nfoo\r\n$-1\r\n*2\r\n*1\r\n$1\r\na\r\n-nested\r\n*0\r\n"
+                "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n" );
+
+            // any split of the data gives the same result
+            for( size_t ChunkSize = 1; ChunkSize <= Replies.size(); ++ChunkSize )
+            {
+                redis::ReplyCounter Counter;
+                std::vector<size_t> Errors;
+                size_t Completed = 0;
+                for( size_t Position = 0; Position < Replies.size(); Position += ChunkSize )
+                    Completed += Counter.consume( Replies.data() + Position, std::min( ChunkSize, Replies.size() - Position ),
+                        [&]( size_t ReplyIndex, boost::string_view Message ) { Errors.push_back( ReplyIndex ); } );
+
+                Assert::IsTrue( Completed == 8 && Counter.replies() == 8 && Counter.idle() && !Counter.failed() );
+                // only the top level error counts
+                Assert::IsTrue( Errors.size() == 1 && Errors[0] == 1 );
+            }
+
+            redis::ReplyCounter Partial;
+            Assert::IsTrue( Partial.consume( "*1\r\n$3\r\nfo", 10 ) == 0 && !Partial.idle() );
+
+            // inline commands are no RESP
+            redis::ReplyCounter Invalid;
+            Invalid.consume( "PING\r\n", 6 );
+            Assert::IsTrue( Invalid.failed() );
+
+            // an invalid length fails without completing the reply - nothing is parsed afterwards
+            for( const std::string Data : { "*x\r\n", "$abc\r\n", "*1\r\n*-\r\n" } )
+            {
+                redis::ReplyCounter Counter;
+                Assert::IsTrue( Counter.consume( ":1\r\n", 4 ) == 1 );
+                Assert::IsTrue( Counter.consume( Data.data(), Data.size() ) == 0 );
+                Assert::IsTrue( Counter.failed() && Counter.replies() == 1 );
+                Assert::IsTrue( Counter.consume( ":2\r\n", 4 ) == 0 && Counter.replies() == 1 );
+            }
+        }
+
+        TEST_METHOD( Redis_BulkLoader_Invalid_Input )
+        {
+            redis::MockServer Server;
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            boost::system::error_code ec;
+
+            std::string Commands( "*3\r\n$3\r\nSET\r\n$1\r\na\r\n$1\r\n1\r\n*2\r\n$4\r\nINCR\r\n$1\r\nb\r\n" );
+            redis::BulkLoader<redis::SingleHostConnectionManager> Loader( Manager );
+            auto Result = Loader.load( boost::asio::buffer( Commands ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.Commands == 2 && Result.Replies == 2 && Result.Errors.empty() );
+            Assert::IsTrue( *Server.value( "a" ) == "1" );
+
+            // invalid data is not sent at all
+            auto Executed = Server.commands();
+            std::string Invalid( "*1\r\n$4\r\nPING\r\n*x\r\n" );
+            Result = Loader.load( boost::asio::buffer( Invalid ), ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::protocol_error ) );
+            Assert::IsTrue( Result.Commands == 0 );
+            Assert::IsTrue( Server.commands() == Executed );
+
+            // the complete commands of truncated data are loaded, the error is reported anyway - with small send
+            // windows the invalid part is detected after the first chunks have been sent
+            for( size_t SendWindow : { size_t( 7 ), redis::BulkLoader<redis::SingleHostConnectionManager>::DefaultSendWindow } )
+            {
+                redis::BulkLoader<redis::SingleHostConnectionManager> WindowLoader( Manager, SendWindow );
+                std::string Truncated( Commands + "*3\r\n$3\r\nSET" );
+                Result = WindowLoader.load( boost::asio::buffer( Truncated ), ec );
+                Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::protocol_error ) );
+                Assert::IsTrue( Result.Commands == 2 && Result.Replies == 2 );
+
+                std::string Garbage( Commands + "*2\r\n$x\r\n" );
+                Result = WindowLoader.load( boost::asio::buffer( Garbage ), ec );
+                Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::protocol_error ) );
+                Assert::IsTrue( Result.Replies == Result.Commands );
+            }
+        }
+
+        TEST_METHOD( Redis_BulkLoader_Database )
+        {
+            redis::MockServer Server;
+            std::mutex Mutex;
+            std::vector<std::string> Names;
+            Server.setScript( [&]( const redis::MockServer::Command& TheCommand ) {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Names.push_back( TheCommand[0] );
+                redis::MockAction Action;
+                // the mock has one database only - 15 is rejected like a database beyond the configured ones
+                if( TheCommand[0] == "SELECT" && TheCommand[1] == "15" )
+                    Action.Reply = redis::Detail::respError( "ERR DB index is out of range" );
+                return Action;
+            } );
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            boost::system::error_code ec;
+
+            // the database is selected first - the error indices refer to the loaded commands only
+            std::string Commands( "*3\r\n$3\r\nSET\r\n$1\r\na\r\n$1\r\nx\r\n*2\r\n$4\r\nINCR\r\n$1\r\na\r\n" );
+            redis::BulkLoader<redis::SingleHostConnectionManager> Loader( Manager, redis::BulkLoader<redis::SingleHostConnectionManager>::DefaultSendWindow, 3 );
+            auto Result = Loader.load( boost::asio::buffer( Commands ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.Commands == 2 && Result.Replies == 2 );
+            Assert::IsTrue( Result.Errors.size() == 1 && Result.Errors[0].CommandIndex == 1 );
+            {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Assert::IsTrue( Names == std::vector<std::string>( { "SELECT", "SET", "INCR" } ) );
+            }
+
+            // nothing is loaded into the wrong database
+            redis::BulkLoader<redis::SingleHostConnectionManager> Failing( Manager, redis::BulkLoader<redis::SingleHostConnectionManager>::DefaultSendWindow, 15 );
+            auto Executed = Server.commands();
+            Result = Failing.load( boost::asio::buffer( Commands ), ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::server_error ) );
+            Assert::IsTrue( Result.Commands == 0 && Server.commands() == Executed + 1 );
+        }
+
+        TEST_METHOD( Redis_MultiKey_Split )
+        {
+            std::vector<std::string> Keys{ "k1", "k2", "k3", "k4", "k5" };
+
+            redis::Pipeline Commands;
+            redis::Detail::splitKeyCommand( Commands, "MGET", Keys.begin(), Keys.end(), 2, true );
+            Assert::IsTrue( Commands.requestCount() == 3 );
+            Assert::IsTrue( Commands.requests()[0]->argumentCount() == 3 && Commands.requests()[2]->argumentCount() == 2 );
+            Assert::IsTrue( Commands.requests()[2]->readOnly() );
+
+            // the keys are not copied
+            Assert::IsTrue( boost::asio::buffer_cast<const char*>(Commands.requests()[1]->argument( 2 )) == Keys[3].data() );
+
+            std::vector<std::pair<std::string, std::string>> Entries{ { "k1", "v1" }, { "k2", "v2" }, { "k3", "v3" } };
+            redis::Pipeline Sets;
+            redis::Detail::splitCommand( Sets, "MSET", Entries.begin(), Entries.end(), 2, []( redis::Request& r, const auto& Entry )
+            {
+                r << redis::Detail::argumentBuffer( Entry.first ) << redis::Detail::argumentBuffer( Entry.second );
+            }, false );
+            Assert::IsTrue( Sets.requestCount() == 2 && Sets.requests()[0]->argumentCount() == 5 && Sets.requests()[1]->argumentCount() == 3 );
+
+            // C strings refer to their characters, without the terminator
+            const char* CKeys[] = { "k1", "key2" };
+            redis::Pipeline Dels;
+            redis::Detail::splitKeyCommand( Dels, "DEL", std::begin( CKeys ), std::end( CKeys ), 2, false );
+            Assert::IsTrue( Dels.requestCount() == 1 && boost::asio::buffer_size( Dels.requests()[0]->argument( 2 ) ) == 4 );
+            Assert::IsTrue( boost::asio::buffer_cast<const char*>(Dels.requests()[0]->argument( 2 )) == CKeys[1] );
+        }
+
+        TEST_METHOD( Redis_Hash_Decode_Batch_Results )
+        {
+            auto BufferString = []( const boost::asio::const_buffer& Buffer ) { return std::string( boost::asio::buffer_cast<const char*>(Buffer), boost::asio::buffer_size( Buffer ) ); };
+
+            Assert::IsTrue( testit( "*4\r\n$4\r\nname\r\n$5\r\nAlice\r\n$3\r\nage\r\n$2\r\n42\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Fields = redis::hgetallResult( Data, ec );
+
+                // decoding into a caller provided container
+                redis::FieldValueViews Provided( 2 );
+                auto Count = redis::Detail::fieldValues( Data, Provided.begin(), ec );
+
+                return !ec && Fields.size() == 2 && BufferString( Fields[0].first ) == "name" && BufferString( Fields[1].second ) == "42"
+                    && Count == 2 && BufferString( Provided[1].first ) == "age";
+            } ) );
+
+            Assert::IsTrue( testit( "*3\r\n$5\r\nAlice\r\n$-1\r\n$2\r\n42\r\n", redis::ResponseHandler<>(), [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Values = redis::hmgetResult( Data, ec );
+                return !ec && Values.size() == 3 && Values[0] && !Values[1] && BufferString( *Values[2] ) == "42";
+            } ) );
+
+            std::vector<std::string> Fields{ "name", "age" };
+            auto Command = redis::hmgetCommand( std::string( "user:1" ), Fields.begin(), Fields.end() );
+            Assert::IsTrue( Command.argumentCount() == 4 && Command.readOnly() );
+        }
+
+        TEST_METHOD( Redis_SortedSet_Decode_Scores )
+        {
+            Assert::IsTrue( testit( "*6\r\n$5\r\nalice\r\n$4\r\n12.5\r\n$3\r\nbob\r\n$4\r\n-inf\r\n$5\r\ncarol\r\n$5\r\n1e+20\r\n", redis::ResponseHandler<>(),
+                [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Members = redis::scoredMembersResult( Data, ec );
+                return !ec && Members.size() == 3 && boost::asio::buffer_size( Members[0].first ) == 5 && Members[0].second == 12.5
+                    && Members[1].second == -std::numeric_limits<double>::infinity() && Members[2].second == 1e20;
+            } ) );
+
+            // scores survive the round trip through a request argument
+            double Score = 0.1 + 0.2;
+            double Parsed = 0;
+            auto Argument = redis::Detail::scoreArgument( Score );
+            Assert::IsTrue( redis::Detail::parseDouble( Argument.data(), Argument.size(), Parsed ) && Parsed == Score );
+
+            redis::Response Integer( redis::Response::Type::Integer, "-9223372036854775808", 20 );
+            Assert::IsTrue( Integer.asint() == std::numeric_limits<int64_t>::min() );
+        }
+
+        TEST_METHOD( Redis_Integer_Overflow )
+        {
+            int64_t Value = 0;
+            Assert::IsTrue( redis::Detail::parseInteger( "9223372036854775807", 19, Value ) && Value == std::numeric_limits<int64_t>::max() );
+            Assert::IsTrue( redis::Detail::parseInteger( "-9223372036854775808", 20, Value ) && Value == std::numeric_limits<int64_t>::min() );
+            Assert::IsFalse( redis::Detail::parseInteger( "9223372036854775808", 19, Value ) );
+            Assert::IsFalse( redis::Detail::parseInteger( "-9223372036854775809", 20, Value ) );
+            Assert::IsFalse( redis::Detail::parseInteger( "99999999999999999999", 20, Value ) );
+
+            // an integer reply beyond 64 bits is a protocol error, not a wrapped value
+            Assert::IsTrue( testit( ":99999999999999999999\r\n", redis::ResponseHandler<>(), [&]( auto ParseId, const auto& Data )
+            {
+                boost::system::error_code ec;
+                auto Result = redis::IntResult( Data, ec );
+                boost::system::error_code IncrEc;
+                redis::incrResult( Data, IncrEc );
+                return Result == 0 && ec == redis::make_error_code( redis::ErrorCodes::protocol_error ) && IncrEc == ec;
+            } ) );
+        }
+
+        TEST_METHOD( Redis_Script_Registry )
+        {
+            redis::ScriptRegistry Registry;
+            auto First = Registry.add( "return 1" );
+            Assert::IsTrue( First.sha1() == "e0e1f9fabfc9d4800c877a703b823ac0578ff8db" );
+
+            // the same source is registered only once
+            auto Second = Registry.add( std::string( "return 1" ) );
+            Assert::IsTrue( Second.sha1() == First.sha1() && Registry.size() == 1 );
+
+            Registry.add( "return redis.call('GET', KEYS[1])" );
+            Assert::IsTrue( Registry.size() == 2 );
+
+            Assert::IsTrue( redis::Detail::isNoScriptError( "NOSCRIPT No matching script. Please use EVAL." ) );
+            Assert::IsFalse( redis::Detail::isNoScriptError( "ERR unknown command" ) );
+        }
+
+        TEST_METHOD( Redis_Script_MockServer )
+        {
+            // the mock server knows no scripts - EVALSHA and SCRIPT LOAD are scripted
+            redis::MockServer Server;
+            std::mutex Mutex;
+            std::set<std::string> Loaded;
+            std::atomic<bool> RejectLoad{ false };
+            std::atomic<size_t> Loads{ 0 };
+            Server.setScript( [&]( const redis::MockServer::Command& Command )
+            {
+                redis::MockAction Action;
+                std::lock_guard<std::mutex> Lock( Mutex );
+                if( Command[0] == "EVALSHA" )
+                    Action.Reply = Loaded.count( Command[1] ) ? redis::Detail::respInteger( 1 ) : redis::Detail::respError( "NOSCRIPT No matching script. Please use EVAL." );
+                else if( Command[0] == "SCRIPT" && Command[1] == "LOAD" )
+                {
+                    ++Loads;
+                    if( RejectLoad )
+                        Action.Reply = redis::Detail::respError( "ERR Error compiling script" );
+                    else
+                    {
+                        Loaded.insert( redis::Detail::sha1Hex( Command[2] ) );
+                        Action.Reply = redis::Detail::respBulk( redis::Detail::sha1Hex( Command[2] ) );
+                    }
+                }
+                return Action;
+            } );
+
+            boost::asio::io_service io_service;
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            const std::vector<std::string> None;
+            boost::system::error_code ec;
+
+            // an unknown script is loaded on NOSCRIPT and called again
+            redis::Script Unknown( "return 1" );
+            redis::Connection<redis::SingleHostConnectionManager> con( io_service, Manager );
+            auto Result = redis::evalScript( con, ec, Unknown, None, None, &redis::IntResult );
+            Assert::IsTrue( !ec && Result.second == 1 && Loads == 1 );
+
+            // the registry loads its scripts on connect - next to the other connect handlers
+            redis::ScriptRegistry Registry;
+            auto Registered = Registry.add( "return 2" );
+            size_t Connects = 0;
+            redis::Connection<redis::SingleHostConnectionManager> Attached( io_service, Manager );
+            Attached.addConnectHandler( [&Connects]( auto&, boost::system::error_code& ) { ++Connects; } );
+            Registry.attach( Attached );
+            Result = redis::evalsha( Attached, ec, Registered, None, None, &redis::IntResult );
+            Assert::IsTrue( !ec && Result.second == 1 && Connects == 1 && Loads == 2 );
+
+            // a rejected script does not fail the connect, the call reports the server error
+            RejectLoad = true;
+            redis::Connection<redis::SingleHostConnectionManager> Rejected( io_service, Manager );
+            Registry.attach( Rejected );
+            redis::set( Rejected, ec, std::string( "key" ), std::string( "value" ) );
+            Assert::IsTrue( !ec && Loads == 3 );
+            Result = redis::evalScript( Rejected, ec, redis::Script( "return 3" ), None, None, &redis::IntResult );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::server_error ) && Rejected.lastServerError() == "ERR Error compiling script" );
+        }
+
+        TEST_METHOD( Redis_Transaction_Typed_Results )
+        {
+            using namespace std::chrono_literals;
+            boost::system::error_code ec;
+
+            auto Increment = redis::Transaction<>()
+                .add( redis::setCommand( "counter", "0", 60s, redis::SetOptions::SetIfNotExist ), &redis::OKResult )
+                .add( redis::incrCommand( "counter" ), &redis::incrResult );
+            Assert::IsTrue( Increment.size() == 2 );
+
+            ReplayConnection Executed{ "+OK\r\n+QUEUED\r\n+QUEUED\r\n*2\r\n$-1\r\n:1\r\n" };
+            auto Result = Increment.exec( Executed, ec );
+            Assert::IsTrue( !ec && !std::get<0>( Result.second ) && std::get<1>( Result.second ) == 1 );
+
+            // a watched key was modified
+            ReplayConnection Aborted{ "+OK\r\n+QUEUED\r\n+QUEUED\r\n*-1\r\n" };
+            Increment.exec( Aborted, ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::transaction_aborted ) );
+
+            // a failed command is reported, the results before it are set
+            ReplayConnection Failed{ "+OK\r\n+QUEUED\r\n+QUEUED\r\n*2\r\n+OK\r\n-ERR value is not an integer or out of range\r\n" };
+            ec.clear();
+            Result = Increment.exec( Failed, ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::server_error ) && std::get<0>( Result.second ) );
+            Assert::IsTrue( Failed.LastServerError == "ERR value is not an integer or out of range" );
+        }
+
+        TEST_METHOD( Redis_Transaction_Watched_Reconnect )
+        {
+            redis::MockServer Server;
+            boost::asio::io_service io_service;
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::Connection<redis::SingleHostConnectionManager> con( io_service, Manager ), Other( io_service, Manager );
+
+            boost::system::error_code ec;
+            redis::set( con, ec, std::string( "counter" ), std::string( "1" ) );
+            Assert::IsFalse( !!ec );
+
+            const std::vector<std::string> Keys{ "counter" };
+            size_t Attempts = 0;
+            auto Result = redis::watchedTransaction( con, ec, Keys, [&]( auto& con, boost::system::error_code& ec )
+            {
+                // the first read loses the connection and is repeated on a new one - without the watch
+                if( ++Attempts == 1 )
+                    Server.dropAfter( 1 );
+                auto Value = redis::get( con, ec, std::string( "counter" ) );
+                if( ec )
+                {
+                    ec.clear();
+                    Value = redis::get( con, ec, std::string( "counter" ) );
+                }
+                auto Current = std::stoll( std::string( boost::asio::buffer_cast<const char*>( *Value.second ), boost::asio::buffer_size( *Value.second ) ) );
+
+                // modified by another client before EXEC - with the watch lost, this update would be overwritten
+                if( Attempts == 1 )
+                    redis::set( Other, ec, std::string( "counter" ), std::string( "100" ) );
+
+                return redis::Transaction<>().add( redis::setCommand( std::string( "counter" ), std::to_string( Current + 1 ) ), &redis::OKResult );
+            } );
+
+            Assert::IsTrue( !ec && Result && Attempts == 2 );
+            Assert::IsTrue( *Server.value( "counter" ) == "101" );
+        }
+
+        TEST_METHOD( Redis_SharedConnection_Concurrent_Failures )
+        {
+            // nobody listens on port 1 - every submission has to complete with an error instead of blocking
+            redis::SingleHostConnectionManager Unreachable( redis::Host{ "127.0.0.1", 1 } );
+            redis::SharedConnection<redis::SingleHostConnectionManager> Shared( Unreachable );
+
+            std::atomic<size_t> Failures{ 0 };
+            std::vector<std::thread> Workers;
+            for( size_t Index = 0; Index < 4; ++Index )
+                Workers.emplace_back( [&Shared, &Failures]()
+                {
+                    for( size_t Count = 0; Count < 50; ++Count )
+                    {
+                        boost::system::error_code ec;
+                        auto Result = redis::get( Shared, ec, std::string( "key" ) );
+                        if( ec && !Result.second )
+                            ++Failures;
+                    }
+                } );
+            for( auto& Worker : Workers )
+                Worker.join();
+
+            Assert::IsTrue( Failures == 200 );
+            Assert::IsTrue( Shared.statistics().Submissions == 200 );
+        }
+
+        TEST_METHOD( Redis_SharedConnection_MockServer )
+        {
+            redis::MockServer Server;
+            // late replies let the requests of several threads pile up in the queue
+            Server.setLatency( std::chrono::milliseconds( 1 ) );
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::SharedConnection<redis::SingleHostConnectionManager> Shared( Manager );
+
+            // every thread gets its own replies in the order of its requests
+            const size_t Threads = 8, Requests = 100;
+            std::atomic<size_t> OutOfOrder{ 0 };
+            std::vector<std::thread> Workers;
+            for( size_t Index = 0; Index < Threads; ++Index )
+                Workers.emplace_back( [&Shared, &OutOfOrder, Index]()
+                {
+                    std::string Key( "counter" + std::to_string( Index ) );
+                    for( size_t Count = 1; Count <= Requests; ++Count )
+                    {
+                        boost::system::error_code ec;
+                        auto Value = redis::incr( Shared, ec, Key );
+                        if( ec || Value.second != static_cast<int64_t>( Count ) )
+                            ++OutOfOrder;
+                    }
+                } );
+            for( auto& Worker : Workers )
+                Worker.join();
+
+            Assert::IsTrue( OutOfOrder == 0 );
+            auto Statistics = Shared.statistics();
+            Assert::IsTrue( Statistics.Submissions == Threads * Requests );
+            // requests queued during a write are sent together
+            Assert::IsTrue( Statistics.Writes < Statistics.Submissions );
+
+            // the responses of a pipeline are in order, the buffers are replaced while the large replies arrive
+            Server.setLatency( std::chrono::milliseconds( 0 ) );
+            Server.setMaximumWriteSize( 7000 );
+            boost::system::error_code ec;
+            redis::Pipeline Commands;
+            std::vector<std::string> Keys, Values;
+            for( size_t Index = 0; Index < 40; ++Index )
+            {
+                Keys.push_back( "large" + std::to_string( Index ) );
+                Values.push_back( std::string( 10000, static_cast<char>( 'a' + Index % 26 ) ) + std::to_string( Index ) );
+                redis::set( Shared, ec, Keys.back(), Values.back() );
+                Assert::IsFalse( !!ec );
+            }
+            for( const auto& Key : Keys )
+                Commands << redis::getCommand( Key );
+            auto Result = Shared.transmit( Commands, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.size() == 40 );
+            for( size_t Index = 0; Index < 40; ++Index )
+                Assert::IsTrue( std::string( Result[Index].data(), Result[Index].size() ) == Values[Index] );
+
+            // the asynchronous handler is called on the I/O thread
+            std::promise<std::string> Received;
+            redis::async_get( Shared, [&Received]( const boost::system::error_code& ec, const auto& Data )
+            {
+                Received.set_value( !ec && Data ? std::string( boost::asio::buffer_cast<const char*>( *Data ), boost::asio::buffer_size( *Data ) ) : "" );
+            }, Keys[0] );
+            Assert::IsTrue( Received.get_future().get() == Values[0] );
+
+            // a synchronous command in an asynchronous handler fails instead of blocking the I/O thread forever
+            std::promise<boost::system::error_code> Nested;
+            redis::async_get( Shared, [&Shared, &Nested, &Keys]( const boost::system::error_code&, const auto& )
+            {
+                boost::system::error_code ec;
+                redis::get( Shared, ec, Keys[1] );
+                Nested.set_value( ec );
+            }, Keys[0] );
+            Assert::IsTrue( Nested.get_future().get() == boost::system::errc::resource_deadlock_would_occur );
+            redis::get( Shared, ec, Keys[1] );
+            Assert::IsFalse( !!ec );
+        }
+
+        TEST_METHOD( Redis_SharedConnection_Full_Queue )
+        {
+            redis::MockServer Server;
+            redis::SingleHostConnectionManager Manager( Server.host() );
+
+            // the I/O thread does not run yet - the submitters block on the full queue
+            boost::asio::io_service IOService;
+            redis::SharedConnection<redis::SingleHostConnectionManager> Shared( IOService, Manager, 0, redis::NullNotificationSink{}, 2 );
+
+            std::atomic<size_t> Failures{ 0 };
+            std::vector<std::thread> Workers;
+            for( size_t Index = 0; Index < 6; ++Index )
+                Workers.emplace_back( [&Shared, &Failures]()
+                {
+                    for( size_t Count = 0; Count < 20; ++Count )
+                    {
+                        boost::system::error_code ec;
+                        redis::incr( Shared, ec, std::string( "counter" ) );
+                        if( ec )
+                            ++Failures;
+                    }
+                } );
+
+            while( !Shared.statistics().Stalls )
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+            // the connection keeps a read pending - the service has to be stopped
+            std::thread Runner( [&IOService]() { IOService.run(); } );
+            for( auto& Worker : Workers )
+                Worker.join();
+            IOService.stop();
+            Runner.join();
+
+            Assert::IsTrue( Failures == 0 );
+            Assert::IsTrue( *Server.value( "counter" ) == "120" );
+        }
+
+        TEST_METHOD( Redis_ClientRuntime_Dispatch )
+        {
+            redis::SingleHostConnectionManager Unreachable( redis::Host{ "127.0.0.1", 1 } );
+            redis::ClientRuntimeOptions Options;
+            Options.Threads = 3;
+            Options.ConnectionsPerThread = 2;
+            redis::ClientRuntime<redis::SingleHostConnectionManager> Runtime( Unreachable, Options );
+            Assert::IsTrue( Runtime.threads() == 3 );
+
+            boost::system::error_code ec;
+            for( size_t Index = 0; Index < 30; ++Index )
+            {
+                ec.clear();
+                redis::get( Runtime, ec, "key" + std::to_string( Index ) );
+                Assert::IsTrue( !!ec );
+            }
+
+            // requests without a key go to the least loaded thread
+            ec.clear();
+            redis::ping( Runtime, ec );
+            Assert::IsTrue( !!ec );
+
+            // the asynchronous handlers are called on the io_service of the caller
+            boost::asio::io_service Caller;
+            boost::asio::io_service::work Waiting( Caller );
+            auto Posting = Runtime.postingTo( Caller );
+            bool Called = false;
+            redis::async_get( Posting, [&Called]( const auto& ec, const auto& Value ) { Called = true; }, std::string( "key" ) );
+            Caller.run_one();
+            Assert::IsTrue( Called );
+
+            Assert::IsTrue( Runtime.statistics().Submissions == 32 );
+        }
+
+        TEST_METHOD( Redis_ClientRuntime_Key_Routing )
+        {
+            // a late INCR delays the following replies of its connection
+            redis::MockServer Server;
+            Server.setScript( []( const redis::MockServer::Command& Command )
+            {
+                redis::MockAction Action;
+                if( Command[0] == "INCR" )
+                    Action.Latency = std::chrono::milliseconds( 100 );
+                else if( Command[0] == "OBJECT" )
+                    Action.Reply = redis::Detail::respBulk( "int" );
+                return Action;
+            } );
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::ClientRuntimeOptions Options;
+            Options.Threads = 3;
+            Options.ConnectionsPerThread = 2;
+            redis::ClientRuntime<redis::SingleHostConnectionManager> Runtime( Manager, Options );
+
+            boost::asio::io_service Caller;
+            boost::asio::io_service::work Waiting( Caller );
+            auto Posting = Runtime.postingTo( Caller );
+
+            // OBJECT ENCODING takes its key as second argument - it has to use the connection of the INCR and is answered
+            // after it
+            std::vector<std::string> Completed;
+            redis::Request Increment( "INCR" );
+            Increment << "counter";
+            redis::Request Encoding( "OBJECT" );
+            Encoding << "ENCODING" << "counter";
+            Posting.async_command( Increment, [&Completed]( const boost::system::error_code& ec, const redis::Response& ) { Completed.push_back( ec ? "failed" : "INCR" ); } );
+            Posting.async_command( Encoding, [&Completed]( const boost::system::error_code& ec, const redis::Response& ) { Completed.push_back( ec ? "failed" : "OBJECT" ); } );
+            Caller.run_one();
+            Caller.run_one();
+            Assert::IsTrue( Completed == std::vector<std::string>{ "INCR", "OBJECT" } );
+
+            // commands without a key go to the least loaded thread
+            boost::system::error_code ec;
+            auto Reply = Runtime.transmit( redis::Request( "PING" ), ec );
+            Assert::IsTrue( !ec && Reply->top().string() == "PONG" );
+        }
+
+        TEST_METHOD( Redis_ClientRuntime_MockServer )
+        {
+            redis::MockServer Server;
+            Server.setLatency( std::chrono::milliseconds( 1 ) );
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::ClientRuntimeOptions Options;
+            Options.Threads = 3;
+            Options.ConnectionsPerThread = 2;
+            redis::ClientRuntime<redis::SingleHostConnectionManager> Runtime( Manager, Options );
+
+            // the asynchronous requests for a key are executed in order, their handlers are called on the io_service
+            // of the caller
+            boost::asio::io_service Caller;
+            boost::asio::io_service::work Waiting( Caller );
+            auto Posting = Runtime.postingTo( Caller );
+            const size_t Keys = 8, Requests = 50;
+            std::vector<std::string> Names;
+            for( size_t Key = 0; Key < Keys; ++Key )
+                Names.push_back( "counter" + std::to_string( Key ) );
+
+            std::vector<std::vector<int64_t>> Values( Keys );
+            size_t ForeignThread = 0;
+            auto CallerThread = std::this_thread::get_id();
+            for( size_t Count = 0; Count < Requests; ++Count )
+                for( size_t Key = 0; Key < Keys; ++Key )
+                    redis::async_incr( Posting, [&Values, &ForeignThread, CallerThread, Key]( const boost::system::error_code& ec, int64_t Value )
+                    {
+                        if( std::this_thread::get_id() != CallerThread )
+                            ++ForeignThread;
+                        Values[Key].push_back( ec ? -1 : Value );
+                    }, Names[Key] );
+
+            size_t Handled = 0;
+            while( Handled < Keys * Requests )
+                Handled += Caller.run_one();
+
+            Assert::IsTrue( ForeignThread == 0 );
+            for( const auto& KeyValues : Values )
+                for( size_t Index = 0; Index < Requests; ++Index )
+                    Assert::IsTrue( KeyValues[Index] == static_cast<int64_t>( Index + 1 ) );
+
+            // the synchronous requests of several threads for the same keys do not get lost
+            std::vector<std::thread> Workers;
+            for( size_t Index = 0; Index < 4; ++Index )
+                Workers.emplace_back( [&Runtime, &Names]()
+                {
+                    for( const auto& Name : Names )
+                    {
+                        boost::system::error_code ec;
+                        redis::incr( Runtime, ec, Name );
+                    }
+                } );
+            for( auto& Worker : Workers )
+                Worker.join();
+
+            for( const auto& Name : Names )
+                Assert::IsTrue( *Server.value( Name ) == std::to_string( Requests + 4 ) );
+            Assert::IsTrue( Runtime.statistics().Submissions == Keys * (Requests + 4) );
+        }
+
+        TEST_METHOD( Redis_Notification_Level_Gating )
+        {
+            size_t Evaluated = 0;
+            auto Argument = [&Evaluated]() { ++Evaluated; return std::string( "payload" ); };
+
+            redis::NullNotificationSink Null;
+            REDISPP_NOTIFY( Null, debug, "'{}'", Argument() );
+            Assert::IsTrue( Evaluated == 0 );
+
+            size_t Notifications = 0;
+            WarningCountingSink Warnings{ &Notifications };
+            REDISPP_NOTIFY( Warnings, debug, "'{}'", Argument() );
+            REDISPP_NOTIFY( Warnings, warning, "'{}'", Argument() );
+            Assert::IsTrue( Evaluated == 1 && Notifications == 1 );
+
+            RuntimeLevelSink Runtime{ redis::NotificationLevel::trace };
+            REDISPP_NOTIFY( Runtime, debug, "'{}'", Argument() );
+            REDISPP_NOTIFY( Runtime, trace, "'{}'", Argument() );
+            Assert::IsTrue( Evaluated == 2 );
+
+            // the parser does not build the debug strings for a disabled sink
+            Assert::IsTrue( testit( "$5\r\nhello\r\n", redis::ResponseHandler<>(), []( auto ParseId, const auto& Data ) { return Data.string() == "hello"; } ) );
+        }
+
+        TEST_METHOD( Redis_Metrics_Histogram_Percentiles )
+        {
+            // bucket boundaries are continuous and the relative error stays below 1/16
+            for( uint64_t Value : { 0ull, 31ull, 32ull, 63ull, 64ull, 1000ull, 123456789ull } )
+            {
+                auto Index = redis::LatencyHistogram::bucketIndex( Value );
+                Assert::IsTrue( redis::LatencyHistogram::bucketValue( Index ) <= Value );
+                Assert::IsTrue( Value - redis::LatencyHistogram::bucketValue( Index ) <= Value / 16 );
+            }
+
+            redis::RedisMetrics Metrics;
+            for( uint64_t Microseconds = 1; Microseconds <= 1000; ++Microseconds )
+                Metrics.commandCompleted( "GET", std::chrono::microseconds( Microseconds ), Microseconds > 990 );
+            std::thread Other( [&Metrics]() { Metrics.commandCompleted( "GET", std::chrono::milliseconds( 5 ), false ); } );
+            Other.join();
+
+            // commands sent to an unreachable server are recorded as failed
+            redis::SingleHostConnectionManager Unreachable( redis::Host{ "127.0.0.1", 1 } );
+            boost::asio::io_service io_service;
+            redis::Connection<redis::SingleHostConnectionManager, redis::NullNotificationSink, redis::RedisMetrics&> con( io_service, Unreachable, 0, redis::NullNotificationSink{}, Metrics );
+            boost::system::error_code ec;
+            redis::ping( con, ec );
+            Assert::IsTrue( !!ec );
+
+            auto Snapshot = Metrics.snapshot();
+            const auto& Get = Snapshot.Commands.at( "GET" );
+            Assert::IsTrue( Get.Count == 1001 );
+            Assert::IsTrue( Get.Failures == 10 );
+            Assert::IsTrue( Get.Maximum == 5000000 );
+            Assert::IsTrue( Get.percentile( 50. ) >= 480000 && Get.percentile( 50. ) <= 540000 );
+            Assert::IsTrue( Get.percentile( 99. ) >= 960000 && Get.percentile( 99. ) <= 1060000 );
+            Assert::IsTrue( Snapshot.Commands.at( "PING" ).Failures == 1 );
+
+            std::ostringstream Export;
+            Snapshot.writeTo( Export );
+            Assert::IsTrue( Export.str().find( "command GET count=1001 failures=10" ) != std::string::npos );
+        }
+
+        TEST_METHOD( Redis_Tracing_Request_Spans )
+        {
+            SpanRecorder Tracer;
+            redis::SingleHostConnectionManager Unreachable( redis::Host{ "127.0.0.1", 1 } );
+            boost::asio::io_service io_service;
+            redis::Connection<redis::SingleHostConnectionManager, redis::NullNotificationSink, redis::NullMetrics, SpanRecorder&> con( io_service, Unreachable, 0, redis::NullNotificationSink{}, redis::NullMetrics{}, Tracer );
+
+            boost::system::error_code ec;
+            redis::ping( con, ec );
+            Assert::IsTrue( !!ec );
+
+            redis::Pipeline Commands;
+            Commands << redis::pingCommand();
+            con.transmit( Commands, ec );
+            Assert::IsTrue( !!ec );
+
+            // connecting failed - the span ends without a connection
+            Assert::IsTrue( Tracer.Spans.size() == 2 );
+            Assert::IsTrue( Tracer.Commands[0] == "PING" && Tracer.Commands[1] == "PIPELINE" );
+            for( const auto& Span : Tracer.Spans )
+            {
+                Assert::IsTrue( Span.Failed );
+                Assert::IsTrue( Span.reached( redis::TracePoint::Enqueued ) && Span.reached( redis::TracePoint::HandlerInvoked ) );
+                Assert::IsFalse( Span.reached( redis::TracePoint::ConnectionAcquired ) || Span.reached( redis::TracePoint::FirstResponseByte ) );
+                Assert::IsTrue( Span.between( redis::TracePoint::Enqueued, redis::TracePoint::HandlerInvoked ) >= redis::TraceClock::duration::zero() );
+            }
+        }
+
+        TEST_METHOD( Redis_MockServer_Commands )
+        {
+            redis::MockServer Server;
+            // every reply arrives late and in pieces of 3 bytes
+            Server.setLatency( std::chrono::milliseconds( 2 ) );
+            Server.setMaximumWriteSize( 3 );
+
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            boost::asio::io_service io_service;
+            redis::Connection<redis::SingleHostConnectionManager> con( io_service, Manager );
+
+            boost::system::error_code ec;
+            redis::set( con, ec, std::string( "key" ), std::string( "value" ) );
+            Assert::IsFalse( !!ec );
+            auto Value = redis::get( con, ec, std::string( "key" ) );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Value.second && std::string( boost::asio::buffer_cast<const char*>( *Value.second ), boost::asio::buffer_size( *Value.second ) ) == "value" );
+            redis::hset( con, ec, std::string( "hash" ), std::string( "field" ), std::string( "1" ) );
+            Assert::IsFalse( !!ec );
+
+            // a scripted error and a dropped connection
+            Server.setScript( []( const redis::MockServer::Command& Command )
+            {
+                redis::MockAction Action;
+                if( Command[0] == "GET" )
+                    Action.Reply = "-LOADING Redis is loading the dataset in memory\r\n";
+                return Action;
+            } );
+            redis::get( con, ec, std::string( "key" ) );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::server_error ) );
+            Server.setScript( nullptr );
+            Server.dropAfter( 1 );
+            redis::get( con, ec, std::string( "key" ) );
+            Assert::IsTrue( !!ec );
+
+            Assert::IsTrue( *Server.value( "key" ) == "value" );
+            Assert::IsTrue( Server.commands() >= 5 );
+        }
+
+        TEST_METHOD( Redis_MockServer_Sentinel_Failover )
+        {
+            redis::MockServer Master, Replica( redis::MockRole::Replica ), Sentinel( redis::MockRole::Sentinel );
+            Replica.setRole( redis::MockRole::Replica, Master.host() );
+            Sentinel.setMaster( "mymaster", Master.host() );
+            Sentinel.setSentinels( "mymaster", { Sentinel.host() } );
+            Sentinel.setReplicas( "mymaster", { Replica.host() } );
+
+            boost::asio::io_service io_service;
+            redis::SentinelConnectionManager<> Manager( io_service, { Sentinel.host() }, "mymaster", redis::NullNotificationSink{}, std::chrono::milliseconds::zero() );
+            redis::Connection<redis::SentinelConnectionManager<>> con( io_service, Manager );
+
+            boost::system::error_code ec;
+            redis::set( con, ec, std::string( "key" ), std::string( "before" ) );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( *Master.value( "key" ) == "before" );
+
+            // the replica is promoted, the old master demoted and its clients disconnected
+            Replica.setRole( redis::MockRole::Master );
+            Master.setRole( redis::MockRole::Replica, Replica.host() );
+            Sentinel.setMaster( "mymaster", Replica.host() );
+            Master.dropConnections();
+
+            for( size_t Attempt = 0; Attempt < 3; ++Attempt )
+            {
+                ec.clear();
+                redis::set( con, ec, std::string( "key" ), std::string( "after" ) );
+                if( !ec )
+                    break;
+            }
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( *Replica.value( "key" ) == "after" );
+            Assert::IsTrue( *Master.value( "key" ) == "before" );
+        }
+
+        TEST_METHOD( Redis_Loopback_Transport )
+        {
+            redis::MockEngine Engine;
+            redis::LoopbackConnectionManager Loopback( Engine );
+            boost::asio::io_service io_service;
+            // database 2 - the SELECT runs on the passed socket before the first command
+            redis::Connection<redis::LoopbackConnectionManager> con( io_service, Loopback, 2 );
+
+            boost::system::error_code ec;
+            redis::set( con, ec, std::string( "key" ), std::string( "value" ) );
+            Assert::IsFalse( !!ec );
+
+            redis::Pipeline Commands;
+            for( size_t Index = 0; Index < 100; ++Index )
+                Commands << redis::incrCommand( std::string( "counter" ) );
+            auto Result = con.transmit( Commands, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.size() == 100 && Result[99].asint() == 100 );
+
+            auto Value = redis::get( con, ec, std::string( "key" ) );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Value.second && boost::asio::buffer_size( *Value.second ) == 5 );
+            Assert::IsTrue( Engine.commands() == 103 );
+            Assert::IsTrue( *Engine.value( "counter" ) == "100" );
+        }
+
+        TEST_METHOD( Redis_FireAndForget_Modes )
+        {
+            redis::MockEngine Engine;
+            redis::LoopbackConnectionManager Loopback( Engine );
+            boost::system::error_code ec;
+
+            // counted: only the errors are reported, with the index of their command
+            std::vector<size_t> Failed;
+            redis::FireAndForgetWriter<redis::LoopbackConnectionManager> Counted( Loopback, redis::FireAndForgetMode::Counted, [&Failed]( size_t CommandIndex, boost::string_view ) { Failed.push_back( CommandIndex ); } );
+            Assert::IsTrue( Counted.send( redis::setCommand( std::string( "text" ), std::string( "abc" ) ), ec ) );
+            for( size_t Index = 0; Index < 1000; ++Index )
+                Counted.send( redis::incrCommand( std::string( Index == 500 ? "text" : "counter" ) ), ec );
+            Assert::IsTrue( Counted.flush( ec ) );
+            Assert::IsTrue( Counted.commands() == 1001 && Counted.confirmed() == 1001 && Counted.errors() == 1 && Counted.lost() == 0 );
+            Assert::IsTrue( Failed.size() == 1 && Failed[0] == 501 );
+            Assert::IsTrue( *Engine.value( "counter" ) == "999" );
+
+            // off: the server sends nothing until the flush asks for a confirmation
+            redis::FireAndForgetWriter<redis::LoopbackConnectionManager> Off( Loopback, redis::FireAndForgetMode::Off );
+            redis::Pipeline Commands;
+            for( size_t Index = 0; Index < 100; ++Index )
+                Commands << redis::incrCommand( std::string( "other" ) );
+            Assert::IsTrue( Off.send( Commands, ec ) );
+            Assert::IsTrue( Off.confirmed() == 0 );
+            Assert::IsTrue( Off.flush( ec ) );
+            Assert::IsTrue( Off.confirmed() == 100 );
+            Assert::IsTrue( *Engine.value( "other" ) == "100" );
+        }
+
+        TEST_METHOD( Redis_FireAndForget_Reconnect )
+        {
+            redis::MockServer Server;
+            std::mutex Mutex;
+            std::vector<std::string> Received;
+            Server.setScript( [&Mutex, &Received]( const redis::MockServer::Command& TheCommand ) {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Received.push_back( TheCommand[0] + (TheCommand.size() > 1 ? " " + TheCommand[1] : "") );
+                return redis::MockAction();
+            } );
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            boost::system::error_code ec;
+
+            // the database is selected before the first command, its reply is not counted
+            std::vector<size_t> Failed;
+            redis::FireAndForgetWriter<redis::SingleHostConnectionManager> Writer( Manager, redis::FireAndForgetMode::Counted, [&Failed]( size_t CommandIndex, boost::string_view ) { Failed.push_back( CommandIndex ); }, 3 );
+            for( size_t Index = 0; Index < 10; ++Index )
+                Writer.send( redis::incrCommand( std::string( "counter" ) ), ec );
+            Assert::IsTrue( Writer.flush( ec ) );
+            Assert::IsTrue( Writer.confirmed() == 10 && Writer.lost() == 0 );
+            Assert::IsTrue( Received.front() == "SELECT 3" && Received.size() == 11 );
+
+            // the connection is dropped at the third command - the commands without a reply are lost, not confirmed
+            Server.dropAfter( 3 );
+            redis::Pipeline Commands;
+            for( size_t Index = 0; Index < 5; ++Index )
+                Commands << redis::incrCommand( std::string( "counter" ) );
+            Assert::IsTrue( Writer.send( Commands, ec ) );
+            Assert::IsFalse( Writer.flush( ec ) );
+            Assert::IsTrue( Writer.commands() == 15 && Writer.lost() >= 3 );
+            Assert::IsTrue( Writer.confirmed() + Writer.lost() == 15 );
+            auto Lost = Writer.lost();
+
+            // the next send reconnects and selects the database again - errors keep the index of their command
+            Assert::IsTrue( Writer.send( redis::setCommand( std::string( "text" ), std::string( "abc" ) ), ec ) );
+            Assert::IsTrue( Writer.send( redis::incrCommand( std::string( "text" ) ), ec ) );
+            Assert::IsTrue( Writer.flush( ec ) );
+            Assert::IsTrue( Failed.size() == 1 && Failed[0] == 16 );
+            Assert::IsTrue( Writer.lost() == Lost && Writer.confirmed() == 17 - Lost );
+            Assert::IsTrue( std::count( Received.begin(), Received.end(), "SELECT 3" ) == 2 );
+
+            // off: the database is selected before the replies are switched off
+            Received.clear();
+            redis::FireAndForgetWriter<redis::SingleHostConnectionManager> Off( Manager, redis::FireAndForgetMode::Off, nullptr, 3 );
+            Assert::IsTrue( Off.send( redis::incrCommand( std::string( "other" ) ), ec ) );
+            Assert::IsTrue( Off.flush( ec ) );
+            Assert::IsTrue( Off.confirmed() == 1 && Off.lost() == 0 );
+            Assert::IsTrue( Received.size() >= 3 && Received[0] == "SELECT 3" && Received[1] == "CLIENT REPLY" && Received[2] == "INCR other" );
+        }
+
+        TEST_METHOD( Redis_Response_Wire_Bytes )
+        {
+            const std::vector<std::string> Replies{ "+OK\r\n", "-ERR wrong type\r\n", ":42\r\n", "$5\r\nhello\r\n", "$-1\r\n", "*-1\r\n", "*0\r\n",
+                "*3\r\n$3\r\nfoo\r\n*2\r\n:1\r\n$10\r\n0123456789\r\n+bar\r\n", "*2\r\n*2\r\n*1\r\n$3\r\nabc\r\n*0\r\n$-1\r\n" };
+            std::string Input;
+            for( const auto& Reply : Replies )
+                Input += Reply;
+
+            boost::system::error_code ec;
+            for( size_t Buffersize = 1; Buffersize <= Input.size(); ++Buffersize )
+            {
+                redis::ResponseHandler<> rh{ Buffersize };
+
+                auto r = testitmultiple( Input, rh, Replies.size(), ec );
+                Assert::IsTrue( !ec );
+                for( size_t Index = 0; Index < Replies.size(); ++Index )
+                {
+                    std::string Wire;
+                    for( const auto& Buffer : r[Index]->wire() )
+                        Wire.append( boost::asio::buffer_cast<const char*>( Buffer ), boost::asio::buffer_size( Buffer ) );
+                    Assert::IsTrue( Wire == Replies[Index] );
+                    Assert::IsTrue( r[Index]->wireSize() == Replies[Index].size() );
+                }
+            }
+
+            // received into a single buffer - a single piece, forwardable with one write
+            redis::ResponseHandler<> rh;
+            auto r = testitmultiple( Replies[7], rh, 1, ec );
+            Assert::IsTrue( !ec );
+            Assert::IsTrue( r[0]->wire().size() == 1 );
+            Assert::IsTrue( redis::Response().wire().empty() );
+        }
+
+        TEST_METHOD( Redis_Pipeline_Parallel_Receive )
+        {
+            redis::MockEngine Engine;
+            redis::LoopbackConnectionManager Loopback( Engine );
+            boost::asio::io_service io_service;
+            redis::Connection<redis::LoopbackConnectionManager> con( io_service, Loopback );
+
+            boost::system::error_code ec;
+            redis::Pipeline Writes;
+            for( size_t Index = 0; Index < 50; ++Index )
+                Writes << redis::setCommand( "key" + std::to_string( Index ), std::string( 5000, static_cast<char>( 'a' + Index % 26 ) ) );
+            con.transmit( Writes, ec );
+            Assert::IsFalse( !!ec );
+
+            // small buffers - replies span many reads and the I/O thread has to wait for the parser
+            redis::ParallelReceiveSettings Settings;
+            Settings.ChunkSize = 1000;
+            Settings.Chunks = 2;
+
+            redis::Pipeline Reads;
+            for( size_t Index = 0; Index < 50; ++Index )
+                Reads << redis::getCommand( "key" + std::to_string( Index ) );
+            Reads << redis::incrCommand( std::string( "counter" ) );
+
+            redis::ReceiveStageTimes Times;
+            auto Result = con.transmit( Reads, ec, Settings, &Times );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.size() == 51 );
+            for( size_t Index = 0; Index < 50; ++Index )
+                Assert::IsTrue( Result[Index].string() == std::string( 5000, static_cast<char>( 'a' + Index % 26 ) ) );
+            Assert::IsTrue( Result[50].asint() == 1 );
+
+            // 50 * "$5000\r\n" + data + CRLF and ":1\r\n"
+            Assert::IsTrue( Times.Bytes == 50 * 5009 + 4 );
+            Assert::IsTrue( Times.Reads >= Times.Bytes / Settings.ChunkSize );
+            Assert::IsTrue( Times.Total >= Times.Parse );
+
+            // the connection is usable as before
+            Assert::IsTrue( con.transmit( Reads, ec ).size() == 51 );
+            Assert::IsFalse( !!ec );
+
+            // a failing parser stops the I/O thread, which waits for a free buffer, instead of terminating the process
+            struct ReplaySocket
+            {
+                std::string Data;
+                size_t Position;
+
+                size_t read_some( const boost::asio::mutable_buffer& Buffer, boost::system::error_code& ec )
+                {
+                    auto Size = std::min( boost::asio::buffer_size( Buffer ), Data.size() - Position );
+                    std::memcpy( boost::asio::buffer_cast<char*>( Buffer ), Data.data() + Position, Size );
+                    Position += Size;
+                    return Size;
+                }
+            };
+            struct FailingTrace
+            {
+                void dataReceived() { throw std::runtime_error( "parser failed" ); }
+            };
+
+            std::string Integers;
+            for( size_t Index = 0; Index < 20; ++Index )
+                Integers += ":1\r\n";
+            ReplaySocket Socket{ Integers, 0 };
+            redis::ResponseHandler<> Handler;
+            redis::Response::ElementContainer Parsed( 20 );
+            Settings.ChunkSize = 10;
+            FailingTrace Failing;
+            bool Thrown = false;
+            try
+            {
+                redis::Detail::receiveParallel( Socket, Handler, Parsed, 20, Settings, Times, Failing, ec );
+            }
+            catch( const std::runtime_error& )
+            {
+                Thrown = true;
+            }
+            Assert::IsTrue( Thrown );
+        }
+
+        TEST_METHOD( Redis_Sentinel_MasterEndpointCache )
+        {
+            using Cache = redis::SentinelConnectionManager<>::MasterEndpointCache;
+            const redis::Host First( "10.0.0.1", 6379 ), Second( "10.0.0.2", 6379 );
+
+            Cache TheCache( std::chrono::milliseconds( 200 ) );
+            Assert::IsFalse( !!TheCache.get() );
+            TheCache.set( First );
+            Assert::IsTrue( TheCache.get() && *TheCache.get() == First );
+
+            // only the failed master is forgotten - a newer entry stored by another thread is kept
+            TheCache.invalidate( Second );
+            Assert::IsTrue( TheCache.get() && *TheCache.get() == First );
+            TheCache.invalidate( First );
+            Assert::IsFalse( !!TheCache.get() );
+
+            TheCache.set( Second );
+            TheCache.invalidate();
+            Assert::IsFalse( !!TheCache.get() );
+
+            // expiry
+            TheCache.set( First );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+            Assert::IsFalse( !!TheCache.get() );
+
+            // a validity of zero disables the cache
+            Cache Disabled( std::chrono::milliseconds::zero() );
+            Disabled.set( First );
+            Assert::IsFalse( !!Disabled.get() );
+        }
+
+        TEST_METHOD( Redis_Sentinel_Cached_Master_Connect )
+        {
+            redis::MockServer Master, Replica( redis::MockRole::Replica ), Sentinel( redis::MockRole::Sentinel );
+            Replica.setRole( redis::MockRole::Replica, Master.host() );
+            Sentinel.setMaster( "mymaster", Master.host() );
+            Sentinel.setSentinels( "mymaster", { Sentinel.host() } );
+            Sentinel.setReplicas( "mymaster", { Replica.host() } );
+
+            boost::asio::io_service io_service;
+            redis::SentinelConnectionManager<> Manager( io_service, { Sentinel.host() }, "mymaster", redis::NullNotificationSink{}, std::chrono::seconds( 30 ) );
+            redis::Connection<redis::SentinelConnectionManager<>> con( io_service, Manager );
+
+            // writes the key, reconnecting if the connection was dropped
+            auto setKey = [&]( const std::string& Value ) {
+                boost::system::error_code ec;
+                for( size_t Attempt = 0; Attempt < 3; ++Attempt )
+                {
+                    ec.clear();
+                    redis::set( con, ec, std::string( "key" ), Value );
+                    if( !ec )
+                        break;
+                }
+                return ec;
+            };
+
+            Assert::IsFalse( !!setKey( "first" ) );
+            auto SentinelCommands = Sentinel.commands();
+            Assert::IsTrue( SentinelCommands > 0 );
+
+            // a reconnect goes straight to the cached master
+            Master.dropConnections();
+            Assert::IsFalse( !!setKey( "second" ) );
+            Assert::IsTrue( *Master.value( "key" ) == "second" );
+            Assert::IsTrue( Sentinel.commands() == SentinelCommands );
+
+            // the cached master answers ROLE as replica after the failover - the cache is invalidated and the
+            // sentinel asked again
+            Replica.setRole( redis::MockRole::Master );
+            Master.setRole( redis::MockRole::Replica, Replica.host() );
+            Sentinel.setMaster( "mymaster", Replica.host() );
+            Master.dropConnections();
+
+            Assert::IsFalse( !!setKey( "third" ) );
+            Assert::IsTrue( *Replica.value( "key" ) == "third" );
+            Assert::IsTrue( Sentinel.commands() > SentinelCommands );
+
+            // an explicit invalidation asks the sentinel on the next connect as well
+            SentinelCommands = Sentinel.commands();
+            Manager.invalidateMasterCache();
+            Replica.dropConnections();
+            Assert::IsFalse( !!setKey( "fourth" ) );
+            Assert::IsTrue( Sentinel.commands() > SentinelCommands );
+        }
+
+        TEST_METHOD( Redis_Sentinel_Async_Connect )
+        {
+            redis::MockServer Master, Sentinel( redis::MockRole::Sentinel );
+            Sentinel.setMaster( "mymaster", Master.host() );
+            Sentinel.setSentinels( "mymaster", { Sentinel.host() } );
+            Sentinel.setLatency( std::chrono::milliseconds( 50 ) );
+
+            boost::asio::io_service io_service;
+            redis::SentinelConnectionManager<> Manager( io_service, { Sentinel.host() }, "mymaster" );
+            auto Instance = Manager.getInstance();
+
+            // the discovery does not block the io_service - a handler posted afterwards runs first
+            std::vector<std::string> Order;
+            Instance.async_getConnectedSocket( io_service, [&Order]( const boost::system::error_code& ec, std::shared_ptr<boost::asio::ip::tcp::socket> spSocket )
+            {
+                Order.push_back( !ec && spSocket->is_open() ? "connected" : "failed" );
+            } );
+            io_service.post( [&Order]() { Order.push_back( "posted" ); } );
+            io_service.run();
+
+            Assert::IsTrue( Order.size() == 2 && Order[0] == "posted" && Order[1] == "connected" );
+        }
+
+        TEST_METHOD( Redis_ReplicaSet_Policies )
+        {
+            const redis::Host First( "10.0.0.1", 6379 ), Second( "10.0.0.2", 6379 ), Third( "10.0.0.3", 6379 );
+            redis::ReplicaSet Replicas( std::chrono::milliseconds( 100 ) );
+
+            redis::Host Replica;
+            redis::ReplicaSet::StatisticsHandle spStatistics;
+            Assert::IsFalse( Replicas.select( redis::ReadPolicy::RoundRobin, Replica, spStatistics ) );
+            Assert::IsTrue( Replicas.lastUpdate() == std::chrono::steady_clock::time_point() );
+
+            Replicas.set( { First, Second, Third } );
+            Assert::IsTrue( Replicas.size() == 3 );
+            Assert::IsFalse( Replicas.select( redis::ReadPolicy::Master, Replica, spStatistics ) );
+
+            // round robin visits every replica once per round
+            std::map<redis::Host, redis::ReplicaSet::StatisticsHandle> Statistics;
+            for( size_t Round = 0; Round < 2; ++Round )
+            {
+                std::set<redis::Host> Seen;
+                for( size_t Count = 0; Count < 3; ++Count )
+                {
+                    Assert::IsTrue( Replicas.select( redis::ReadPolicy::RoundRobin, Replica, spStatistics ) );
+                    Seen.insert( Replica );
+                    Statistics[Replica] = spStatistics;
+                }
+                Assert::IsTrue( Seen.size() == 3 );
+            }
+
+            // the replica with the fewest outstanding requests, wherever the scan starts
+            Statistics[First]->Outstanding = 2;
+            Statistics[Second]->Outstanding = 0;
+            Statistics[Third]->Outstanding = 1;
+            for( size_t Count = 0; Count < 3; ++Count )
+            {
+                Assert::IsTrue( Replicas.select( redis::ReadPolicy::LeastOutstanding, Replica, spStatistics ) );
+                Assert::IsTrue( Replica == Second );
+            }
+
+            // the first sample is taken as is, later ones are weighted 1/8
+            Replicas.completed( *Statistics[First], std::chrono::microseconds( 300 ), true );
+            Replicas.completed( *Statistics[Second], std::chrono::microseconds( 500 ), true );
+            Replicas.completed( *Statistics[Third], std::chrono::microseconds( 100 ), true );
+            Assert::IsTrue( Statistics[Third]->LatencyMicroseconds == 100 );
+            Replicas.completed( *Statistics[Third], std::chrono::microseconds( 900 ), true );
+            Assert::IsTrue( Statistics[Third]->LatencyMicroseconds == 200 );
+            for( size_t Count = 0; Count < 3; ++Count )
+            {
+                Assert::IsTrue( Replicas.select( redis::ReadPolicy::LowestLatency, Replica, spStatistics ) );
+                Assert::IsTrue( Replica == Third );
+            }
+
+            // a failed replica is skipped for the error backoff
+            Replicas.completed( *Statistics[Third], std::chrono::microseconds( 100 ), false );
+            for( size_t Count = 0; Count < 3; ++Count )
+            {
+                Assert::IsTrue( Replicas.select( redis::ReadPolicy::LowestLatency, Replica, spStatistics ) );
+                Assert::IsTrue( Replica == First );
+                Assert::IsTrue( Replicas.select( redis::ReadPolicy::RoundRobin, Replica, spStatistics ) );
+                Assert::IsFalse( Replica == Third );
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 150 ) );
+            Assert::IsTrue( Replicas.select( redis::ReadPolicy::LowestLatency, Replica, spStatistics ) );
+            Assert::IsTrue( Replica == Third );
+
+            // statistics of replicas still known are kept
+            Replicas.set( { Third, First } );
+            Assert::IsTrue( Replicas.size() == 2 );
+            Assert::IsTrue( Replicas.lastUpdate() != std::chrono::steady_clock::time_point() );
+            Assert::IsTrue( Replicas.select( redis::ReadPolicy::LowestLatency, Replica, spStatistics ) );
+            Assert::IsTrue( Replica == Third && spStatistics == Statistics[Third] );
+        }
+
+        TEST_METHOD( Redis_ReadRouting_Async_Reads )
+        {
+            redis::MockServer Master, Replica, Sentinel( redis::MockRole::Sentinel );
+            redis::MockEngine::Client Admin;
+            Master.engine().execute( Admin, { "SET", "key", "master" } );
+            Replica.engine().execute( Admin, { "SET", "key", "replica" } );
+            Replica.setRole( redis::MockRole::Replica, Master.host() );
+            Sentinel.setMaster( "mymaster", Master.host() );
+            Sentinel.setSentinels( "mymaster", { Sentinel.host() } );
+            Sentinel.setReplicas( "mymaster", { Replica.host() } );
+
+            boost::asio::io_service io_service;
+            redis::SentinelConnectionManager<> Manager( io_service, { Sentinel.host() }, "mymaster" );
+            redis::ReadRoutingConnection<> con( io_service, Manager, redis::ReadPolicy::LeastOutstanding );
+
+            // the replicas are discovered in the background - the first read would go to the master otherwise
+            boost::system::error_code ec;
+            Manager.refreshReplicas( io_service, ec );
+            Assert::IsFalse( !!ec );
+
+            auto readKey = [&]() {
+                std::string Value;
+                redis::async_get( con, [&Value]( const boost::system::error_code& ec, const auto& Data ) {
+                    if( !ec && Data )
+                        Value.assign( boost::asio::buffer_cast<const char*>( *Data ), boost::asio::buffer_size( *Data ) );
+                }, std::string( "key" ) );
+                io_service.run();
+                io_service.reset();
+                return Value;
+            };
+
+            // the read is recorded in the statistics of the replica
+            Assert::IsTrue( readKey() == "replica" );
+            redis::Host Selected;
+            redis::ReplicaSet::StatisticsHandle spStatistics;
+            Assert::IsTrue( Manager.replicas().select( redis::ReadPolicy::RoundRobin, Selected, spStatistics ) );
+            Assert::IsTrue( Selected == Replica.host() );
+            Assert::IsTrue( spStatistics->Outstanding == 0 );
+            Assert::IsTrue( spStatistics->LatencyMicroseconds > 0 );
+
+            // the replica drops the connection - the read is answered by the master and the replica skipped
+            Replica.setScript( []( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                Action.Drop = TheCommand[0] == "GET";
+                return Action;
+            } );
+            Assert::IsTrue( readKey() == "master" );
+            Assert::IsTrue( spStatistics->Outstanding == 0 );
+            Assert::IsFalse( Manager.replicas().select( redis::ReadPolicy::RoundRobin, Selected, spStatistics ) );
+            Assert::IsTrue( readKey() == "master" );
+        }
+
+        TEST_METHOD( Redis_ReadRouting_Replica_Errors )
+        {
+            redis::MockServer Master, Replica, Sentinel( redis::MockRole::Sentinel );
+            redis::MockEngine::Client Admin;
+            Master.engine().execute( Admin, { "SET", "key", "master" } );
+            Replica.engine().execute( Admin, { "SET", "key", "replica" } );
+            Replica.setRole( redis::MockRole::Replica, Master.host() );
+            Sentinel.setMaster( "mymaster", Master.host() );
+            Sentinel.setSentinels( "mymaster", { Sentinel.host() } );
+            Sentinel.setReplicas( "mymaster", { Replica.host() } );
+
+            boost::asio::io_service io_service;
+            redis::SentinelConnectionManager<> Manager( io_service, { Sentinel.host() }, "mymaster" );
+            redis::ReadRoutingConnection<> con( io_service, Manager, redis::ReadPolicy::RoundRobin, 0, redis::NullNotificationSink{}, std::chrono::milliseconds( 50 ) );
+
+            auto readKey = [&]() {
+                boost::system::error_code ec;
+                auto Value = redis::get( con, ec, std::string( "key" ) );
+                Assert::IsFalse( !!ec );
+                return Value.second ? std::string( boost::asio::buffer_cast<const char*>( *Value.second ), boost::asio::buffer_size( *Value.second ) ) : std::string();
+            };
+
+            // no replica known yet - the master answers while the discovery runs
+            Assert::IsTrue( readKey() == "master" );
+            for( size_t Wait = 0; Wait < 100 && !Manager.replicas().size(); ++Wait )
+                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            Assert::IsTrue( readKey() == "replica" );
+            Assert::IsTrue( con.replicaConnections() == 1 );
+
+            // a replica still loading its dataset counts as failed - the master answers and the replica is skipped
+            Replica.setScript( []( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                if( TheCommand[0] == "GET" )
+                    Action.Reply = "-LOADING Redis is loading the dataset in memory\r\n";
+                return Action;
+            } );
+            Assert::IsTrue( readKey() == "master" );
+            redis::Host Selected;
+            redis::ReplicaSet::StatisticsHandle spStatistics;
+            Assert::IsFalse( Manager.replicas().select( redis::ReadPolicy::RoundRobin, Selected, spStatistics ) );
+
+            // the connection to a replica the sentinel no longer reports is closed
+            Sentinel.setReplicas( "mymaster", {} );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 60 ) );
+            Assert::IsTrue( readKey() == "master" );
+            for( size_t Wait = 0; Wait < 100 && Manager.replicas().size(); ++Wait )
+                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            Assert::IsTrue( readKey() == "master" );
+            Assert::IsTrue( con.replicaConnections() == 0 );
+        }
+
+        TEST_METHOD( Redis_Cluster_RequestKey )
+        {
+            auto key = []( redis::Request&& Command ) {
+                boost::asio::const_buffer Key;
+                if( !redis::requestKey( Command, Key ) )
+                    return std::string( "-" );
+                return std::string( boost::asio::buffer_cast<const char*>( Key ), boost::asio::buffer_size( Key ) );
+            };
+
+            Assert::IsTrue( key( redis::Request( "GET", "foo" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "set", "foo", "bar" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "EVALSHA", "0123abcd", "2", "foo", "bar", "argument" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "eval", "return 1", "1", "foo" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "FCALL_RO", "myfunction", "1", "foo" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "XREADGROUP", "GROUP", "streams", "consumer", "COUNT", "10", "STREAMS", "foo", ">" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "XREAD", "BLOCK", "0", "streams", "foo", "$" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "ZUNION", "2", "foo", "bar" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "BZMPOP", "1.5", "1", "foo", "MIN" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "OBJECT", "ENCODING", "foo" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "XGROUP", "CREATE", "foo", "group", "$" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "MIGRATE", "host", "6379", "foo", "0", "1000" ) ) == "foo" );
+            Assert::IsTrue( key( redis::Request( "MIGRATE", "host", "6379", "", "0", "1000", "REPLACE", "KEYS", "foo", "bar" ) ) == "foo" );
+
+            // commands without a key
+            Assert::IsTrue( key( redis::Request( "PING" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "ECHO", "foo" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "SCAN", "0" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "CLUSTER", "SHARDS" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "EVALSHA", "0123abcd", "0", "argument" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "MEMORY", "STATS" ) ) == "-" );
+            Assert::IsTrue( key( redis::Request( "XREAD", "COUNT", "1" ) ) == "-" );
+
+            uint16_t Slot;
+            Assert::IsTrue( redis::Detail::requestSlot( redis::Request( "EVALSHA", "0123abcd", "1", "{user1000}.following" ), Slot ) );
+            Assert::IsTrue( Slot == redis::hashSlot( std::string( "user1000" ) ) );
+            Assert::IsFalse( redis::Detail::requestSlot( redis::Request( "INFO", "replication" ), Slot ) );
+        }
+
+        TEST_METHOD( Redis_Cluster_ShardsResult )
+        {
+            using namespace redis::Detail;
+            auto node = []( const std::string& Endpoint, int64_t Port, const std::string& Role, const std::string& Health ) {
+                return respArray( { respBulk( "id" ), respBulk( "e5c4" ), respBulk( "port" ), respInteger( Port ), respBulk( "ip" ), respBulk( "10.0.0.1" ),
+                                    respBulk( "endpoint" ), respBulk( Endpoint ), respBulk( "role" ), respBulk( Role ), respBulk( "health" ), respBulk( Health ) } );
+            };
+            auto Shards = respArray( {
+                respArray( { respBulk( "slots" ), respArray( { respInteger( 0 ), respInteger( 100 ), respInteger( 200 ), respInteger( 300 ) } ),
+                             respBulk( "nodes" ), respArray( { node( "replica1", 7001, "replica", "online" ), node( "master1", 7000, "master", "online" ), node( "replica2", 7002, "replica", "loading" ) } ) } ),
+                // the endpoint is unknown - the ip is used
+                respArray( { respBulk( "slots" ), respArray( { respInteger( 101 ), respInteger( 199 ) } ),
+                             respBulk( "nodes" ), respArray( { node( "?", 7003, "master", "online" ) } ) } ),
+                // no slots assigned
+                respArray( { respBulk( "slots" ), respArray( {} ), respBulk( "nodes" ), respArray( { node( "master3", 7004, "master", "online" ) } ) } ) } );
+
+            redis::ResponseHandler<> res( 64 );
+            boost::system::error_code ec;
+            auto Responses = testitmultiple( Shards, res, 1, ec );
+            Assert::IsFalse( !!ec );
+
+            auto Ranges = redis::clusterShardsResult( *Responses[0], ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Ranges.size() == 3 );
+            Assert::IsTrue( Ranges[0].Start == 0 && Ranges[0].End == 100 && Ranges[0].Master == redis::Host( "master1", 7000 ) );
+            Assert::IsTrue( Ranges[0].Replicas.size() == 1 && Ranges[0].Replicas[0] == redis::Host( "replica1", 7001 ) );
+            Assert::IsTrue( Ranges[1].Start == 200 && Ranges[1].End == 300 && Ranges[1].Master == redis::Host( "master1", 7000 ) );
+            Assert::IsTrue( Ranges[2].Start == 101 && Ranges[2].End == 199 && Ranges[2].Master == redis::Host( "10.0.0.1", 7003 ) );
+
+            // a node without port
+            auto Broken = respArray( { respArray( { respBulk( "slots" ), respArray( { respInteger( 0 ), respInteger( 1 ) } ),
+                                                    respBulk( "nodes" ), respArray( { respArray( { respBulk( "role" ), respBulk( "master" ) } ) } ) } ) } );
+            Responses = testitmultiple( Broken, res, 1, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( redis::clusterShardsResult( *Responses[0], ec ).empty() );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::protocol_error ) );
+        }
+
+        TEST_METHOD( Redis_Cluster_Routing )
+        {
+            // two masters: First serves the slots 0 - 8191, Second the slots 8192 - 16383
+            redis::MockServer First, Second;
+            auto Shards = [&]() {
+                using namespace redis::Detail;
+                auto shard = []( int64_t Start, int64_t End, const redis::Host& Master ) {
+                    return respArray( { respBulk( "slots" ), respArray( { respInteger( Start ), respInteger( End ) } ),
+                                        respBulk( "nodes" ), respArray( { respArray( { respBulk( "port" ), respInteger( std::get<1>( Master ) ), respBulk( "ip" ), respBulk( std::get<0>( Master ) ),
+                                                                                       respBulk( "role" ), respBulk( "master" ), respBulk( "health" ), respBulk( "online" ) } ) } ) } );
+                };
+                return respArray( { shard( 0, 8191, First.host() ), shard( 8192, 16383, Second.host() ) } );
+            }();
+            auto script = [Shards]( const std::string& Name ) {
+                return [Shards, Name]( const redis::MockServer::Command& TheCommand ) {
+                    redis::MockAction Action;
+                    if( TheCommand[0] == "CLUSTER" )
+                        Action.Reply = Shards;
+                    if( TheCommand[0] == "EVALSHA" || TheCommand[0] == "XREADGROUP" )
+                        Action.Reply = redis::Detail::respSimple( Name );
+                    return Action;
+                };
+            };
+            First.setScript( script( "first" ) );
+            Second.setScript( script( "second" ) );
+
+            // "foo" is in slot 12182, "bar" in slot 5061
+            Assert::IsTrue( redis::hashSlot( std::string( "bar" ) ) < 8192 );
+
+            boost::asio::io_service io_service;
+            redis::ClusterConnectionManager<> Manager( { First.host() } );
+            redis::ClusterConnection<> con( io_service, Manager );
+
+            boost::system::error_code ec;
+            auto spResult = con.transmit( redis::Request( "EVALSHA", "0123abcd", "1", "foo" ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( spResult->top().string() == "second" );
+            Assert::IsTrue( Manager.masters().size() == 2 );
+
+            spResult = con.transmit( redis::Request( "XREADGROUP", "GROUP", "group", "consumer", "STREAMS", "bar", ">" ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( spResult->top().string() == "first" );
+
+            // the pipeline is split per node and the replies are returned in order
+            redis::Pipeline Commands;
+            Commands << redis::setCommand( std::string( "foo" ), std::string( "1" ) )
+                     << redis::setCommand( std::string( "bar" ), std::string( "2" ) )
+                     << redis::getCommand( std::string( "foo" ) )
+                     << redis::Request( "EVALSHA", "0123abcd", "1", "bar" )
+                     << redis::getCommand( std::string( "bar" ) );
+            auto Result = con.transmit( Commands, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result.size() == 5 );
+            Assert::IsTrue( Result[2].string() == "1" );
+            Assert::IsTrue( Result[3].string() == "first" );
+            Assert::IsTrue( Result[4].string() == "2" );
+            Assert::IsTrue( *Second.value( "foo" ) == "1" && !First.value( "foo" ) );
+            Assert::IsTrue( *First.value( "bar" ) == "2" && !Second.value( "bar" ) );
+        }
+
+        TEST_METHOD( Redis_Cluster_Topology_Load )
+        {
+            // only servers not knowing CLUSTER SHARDS are asked with CLUSTER SLOTS
+            Assert::IsTrue( redis::Detail::unknownCommand( "ERR unknown subcommand 'shards'. Try CLUSTER HELP." ) );
+            Assert::IsTrue( redis::Detail::unknownCommand( "ERR Unknown subcommand or wrong number of arguments for 'SHARDS'. Try CLUSTER HELP." ) );
+            Assert::IsTrue( redis::Detail::unknownCommand( "ERR unknown command 'CLUSTER'" ) );
+            Assert::IsFalse( redis::Detail::unknownCommand( "ERR This instance has cluster support disabled" ) );
+            Assert::IsFalse( redis::Detail::unknownCommand( "LOADING Redis is loading the dataset in memory" ) );
+
+            redis::MockServer Node;
+            auto Shards = redis::Detail::respArray( { redis::Detail::respArray( { redis::Detail::respBulk( "slots" ), redis::Detail::respArray( { redis::Detail::respInteger( 0 ), redis::Detail::respInteger( 16383 ) } ),
+                redis::Detail::respBulk( "nodes" ), redis::Detail::respArray( { redis::Detail::respArray( { redis::Detail::respBulk( "port" ), redis::Detail::respInteger( std::get<1>( Node.host() ) ), redis::Detail::respBulk( "ip" ), redis::Detail::respBulk( std::get<0>( Node.host() ) ),
+                                                                                                          redis::Detail::respBulk( "role" ), redis::Detail::respBulk( "master" ), redis::Detail::respBulk( "health" ), redis::Detail::respBulk( "online" ) } ) } ) } ) } );
+            Node.setScript( [Shards]( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                if( TheCommand[0] == "CLUSTER" )
+                {
+                    Action.Reply = Shards;
+                    Action.Latency = std::chrono::milliseconds( 100 );
+                }
+                return Action;
+            } );
+
+            // callers starting while the first slot map is loaded wait for it instead of failing
+            redis::ClusterConnectionManager<> Manager( { Node.host() } );
+            std::vector<std::future<boost::system::error_code>> Callers;
+            for( size_t Count = 0; Count < 3; ++Count )
+                Callers.push_back( std::async( std::launch::async, [&Manager]() {
+                    boost::asio::io_service io_service;
+                    redis::ClusterConnection<> con( io_service, Manager );
+                    boost::system::error_code ec;
+                    redis::get( con, ec, std::string( "key" ) );
+                    return ec;
+                } ) );
+            for( auto& Caller : Callers )
+                Assert::IsFalse( !!Caller.get() );
+        }
+
+        TEST_METHOD( Redis_Cluster_Transactions )
+        {
+            // First serves the slots 0 - 8191 with "bar", Second the slots 8192 - 16383 with "foo"
+            redis::MockServer First, Second;
+            auto Shards = [&]() {
+                using namespace redis::Detail;
+                auto shard = []( int64_t Start, int64_t End, const redis::Host& Master ) {
+                    return respArray( { respBulk( "slots" ), respArray( { respInteger( Start ), respInteger( End ) } ),
+                                        respBulk( "nodes" ), respArray( { respArray( { respBulk( "port" ), respInteger( std::get<1>( Master ) ), respBulk( "ip" ), respBulk( std::get<0>( Master ) ),
+                                                                                       respBulk( "role" ), respBulk( "master" ), respBulk( "health" ), respBulk( "online" ) } ) } ) } );
+                };
+                return respArray( { shard( 0, 8191, First.host() ), shard( 8192, 16383, Second.host() ) } );
+            }();
+            Second.setScript( [Shards]( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                if( TheCommand[0] == "CLUSTER" )
+                    Action.Reply = Shards;
+                return Action;
+            } );
+            First.setScript( [Shards, &Second]( const redis::MockServer::Command& TheCommand ) {
+                redis::MockAction Action;
+                if( TheCommand[0] == "CLUSTER" )
+                    Action.Reply = Shards;
+                // "moved" has been migrated to Second
+                if( TheCommand.size() > 1 && TheCommand[1] == "moved" )
+                    Action.Reply = redis::Detail::respError( "MOVED " + std::to_string( redis::hashSlot( std::string( "moved" ) ) ) + " " + std::get<0>( Second.host() ) + ":" + std::to_string( std::get<1>( Second.host() ) ) );
+                return Action;
+            } );
+            Assert::IsTrue( redis::hashSlot( std::string( "moved" ) ) < 8192 );
+
+            boost::asio::io_service io_service;
+            redis::ClusterConnectionManager<> Manager( { First.host() } );
+            redis::ClusterConnection<> con( io_service, Manager );
+
+            // MULTI and EXEC are sent to the node of the transaction, not to the one of the following request
+            boost::system::error_code ec;
+            redis::Pipeline Commands;
+            Commands << redis::Request( "MULTI" ) << redis::setCommand( std::string( "bar" ), std::string( "1" ) ) << redis::Request( "EXEC" )
+                     << redis::getCommand( std::string( "foo" ) );
+            auto Result = con.transmit( Commands, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result[2].type() == redis::Response::Type::Array && Result[2].elements().size() == 1 );
+            Assert::IsTrue( *First.value( "bar" ) == "1" );
+
+            // a transaction with keys on both nodes is rejected before anything is sent
+            auto FirstCommands = First.commands(), SecondCommands = Second.commands();
+            redis::Pipeline CrossNode;
+            CrossNode << redis::Request( "MULTI" ) << redis::setCommand( std::string( "bar" ), std::string( "2" ) ) << redis::setCommand( std::string( "foo" ), std::string( "2" ) ) << redis::Request( "EXEC" );
+            con.transmit( CrossNode, ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::cross_node_transaction ) );
+            Assert::IsTrue( First.commands() == FirstCommands && Second.commands() == SecondCommands );
+
+            // a redirected transaction is repeated as a whole on the new node
+            redis::Pipeline Redirected;
+            Redirected << redis::Request( "MULTI" ) << redis::setCommand( std::string( "moved" ), std::string( "3" ) ) << redis::Request( "EXEC" );
+            Result = con.transmit( Redirected, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result[0].string() == "OK" && Result[1].string() == "QUEUED" );
+            Assert::IsTrue( Result[2].type() == redis::Response::Type::Array && Result[2].elements().size() == 1 );
+            Assert::IsTrue( *Second.value( "moved" ) == "3" && !First.value( "moved" ) );
+        }
+
+        TEST_METHOD( Redis_Sharding_Routing )
+        {
+            redis::MockServer First, Second;
+            auto script = []( const std::string& Name ) {
+                return [Name]( const redis::MockServer::Command& TheCommand ) {
+                    redis::MockAction Action;
+                    if( TheCommand[0] == "EVALSHA" )
+                        Action.Reply = redis::Detail::respSimple( Name );
+                    return Action;
+                };
+            };
+            First.setScript( script( "first" ) );
+            Second.setScript( script( "second" ) );
+
+            redis::ShardedConnectionManager<> Manager( { { First.host(), 1 }, { Second.host(), 1 } } );
+            boost::asio::io_service io_service;
+            redis::ShardedConnection<> con( io_service, Manager );
+
+            // a key of each shard
+            std::map<redis::Host, std::string> Keys;
+            for( size_t Index = 0; Keys.size() < 2; ++Index )
+            {
+                redis::Host Node;
+                Assert::IsTrue( Manager.shardForKey( "key" + std::to_string( Index ), Node ) );
+                Keys.emplace( Node, "key" + std::to_string( Index ) );
+            }
+
+            // routed by the key, not by the script hash
+            boost::system::error_code ec;
+            auto spResult = con.transmit( redis::Request( "EVALSHA", "0123abcd", "1", Keys[First.host()] ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( spResult->top().string() == "first" );
+            spResult = con.transmit( redis::Request( "EVALSHA", "0123abcd", "1", Keys[Second.host()] ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( spResult->top().string() == "second" );
+
+            // requests without a key need an explicit shard
+            auto FirstCommands = First.commands(), SecondCommands = Second.commands();
+            con.transmit( redis::Request( "ECHO", "hello" ), ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::keyless_request ) );
+            redis::Pipeline Pings;
+            Pings << redis::Request( "PING" ) << redis::Request( "PING" );
+            con.transmit( Pings, ec );
+            Assert::IsTrue( ec == redis::make_error_code( redis::ErrorCodes::keyless_request ) );
+            Assert::IsTrue( First.commands() == FirstCommands && Second.commands() == SecondCommands );
+
+            con.setKeylessShard( Second.host() );
+            spResult = con.transmit( redis::Request( "ECHO", "hello" ), ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( spResult->top().string() == "hello" );
+            Assert::IsTrue( con.transmit( Pings, ec ).size() == 2 );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( First.commands() == FirstCommands && Second.commands() == SecondCommands + 3 );
+            con.clearKeylessShard();
+
+            // MULTI and EXEC stay with the key of the transaction
+            redis::Pipeline Transaction;
+            Transaction << redis::Request( "MULTI" ) << redis::setCommand( Keys[Second.host()], std::string( "value" ) ) << redis::Request( "EXEC" );
+            auto Result = con.transmit( Transaction, ec );
+            Assert::IsFalse( !!ec );
+            Assert::IsTrue( Result[2].type() == redis::Response::Type::Array );
+            Assert::IsTrue( *Second.value( Keys[Second.host()] ) == "value" );
+        }
+
+        TEST_METHOD( Redis_Response_Move_Tail )
+        {
+            // a pub/sub stream: nested frames, split at every possible position
+            std::string Stream;
+            for( size_t Index = 0; Index < 20; ++Index )
+            {
+                auto Payload = std::string( Index * 7, static_cast<char>( 'a' + Index ) );
+                Stream += "*3\r\n$7\r\nmessage\r\n$7\r\nchannel\r\n$" + std::to_string( Payload.size() ) + "\r\n" + Payload + "\r\n";
+                Stream += "*2\r\n*1\r\n:" + std::to_string( Index ) + "\r\n+OK\r\n";
+            }
+
+            for( size_t Split = 1; Split < Stream.size(); Split += 3 )
+            {
+                auto spHandler = std::make_unique<redis::ResponseHandler<>>( 16 );
+                std::vector<std::shared_ptr<redis::Response>> Responses;
+                std::vector<std::shared_ptr<redis::ResponseHandler<>::BufferContainerType>> Leases;
+
+                size_t Position = 0;
+                while( Position < Stream.size() )
+                {
+                    auto Buffer = spHandler->buffer();
+                    auto Bytes = std::min( { boost::asio::buffer_size( Buffer ), Stream.size() - Position, Position < Split ? Split - Position : Stream.size() } );
+                    memcpy( boost::asio::buffer_cast<char*>( Buffer ), Stream.data() + Position, Bytes );
+                    Position += Bytes;
+
+                    if( spHandler->dataReceived( Bytes ) )
+                    {
+                        do
+                        {
+                            Responses.push_back( spHandler->spTop() );
+                        } while( spHandler->commit( true ) );
+                    }
+
+                    // replace the handler after every chunk - with or without a partial response
+                    Leases.push_back( spHandler->bufferContainer() );
+                    auto spFresh = std::make_unique<redis::ResponseHandler<>>( 16 );
+                    spHandler->moveTail( *spFresh );
+                    spHandler = std::move( spFresh );
+                }
+
+                Assert::IsTrue( Responses.size() == 40 );
+                for( size_t Index = 0; Index < 20; ++Index )
+                {
+                    Assert::IsTrue( (*Responses[2 * Index])[2].string() == std::string( Index * 7, static_cast<char>( 'a' + Index ) ) );
+                    Assert::IsTrue( (*Responses[2 * Index + 1])[0][0].asint() == static_cast<int64_t>( Index ) );
+                    Assert::IsTrue( (*Responses[2 * Index + 1])[1].string() == "OK" );
+                }
+            }
+        }
+
+        TEST_METHOD( Redis_Subscriber_Dispatch_And_Resubscribe )
+        {
+            // the mock server has no pub/sub - a subscription is answered with the confirmation and, once armed,
+            // a canned series of messages
+            const size_t Messages = 60;
+            std::atomic<bool> Armed{ true };
+            auto payload = []( size_t Index ) { return std::to_string( Index ) + ":" + std::string( 10000, static_cast<char>( 'a' + Index % 26 ) ); };
+
+            redis::MockServer Server;
+            Server.setScript( [&payload, &Armed]( const redis::MockServer::Command& TheCommand ) {
+                using namespace redis::Detail;
+                redis::MockAction Action;
+                if( TheCommand[0] == "SUBSCRIBE" )
+                {
+                    std::string Reply = respArray( { respBulk( "subscribe" ), respBulk( TheCommand[1] ), respInteger( 1 ) } );
+                    if( Armed.exchange( false ) )
+                        for( size_t Index = 0; Index < Messages; ++Index )
+                            Reply += respArray( { respBulk( "message" ), respBulk( TheCommand[1] ), respBulk( payload( Index ) ) } );
+                    Action.Reply = Reply;
+                }
+                if( TheCommand[0] == "PSUBSCRIBE" )
+                    Action.Reply = respArray( { respBulk( "psubscribe" ), respBulk( TheCommand[1] ), respInteger( 2 ) } )
+                                 + respArray( { respBulk( "pmessage" ), respBulk( TheCommand[1] ), respBulk( "news.sport" ), respBulk( "goal" ) } );
+                return Action;
+            } );
+            // the frames are split over many reads - the receive buffers are replaced in the middle of a frame
+            Server.setMaximumWriteSize( 7000 );
+
+            std::mutex Mutex;
+            std::vector<std::string> Received;
+            std::vector<std::string> Patterns;
+
+            redis::SingleHostConnectionManager Manager( Server.host() );
+            redis::Subscriber<redis::SingleHostConnectionManager> Subscriber( Manager, 2 );
+            Subscriber.subscribe( "channel", [&]( const redis::SubscriberMessage& Message ) {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Received.emplace_back( boost::asio::buffer_cast<const char*>( Message.Payload ), boost::asio::buffer_size( Message.Payload ) );
+            } );
+            Subscriber.psubscribe( "news.*", [&]( const redis::SubscriberMessage& Message ) {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Patterns.push_back( std::string( boost::asio::buffer_cast<const char*>( Message.Pattern ), boost::asio::buffer_size( Message.Pattern ) ) + " "
+                                  + std::string( boost::asio::buffer_cast<const char*>( Message.Channel ), boost::asio::buffer_size( Message.Channel ) ) + " "
+                                  + std::string( boost::asio::buffer_cast<const char*>( Message.Payload ), boost::asio::buffer_size( Message.Payload ) ) );
+            } );
+
+            auto waitFor = [&]( size_t Count ) {
+                for( int Attempt = 0; Attempt < 1000; ++Attempt )
+                {
+                    {
+                        std::lock_guard<std::mutex> Lock( Mutex );
+                        if( Received.size() >= Count && !Patterns.empty() )
+                            return true;
+                    }
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                }
+                return false;
+            };
+
+            // the messages of a channel arrive in order and intact
+            Assert::IsTrue( waitFor( Messages ) );
+            {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                for( size_t Index = 0; Index < Messages; ++Index )
+                    Assert::IsTrue( Received[Index] == payload( Index ) );
+                Assert::IsTrue( Patterns.front() == "news.* news.sport goal" );
+            }
+
+            // after a connection loss the subscriptions are renewed
+            size_t Before;
+            {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                Before = Received.size();
+            }
+            Armed = true;
+            Server.dropConnections();
+            Assert::IsTrue( waitFor( Before + Messages ) );
+            {
+                std::lock_guard<std::mutex> Lock( Mutex );
+                for( size_t Index = 0; Index < Messages; ++Index )
+                    Assert::IsTrue( Received[Before + Index] == payload( Index ) );
+            }
+
+            auto Statistics = Subscriber.statistics();
+            Assert::IsTrue( Statistics.Reconnects >= 1 );
+            Assert::IsTrue( Statistics.Dispatched >= 2 * Messages + 1 );
+            Assert::IsTrue( Statistics.Unrouted == 0 );
+        }
     };
 }
\ No newline at end of file